@@ -650,12 +650,32 @@ typedef void          (AL_APIENTRY *LPALSPEEDOFSOUND)(ALfloat value);
 typedef void          (AL_APIENTRY *LPALDISTANCEMODEL)(ALenum distanceModel);
 
 #define AL_EXT_TRACE_INFO 1
+AL_API void AL_APIENTRY alTracePushScope(const ALchar *str);
+AL_API void AL_APIENTRY alTracePopScope(void);
+AL_API void AL_APIENTRY alTraceMessage(const ALchar *str);
+AL_API void AL_APIENTRY alTraceBufferLabel(ALuint name, const ALchar *str);
+AL_API void AL_APIENTRY alTraceSourceLabel(ALuint name, const ALchar *str);
 typedef void          (AL_APIENTRY *LPALTRACEPUSHSCOPE)(const ALchar *str);
 typedef void          (AL_APIENTRY *LPALTRACEPOPSCOPE)(void);
 typedef void          (AL_APIENTRY *LPALTRACEMESSAGE)(const ALchar *str);
 typedef void          (AL_APIENTRY *LPALTRACEBUFFERLABEL)(ALuint name, const ALchar *str);
 typedef void          (AL_APIENTRY *LPALTRACESOURCELABEL)(ALuint name, const ALchar *str);
 
+#define AL_SOFT_deferred_updates 1
+#define AL_DEFERRED_UPDATES_SOFT 0xC002
+AL_API void AL_APIENTRY alDeferUpdatesSOFT(void);
+AL_API void AL_APIENTRY alProcessUpdatesSOFT(void);
+typedef void          (AL_APIENTRY *LPALDEFERUPDATESSOFT)(void);
+typedef void          (AL_APIENTRY *LPALPROCESSUPDATESSOFT)(void);
+
+#define AL_EXT_STATIC_BUFFER 1
+AL_API void AL_APIENTRY alBufferDataStatic(ALuint buffer, ALenum format, ALvoid *data, ALsizei size, ALsizei freq);
+typedef void          (AL_APIENTRY *LPALBUFFERDATASTATIC)(ALuint buffer, ALenum format, ALvoid *data, ALsizei size, ALsizei freq);
+
+#define AL_EXT_SOUND_BANK 1
+AL_API ALsizei AL_APIENTRY alLoadSoundBank(const ALchar *path, ALsizei n, const ALuint *buffers);
+typedef ALsizei       (AL_APIENTRY *LPALLOADSOUNDBANK)(const ALchar *path, ALsizei n, const ALuint *buffers);
+
 #if defined(__cplusplus)
 }  /* extern "C" */
 #endif
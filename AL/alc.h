@@ -231,8 +231,70 @@ typedef void           (ALC_APIENTRY *LPALCCAPTURESTOP)(ALCdevice *device);
 typedef void           (ALC_APIENTRY *LPALCCAPTURESAMPLES)(ALCdevice *device, ALCvoid *buffer, ALCsizei samples);
 
 #define ALC_EXT_TRACE_INFO 1
+ALC_API void       ALC_APIENTRY alcTraceDeviceLabel(ALCdevice *device, const ALCchar *str);
+ALC_API void       ALC_APIENTRY alcTraceContextLabel(ALCcontext *ctx, const ALCchar *str);
+ALC_API ALCboolean ALC_APIENTRY alcTraceDump(const ALCchar *path);
 typedef void          (AL_APIENTRY *LPALCTRACEDEVICELABEL)(ALCdevice *device, const ALCchar *str);
 typedef void          (AL_APIENTRY *LPALCTRACECONTEXTLABEL)(ALCcontext *ctx, const ALCchar *str);
+typedef ALCboolean    (AL_APIENTRY *LPALCTRACEDUMP)(const ALCchar *path);
+
+#define ALC_SOFT_loopback 1
+#define ALC_BYTE_SOFT                            0x1400
+#define ALC_UNSIGNED_BYTE_SOFT                   0x1401
+#define ALC_SHORT_SOFT                           0x1402
+#define ALC_UNSIGNED_SHORT_SOFT                  0x1403
+#define ALC_INT_SOFT                             0x1404
+#define ALC_UNSIGNED_INT_SOFT                    0x1405
+#define ALC_FLOAT_SOFT                           0x1406
+#define ALC_MONO_SOFT                            0x1500
+#define ALC_STEREO_SOFT                          0x1501
+#define ALC_QUAD_SOFT                            0x1503
+#define ALC_5POINT1_SOFT                         0x1504
+#define ALC_6POINT1_SOFT                         0x1505
+#define ALC_7POINT1_SOFT                         0x1506
+#define ALC_FORMAT_CHANNELS_SOFT                 0x1990
+#define ALC_FORMAT_TYPE_SOFT                     0x1991
+ALC_API ALCdevice* ALC_APIENTRY alcLoopbackOpenDeviceSOFT(const ALCchar *deviceName);
+ALC_API ALCboolean ALC_APIENTRY alcIsRenderFormatSupportedSOFT(ALCdevice *device, ALCsizei freq, ALCenum channels, ALCenum type);
+ALC_API void       ALC_APIENTRY alcRenderSamplesSOFT(ALCdevice *device, ALCvoid *buffer, ALCsizei samples);
+typedef ALCdevice* (ALC_APIENTRY *LPALCLOOPBACKOPENDEVICESOFT)(const ALCchar *deviceName);
+typedef ALCboolean (ALC_APIENTRY *LPALCISRENDERFORMATSUPPORTEDSOFT)(ALCdevice *device, ALCsizei freq, ALCenum channels, ALCenum type);
+typedef void       (ALC_APIENTRY *LPALCRENDERSAMPLESSOFT)(ALCdevice *device, ALCvoid *buffer, ALCsizei samples);
+
+#define ALC_EXT_thread_local_context 1
+ALC_API ALCboolean  ALC_APIENTRY alcSetThreadContext(ALCcontext *context);
+ALC_API ALCcontext* ALC_APIENTRY alcGetThreadContext(void);
+typedef ALCboolean  (ALC_APIENTRY *PFNALCSETTHREADCONTEXTPROC)(ALCcontext *context);
+typedef ALCcontext* (ALC_APIENTRY *PFNALCGETTHREADCONTEXTPROC)(void);
+
+#define ALC_EXT_MIXER_STATS 1
+#if defined(_MSC_VER)
+typedef __int64 ALCint64SOFT;
+#else
+typedef long long ALCint64SOFT;
+#endif
+#define ALC_MIX_CALLBACKS                        0x1F200
+#define ALC_MIX_TIME_NS                          0x1F201
+#define ALC_MIX_TIME_AVG_NS                      0x1F202
+#define ALC_MIX_TIME_MAX_NS                      0x1F203
+#define ALC_MIX_TIME_TOTAL_NS                    0x1F204
+#define ALC_MIX_VOICES                           0x1F205
+#define ALC_MIX_VOICES_RESAMPLED                 0x1F206
+#define ALC_MIX_VOICES_PITCH_SHIFTED             0x1F207
+#define ALC_MIX_SOURCE_LOCKS                     0x1F208
+#define ALC_MIX_GAINS_TIME_NS                    0x1F209
+#define ALC_MIX_BUDGET_NS                        0x1F20A
+#define ALC_MIX_OVERRUNS                         0x1F20B
+#define ALC_MIX_LATE_CALLBACKS                   0x1F20C
+#define ALC_MIX_BUDGET_HISTOGRAM                 0x1F20D
+#define ALC_MIX_BUDGET_HISTOGRAM_BUCKETS         11
+#define ALC_MIX_VOICES_VIRTUAL                   0x1F20E
+#define ALC_MIX_QUALITY                          0x1F20F
+typedef void (ALC_APIENTRY *ALCMIXDEADLINEPROC)(ALCdevice *device, ALCenum reason, ALCint64SOFT ns, ALCint64SOFT budget_ns, void *userdata);
+ALC_API void       ALC_APIENTRY alcGetInteger64v(ALCdevice *device, ALCenum param, ALCsizei size, ALCint64SOFT *values);
+ALC_API void       ALC_APIENTRY alcMixDeadlineCallback(ALCdevice *device, ALCMIXDEADLINEPROC callback, void *userdata);
+typedef void       (ALC_APIENTRY *LPALCGETINTEGER64V)(ALCdevice *device, ALCenum param, ALCsizei size, ALCint64SOFT *values);
+typedef void       (ALC_APIENTRY *LPALCMIXDEADLINECALLBACK)(ALCdevice *device, ALCMIXDEADLINEPROC callback, void *userdata);
 
 #if defined(__cplusplus)
 }
@@ -24,6 +24,19 @@
 #include "alc.h"
 #include "SDL.h"
 
+/* Sound banks get memory-mapped where we know how; otherwise we read them into memory. */
+#if defined(_WIN32)
+#define SOUND_BANK_MMAP_WINDOWS 1
+#define WIN32_LEAN_AND_MEAN 1
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#define SOUND_BANK_MMAP_POSIX 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #ifdef __SSE__  /* if you are on x86 or x86-64, we assume you have SSE1 by now. */
 #define NEED_SCALAR_FALLBACK 0
 #elif (defined(__ARM_ARCH) && (__ARM_ARCH >= 8))  /* ARMv8 always has NEON. */
@@ -47,10 +60,41 @@
 #include <xmmintrin.h>
 #endif
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/* AVX/AVX2/AVX-512 mixers are built regardless of compiler flags and chosen at runtime. */
+#if defined(__SSE__) && (defined(__GNUC__) || defined(__clang__))
+#define HAVE_AVX_MIXERS 1
+#define TARGET_AVX __attribute__((target("avx")))
+#define TARGET_AVX2_FMA __attribute__((target("avx2,fma")))
+#define TARGET_AVX512 __attribute__((target("avx2,fma,avx512f")))
+#include <immintrin.h>
+#include <cpuid.h>
+#elif defined(__SSE__) && defined(_MSC_VER)
+#define HAVE_AVX_MIXERS 1
+#define TARGET_AVX
+#define TARGET_AVX2_FMA
+#define TARGET_AVX512
+#include <immintrin.h>
+#include <intrin.h>
+#else
+#define HAVE_AVX_MIXERS 0
+#endif
+
 #ifdef __ARM_NEON__
 #include <arm_neon.h>
 #endif
 
+/* Batched spatialization needs vector division and square roots, which
+   32-bit ARM NEON doesn't have; those chips do one source at a time. */
+#if defined(__SSE__) || (defined(__ARM_NEON__) && (defined(__aarch64__) || defined(_M_ARM64)))
+#define HAVE_SPATIALIZE_BATCH 1
+#else
+#define HAVE_SPATIALIZE_BATCH 0
+#endif
+
 #define OPENAL_VERSION_MAJOR 1
 #define OPENAL_VERSION_MINOR 1
 #define OPENAL_VERSION_STRING3(major, minor) #major "." #minor
@@ -63,6 +107,7 @@
 
 #define DEFAULT_PLAYBACK_DEVICE "Default OpenAL playback device"
 #define DEFAULT_CAPTURE_DEVICE "Default OpenAL capture device"
+#define LOOPBACK_DEVICE "OpenAL loopback device"
 
 /* Number of buffers to allocate at once when we need a new block during alGenBuffers(). */
 #ifndef OPENAL_BUFFER_BLOCK_SIZE
@@ -74,6 +119,69 @@
 #define OPENAL_SOURCE_BLOCK_SIZE 64
 #endif
 
+/* Number of source commands (play, stop, seek, etc) that can wait for the mixer at once, per context. Must be a power of two. */
+#ifndef OPENAL_SOURCE_COMMAND_RING_SIZE
+#define OPENAL_SOURCE_COMMAND_RING_SIZE 1024
+#endif
+
+/* Source names are the source's index (plus one) in the low bits, and a tag
+   from the slot's generation in the rest, so a stale name never matches a
+   source that reused its slot. This limits a context to about a million sources. */
+#define SOURCE_NAME_INDEX_BITS 20
+#define SOURCE_NAME_INDEX_MASK ((((ALuint) 1) << SOURCE_NAME_INDEX_BITS) - 1)
+#define source_name_tag(generation) ((((ALuint) (generation)) << SOURCE_NAME_INDEX_BITS) & ~SOURCE_NAME_INDEX_MASK)
+
+/* Most threads we'll ever use to mix a single context (including the SDL audio thread). */
+#ifndef OPENAL_MAX_MIXER_THREADS
+#define OPENAL_MAX_MIXER_THREADS 64
+#endif
+
+/* mojoAL-specific context attribute: number of threads that mix this context's sources. */
+#ifndef ALC_MIXER_THREADS
+#define ALC_MIXER_THREADS 0x1F000
+#endif
+
+/* mojoAL-specific context attribute: most voices we'll mix at once; the rest go virtual. 0 (the default) is no limit. */
+#ifndef ALC_MAX_REAL_VOICES
+#define ALC_MAX_REAL_VOICES 0x1F001
+#endif
+
+/* mojoAL-specific context attribute: ALC_TRUE to let the device trade mix quality for time when it's overloaded. Defaults to ALC_FALSE. */
+#ifndef ALC_MIX_GOVERNOR
+#define ALC_MIX_GOVERNOR 0x1F002
+#endif
+
+/* mojoAL-specific source property: AL_TRUE to change pitch without changing playback speed. */
+#ifndef AL_PITCH_PRESERVE_DURATION
+#define AL_PITCH_PRESERVE_DURATION 0x1F100
+#endif
+
+/* mojoAL-specific source property: when more than ALC_MAX_REAL_VOICES are audible, higher priorities get mixed first. Defaults to 0. */
+#ifndef AL_SOURCE_PRIORITY
+#define AL_SOURCE_PRIORITY 0x1F101
+#endif
+
+/* Playing voices quieter than this in both channels, after every gain and
+   panning, are virtual: they don't get decoded, resampled or mixed, their
+   offset just moves along like it would have. 0.00001 is -100dB, below
+   anything 16-bit output can represent. */
+#ifndef OPENAL_VIRTUAL_VOICE_GAIN
+#define OPENAL_VIRTUAL_VOICE_GAIN 0.00001f
+#endif
+
+/* When more voices are audible than we'll mix, a virtual voice has to be
+   this much louder than one we're already mixing (at the same priority) to
+   take its place, so voices near the limit don't swap back and forth
+   every callback. 1.25 is about 2dB. */
+#ifndef OPENAL_CULL_HYSTERESIS
+#define OPENAL_CULL_HYSTERESIS 1.25f
+#endif
+
+/* AL_SOFT_deferred_updates support... */
+#ifndef AL_DEFERRED_UPDATES_SOFT
+#define AL_DEFERRED_UPDATES_SOFT 0xC002
+#endif
+
 /* AL_EXT_FLOAT32 support... */
 #ifndef AL_FORMAT_MONO_FLOAT32
 #define AL_FORMAT_MONO_FLOAT32 0x10010
@@ -83,11 +191,122 @@
 #define AL_FORMAT_STEREO_FLOAT32 0x10011
 #endif
 
+/* AL_EXT_IMA4 support... */
+#ifndef AL_FORMAT_MONO_IMA4
+#define AL_FORMAT_MONO_IMA4 0x1300
+#endif
+
+#ifndef AL_FORMAT_STEREO_IMA4
+#define AL_FORMAT_STEREO_IMA4 0x1301
+#endif
+
+/* AL_SOFT_MSADPCM support... */
+#ifndef AL_FORMAT_MONO_MSADPCM_SOFT
+#define AL_FORMAT_MONO_MSADPCM_SOFT 0x1302
+#endif
+
+#ifndef AL_FORMAT_STEREO_MSADPCM_SOFT
+#define AL_FORMAT_STEREO_MSADPCM_SOFT 0x1303
+#endif
+
+/* AL_SOFT_block_alignment support... */
+#ifndef AL_UNPACK_BLOCK_ALIGNMENT_SOFT
+#define AL_UNPACK_BLOCK_ALIGNMENT_SOFT 0x200C
+#endif
+
+/* Largest ADPCM block we'll accept, in sample frames. The mixer decodes a block at a time on the stack. */
+#ifndef OPENAL_MAX_ADPCM_BLOCK_FRAMES
+#define OPENAL_MAX_ADPCM_BLOCK_FRAMES 8192
+#endif
+
 /* ALC_EXT_DISCONNECTED support... */
 #ifndef ALC_CONNECTED
 #define ALC_CONNECTED 0x313
 #endif
 
+/* ALC_SOFT_loopback support... */
+#ifndef ALC_FORMAT_CHANNELS_SOFT
+#define ALC_FORMAT_CHANNELS_SOFT 0x1990
+#endif
+
+#ifndef ALC_FORMAT_TYPE_SOFT
+#define ALC_FORMAT_TYPE_SOFT 0x1991
+#endif
+
+#ifndef ALC_BYTE_SOFT
+#define ALC_BYTE_SOFT 0x1400
+#define ALC_UNSIGNED_BYTE_SOFT 0x1401
+#define ALC_SHORT_SOFT 0x1402
+#define ALC_UNSIGNED_SHORT_SOFT 0x1403
+#define ALC_INT_SOFT 0x1404
+#define ALC_UNSIGNED_INT_SOFT 0x1405
+#define ALC_FLOAT_SOFT 0x1406
+#endif
+
+#ifndef ALC_MONO_SOFT
+#define ALC_MONO_SOFT 0x1500
+#define ALC_STEREO_SOFT 0x1501
+#define ALC_QUAD_SOFT 0x1503
+#define ALC_5POINT1_SOFT 0x1504
+#define ALC_6POINT1_SOFT 0x1505
+#define ALC_7POINT1_SOFT 0x1506
+#endif
+
+/* ALC_EXT_MIXER_STATS support... */
+#ifndef ALC_MIX_CALLBACKS
+#define ALC_MIX_CALLBACKS 0x1F200
+#define ALC_MIX_TIME_NS 0x1F201
+#define ALC_MIX_TIME_AVG_NS 0x1F202
+#define ALC_MIX_TIME_MAX_NS 0x1F203
+#define ALC_MIX_TIME_TOTAL_NS 0x1F204
+#define ALC_MIX_VOICES 0x1F205
+#define ALC_MIX_VOICES_RESAMPLED 0x1F206
+#define ALC_MIX_VOICES_PITCH_SHIFTED 0x1F207
+#define ALC_MIX_SOURCE_LOCKS 0x1F208
+#define ALC_MIX_GAINS_TIME_NS 0x1F209
+#endif
+#ifndef ALC_MIX_BUDGET_NS
+#define ALC_MIX_BUDGET_NS 0x1F20A
+#define ALC_MIX_OVERRUNS 0x1F20B
+#define ALC_MIX_LATE_CALLBACKS 0x1F20C
+#define ALC_MIX_BUDGET_HISTOGRAM 0x1F20D
+#define ALC_MIX_BUDGET_HISTOGRAM_BUCKETS 11
+#endif
+#ifndef ALC_MIX_VOICES_VIRTUAL
+#define ALC_MIX_VOICES_VIRTUAL 0x1F20E
+#endif
+#ifndef ALC_MIX_QUALITY
+#define ALC_MIX_QUALITY 0x1F20F
+#endif
+
+/* A playback callback that arrives more than this percent of its period after the last one started counts as late. */
+#ifndef OPENAL_LATE_CALLBACK_PERCENT
+#define OPENAL_LATE_CALLBACK_PERCENT 150
+#endif
+
+/* The mix quality governor drops a step of quality when OPENAL_GOVERNOR_BUSY_CALLBACKS in a row use more than this percent of their budget... */
+#ifndef OPENAL_GOVERNOR_HIGH_PERCENT
+#define OPENAL_GOVERNOR_HIGH_PERCENT 80
+#endif
+
+#ifndef OPENAL_GOVERNOR_BUSY_CALLBACKS
+#define OPENAL_GOVERNOR_BUSY_CALLBACKS 8
+#endif
+
+/* ...and comes back up a step after OPENAL_GOVERNOR_CALM_CALLBACKS in a row use less than this percent. */
+#ifndef OPENAL_GOVERNOR_LOW_PERCENT
+#define OPENAL_GOVERNOR_LOW_PERCENT 50
+#endif
+
+#ifndef OPENAL_GOVERNOR_CALM_CALLBACKS
+#define OPENAL_GOVERNOR_CALM_CALLBACKS 100
+#endif
+
+/* Loopback devices mix into this many sample frames at a time, then convert to the app's format. */
+#ifndef OPENAL_LOOPBACK_CHUNK_FRAMES
+#define OPENAL_LOOPBACK_CHUNK_FRAMES 1024
+#endif
+
 
 /*
 The locking strategy for this OpenAL implementation:
@@ -96,23 +315,56 @@ The locking strategy for this OpenAL implementation:
   lock free, and it lead to fragile, overly-clever, and complicated code.
   Attempt #2 is making more reasonable tradeoffs.
 
-- All API entry points are protected by a global mutex, which means that
-  calls into the API are serialized, but we expect this to not be a
-  serious problem; most AL calls are likely to come from a single thread
-  and uncontended mutexes generally aren't very expensive. This mutex
-  is not shared with the mixer thread, so there is never a point where
-  an innocent "fast" call into the AL will block because of the bad luck
-  of a high mixing load and the wrong moment.
-
-- In rare cases we'll lock the mixer thread for a brief time; when a playing
-  source is accessible to the mixer, it is flagged as such. The mixer has a
-  mutex that it holds when mixing a source, and if we need to touch a source
-  that is flagged as accessible, we'll grab that lock to make sure there isn't
-  a conflict. Not all source changes need to do this. The likelihood of
-  hitting this case is extremely small, and the lock hold time is pretty
-  short. Things that might do this, only on currently-playing sources:
-  alDeleteSources, alSourceStop, alSourceRewind. alSourcePlay and
-  alSourcePause never need to lock.
+- API entry points are protected by a mutex that belongs to the device
+  they operate on: AL calls use the current context's device (a thread's
+  own context from alcSetThreadContext() wins over the process-wide one,
+  so threads driving different contexts never touch shared state to find
+  theirs), and ALC calls use the device (or context's device) you pass
+  them. Contexts share buffers with the other contexts on their device, so
+  the device is the smallest thing that can own the lock. Calls on the same device are serialized, but
+  we expect this to not be a serious problem; most AL calls are likely to
+  come from a single thread and uncontended mutexes generally aren't very
+  expensive. Calls on different devices don't contend at all, so a process
+  running many independent devices, each with their own context and thread,
+  runs them in parallel. These mutexes are not shared with the mixer thread,
+  so there is never a point where an innocent "fast" call into the AL will
+  block because of the bad luck of a high mixing load and the wrong moment.
+
+- There's still a global api lock, for the few things that aren't owned by
+  a device: device enumeration, errors set with no device or context, and
+  building the shared pitch-shifting tables. Calls with a NULL device or no
+  current context use it, too. A device lock can be held while grabbing the
+  global lock, never the other way around.
+
+- The mixer doesn't take a lock to mix a source. While a source is on the
+  mixer's playlist, or has source commands the mixer hasn't run yet, the
+  mixer owns its offset, resampler and buffer queue, and the API changes
+  those by sending source commands (play, pause, stop, rewind, seek)
+  through a ring for each context instead. The api lock makes the API the
+  only producer, and the mixer is the only consumer; it runs everything
+  published so far at the start of each callback, before it touches any
+  source. Sources the mixer doesn't own, the API just changes directly.
+  AL_SOURCE_STATE belongs to the app and changes immediately; the mixer
+  keeps its own copy, and when it plays a source to the end, it records
+  which alSourcePlay finished instead of writing the state, so it can't
+  stomp on a newer play.
+
+- The API publishes all the commands from one alSourcePlayv, alSourceStopv,
+  etc, at once, so those sources all change in the same callback, and it
+  never locks the mixer to do it. If the ring fills up (the mixer isn't
+  keeping up, or isn't running, like a loopback device nobody is
+  rendering), the API locks the mixer until it publishes and runs the
+  commands itself. ALC_MIX_SOURCE_LOCKS counts those times, so a
+  persistently nonzero rate means OPENAL_SOURCE_COMMAND_RING_SIZE is too
+  small for the app.
+
+- Some things need the mixer to be completely done with a source right now:
+  marking a stopped streaming source's buffers processed, changing
+  AL_BUFFER, and deleting a source, since the app can delete the buffers
+  right after. The device bumps a counter before and after each mix, so
+  it's odd while mixing. After publishing a stop command, the API waits
+  for a mix that's already running to finish; any mix after that runs the
+  command first. Only the API waits; the mixer never waits for the API.
 
 - Devices are expected to live for the entire life of your OpenAL
   experience, so closing one while another thread is using it is your own
@@ -131,9 +383,9 @@ The locking strategy for this OpenAL implementation:
   does not lock the mixer thread.
 
 - Deleting a buffer does not lock the mixer thread (in-use buffers can
-  not be deleted per API spec). Deleting a source will lock the mixer briefly
-  if the source is still visible to the mixer. We don't believe this will be
-  a serious issue in normal use cases. Deleted objects' memory is marked for
+  not be deleted per API spec). Deleting a source the mixer still owns
+  waits for a mix that's already running, as above. We don't believe this
+  will be a serious issue in normal use cases. Deleted objects' memory is marked for
   reuse, but no memory is free'd by deleting sources or buffers until the
   context or device, respectively, are destroyed. A deleted source that's
   still visible to the mixer will not be available for reallocation until
@@ -153,12 +405,47 @@ The locking strategy for this OpenAL implementation:
   need a lock to access as the pointers are immutable once they're wired in.
   We don't keep a ALuint name index array, but rather an array of block
   pointers, which lets us find the right offset in the correct block without
-  iteration. The mixer thread never references the blocks directly, as they
+  iteration. Unallocated objects are kept in a free list (for each device,
+  for buffers, and each context, for sources), so generating and deleting
+  names doesn't walk the blocks either. A deleted source the mixer still
+  owns goes on a separate reclaim list until the mixer lets it go, so
+  it isn't handed out again while the mixer is still looking at it. The mixer thread never references the blocks directly, as they
   get buffer and source pointers to objects within those blocks. Sources keep
   a pointer to their specifically-bound buffer, and the mixer keeps a list of
   pointers to playing sources. Since the API is serialized and the mixer
   doesn't touch them, we don't need to tapdance to add new blocks.
 
+- The source getters that streaming code polls (AL_SOURCE_STATE,
+  AL_BUFFERS_PROCESSED, and AL_SAMPLE_OFFSET on static sources) don't take
+  any lock. Each source slot has an atomic generation, bumped when the
+  source is generated (making it odd) and deleted (even again), and a
+  source's name carries a tag of its generation. The lockless reader finds
+  the slot (the table of source block pointers is replaced, never realloc'd
+  in place, and old tables live until the context dies, so the reader
+  never touches freed memory), checks the generation against the name,
+  reads the atomic value, then checks the generation again. If anything
+  doesn't match, the source was deleted (and maybe reused) while it
+  looked, and it falls back to the locked path, which reports the error.
+
+- alDeferUpdatesSOFT (and alcSuspendContext) sets a per-context flag, then
+  waits for a mix that's already running (as above), since it might be
+  recalculating gains from the old flag. While the flag is set, listener
+  and source changes still land in the source and listener fields and
+  still flag the source (or context) for recalculation, but the mixer
+  leaves those flags alone and keeps mixing with the gains it already
+  calculated, so voices that were already playing never see half of a
+  scene update. alProcessUpdatesSOFT (and alcProcessContext) clears the
+  flag, and the next mix recalculates everything that changed in one pass.
+  Sources that start playing during a batch don't have older gains to
+  keep, so they get theirs right away, from a copy of the listener and
+  distance model taken when the batch started (it's only written while no
+  mix is running and before the flag is set, and only read while the flag
+  is set). Their own source fields are read as they stand, though: if the
+  app changes a source in the same batch that starts it, that first set of
+  gains might catch the change halfway. The change flags the source again,
+  so the recalculation when the batch is processed fixes it. Pitch changes
+  aren't deferred.
+
 - Buffer data is owned by the AL, and it's illegal to delete a buffer or
   alBufferData() its contents while attached to a source with either
   AL_BUFFER or alSourceQueueBuffers(). We keep an atomic refcount for each
@@ -169,13 +456,6 @@ The locking strategy for this OpenAL implementation:
   refcount, as a buffer moving from AL_PENDING to AL_PROCESSED is still
   attached to a source.
 
-- alSource(Stop|Pause|Rewind)v with > 1 source used will always lock the
-  mixer thread to guarantee that all sources change in sync (!!! FIXME?).
-  The non-v version of these functions do not lock the mixer thread.
-  alSourcePlayv never locks the mixer thread (it atomically appends to a
-  linked list of sources to be played, which the mixer will pick up all
-  at once).
-
 - alSourceQueueBuffers will build a linked list of buffers, then atomically
   move this list into position for the mixer to obtain it. The mixer will
   process this list without the need to be atomic (as it owns it once it
@@ -184,12 +464,29 @@ The locking strategy for this OpenAL implementation:
   them atomically to a linked list that other threads can pick up for
   alSourceUnqueueBuffers.
 
+- Mixing a context can optionally be spread across a pool of worker threads
+  (ALC_MIXER_THREADS context attribute, or the MOJOAL_MIXER_THREADS
+  environment variable). The SDL audio thread wakes the workers, and everyone
+  (including the audio thread) pulls voices off the playlist array until
+  it's empty, each mixing into their own buffer.
+  The audio thread sums the workers' buffers into the device stream and then
+  removes finished sources from the playlist itself, so the playlist is still
+  only ever touched by one thread. Source commands only run before the
+  workers wake up, so they never see one. The default is still to mix
+  everything on the SDL audio thread.
+
 - Capture just locks the SDL audio device for everything, since it's a very
   lightweight load and a much simplified API; good enough. The capture device
   thread is an almost-constant minimal load (1 or 2 memcpy's, depending on the
   ring buffer position), and the worst load on the API side (alcCaptureSamples)
   is the same deal, so this never takes long, and is good enough.
 
+- The mixer keeps performance counters for each playback device
+  (ALC_EXT_MIXER_STATS). Only the thread running the device's callback
+  writes them, bumping a sequence number before and after, so it never
+  waits. alcGetIntegerv/alcGetInteger64v read them without the api lock and
+  retry if the sequence number was odd or changed while they were copying.
+
 - Probably other things. These notes might get updates later.
 */
 
@@ -218,6 +515,18 @@ The locking strategy for this OpenAL implementation:
 #define SIMDALIGNEDSTRUCT struct
 #endif
 
+/* Things written by both the API thread and the mixer go on their own cache
+   line, so neither side stalls on the other's unrelated writes. This is a
+   guess that's right for basically every x86 and ARM chip around. */
+#define OPENAL_CACHELINE_SIZE 64
+#ifdef _MSC_VER
+#define CACHELINEALIGNEDSTRUCT __declspec(align(64)) struct
+#elif (defined(__GNUC__) || defined(__clang__))
+#define CACHELINEALIGNEDSTRUCT struct __attribute__((aligned(64)))
+#else
+#define CACHELINEALIGNEDSTRUCT struct
+#endif
+
 #ifdef __SSE__  /* we assume you always have this on x86/x86-64 chips. SSE1 is 20 years old! */
 #define has_sse 1
 #endif
@@ -230,6 +539,26 @@ static int has_neon = 0;
 #endif
 #endif
 
+/* the mixers we use, chosen at device open by select_mixers(). */
+typedef void (*MixFloat32Fn)(const ALfloat * restrict panning, const float * restrict data, float * restrict stream, const ALsizei mixframes);
+static MixFloat32Fn mix_float32_c1 = NULL;
+static MixFloat32Fn mix_float32_c2 = NULL;
+typedef void (*MixS16Fn)(const ALfloat * restrict panning, const Sint16 * restrict data, float * restrict stream, const ALsizei mixframes);
+static MixS16Fn mix_s16_c1 = NULL;
+static MixS16Fn mix_s16_c2 = NULL;
+typedef void (*MixU8Fn)(const ALfloat * restrict panning, const Uint8 * restrict data, float * restrict stream, const ALsizei mixframes);
+static MixU8Fn mix_u8_c1 = NULL;
+static MixU8Fn mix_u8_c2 = NULL;
+static void select_mixers(void);
+
+#if HAVE_SPATIALIZE_BATCH
+/* calculates channel gains for a batch of sources at once, chosen at device open by select_spatializer(). */
+typedef struct SpatialBatch SpatialBatch;
+typedef void (*SpatializeBatchFn)(SpatialBatch *batch);
+static SpatializeBatchFn spatialize_batch = NULL;
+static void select_spatializer(void);
+#endif
+
 /* no threads in Emscripten (at the moment...!) */
 #if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
 #define init_api_lock() 1
@@ -272,11 +601,207 @@ static void ungrab_api_lock(void)
 }
 #endif
 
-#define ENTRYPOINT(rettype,fn,params,args) \
-    rettype fn params { rettype retval; grab_api_lock(); retval = _##fn args ; ungrab_api_lock(); return retval; }
 
-#define ENTRYPOINTVOID(fn,params,args) \
-    void fn params { grab_api_lock(); _##fn args ; ungrab_api_lock(); }
+/* AL_EXT_trace_info / ALC_EXT_trace_info: set the MOJOAL_TRACE environment
+   variable to a filename and we record timestamped events for every API
+   entry point (including the wait for the api lock), the mixer's phases and
+   each source it mixes, plus whatever scopes and messages the app pushes.
+   It's written out as Chrome trace JSON (chrome://tracing, ui.perfetto.dev)
+   at exit, or whenever the app calls alcTraceDump().
+
+   Each thread records into its own ring buffer, found through thread-local
+   storage, so recording never takes a lock; when a ring fills up, the oldest
+   events get overwritten. Rings are never freed, so the events of threads
+   that have exited still show up in the dump. Strings in events (labels,
+   scope names, messages) are interned and live forever, so the mixer can
+   record a pointer to a source's label without worrying about it changing
+   under it. */
+#ifndef OPENAL_TRACE_RING_EVENTS
+#define OPENAL_TRACE_RING_EVENTS 65536  /* per thread, must be a power of two. */
+#endif
+
+/* Most distinct strings we'll intern for traces, so an app that sends a unique message every frame doesn't eat all memory. */
+#ifndef OPENAL_TRACE_MAX_STRINGS
+#define OPENAL_TRACE_MAX_STRINGS 16384
+#endif
+
+typedef struct TraceEvent
+{
+    Uint64 ticks;  /* SDL_GetPerformanceCounter() */
+    const char *name;
+    const char *category;
+    const char *detail;  /* optional, shows up in the event's args. */
+    Uint32 id;  /* optional AL object name, shows up in the event's args. */
+    char phase;  /* 'B'egin, 'E'nd or 'i'nstant, like Chrome's JSON. */
+} TraceEvent;
+
+typedef struct TraceRing
+{
+    struct TraceRing *next;  /* all the rings, pushed atomically; never removed. */
+    SDL_threadID thread;
+    const char *thread_name;  /* static string, set by the owning thread. */
+    SDL_atomic_t head;  /* events ever written, wrapping. Only the owning thread writes it. */
+    Uint32 written;  /* same as head, but only the owning thread reads this, so it doesn't need a barrier. */
+    ALboolean full;  /* head has been past the end at least once. */
+    TraceEvent events[OPENAL_TRACE_RING_EVENTS];
+} TraceRing;
+
+typedef struct TraceString
+{
+    struct TraceString *next;
+    Uint32 hash;
+    char str[1];  /* allocated bigger. */
+} TraceString;
+
+static int trace_enabled = 0;  /* only ever set once, before any other thread could read it. */
+static SDL_atomic_t trace_state;  /* 0: untouched, 1: initializing, 2: done (maybe disabled). */
+static SDL_TLSID trace_tls = 0;
+static void *trace_rings = NULL;  /* TraceRing *, void* so we can AtomicCASPtr it. */
+static char *trace_path = NULL;
+static Uint64 trace_start_ticks = 0;
+static TraceString *trace_strings[256];  /* hashed; only touched while holding trace_strings_lock. */
+static SDL_SpinLock trace_strings_lock = 0;
+static int trace_num_strings = 0;
+
+static ALCboolean trace_dump(const char *path);
+
+static void trace_atexit(void)
+{
+    trace_dump(trace_path);
+}
+
+/* Called at device open. Only the first call does anything. */
+static void init_tracing(void)
+{
+    const char *env;
+
+    if (!SDL_AtomicCAS(&trace_state, 0, 1)) {
+        while (SDL_AtomicGet(&trace_state) != 2) { /* someone else is on it, wait for them. */ }
+        return;
+    }
+
+    env = SDL_getenv("MOJOAL_TRACE");
+    if (env && *env) {
+        trace_path = SDL_strdup(env);
+        trace_tls = trace_path ? SDL_TLSCreate() : 0;
+        if (trace_tls) {
+            trace_start_ticks = SDL_GetPerformanceCounter();
+            atexit(trace_atexit);
+            trace_enabled = 1;
+        }
+    }
+
+    SDL_AtomicSet(&trace_state, 2);
+}
+
+/* find or create the calling thread's ring. Returns NULL if we're out of memory. */
+static TraceRing *get_trace_ring(void)
+{
+    TraceRing *ring = (TraceRing *) SDL_TLSGet(trace_tls);
+    void *ptr;
+
+    if (ring) {
+        return ring;
+    }
+
+    ring = (TraceRing *) SDL_calloc(1, sizeof (TraceRing));
+    if (!ring) {
+        return NULL;
+    }
+
+    ring->thread = SDL_ThreadID();
+    ring->thread_name = "app thread";
+    if (SDL_TLSSet(trace_tls, ring, NULL) == -1) {
+        SDL_free(ring);
+        return NULL;
+    }
+
+    do {
+        ptr = SDL_AtomicGetPtr(&trace_rings);
+        ring->next = (TraceRing *) ptr;
+    } while (!SDL_AtomicCASPtr(&trace_rings, ptr, ring));
+
+    return ring;
+}
+
+static void trace_event(const char phase, const char *name, const char *category, const char *detail, const Uint32 id)
+{
+    TraceRing *ring = get_trace_ring();
+    if (ring) {
+        const Uint32 head = ring->written++;
+        TraceEvent *event = &ring->events[head & (OPENAL_TRACE_RING_EVENTS - 1)];
+        event->ticks = SDL_GetPerformanceCounter();
+        event->name = name;
+        event->category = category;
+        event->detail = detail;
+        event->id = id;
+        event->phase = phase;
+        if ((head & (OPENAL_TRACE_RING_EVENTS - 1)) == (OPENAL_TRACE_RING_EVENTS - 1)) {
+            ring->full = AL_TRUE;
+        }
+        SDL_AtomicSet(&ring->head, (int) (head + 1));  /* a full barrier, so a dump sees the event before the new head. */
+    }
+}
+
+#define TRACE_BEGIN(name, category, detail, id) if (trace_enabled) { trace_event('B', name, category, detail, id); }
+#define TRACE_END(name, category) if (trace_enabled) { trace_event('E', name, category, NULL, 0); }
+
+/* names the calling thread in the trace. (name) must be a static string. */
+static void trace_thread_name(const char *name)
+{
+    if (trace_enabled) {
+        TraceRing *ring = get_trace_ring();
+        if (ring) {
+            ring->thread_name = name;
+        }
+    }
+}
+
+/* Returns a copy of (str) that lives forever, the same copy every time. Safe to call from any thread. */
+static const char *trace_intern(const char *str)
+{
+    Uint32 hash = 5381;
+    const char *ptr;
+    const char *retval;
+    TraceString *item;
+    size_t len;
+
+    if (!str) {
+        return NULL;
+    }
+
+    for (ptr = str; *ptr; ptr++) {
+        hash = ((hash << 5) + hash) ^ ((Uint8) *ptr);
+    }
+
+    SDL_AtomicLock(&trace_strings_lock);
+    for (item = trace_strings[hash & 0xFF]; item != NULL; item = item->next) {
+        if ((item->hash == hash) && (SDL_strcmp(item->str, str) == 0)) {
+            SDL_AtomicUnlock(&trace_strings_lock);
+            return item->str;
+        }
+    }
+
+    if (trace_num_strings >= OPENAL_TRACE_MAX_STRINGS) {
+        SDL_AtomicUnlock(&trace_strings_lock);
+        return "(too many trace strings)";
+    }
+
+    len = SDL_strlen(str);
+    item = (TraceString *) SDL_malloc(sizeof (TraceString) + len);
+    if (!item) {
+        retval = "(out of memory)";
+    } else {
+        item->hash = hash;
+        SDL_memcpy(item->str, str, len + 1);
+        item->next = trace_strings[hash & 0xFF];
+        trace_strings[hash & 0xFF] = item;
+        trace_num_strings++;
+        retval = item->str;
+    }
+    SDL_AtomicUnlock(&trace_strings_lock);
+    return retval;
+}
 
 
 /* lifted this ring buffer code from my al_osx project; I wrote it all, so it's stealable. */
@@ -365,14 +890,15 @@ static ALCsizei ring_buffer_get(RingBuffer *ring, void *_data, ALCsizei size)
     return size;  /* may have been clamped if there wasn't enough data... */
 }
 
+/* this actually aligns to OPENAL_CACHELINE_SIZE, which is good enough for SIMD too. */
 static void *calloc_simd_aligned(const size_t len)
 {
     Uint8 *retval = NULL;
-    Uint8 *ptr = (Uint8 *) SDL_calloc(1, len + 16 + sizeof (void *));
+    Uint8 *ptr = (Uint8 *) SDL_calloc(1, len + OPENAL_CACHELINE_SIZE + sizeof (void *));
     if (ptr) {
         void **storeptr;
         retval = ptr + sizeof (void *);
-        retval += 16 - (((size_t) retval) % 16);
+        retval += OPENAL_CACHELINE_SIZE - (((size_t) retval) % OPENAL_CACHELINE_SIZE);
         storeptr = (void **) retval;
         storeptr--;
         *storeptr = ptr;
@@ -390,16 +916,41 @@ static void free_simd_aligned(void *ptr)
 }
 
 
+/* A memory-mapped sound bank file; see alLoadSoundBank. */
+typedef struct SoundBank
+{
+    const Uint8 *data;  /* the whole file. */
+    size_t len;
+    ALboolean mapped;  /* AL_FALSE if we read it into memory instead. */
+    SDL_atomic_t refcount;  /* one for each ALbuffer using it. */
+} SoundBank;
+
+static void sound_bank_release(SoundBank *bank);
+
+/* ALbuffer::format values for compressed data. SDL has no 4-bit formats, so these can't collide with an SDL_AudioFormat. */
+#define BUFFER_FORMAT_IMA4 0x0004
+#define BUFFER_FORMAT_MSADPCM 0x1004
+#define buffer_is_adpcm(buffer) (((buffer)->format == BUFFER_FORMAT_IMA4) || ((buffer)->format == BUFFER_FORMAT_MSADPCM))
+
 typedef struct ALbuffer
 {
     ALboolean allocated;
     ALuint name;
     ALint channels;
-    ALint bits;  /* always float32 internally, but this is what alBufferData saw */
+    ALint bits;  /* what alBufferData saw. */
+    SDL_AudioFormat format;  /* how (data) is stored: AUDIO_U8, AUDIO_S16SYS, AUDIO_F32SYS or BUFFER_FORMAT_*, same as alBufferData saw. */
     ALsizei frequency;
     ALsizei len;   /* length of data in bytes. */
-    const float *data;  /* we only work in Float32 format. */
+    ALsizei frames;  /* length of data in sample frames. */
+    ALsizei block_frames;  /* compressed formats: sample frames per block. */
+    ALsizei block_size;  /* compressed formats: bytes per block. */
+    ALsizei unpack_block_alignment;  /* AL_UNPACK_BLOCK_ALIGNMENT_SOFT: frames per block for the next alBufferData, 0 for the default. */
+    const void *data;  /* SIMD aligned unless static. The mixers convert to float (or decode) as they go. */
+    ALboolean static_data;  /* AL_TRUE if (data) is app memory from alBufferDataStatic, or in (bank), so we don't free it. */
+    SoundBank *bank;  /* if (data) points into a sound bank, we hold a reference to it. */
     SDL_atomic_t refcount;  /* if zero, can be deleted or alBufferData'd */
+    void *label;  /* alTraceBufferLabel(), interned. void* because the mixer atomicgetptrs it. */
+    struct ALbuffer *next_free;  /* in the device's free list while not allocated. */
 } ALbuffer;
 
 /* !!! FIXME: buffers and sources use almost identical code for blocks */
@@ -407,7 +958,6 @@ typedef struct BufferBlock
 {
     ALbuffer buffers[OPENAL_BUFFER_BLOCK_SIZE];  /* allocate these in blocks so we can step through faster. */
     ALuint used;
-    ALuint tmp;  /* only touch under api_lock, assume it'll be gone later. */
 } BufferBlock;
 
 typedef struct BufferQueueItem
@@ -416,7 +966,8 @@ typedef struct BufferQueueItem
     void *next;  /* void* because we'll atomicgetptr it. */
 } BufferQueueItem;
 
-typedef struct BufferQueue
+/* the API thread and the mixer both write to these, so each gets its own cache line. */
+typedef CACHELINEALIGNEDSTRUCT BufferQueue
 {
     void *just_queued;  /* void* because we'll atomicgetptr it. */
     BufferQueueItem *head;
@@ -443,66 +994,159 @@ typedef struct PitchState
 
 typedef struct ALsource ALsource;
 
+/* The parts of a source the mixer touches on every pass, packed into the
+   first cache line so walking the playlist doesn't drag in positions, cone
+   settings and other things that only matter when recalculating gains. Each
+   ALsource has exactly one of these, in the same SourceBlock. */
+typedef CACHELINEALIGNEDSTRUCT SourceVoice
+{
+    SDL_atomic_t state;  /* initial, playing, paused, stopped, as the app last set it. Only the API writes this; read it with source_state(). */
+    ALenum type;  /* undetermined, static, streaming */
+    ALboolean recalc;
+    ALboolean looping;
+    ALboolean preserve_duration;  /* AL_PITCH_PRESERVE_DURATION: pitch shifts through the phase vocoder instead of resampling. */
+    ALboolean playing;  /* the mixer's own idea of AL_PLAYING, only changed by source commands. Mixer thread only! */
+    ALfloat pitch;
+    ALfloat panning[2];  /* we only do stereo for now */
+    ALbuffer *buffer;
+    ALsizei offset;  /* offset in sample frames into the current buffer. */
+    Uint32 offset_frac;  /* fraction of a frame past (offset) when resampling, in RESAMPLER_FRAC_BITS fixed point. */
+    ALfloat resample_history[2];  /* the frame before (offset), so the resampler can interpolate across buffers. */
+    ALboolean history_stale;  /* a virtual voice skipped through compressed data without decoding it, so resample_history needs decoding before the next mix. */
+    ALfloat cull_gain;  /* 0.0f if culled out as of last callback, 1.0f otherwise; a voice crossing the limit fades between them over one callback. Mixer thread only! */
+    PitchState *pitchstate;
+    ALsource *source;  /* the cold half, for recalculating gains and streaming. */
+
+    /* the API thread polls this, so keep it off the line the mixer is writing. */
+    CACHELINEALIGNEDSTRUCT {
+        SDL_atomic_t mixer_accessible;  /* set while listed. Only the mixer thread writes this. */
+        SDL_atomic_t commands_pending;  /* source commands for this voice that the mixer hasn't run yet. */
+        SDL_atomic_t play_serial;  /* bumped by every alSourcePlay. Only the API writes this. */
+        SDL_atomic_t finished_serial;  /* the play_serial the mixer last played to the end. Only the mixer thread writes this. */
+        int mixer_play_serial;  /* the play_serial the mixer is playing now. Only touched by mixer thread! */
+        ALboolean listed;  /* in ctx->playlist? Only touched by mixer thread! */
+        ALboolean virtualized;  /* advanced without mixing last callback; see mix_source(). Only touched by mixer thread! */
+        ALboolean culled;  /* over ctx->max_real_voices this callback; only means anything while ctx->culling. Only touched by mixer thread! */
+    };
+} SourceVoice;
+
 SIMDALIGNEDSTRUCT ALsource
 {
     /* keep these first to help guarantee that its elements are aligned for SIMD */
     ALfloat position[4];
     ALfloat velocity[4];
     ALfloat direction[4];
-    ALfloat panning[2];  /* we only do stereo for now */
-    SDL_atomic_t mixer_accessible;
-    SDL_atomic_t state;  /* initial, playing, paused, stopped */
+    SourceVoice *voice;  /* mixer state; never changes once the SourceBlock is allocated. */
     ALuint name;
     ALboolean allocated;
-    ALenum type;  /* undetermined, static, streaming */
-    ALboolean recalc;
+    SDL_atomic_t generation;  /* odd while allocated; bumped on generate and delete. Survives reuse. See the locking notes. */
     ALboolean source_relative;
-    ALboolean looping;
     ALfloat gain;
     ALfloat min_gain;
     ALfloat max_gain;
     ALfloat reference_distance;
     ALfloat max_distance;
     ALfloat rolloff_factor;
-    ALfloat pitch;
     ALfloat cone_inner_angle;
     ALfloat cone_outer_angle;
     ALfloat cone_outer_gain;
-    ALbuffer *buffer;
-    SDL_AudioStream *stream;  /* for resampling. */
+    ALint priority;  /* AL_SOURCE_PRIORITY */
     SDL_atomic_t total_queued_buffers;   /* everything queued, playing and processed. AL_BUFFERS_QUEUED value. */
-    BufferQueue buffer_queue;
-    BufferQueue buffer_queue_processed;
-    ALsizei offset;  /* offset in bytes for converted stream! */
     ALboolean offset_latched;  /* AL_SEC_OFFSET, etc, say set values apply to next alSourcePlay if not currently playing! */
     ALint queue_channels;
     ALsizei queue_frequency;
-    PitchState *pitchstate;
-    ALsource *playlist_next;  /* linked list that contains currently-playing sources! Only touched by mixer thread! */
+    BufferQueue buffer_queue;
+    BufferQueue buffer_queue_processed;
+    void *label;  /* alTraceSourceLabel(), interned. void* because the mixer atomicgetptrs it. */
+    ALsource *next_free;  /* in the context's free (or reclaim) list while not allocated. */
 };
 
 /* !!! FIXME: buffers and sources use almost identical code for blocks */
 typedef struct SourceBlock
 {
+    SourceVoice voices[OPENAL_SOURCE_BLOCK_SIZE];  /* kept apart from the sources, so the mixer walks a compact array. */
     ALsource sources[OPENAL_SOURCE_BLOCK_SIZE];  /* allocate these in blocks so we can step through faster. */
     ALuint used;
-    ALuint tmp;  /* only touch under api_lock, assume it'll be gone later. */
 } SourceBlock;
 
 
-typedef struct SourcePlayTodo
+/* Something the API wants the mixer to do to a source it might be mixing.
+   (type) is AL_PLAYING, AL_PAUSED, AL_STOPPED, AL_INITIAL (rewind), or
+   AL_SAMPLE_OFFSET (seek). See the locking notes. */
+typedef struct SourceCommand
+{
+    SourceVoice *voice;
+    ALenum type;
+    int arg;  /* AL_PLAYING: the new play_serial. AL_SAMPLE_OFFSET: the new offset in sample frames. */
+} SourceCommand;
+
+/* what the mixer did during one callback. Each mixing thread counts into its own. */
+typedef struct MixCounts
+{
+    int voices;
+    int voices_resampled;
+    int voices_pitch_shifted;
+    int voices_virtual;  /* playing, but only their offsets moved. Not counted in (voices). */
+    Uint64 gains_ticks;  /* SDL_GetPerformanceCounter() ticks spent recalculating gains. */
+} MixCounts;
+
+/* ALC_EXT_MIXER_STATS. Written once per callback by the mixer thread, read from anywhere; see the locking notes. */
+typedef struct MixerStats
+{
+    SDL_atomic_t sequence;  /* odd while the mixer is updating everything below. */
+    Uint64 callbacks;
+    Uint64 last_ns;
+    Uint64 max_ns;
+    Uint64 total_ns;
+    Uint64 gains_ns;  /* total, across all callbacks. */
+    int voices;  /* these four are for the last callback. */
+    int voices_resampled;
+    int voices_pitch_shifted;
+    int voices_virtual;
+    int quality;  /* the governor's MIX_QUALITY_* level for the last callback. */
+    Uint64 budget_ns;  /* how long the last callback had before the device needed its audio: frames / frequency. */
+    Uint64 overruns;  /* callbacks that took longer than their budget. Never counted for loopback devices. */
+    Uint64 late_callbacks;  /* callbacks that arrived too long after the previous one. Never counted for loopback devices. */
+    Uint64 histogram[ALC_MIX_BUDGET_HISTOGRAM_BUCKETS];  /* callbacks by percent of budget used: 0-9%, 10-19%, ... 90-99%, 100% and up. */
+} MixerStats;
+
+typedef struct MixerPool MixerPool;
+
+typedef struct MixerWorker
+{
+    MixerPool *pool;
+    SDL_Thread *thread;
+    SDL_sem *wake;
+    float *buffer;  /* SIMD-aligned, this worker's partial mix. */
+    ALboolean mixed;  /* did this worker mix anything into buffer this pass? */
+    MixCounts counts;  /* what this worker mixed this pass. */
+} MixerWorker;
+
+struct MixerPool
 {
-    ALsource *source;
-    struct SourcePlayTodo *next;
-} SourcePlayTodo;
+    ALCcontext *ctx;
+    MixerWorker *workers;  /* threads besides the SDL audio thread. */
+    int num_workers;
+    int buflen;  /* bytes available in each worker's buffer. */
+    SDL_sem *done;
+    SDL_atomic_t quit;
+    SDL_atomic_t next_voice;  /* index into ctx->playlist of next voice to claim. */
+    ALCboolean *keep;  /* mix_source() results, parallel to ctx->playlist. */
+    int num_voices;
+    int keep_capacity;
+    int len;  /* bytes to mix this pass. */
+};
 
 struct ALCdevice_struct
 {
     char *name;
     ALCenum error;
     SDL_atomic_t connected;
+    SDL_mutex *api_lock;  /* held by API calls on this device or its contexts. See the locking notes. */
     ALCboolean iscapture;
+    ALCboolean isloopback;  /* ALC_SOFT_loopback: the app mixes with alcRenderSamplesSOFT(), there's no SDL device. */
     SDL_AudioDeviceID sdldevice;
+    void *label;  /* alcTraceDeviceLabel(), interned. void* because the mixer atomicgetptrs it. */
 
     ALint channels;
     ALint frequency;
@@ -513,8 +1157,24 @@ struct ALCdevice_struct
             ALCcontext *contexts;
             BufferBlock **buffer_blocks;  /* buffers are shared between contexts on the same device. */
             ALCsizei num_buffer_blocks;
+            ALbuffer *free_buffers;  /* every unallocated buffer in buffer_blocks, linked through next_free. */
+            ALCsizei num_free_buffers;
             BufferQueueItem *buffer_queue_pool;  /* mixer thread doesn't touch this. */
-            void *source_todo_pool;  /* void* because we'll atomicgetptr it. */
+            SDL_atomic_t mix_serial;  /* bumped before and after each mix, so it's odd while mixing. See wait_for_mixer(). */
+            SDL_atomic_t source_locks;  /* ALC_MIX_SOURCE_LOCKS: times the API locked the mixer because a context's source command ring was full. */
+            SDL_atomic_t mix_waiters;  /* API threads blocked in wait_for_mixer(). The mixer posts mix_done if this isn't zero. */
+            SDL_sem *mix_done;  /* created the first time wait_for_mixer() has to block. */
+            SDL_mutex *loopback_lock;  /* held while mixing, like SDL's device lock. Only if isloopback. */
+            float *loopback_mix;  /* SIMD-aligned, OPENAL_LOOPBACK_CHUNK_FRAMES of float32 stereo. Only if isloopback. */
+            ALCenum loopback_type;  /* ALC_FORMAT_TYPE_SOFT that alcRenderSamplesSOFT() produces. */
+            MixCounts mix_counts;  /* this callback's counts so far. Mixer thread only! */
+            MixerStats stats;
+            Uint64 last_callback_ticks;  /* when the last callback started, to catch late ones. Mixer thread only! */
+            int quality;  /* the governor's current MIX_QUALITY_* level. Mixer thread only! */
+            int busy_callbacks;  /* callbacks in a row that used more than OPENAL_GOVERNOR_HIGH_PERCENT of their budget. Mixer thread only! */
+            int calm_callbacks;  /* callbacks in a row that used less than OPENAL_GOVERNOR_LOW_PERCENT of their budget. Mixer thread only! */
+            ALCMIXDEADLINEPROC deadline_callback;  /* alcMixDeadlineCallback(). Only changed while holding the mixer lock. */
+            void *deadline_userdata;
         } playback;
         struct {
             RingBuffer ring;  /* only used if iscapture */
@@ -522,18 +1182,45 @@ struct ALCdevice_struct
     };
 };
 
+/* how cull_playlist_voices() sorts voices. */
+typedef struct VoiceRank
+{
+    SourceVoice *voice;
+    ALint priority;
+    ALfloat gain;  /* louder if we were already mixing it; see OPENAL_CULL_HYSTERESIS. */
+    int order;  /* playlist position, so equal ranks still sort the same way every time. */
+} VoiceRank;
+
+/* The listener half of the gain math. See calculate_channel_gains(). */
+typedef SIMDALIGNEDSTRUCT ListenerState
+{
+    ALfloat position[4];
+    ALfloat velocity[4];
+    ALfloat orientation[8];
+    ALfloat gain;
+} ListenerState;
+
+typedef struct RetiredSourceBlocks
+{
+    SourceBlock **source_blocks;
+    struct RetiredSourceBlocks *next;
+} RetiredSourceBlocks;
+
 struct ALCcontext_struct
 {
     /* keep these first to help guarantee that its elements are aligned for SIMD */
-    SourceBlock **source_blocks;
+    SourceBlock **source_blocks;  /* replaced atomically when it grows, for lockless readers. */
     ALsizei num_source_blocks;
+    ALsizei source_blocks_capacity;  /* slots in source_blocks; it doubles when it's full. */
+    SDL_atomic_t lockless_num_source_blocks;  /* num_source_blocks, but only set after source_blocks has that many. */
+    RetiredSourceBlocks *retired_source_blocks;  /* old source_blocks tables, lockless readers might still be looking at them. */
+    ALsource *free_sources;  /* unallocated sources the mixer is done with, linked through next_free, oldest first. */
+    ALsource **free_sources_tail;  /* the last next_free in free_sources (or free_sources itself, if it's empty), where freed sources go. */
+    ALsizei num_free_sources;
+    ALsource *reclaim_sources;  /* deleted sources the mixer might still own. They move to free_sources once it lets go. */
 
-    SIMDALIGNEDSTRUCT {
-        ALfloat position[4];
-        ALfloat velocity[4];
-        ALfloat orientation[8];
-        ALfloat gain;
-    } listener;
+    ListenerState listener;
+    ListenerState deferred_listener;  /* (listener) as of the alDeferUpdatesSOFT that started this batch. See the locking notes. */
 
     ALCdevice *device;
     SDL_atomic_t processing;
@@ -542,16 +1229,35 @@ struct ALCcontext_struct
     ALCsizei attributes_count;
 
     ALCboolean recalc;
+    SDL_atomic_t deferring;  /* AL_SOFT_deferred_updates. See the locking notes. */
     ALenum distance_model;
+    ALenum deferred_distance_model;  /* like deferred_listener. */
     ALfloat doppler_factor;
     ALfloat doppler_velocity;
     ALfloat speed_of_sound;
 
-    SDL_mutex *source_lock;
+    MixerPool *mixer_pool;  /* NULL if we mix everything on the SDL audio thread. */
+
+    /* source commands, from the API to the mixer. See the locking notes. */
+    SourceCommand *commands;  /* OPENAL_SOURCE_COMMAND_RING_SIZE of them. */
+    SDL_atomic_t commands_head;  /* next command the mixer will run. Only the mixer moves this. */
+    SDL_atomic_t commands_tail;  /* end of the commands the mixer can see. Only the API moves this. */
+    Uint32 commands_written;  /* end of the commands the API has written; publish_source_commands() moves commands_tail here. API only! */
+    ALboolean commands_locked_mixer;  /* the ring filled up, so the API locked the mixer until it publishes. API only! */
 
-    void *playlist_todo;  /* void* so we can AtomicCASPtr it. Transmits new play commands from api thread to mixer thread */
-    ALsource *playlist;  /* linked list of currently-playing sources. Mixer thread only! */
-    ALsource *playlist_tail;  /* end of playlist so we know if last item is being readded. Mixer thread only! */
+    SourceVoice **playlist;  /* dense array of currently-playing voices. Mixer thread only! */
+    int playlist_count;
+    int playlist_capacity;
+
+    int max_real_voices;  /* ALC_MAX_REAL_VOICES, 0 for no limit. */
+    ALCboolean mix_governor;  /* ALC_MIX_GOVERNOR. The governor runs on the device if any of its contexts asked for it. */
+    VoiceRank *voice_ranks;  /* scratch space for cull_playlist_voices(). Mixer thread only! */
+    int voice_ranks_capacity;
+    ALboolean culling;  /* more voices were audible than max_real_voices this callback, so check SourceVoice::culled. Mixer thread only! */
+    int governed_quarters;  /* the governor's cull level last callback... */
+    int governed_voices;  /* ...and how many voices it let us mix. Mixer thread only! */
+
+    void *label;  /* alcTraceContextLabel(), interned. void* because the mixer atomicgetptrs it. */
 
     ALCcontext *prev;  /* contexts are in a double-linked list */
     ALCcontext *next;
@@ -559,7 +1265,7 @@ struct ALCcontext_struct
 
 /* forward declarations */
 static float source_get_offset(ALsource *src, ALenum param);
-static void source_set_offset(ALsource *src, ALenum param, ALfloat value);
+static void source_set_offset(ALCcontext *ctx, ALsource *src, ALenum param, ALfloat value);
 
 /* the just_queued list is backwards. Add it to the queue in the correct order. */
 static void queue_new_buffer_items_recursive(BufferQueue *queue, BufferQueueItem *items)
@@ -614,6 +1320,38 @@ static void source_mark_all_buffers_processed(ALsource *src)
     src->buffer_queue.tail = NULL;
 }
 
+/* start resampling fresh, as if there was silence before the current offset. */
+static void source_reset_resampler(ALsource *src)
+{
+    src->voice->offset_frac = 0;
+    src->voice->resample_history[0] = src->voice->resample_history[1] = 0.0f;
+    src->voice->history_stale = AL_FALSE;
+}
+
+/* AL_SOURCE_STATE, as the app sees it. The mixer never writes (state); when
+   it plays a source to the end, it notes which alSourcePlay that was, and
+   that play reports AL_STOPPED here. A newer play doesn't match. */
+static ALenum source_state(SourceVoice *voice)
+{
+    const ALenum state = (ALenum) SDL_AtomicGet(&voice->state);
+    if ((state == AL_PLAYING) && (SDL_AtomicGet(&voice->finished_serial) == SDL_AtomicGet(&voice->play_serial))) {
+        return AL_STOPPED;
+    }
+    return state;
+}
+
+/* Is the mixer using (voice), or about to? Then the API has to send it
+   source commands instead of changing offsets, etc, directly. Check
+   commands_pending first: the mixer marks a voice accessible before it
+   counts the command that listed it as done. */
+static ALboolean source_mixer_owned(SourceVoice *voice)
+{
+    if (SDL_AtomicGet(&voice->commands_pending)) {
+        return AL_TRUE;
+    }
+    return SDL_AtomicGet(&voice->mixer_accessible) ? AL_TRUE : AL_FALSE;
+}
+
 static void source_release_buffer_queue(ALCcontext *ctx, ALsource *src)
 {
     /* move any buffer queue items to the device's available pool for reuse. */
@@ -646,16 +1384,29 @@ static void source_release_buffer_queue(ALCcontext *ctx, ALsource *src)
 /* ALC implementation... */
 
 static void *current_context = NULL;
-static ALCenum null_device_error = ALC_NO_ERROR;
+static SDL_atomic_t thread_context_tls;  /* SDL_TLSID for ALC_EXT_thread_local_context, 0 until someone calls alcSetThreadContext(). */
+static SDL_SpinLock thread_context_tls_lock = 0;
+static ALCenum null_device_error = ALC_NO_ERROR;  /* calls with a NULL device hold the global api lock. */
 
 /* we don't have any device-specific extensions. */
 #define ALC_EXTENSION_ITEMS \
     ALC_EXTENSION_ITEM(ALC_ENUMERATION_EXT) \
     ALC_EXTENSION_ITEM(ALC_EXT_CAPTURE) \
-    ALC_EXTENSION_ITEM(ALC_EXT_DISCONNECT)
+    ALC_EXTENSION_ITEM(ALC_EXT_DISCONNECT) \
+    ALC_EXTENSION_ITEM(ALC_SOFT_loopback) \
+    ALC_EXTENSION_ITEM(ALC_EXT_MIXER_STATS) \
+    ALC_EXTENSION_ITEM(ALC_EXT_trace_info) \
+    ALC_EXTENSION_ITEM(ALC_EXT_thread_local_context)
 
 #define AL_EXTENSION_ITEMS \
-    AL_EXTENSION_ITEM(AL_EXT_FLOAT32)
+    AL_EXTENSION_ITEM(AL_EXT_FLOAT32) \
+    AL_EXTENSION_ITEM(AL_EXT_IMA4) \
+    AL_EXTENSION_ITEM(AL_SOFT_MSADPCM) \
+    AL_EXTENSION_ITEM(AL_SOFT_block_alignment) \
+    AL_EXTENSION_ITEM(AL_EXT_STATIC_BUFFER) \
+    AL_EXTENSION_ITEM(AL_EXT_SOUND_BANK) \
+    AL_EXTENSION_ITEM(AL_EXT_trace_info) \
+    AL_EXTENSION_ITEM(AL_SOFT_deferred_updates)
 
 
 static void set_alc_error(ALCdevice *device, const ALCenum error)
@@ -667,9 +1418,125 @@ static void set_alc_error(ALCdevice *device, const ALCenum error)
     }
 }
 
+/* Keep the mixer from running on (device) for a moment. Playback devices mix
+   in SDL's audio callback, so that's SDL's device lock; loopback devices mix
+   in alcRenderSamplesSOFT(), which holds its own mutex for the same reason. */
+/* no threads in Emscripten (at the moment...!) */
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#define init_device_api_lock(device) 1
+#define destroy_device_api_lock(device)
+#define grab_device_api_lock(device) ((SDL_mutex *) NULL)
+#define ungrab_device_api_lock(lock)
+#else
+static int init_device_api_lock(ALCdevice *device)
+{
+    device->api_lock = SDL_CreateMutex();
+    return device->api_lock ? 1 : 0;
+}
+
+/* no one else may be using (device) by now. */
+static void destroy_device_api_lock(ALCdevice *device)
+{
+    if (device->api_lock) {
+        SDL_DestroyMutex(device->api_lock);
+        device->api_lock = NULL;
+    }
+}
+
+/* Locks (device)'s api lock, or the global one if there's no device. Returns the lock to hand to ungrab_device_api_lock(). */
+static SDL_mutex *grab_device_api_lock(ALCdevice *device)
+{
+    SDL_mutex *lock = (device && device->api_lock) ? device->api_lock : api_lock;
+    if (!lock) {
+        if (!init_api_lock()) {
+            return NULL;
+        }
+        lock = api_lock;
+    }
+    const int rc = SDL_LockMutex(lock);
+    SDL_assert(rc == 0);
+    return lock;
+}
+
+static void ungrab_device_api_lock(SDL_mutex *lock)
+{
+    if (lock) {
+        const int rc = SDL_UnlockMutex(lock);
+        SDL_assert(rc == 0);
+    }
+}
+#endif
+
+static SDL_mutex *grab_device_api_lock_traced(ALCdevice *device, const char *fn)
+{
+    SDL_mutex *lock;
+    if (trace_enabled) {
+        trace_event('B', fn, "api", NULL, 0);
+        trace_event('B', "api_lock wait", "lock", NULL, 0);
+        lock = grab_device_api_lock(device);
+        trace_event('E', "api_lock wait", "lock", NULL, 0);
+    } else {
+        lock = grab_device_api_lock(device);
+    }
+    return lock;
+}
+
+static void ungrab_device_api_lock_traced(SDL_mutex *lock, const char *fn)
+{
+    ungrab_device_api_lock(lock);
+    TRACE_END(fn, "api");
+}
+
+/* the calling thread's context from alcSetThreadContext() wins over alcMakeContextCurrent()'s. */
+static SDL_INLINE ALCcontext *get_current_context(void)
+{
+    const SDL_TLSID tls = (SDL_TLSID) SDL_AtomicGet(&thread_context_tls);
+    if (tls) {  /* apps that never use thread contexts don't pay for the TLS lookup. */
+        ALCcontext *ctx = (ALCcontext *) SDL_TLSGet(tls);
+        if (ctx) {
+            return ctx;
+        }
+    }
+    return (ALCcontext *) SDL_AtomicGetPtr(&current_context);
+}
+
+/* AL entry points lock the current context's device. The context is read
+   once, here, and handed to the implementation as (ctx), so another thread's
+   alcMakeContextCurrent() can't swap in a context whose device we haven't locked. */
+#define ENTRYPOINT(rettype,fn,params,args) \
+    rettype fn params { rettype retval; ALCcontext *ctx = get_current_context(); SDL_mutex *lock = grab_device_api_lock_traced(ctx ? ctx->device : NULL, #fn); retval = _##fn args ; ungrab_device_api_lock_traced(lock, #fn); return retval; }
+
+#define ENTRYPOINTVOID(fn,params,args) \
+    void fn params { ALCcontext *ctx = get_current_context(); SDL_mutex *lock = grab_device_api_lock_traced(ctx ? ctx->device : NULL, #fn); _##fn args ; ungrab_device_api_lock_traced(lock, #fn); }
+
+/* ALC entry points lock the device they operate on, (device) is an expression using the args. */
+#define DEVICE_ENTRYPOINT(rettype,fn,params,args,device) \
+    rettype fn params { rettype retval; SDL_mutex *lock = grab_device_api_lock_traced(device, #fn); retval = _##fn args ; ungrab_device_api_lock_traced(lock, #fn); return retval; }
+
+#define DEVICE_ENTRYPOINTVOID(fn,params,args,device) \
+    void fn params { SDL_mutex *lock = grab_device_api_lock_traced(device, #fn); _##fn args ; ungrab_device_api_lock_traced(lock, #fn); }
+
+static void lock_mixer(ALCdevice *device)
+{
+    if (device->isloopback) {
+        SDL_LockMutex(device->playback.loopback_lock);
+    } else {
+        SDL_LockAudioDevice(device->sdldevice);
+    }
+}
+
+static void unlock_mixer(ALCdevice *device)
+{
+    if (device->isloopback) {
+        SDL_UnlockMutex(device->playback.loopback_lock);
+    } else {
+        SDL_UnlockAudioDevice(device->sdldevice);
+    }
+}
+
 /* all data written before the release barrier must be available before the recalc flag changes. */ \
 #define context_needs_recalc(ctx) SDL_MemoryBarrierRelease(); ctx->recalc = AL_TRUE;
-#define source_needs_recalc(src) SDL_MemoryBarrierRelease(); src->recalc = AL_TRUE;
+#define source_needs_recalc(src) SDL_MemoryBarrierRelease(); src->voice->recalc = AL_TRUE;
 
 static ALCdevice *prep_alc_device(const char *devicename, const ALCboolean iscapture)
 {
@@ -695,11 +1562,18 @@ static ALCdevice *prep_alc_device(const char *devicename, const ALCboolean iscap
     has_neon = SDL_HasNEON();
     #endif
 
+    select_mixers();
+    #if HAVE_SPATIALIZE_BATCH
+    select_spatializer();
+    #endif
+
     if (!init_api_lock()) {
         SDL_QuitSubSystem(SDL_INIT_AUDIO);
         return NULL;
     }
 
+    init_tracing();
+
     dev = (ALCdevice *) SDL_calloc(1, sizeof (ALCdevice));
     if (!dev) {
         SDL_QuitSubSystem(SDL_INIT_AUDIO);
@@ -713,6 +1587,13 @@ static ALCdevice *prep_alc_device(const char *devicename, const ALCboolean iscap
         return NULL;
     }
 
+    if (!init_device_api_lock(dev)) {
+        SDL_free(dev->name);
+        SDL_free(dev);
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return NULL;
+    }
+
     SDL_AtomicSet(&dev->connected, ALC_TRUE);
     dev->iscapture = iscapture;
 
@@ -732,11 +1613,46 @@ ALCdevice *alcOpenDevice(const ALCchar *devicename)
        created, so we can attempt to match audio formats. */
 }
 
+/* no api lock; this creates it and otherwise doesn't have any state that can race */
+ALCdevice *alcLoopbackOpenDeviceSOFT(const ALCchar *devicename)
+{
+    ALCdevice *device;
+
+    /* there's only one kind of loopback device, so we don't offer any names to pick from. */
+    if (devicename != NULL) {
+        set_alc_error(NULL, ALC_INVALID_VALUE);
+        return NULL;
+    }
+
+    device = prep_alc_device(LOOPBACK_DEVICE, ALC_FALSE);
+    if (!device) {
+        return NULL;
+    }
+
+    /* we never open an SDL audio device for this; the format comes from the context attributes. */
+    device->isloopback = ALC_TRUE;
+    device->playback.loopback_lock = SDL_CreateMutex();
+    device->playback.loopback_mix = (float *) calloc_simd_aligned(OPENAL_LOOPBACK_CHUNK_FRAMES * sizeof (float) * 2);
+    if (!device->playback.loopback_lock || !device->playback.loopback_mix) {
+        if (device->playback.loopback_lock) {
+            SDL_DestroyMutex(device->playback.loopback_lock);
+        }
+        free_simd_aligned(device->playback.loopback_mix);
+        destroy_device_api_lock(device);
+        SDL_free(device->name);
+        SDL_free(device);
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        set_alc_error(NULL, ALC_OUT_OF_MEMORY);
+        return NULL;
+    }
+
+    return device;
+}
+
 /* no api lock; this requires you to not destroy a device that's still in use */
 ALCboolean alcCloseDevice(ALCdevice *device)
 {
     BufferQueueItem *item;
-    SourcePlayTodo *todo;
     ALCsizei i;
 
     if (!device || device->iscapture) {
@@ -758,6 +1674,15 @@ ALCboolean alcCloseDevice(ALCdevice *device)
         SDL_CloseAudioDevice(device->sdldevice);
     }
 
+    if (device->isloopback) {
+        SDL_DestroyMutex(device->playback.loopback_lock);
+        free_simd_aligned(device->playback.loopback_mix);
+    }
+
+    if (device->playback.mix_done) {
+        SDL_DestroySemaphore(device->playback.mix_done);
+    }
+
     for (i = 0; i < device->playback.num_buffer_blocks; i++) {
         SDL_free(device->playback.buffer_blocks[i]);
     }
@@ -770,13 +1695,7 @@ ALCboolean alcCloseDevice(ALCdevice *device)
         item = next;
     }
 
-    todo = (SourcePlayTodo *) device->playback.source_todo_pool;
-    while (todo) {
-        SourcePlayTodo *next = todo->next;
-        SDL_free(todo);
-        todo = next;
-    }
-
+    destroy_device_api_lock(device);
     SDL_free(device->name);
     SDL_free(device);
     SDL_QuitSubSystem(SDL_INIT_AUDIO);
@@ -946,10 +1865,10 @@ static void mix_float32_c1_sse(const ALfloat * restrict panning, const float * r
                 const __m128 vstream2 = _mm_load_ps(stream+4);
                 const __m128 vstream3 = _mm_load_ps(stream+8);
                 const __m128 vstream4 = _mm_load_ps(stream+12);
-                _mm_store_ps(stream, _mm_add_ps(vstream1, _mm_shuffle_ps(vdataload1, vdataload1, _MM_SHUFFLE(0, 0, 1, 1))));
-                _mm_store_ps(stream+4, _mm_add_ps(vstream2, _mm_shuffle_ps(vdataload1, vdataload1, _MM_SHUFFLE(2, 2, 3, 3))));
-                _mm_store_ps(stream+8, _mm_add_ps(vstream3, _mm_shuffle_ps(vdataload2, vdataload2, _MM_SHUFFLE(0, 0, 1, 1))));
-                _mm_store_ps(stream+12, _mm_add_ps(vstream4, _mm_shuffle_ps(vdataload2, vdataload2, _MM_SHUFFLE(2, 2, 3, 3))));
+                _mm_store_ps(stream, _mm_add_ps(vstream1, _mm_shuffle_ps(vdataload1, vdataload1, _MM_SHUFFLE(1, 1, 0, 0))));
+                _mm_store_ps(stream+4, _mm_add_ps(vstream2, _mm_shuffle_ps(vdataload1, vdataload1, _MM_SHUFFLE(3, 3, 2, 2))));
+                _mm_store_ps(stream+8, _mm_add_ps(vstream3, _mm_shuffle_ps(vdataload2, vdataload2, _MM_SHUFFLE(1, 1, 0, 0))));
+                _mm_store_ps(stream+12, _mm_add_ps(vstream4, _mm_shuffle_ps(vdataload2, vdataload2, _MM_SHUFFLE(3, 3, 2, 2))));
             }
         }
         for (i = 0; i < leftover; i++, stream += 2) {
@@ -967,10 +1886,10 @@ static void mix_float32_c1_sse(const ALfloat * restrict panning, const float * r
             const __m128 vstream2 = _mm_load_ps(stream+4);
             const __m128 vstream3 = _mm_load_ps(stream+8);
             const __m128 vstream4 = _mm_load_ps(stream+12);
-            _mm_store_ps(stream, _mm_add_ps(vstream1, _mm_mul_ps(_mm_shuffle_ps(vdataload1, vdataload1, _MM_SHUFFLE(0, 0, 1, 1)), vleftright)));
-            _mm_store_ps(stream+4, _mm_add_ps(vstream2, _mm_mul_ps(_mm_shuffle_ps(vdataload1, vdataload1, _MM_SHUFFLE(2, 2, 3, 3)), vleftright)));
-            _mm_store_ps(stream+8, _mm_add_ps(vstream3, _mm_mul_ps(_mm_shuffle_ps(vdataload2, vdataload2, _MM_SHUFFLE(0, 0, 1, 1)), vleftright)));
-            _mm_store_ps(stream+12, _mm_add_ps(vstream4, _mm_mul_ps(_mm_shuffle_ps(vdataload2, vdataload2, _MM_SHUFFLE(2, 2, 3, 3)), vleftright)));
+            _mm_store_ps(stream, _mm_add_ps(vstream1, _mm_mul_ps(_mm_shuffle_ps(vdataload1, vdataload1, _MM_SHUFFLE(1, 1, 0, 0)), vleftright)));
+            _mm_store_ps(stream+4, _mm_add_ps(vstream2, _mm_mul_ps(_mm_shuffle_ps(vdataload1, vdataload1, _MM_SHUFFLE(3, 3, 2, 2)), vleftright)));
+            _mm_store_ps(stream+8, _mm_add_ps(vstream3, _mm_mul_ps(_mm_shuffle_ps(vdataload2, vdataload2, _MM_SHUFFLE(1, 1, 0, 0)), vleftright)));
+            _mm_store_ps(stream+12, _mm_add_ps(vstream4, _mm_mul_ps(_mm_shuffle_ps(vdataload2, vdataload2, _MM_SHUFFLE(3, 3, 2, 2)), vleftright)));
         }
         for (i = 0; i < leftover; i++, stream += 2) {
             const float samp = *(data++);
@@ -1027,6 +1946,141 @@ static void mix_float32_c2_sse(const ALfloat * restrict panning, const float * r
 }
 #endif
 
+#if HAVE_AVX_MIXERS
+/* These get built no matter what the compiler was told to target, and
+   select_mixers() only picks them if CPUID says the CPU can run them.
+   Data and stream don't have to be 32/64-byte aligned here; unaligned
+   loads on aligned memory are as fast as aligned ones on any chip that
+   has AVX, and most of our buffers are only 16-byte aligned anyhow. */
+TARGET_AVX static void mix_float32_c1_avx(const ALfloat * restrict panning, const float * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0];
+    const ALfloat right = panning[1];
+    const __m256 vleftright = _mm256_setr_ps(left, right, left, right, left, right, left, right);
+    const int unrolled = mixframes / 8;
+    const int leftover = mixframes % 8;
+    ALsizei i;
+
+    for (i = 0; i < unrolled; i++, data += 8, stream += 16) {
+        const __m128 vdata1 = _mm_loadu_ps(data);
+        const __m128 vdata2 = _mm_loadu_ps(data+4);
+        const __m256 vdup1 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_unpacklo_ps(vdata1, vdata1)), _mm_unpackhi_ps(vdata1, vdata1), 1);
+        const __m256 vdup2 = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_unpacklo_ps(vdata2, vdata2)), _mm_unpackhi_ps(vdata2, vdata2), 1);
+        _mm256_storeu_ps(stream, _mm256_add_ps(_mm256_loadu_ps(stream), _mm256_mul_ps(vdup1, vleftright)));
+        _mm256_storeu_ps(stream+8, _mm256_add_ps(_mm256_loadu_ps(stream+8), _mm256_mul_ps(vdup2, vleftright)));
+    }
+
+    if (leftover) {
+        mix_float32_c1_scalar(panning, data, stream, leftover);
+    }
+}
+
+TARGET_AVX static void mix_float32_c2_avx(const ALfloat * restrict panning, const float * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0];
+    const ALfloat right = panning[1];
+    const __m256 vleftright = _mm256_setr_ps(left, right, left, right, left, right, left, right);
+    const int unrolled = mixframes / 8;
+    const int leftover = mixframes % 8;
+    ALsizei i;
+
+    for (i = 0; i < unrolled; i++, data += 16, stream += 16) {
+        _mm256_storeu_ps(stream, _mm256_add_ps(_mm256_loadu_ps(stream), _mm256_mul_ps(_mm256_loadu_ps(data), vleftright)));
+        _mm256_storeu_ps(stream+8, _mm256_add_ps(_mm256_loadu_ps(stream+8), _mm256_mul_ps(_mm256_loadu_ps(data+8), vleftright)));
+    }
+
+    if (leftover) {
+        mix_float32_c2_scalar(panning, data, stream, leftover);
+    }
+}
+
+/* AVX2 gets us a full cross-lane permute for duplicating mono samples, and
+   FMA does the gain-multiply-accumulate in one instruction. Multiplying by
+   exactly 1.0f is exact, so we don't need a separate no-panning path. */
+TARGET_AVX2_FMA static void mix_float32_c1_avx2(const ALfloat * restrict panning, const float * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0];
+    const ALfloat right = panning[1];
+    const __m256 vleftright = _mm256_setr_ps(left, right, left, right, left, right, left, right);
+    const __m256i vlowidx = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+    const __m256i vhighidx = _mm256_setr_epi32(4, 4, 5, 5, 6, 6, 7, 7);
+    const int unrolled = mixframes / 8;
+    const int leftover = mixframes % 8;
+    ALsizei i;
+
+    for (i = 0; i < unrolled; i++, data += 8, stream += 16) {
+        const __m256 vdata = _mm256_loadu_ps(data);
+        _mm256_storeu_ps(stream, _mm256_fmadd_ps(_mm256_permutevar8x32_ps(vdata, vlowidx), vleftright, _mm256_loadu_ps(stream)));
+        _mm256_storeu_ps(stream+8, _mm256_fmadd_ps(_mm256_permutevar8x32_ps(vdata, vhighidx), vleftright, _mm256_loadu_ps(stream+8)));
+    }
+
+    if (leftover) {
+        mix_float32_c1_scalar(panning, data, stream, leftover);
+    }
+}
+
+TARGET_AVX2_FMA static void mix_float32_c2_avx2(const ALfloat * restrict panning, const float * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0];
+    const ALfloat right = panning[1];
+    const __m256 vleftright = _mm256_setr_ps(left, right, left, right, left, right, left, right);
+    const int unrolled = mixframes / 8;
+    const int leftover = mixframes % 8;
+    ALsizei i;
+
+    for (i = 0; i < unrolled; i++, data += 16, stream += 16) {
+        _mm256_storeu_ps(stream, _mm256_fmadd_ps(_mm256_loadu_ps(data), vleftright, _mm256_loadu_ps(stream)));
+        _mm256_storeu_ps(stream+8, _mm256_fmadd_ps(_mm256_loadu_ps(data+8), vleftright, _mm256_loadu_ps(stream+8)));
+    }
+
+    if (leftover) {
+        mix_float32_c2_scalar(panning, data, stream, leftover);
+    }
+}
+
+/* AVX-512 does 16 frames per iteration and lets the AVX2 version clean up. */
+TARGET_AVX512 static void mix_float32_c1_avx512(const ALfloat * restrict panning, const float * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0];
+    const ALfloat right = panning[1];
+    const __m512 vleftright = _mm512_setr_ps(left, right, left, right, left, right, left, right, left, right, left, right, left, right, left, right);
+    const __m512i vlowidx = _mm512_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7);
+    const __m512i vhighidx = _mm512_setr_epi32(8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13, 14, 14, 15, 15);
+    const int unrolled = mixframes / 16;
+    const int leftover = mixframes % 16;
+    ALsizei i;
+
+    for (i = 0; i < unrolled; i++, data += 16, stream += 32) {
+        const __m512 vdata = _mm512_loadu_ps(data);
+        _mm512_storeu_ps(stream, _mm512_fmadd_ps(_mm512_permutexvar_ps(vlowidx, vdata), vleftright, _mm512_loadu_ps(stream)));
+        _mm512_storeu_ps(stream+16, _mm512_fmadd_ps(_mm512_permutexvar_ps(vhighidx, vdata), vleftright, _mm512_loadu_ps(stream+16)));
+    }
+
+    if (leftover) {
+        mix_float32_c1_avx2(panning, data, stream, leftover);
+    }
+}
+
+TARGET_AVX512 static void mix_float32_c2_avx512(const ALfloat * restrict panning, const float * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0];
+    const ALfloat right = panning[1];
+    const __m512 vleftright = _mm512_setr_ps(left, right, left, right, left, right, left, right, left, right, left, right, left, right, left, right);
+    const int unrolled = mixframes / 16;
+    const int leftover = mixframes % 16;
+    ALsizei i;
+
+    for (i = 0; i < unrolled; i++, data += 32, stream += 32) {
+        _mm512_storeu_ps(stream, _mm512_fmadd_ps(_mm512_loadu_ps(data), vleftright, _mm512_loadu_ps(stream)));
+        _mm512_storeu_ps(stream+16, _mm512_fmadd_ps(_mm512_loadu_ps(data+16), vleftright, _mm512_loadu_ps(stream+16)));
+    }
+
+    if (leftover) {
+        mix_float32_c2_avx2(panning, data, stream, leftover);
+    }
+}
+#endif
+
 #ifdef __ARM_NEON__
 static void mix_float32_c1_neon(const ALfloat * restrict panning, const float * restrict data, float * restrict stream, const ALsizei mixframes)
 {
@@ -1149,940 +2203,3006 @@ static void mix_float32_c2_neon(const ALfloat * restrict panning, const float *
 }
 #endif
 
+/* Mixers for buffers we keep as 16-bit signed or 8-bit unsigned PCM. These
+   convert to float as they go, so the buffer never needs a float32 copy.
+   The conversion scale is folded into the panning gains up front. The
+   scalar versions always get built, since the SIMD ones use them for any
+   leftover frames. */
+#define S16_TO_FLOAT_SCALE (1.0f / 32768.0f)
+#define U8_TO_FLOAT_SCALE (1.0f / 128.0f)
 
-/****************************************************************************
-*
-* pitch_fft and pitch_shift are modified versions of code from:
-*
-*    http://blogs.zynaptiq.com/bernsee/pitch-shifting-using-the-ft/
-*
-*   The original code has this copyright/license:
-*
-*****************************************************************************
-*
-* COPYRIGHT 1999-2015 Stephan M. Bernsee <s.bernsee [AT] zynaptiq [DOT] com>
-*
-* 						The Wide Open License (WOL)
-*
-* Permission to use, copy, modify, distribute and sell this software and its
-* documentation for any purpose is hereby granted without fee, provided that
-* the above copyright notice and this license appear in all source copies. 
-* THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY OF
-* ANY KIND. See http://www.dspguru.com/wol.htm for more information.
-*
-*****************************************************************************/ 
+static void mix_s16_c1_scalar(const ALfloat * restrict panning, const Sint16 * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0] * S16_TO_FLOAT_SCALE;
+    const ALfloat right = panning[1] * S16_TO_FLOAT_SCALE;
+    ALsizei i;
 
-/* FFT routine, (C)1996 S.M.Bernsee. */
-static void pitch_fft(float *fftBuffer, int fftFrameSize, int sign)
-{
-    float wr, wi, arg, *p1, *p2, temp;
-    float tr, ti, ur, ui, *p1r, *p1i, *p2r, *p2i;
-    int i, bitm, j, le, le2, k;
-
-    for (i = 2; i < 2*fftFrameSize-2; i += 2) {
-        for (bitm = 2, j = 0; bitm < 2*fftFrameSize; bitm <<= 1) {
-            if (i & bitm) j++;
-            j <<= 1;
-        }
-        if (i < j) {
-            p1 = fftBuffer+i; p2 = fftBuffer+j;
-            temp = *p1; *(p1++) = *p2;
-            *(p2++) = temp; temp = *p1;
-            *p1 = *p2; *p2 = temp;
-        }
-    }
-    const int endval = (int)(SDL_log(fftFrameSize)/SDL_log(2.)+.5);   /* !!! FIXME: precalc this. */
-    for (k = 0, le = 2; k < endval; k++) {
-        le <<= 1;
-        le2 = le>>1;
-        ur = 1.0;
-        ui = 0.0;
-        arg = M_PI / (le2>>1);
-        wr = SDL_cos(arg);
-        wi = sign*SDL_sin(arg);
-        for (j = 0; j < le2; j += 2) {
-            p1r = fftBuffer+j; p1i = p1r+1;
-            p2r = p1r+le2; p2i = p2r+1;
-            for (i = j; i < 2*fftFrameSize; i += le) {
-                tr = *p2r * ur - *p2i * ui;
-                ti = *p2r * ui + *p2i * ur;
-                *p2r = *p1r - tr; *p2i = *p1i - ti;
-                *p1r += tr; *p1i += ti;
-                p1r += le; p1i += le;
-                p2r += le; p2i += le;
-            }
-            tr = ur*wr - ui*wi;
-            ui = ur*wi + ui*wr;
-            ur = tr;
-        }
+    for (i = 0; i < mixframes; i++, stream += 2) {
+        const float samp = (float) *(data++);
+        stream[0] += samp * left;
+        stream[1] += samp * right;
     }
 }
 
-static void pitch_shift(ALsource *src, const ALbuffer *buffer, int numSampsToProcess, const float *indata, float *outdata)
+static void mix_s16_c2_scalar(const ALfloat * restrict panning, const Sint16 * restrict data, float * restrict stream, const ALsizei mixframes)
 {
-    const float pitchShift = src->pitch;
-    const float sampleRate = (float) buffer->frequency;
-    const int osamp = 4;
-    const int stepSize = pitch_framesize / osamp;
-    const int inFifoLatency = pitch_framesize - stepSize;
-    const double freqPerBin = sampleRate / (double)pitch_framesize;
-    const double expct = 2.0 * M_PI * ((double)stepSize / (double)pitch_framesize);
-
-    double magn, phase, tmp, window, real, imag;
-    int i,k, qpd, index;
-    PitchState *state = src->pitchstate;
-
-    SDL_assert(state != NULL);
-
-    if (state->rover == 0) state->rover = inFifoLatency;
-
-    /* main processing loop */
-    for (i = 0; i < numSampsToProcess; i++){
-
-        /* As long as we have not yet collected enough data just read in */
-        state->infifo[state->rover] = indata[i];
-        outdata[i] = state->outfifo[state->rover-inFifoLatency];
-        state->rover++;
-
-        /* now we have enough data for processing */
-        if (state->rover >= pitch_framesize) {
-            state->rover = inFifoLatency;
+    const ALfloat left = panning[0] * S16_TO_FLOAT_SCALE;
+    const ALfloat right = panning[1] * S16_TO_FLOAT_SCALE;
+    ALsizei i;
 
-            /* do windowing and re,im interleave */
-            for (k = 0; k < pitch_framesize;k++) {
-                window = -.5*SDL_cos(2.*M_PI*(double)k/(double)pitch_framesize)+.5;
-                state->workspace[2*k] = state->infifo[k] * window;
-                state->workspace[2*k+1] = 0.;
-            }
+    for (i = 0; i < mixframes; i++, stream += 2, data += 2) {
+        stream[0] += ((float) data[0]) * left;
+        stream[1] += ((float) data[1]) * right;
+    }
+}
 
+static void mix_u8_c1_scalar(const ALfloat * restrict panning, const Uint8 * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0] * U8_TO_FLOAT_SCALE;
+    const ALfloat right = panning[1] * U8_TO_FLOAT_SCALE;
+    ALsizei i;
 
-            /* ***************** ANALYSIS ******************* */
-            /* do transform */
-            pitch_fft(state->workspace, pitch_framesize, -1);
+    for (i = 0; i < mixframes; i++, stream += 2) {
+        const float samp = (float) (((int) *(data++)) - 128);
+        stream[0] += samp * left;
+        stream[1] += samp * right;
+    }
+}
 
-            /* this is the analysis step */
-            for (k = 0; k <= pitch_framesize2; k++) {
+static void mix_u8_c2_scalar(const ALfloat * restrict panning, const Uint8 * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0] * U8_TO_FLOAT_SCALE;
+    const ALfloat right = panning[1] * U8_TO_FLOAT_SCALE;
+    ALsizei i;
 
-                /* de-interlace FFT buffer */
-                real = state->workspace[2*k];
-                imag = state->workspace[2*k+1];
+    for (i = 0; i < mixframes; i++, stream += 2, data += 2) {
+        stream[0] += ((float) (((int) data[0]) - 128)) * left;
+        stream[1] += ((float) (((int) data[1]) - 128)) * right;
+    }
+}
 
-                /* compute magnitude and phase */
-                magn = 2.*SDL_sqrt(real*real + imag*imag);
-                phase = SDL_atan2(imag,real);
+#ifdef __SSE2__
+static void mix_s16_c1_sse2(const ALfloat * restrict panning, const Sint16 * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0] * S16_TO_FLOAT_SCALE;
+    const ALfloat right = panning[1] * S16_TO_FLOAT_SCALE;
+    const __m128 vleftright = _mm_setr_ps(left, right, left, right);
+    const int unrolled = mixframes / 8;
+    const int leftover = mixframes % 8;
+    ALsizei i;
 
-                /* compute phase difference */
-                tmp = phase - state->lastphase[k];
-                state->lastphase[k] = phase;
+    for (i = 0; i < unrolled; i++, data += 8, stream += 16) {
+        const __m128i vdata = _mm_loadu_si128((const __m128i *) data);
+        /* put each sample in the top of a 32-bit lane and shift it back down to sign-extend. */
+        const __m128 vlo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(vdata, vdata), 16));
+        const __m128 vhi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(vdata, vdata), 16));
+        _mm_storeu_ps(stream, _mm_add_ps(_mm_loadu_ps(stream), _mm_mul_ps(_mm_unpacklo_ps(vlo, vlo), vleftright)));
+        _mm_storeu_ps(stream+4, _mm_add_ps(_mm_loadu_ps(stream+4), _mm_mul_ps(_mm_unpackhi_ps(vlo, vlo), vleftright)));
+        _mm_storeu_ps(stream+8, _mm_add_ps(_mm_loadu_ps(stream+8), _mm_mul_ps(_mm_unpacklo_ps(vhi, vhi), vleftright)));
+        _mm_storeu_ps(stream+12, _mm_add_ps(_mm_loadu_ps(stream+12), _mm_mul_ps(_mm_unpackhi_ps(vhi, vhi), vleftright)));
+    }
 
-                /* subtract expected phase difference */
-                tmp -= (double)k*expct;
+    if (leftover) {
+        mix_s16_c1_scalar(panning, data, stream, leftover);
+    }
+}
 
-                /* map delta phase into +/- Pi interval */
-                qpd = tmp/M_PI;
-                if (qpd >= 0) qpd += qpd&1;
-                else qpd -= qpd&1;
-                tmp -= M_PI*(double)qpd;
+static void mix_s16_c2_sse2(const ALfloat * restrict panning, const Sint16 * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0] * S16_TO_FLOAT_SCALE;
+    const ALfloat right = panning[1] * S16_TO_FLOAT_SCALE;
+    const __m128 vleftright = _mm_setr_ps(left, right, left, right);
+    const int unrolled = mixframes / 4;
+    const int leftover = mixframes % 4;
+    ALsizei i;
 
-                /* get deviation from bin frequency from the +/- Pi interval */
-                tmp = osamp*tmp/(2.*M_PI);
+    for (i = 0; i < unrolled; i++, data += 8, stream += 8) {
+        const __m128i vdata = _mm_loadu_si128((const __m128i *) data);
+        const __m128 vlo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(vdata, vdata), 16));
+        const __m128 vhi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(vdata, vdata), 16));
+        _mm_storeu_ps(stream, _mm_add_ps(_mm_loadu_ps(stream), _mm_mul_ps(vlo, vleftright)));
+        _mm_storeu_ps(stream+4, _mm_add_ps(_mm_loadu_ps(stream+4), _mm_mul_ps(vhi, vleftright)));
+    }
 
-                /* compute the k-th partials' true frequency */
-                tmp = (double)k*freqPerBin + tmp*freqPerBin;
+    if (leftover) {
+        mix_s16_c2_scalar(panning, data, stream, leftover);
+    }
+}
 
-                /* store magnitude and true frequency in analysis arrays */
-                state->workspace[2*k] = magn;
-                state->workspace[2*k+1] = tmp;
+static void mix_u8_c1_sse2(const ALfloat * restrict panning, const Uint8 * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0] * U8_TO_FLOAT_SCALE;
+    const ALfloat right = panning[1] * U8_TO_FLOAT_SCALE;
+    const __m128 vleftright = _mm_setr_ps(left, right, left, right);
+    const __m128i vzero = _mm_setzero_si128();
+    const __m128i vbias = _mm_set1_epi16(128);
+    const int unrolled = mixframes / 8;
+    const int leftover = mixframes % 8;
+    ALsizei i;
 
-            }
+    for (i = 0; i < unrolled; i++, data += 8, stream += 16) {
+        /* widen to 16 bits and remove the bias, then sign-extend like the Sint16 version. */
+        const __m128i vdata = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) data), vzero), vbias);
+        const __m128 vlo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(vdata, vdata), 16));
+        const __m128 vhi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(vdata, vdata), 16));
+        _mm_storeu_ps(stream, _mm_add_ps(_mm_loadu_ps(stream), _mm_mul_ps(_mm_unpacklo_ps(vlo, vlo), vleftright)));
+        _mm_storeu_ps(stream+4, _mm_add_ps(_mm_loadu_ps(stream+4), _mm_mul_ps(_mm_unpackhi_ps(vlo, vlo), vleftright)));
+        _mm_storeu_ps(stream+8, _mm_add_ps(_mm_loadu_ps(stream+8), _mm_mul_ps(_mm_unpacklo_ps(vhi, vhi), vleftright)));
+        _mm_storeu_ps(stream+12, _mm_add_ps(_mm_loadu_ps(stream+12), _mm_mul_ps(_mm_unpackhi_ps(vhi, vhi), vleftright)));
+    }
 
-            /* ***************** PROCESSING ******************* */
-            /* this does the actual pitch shifting */
-            SDL_memset(state->synmagn, '\0', sizeof (state->synmagn));
-            for (k = 0; k <= pitch_framesize2; k++) {
-                index = k*pitchShift;
-                if (index <= pitch_framesize2) { 
-                    state->synmagn[index] += state->workspace[2*k];
-                    state->synfreq[index] = state->workspace[2*k+1] * pitchShift;
-                } 
-            }
-            
-            /* ***************** SYNTHESIS ******************* */
-            /* this is the synthesis step */
-            for (k = 0; k <= pitch_framesize2; k++) {
+    if (leftover) {
+        mix_u8_c1_scalar(panning, data, stream, leftover);
+    }
+}
 
-                /* get magnitude and true frequency from synthesis arrays */
-                magn = state->synmagn[k];
-                tmp = state->synfreq[k];
+static void mix_u8_c2_sse2(const ALfloat * restrict panning, const Uint8 * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0] * U8_TO_FLOAT_SCALE;
+    const ALfloat right = panning[1] * U8_TO_FLOAT_SCALE;
+    const __m128 vleftright = _mm_setr_ps(left, right, left, right);
+    const __m128i vzero = _mm_setzero_si128();
+    const __m128i vbias = _mm_set1_epi16(128);
+    const int unrolled = mixframes / 4;
+    const int leftover = mixframes % 4;
+    ALsizei i;
 
-                /* subtract bin mid frequency */
-                tmp -= (double)k*freqPerBin;
+    for (i = 0; i < unrolled; i++, data += 8, stream += 8) {
+        const __m128i vdata = _mm_sub_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *) data), vzero), vbias);
+        const __m128 vlo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(vdata, vdata), 16));
+        const __m128 vhi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(vdata, vdata), 16));
+        _mm_storeu_ps(stream, _mm_add_ps(_mm_loadu_ps(stream), _mm_mul_ps(vlo, vleftright)));
+        _mm_storeu_ps(stream+4, _mm_add_ps(_mm_loadu_ps(stream+4), _mm_mul_ps(vhi, vleftright)));
+    }
 
-                /* get bin deviation from freq deviation */
-                tmp /= freqPerBin;
+    if (leftover) {
+        mix_u8_c2_scalar(panning, data, stream, leftover);
+    }
+}
+#endif
 
-                /* take osamp into account */
-                tmp = 2.*M_PI*tmp/osamp;
+#ifdef __ARM_NEON__
+static void mix_s16_c1_neon(const ALfloat * restrict panning, const Sint16 * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0] * S16_TO_FLOAT_SCALE;
+    const ALfloat right = panning[1] * S16_TO_FLOAT_SCALE;
+    const float32x4_t vleftright = { left, right, left, right };
+    const int unrolled = mixframes / 8;
+    const int leftover = mixframes % 8;
+    ALsizei i;
 
-                /* add the overlap phase advance back in */
-                tmp += (double)k*expct;
+    for (i = 0; i < unrolled; i++, data += 8, stream += 16) {
+        const int16x8_t vdata = vld1q_s16(data);
+        const float32x4_t vlo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(vdata)));
+        const float32x4_t vhi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(vdata)));
+        const float32x4x2_t vzipped1 = vzipq_f32(vlo, vlo);
+        const float32x4x2_t vzipped2 = vzipq_f32(vhi, vhi);
+        vst1q_f32(stream, vmlaq_f32(vld1q_f32(stream), vzipped1.val[0], vleftright));
+        vst1q_f32(stream+4, vmlaq_f32(vld1q_f32(stream+4), vzipped1.val[1], vleftright));
+        vst1q_f32(stream+8, vmlaq_f32(vld1q_f32(stream+8), vzipped2.val[0], vleftright));
+        vst1q_f32(stream+12, vmlaq_f32(vld1q_f32(stream+12), vzipped2.val[1], vleftright));
+    }
 
-                /* accumulate delta phase to get bin phase */
-                state->sumphase[k] += tmp;
-                phase = state->sumphase[k];
+    if (leftover) {
+        mix_s16_c1_scalar(panning, data, stream, leftover);
+    }
+}
 
-                /* get real and imag part and re-interleave */
-                state->workspace[2*k] = magn*SDL_cos(phase);
-                state->workspace[2*k+1] = magn*SDL_sin(phase);
-            } 
+static void mix_s16_c2_neon(const ALfloat * restrict panning, const Sint16 * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0] * S16_TO_FLOAT_SCALE;
+    const ALfloat right = panning[1] * S16_TO_FLOAT_SCALE;
+    const float32x4_t vleftright = { left, right, left, right };
+    const int unrolled = mixframes / 4;
+    const int leftover = mixframes % 4;
+    ALsizei i;
 
-            /* zero negative frequencies */
-            for (k = pitch_framesize+2; k < 2*pitch_framesize; k++) state->workspace[k] = 0.;
+    for (i = 0; i < unrolled; i++, data += 8, stream += 8) {
+        const int16x8_t vdata = vld1q_s16(data);
+        vst1q_f32(stream, vmlaq_f32(vld1q_f32(stream), vcvtq_f32_s32(vmovl_s16(vget_low_s16(vdata))), vleftright));
+        vst1q_f32(stream+4, vmlaq_f32(vld1q_f32(stream+4), vcvtq_f32_s32(vmovl_s16(vget_high_s16(vdata))), vleftright));
+    }
 
-            /* do inverse transform */
-            pitch_fft(state->workspace, pitch_framesize, 1);
+    if (leftover) {
+        mix_s16_c2_scalar(panning, data, stream, leftover);
+    }
+}
 
-            /* do windowing and add to output accumulator */ 
-            for(k=0; k < pitch_framesize; k++) {
-                window = -.5*SDL_cos(2.*M_PI*(double)k/(double)pitch_framesize)+.5;
-                state->outputaccum[k] += 2.*window*state->workspace[2*k]/(pitch_framesize2*osamp);
-            }
-            for (k = 0; k < stepSize; k++) state->outfifo[k] = state->outputaccum[k];
+static void mix_u8_c1_neon(const ALfloat * restrict panning, const Uint8 * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0] * U8_TO_FLOAT_SCALE;
+    const ALfloat right = panning[1] * U8_TO_FLOAT_SCALE;
+    const float32x4_t vleftright = { left, right, left, right };
+    const int unrolled = mixframes / 8;
+    const int leftover = mixframes % 8;
+    ALsizei i;
 
-            /* shift accumulator */
-            SDL_memmove(state->outputaccum, state->outputaccum+stepSize, pitch_framesize*sizeof(float));
+    for (i = 0; i < unrolled; i++, data += 8, stream += 16) {
+        const int16x8_t vdata = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(data))), vdupq_n_s16(128));
+        const float32x4_t vlo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(vdata)));
+        const float32x4_t vhi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(vdata)));
+        const float32x4x2_t vzipped1 = vzipq_f32(vlo, vlo);
+        const float32x4x2_t vzipped2 = vzipq_f32(vhi, vhi);
+        vst1q_f32(stream, vmlaq_f32(vld1q_f32(stream), vzipped1.val[0], vleftright));
+        vst1q_f32(stream+4, vmlaq_f32(vld1q_f32(stream+4), vzipped1.val[1], vleftright));
+        vst1q_f32(stream+8, vmlaq_f32(vld1q_f32(stream+8), vzipped2.val[0], vleftright));
+        vst1q_f32(stream+12, vmlaq_f32(vld1q_f32(stream+12), vzipped2.val[1], vleftright));
+    }
 
-            /* move input FIFO */
-            for (k = 0; k < inFifoLatency; k++) state->infifo[k] = state->infifo[k+stepSize];
-        }
+    if (leftover) {
+        mix_u8_c1_scalar(panning, data, stream, leftover);
     }
 }
 
-static void mix_buffer(ALsource *src, const ALbuffer *buffer, const ALfloat * restrict panning, const float * restrict data, float * restrict stream, const ALsizei mixframes)
+static void mix_u8_c2_neon(const ALfloat * restrict panning, const Uint8 * restrict data, float * restrict stream, const ALsizei mixframes)
 {
-    if ((src->pitch != 1.0f) && (src->pitchstate != NULL)) {
-        float *pitched = (float *) alloca(mixframes * buffer->channels * sizeof (float));
-        pitch_shift(src, buffer, mixframes * buffer->channels, data, pitched);
-        data = pitched;
+    const ALfloat left = panning[0] * U8_TO_FLOAT_SCALE;
+    const ALfloat right = panning[1] * U8_TO_FLOAT_SCALE;
+    const float32x4_t vleftright = { left, right, left, right };
+    const int unrolled = mixframes / 4;
+    const int leftover = mixframes % 4;
+    ALsizei i;
+
+    for (i = 0; i < unrolled; i++, data += 8, stream += 8) {
+        const int16x8_t vdata = vsubq_s16(vreinterpretq_s16_u16(vmovl_u8(vld1_u8(data))), vdupq_n_s16(128));
+        vst1q_f32(stream, vmlaq_f32(vld1q_f32(stream), vcvtq_f32_s32(vmovl_s16(vget_low_s16(vdata))), vleftright));
+        vst1q_f32(stream+4, vmlaq_f32(vld1q_f32(stream+4), vcvtq_f32_s32(vmovl_s16(vget_high_s16(vdata))), vleftright));
     }
 
-    const ALfloat left = panning[0];
-    const ALfloat right = panning[1];
-    FIXME("currently expects output to be stereo");
-    if ((left != 0.0f) || (right != 0.0f)) {  /* don't bother mixing in silence. */
-        if (buffer->channels == 1) {
-            #ifdef __SSE__
-            if (has_sse) { mix_float32_c1_sse(panning, data, stream, mixframes); } else
-            #elif defined(__ARM_NEON__)
-            if (has_neon) { mix_float32_c1_neon(panning, data, stream, mixframes); } else
-            #endif
-            {
-            #if NEED_SCALAR_FALLBACK
-            mix_float32_c1_scalar(panning, data, stream, mixframes);
-            #else
-            SDL_assert(!"uhoh, we didn't compile in enough mixers!");
+    if (leftover) {
+        mix_u8_c2_scalar(panning, data, stream, leftover);
+    }
+}
+#endif
+
+#if HAVE_AVX_MIXERS
+/* SDL can tell us about AVX and AVX2, but not FMA, so ask CPUID directly. */
+static ALboolean cpu_has_fma(void)
+{
+    #ifdef _MSC_VER
+    int regs[4];
+    __cpuid(regs, 1);
+    return (regs[2] & (1 << 12)) ? AL_TRUE : AL_FALSE;
+    #else
+    unsigned int eax, ebx, ecx, edx;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return AL_FALSE;
+    }
+    return (ecx & (1 << 12)) ? AL_TRUE : AL_FALSE;
+    #endif
+}
+#endif
+
+/* Pick the widest mixers this CPU can run. This only ever picks the same
+   thing for a given machine, so it's safe to redo this at each device open. */
+static void select_mixers(void)
+{
+    #if NEED_SCALAR_FALLBACK
+    mix_float32_c1 = mix_float32_c1_scalar;
+    mix_float32_c2 = mix_float32_c2_scalar;
+    #endif
+
+    mix_s16_c1 = mix_s16_c1_scalar;
+    mix_s16_c2 = mix_s16_c2_scalar;
+    mix_u8_c1 = mix_u8_c1_scalar;
+    mix_u8_c2 = mix_u8_c2_scalar;
+
+    #ifdef __SSE2__
+    if (SDL_HasSSE2()) {
+        mix_s16_c1 = mix_s16_c1_sse2;
+        mix_s16_c2 = mix_s16_c2_sse2;
+        mix_u8_c1 = mix_u8_c1_sse2;
+        mix_u8_c2 = mix_u8_c2_sse2;
+    }
+    #elif defined(__ARM_NEON__)
+    if (has_neon) {
+        mix_s16_c1 = mix_s16_c1_neon;
+        mix_s16_c2 = mix_s16_c2_neon;
+        mix_u8_c1 = mix_u8_c1_neon;
+        mix_u8_c2 = mix_u8_c2_neon;
+    }
+    #endif
+
+    #ifdef __SSE__
+    mix_float32_c1 = mix_float32_c1_sse;
+    mix_float32_c2 = mix_float32_c2_sse;
+    #elif defined(__ARM_NEON__)
+    if (has_neon) {
+        mix_float32_c1 = mix_float32_c1_neon;
+        mix_float32_c2 = mix_float32_c2_neon;
+    }
+    #endif
+
+    #if HAVE_AVX_MIXERS
+    if (SDL_HasAVX()) {
+        mix_float32_c1 = mix_float32_c1_avx;
+        mix_float32_c2 = mix_float32_c2_avx;
+        if (SDL_HasAVX2() && cpu_has_fma()) {
+            mix_float32_c1 = mix_float32_c1_avx2;
+            mix_float32_c2 = mix_float32_c2_avx2;
+            #if SDL_VERSION_ATLEAST(2, 0, 9)
+            if (SDL_HasAVX512F()) {
+                mix_float32_c1 = mix_float32_c1_avx512;
+                mix_float32_c2 = mix_float32_c2_avx512;
+            }
             #endif
+        }
+    }
+    #endif
+
+    SDL_assert(mix_float32_c1 != NULL);
+    SDL_assert(mix_float32_c2 != NULL);
+}
+
+
+/* The phase vocoder's FFT. The vocoder only ever transforms real frames of
+   pitch_framesize samples, so we do that as a complex FFT of half the size
+   (even samples in the real parts, odd samples in the imaginary parts) and
+   untangle the result. Twiddle factors, the bit reversal permutation and the
+   analysis/synthesis windows are built once, the first time a source needs
+   the vocoder. */
+#define pitch_fftsize (pitch_framesize / 2)  /* complex points in the half-size FFT. */
+
+typedef struct PitchTables
+{
+    ALboolean initialized;
+    Uint16 bitrev[pitch_fftsize];
+    /* twiddles for each stage, stored as { wr, wr } and { -wi, wi } pairs so butterflies don't shuffle them. Stage with half-length h starts at element (h-1)*2. */
+    SIMDALIGNEDSTRUCT { ALfloat re[2 * pitch_fftsize]; ALfloat im[2 * pitch_fftsize]; } twiddle;
+    ALfloat split[2 * (pitch_fftsize + 1)];  /* e^(-2*pi*i*k/pitch_framesize), for pulling the real spectrum apart. */
+    ALfloat window[pitch_framesize];  /* Hann window for analysis. */
+    ALfloat synthesis_window[pitch_framesize];  /* Hann window for synthesis, with the output scaling folded in. */
+} PitchTables;
+
+static PitchTables pitch_tables;
+
+/* only called with the global api lock held, before any source gets a PitchState. */
+static void init_pitch_tables(void)
+{
+    PitchTables *t = &pitch_tables;
+    const int osamp = 4;
+    int bits = 0;
+    int h, i, j;
+
+    if (t->initialized) {
+        return;
+    }
+
+    while ((1 << bits) < pitch_fftsize) {
+        bits++;
+    }
+
+    for (i = 0; i < pitch_fftsize; i++) {
+        int rev = 0;
+        for (j = 0; j < bits; j++) {
+            rev |= ((i >> j) & 1) << (bits - 1 - j);
+        }
+        t->bitrev[i] = (Uint16) rev;
+    }
+
+    for (h = 1; h < pitch_fftsize; h <<= 1) {
+        ALfloat *re = t->twiddle.re + ((h - 1) * 2);
+        ALfloat *im = t->twiddle.im + ((h - 1) * 2);
+        for (j = 0; j < h; j++) {
+            const double arg = -M_PI * ((double) j) / ((double) h);
+            re[j*2] = re[j*2+1] = (ALfloat) SDL_cos(arg);
+            im[j*2] = (ALfloat) -SDL_sin(arg);
+            im[j*2+1] = (ALfloat) SDL_sin(arg);
+        }
+    }
+
+    for (i = 0; i <= pitch_fftsize; i++) {
+        const double arg = -2.0 * M_PI * ((double) i) / ((double) pitch_framesize);
+        t->split[i*2] = (ALfloat) SDL_cos(arg);
+        t->split[i*2+1] = (ALfloat) SDL_sin(arg);
+    }
+
+    for (i = 0; i < pitch_framesize; i++) {
+        const double window = -.5*SDL_cos(2.*M_PI*(double)i/(double)pitch_framesize)+.5;
+        t->window[i] = (ALfloat) window;
+        /* the 0.5 undoes the doubled DC and Nyquist bins in pitch_ifft_real, see there. */
+        t->synthesis_window[i] = (ALfloat) (0.5 * 2. * window / (pitch_framesize2 * osamp));
+    }
+
+    t->initialized = AL_TRUE;
+}
+
+/* in-place forward complex FFT (e^-i) of pitch_fftsize interleaved complex points. */
+static void pitch_fft_complex(float * restrict data)
+{
+    const PitchTables *t = &pitch_tables;
+    int h, i, j;
+
+    for (i = 0; i < pitch_fftsize; i++) {
+        const int k = t->bitrev[i];
+        if (i < k) {
+            const float re = data[i*2];
+            const float im = data[i*2+1];
+            data[i*2] = data[k*2];
+            data[i*2+1] = data[k*2+1];
+            data[k*2] = re;
+            data[k*2+1] = im;
+        }
+    }
+
+    /* first stage has no twiddles at all. */
+    for (i = 0; i < pitch_fftsize * 2; i += 4) {
+        const float ar = data[i], ai = data[i+1];
+        const float br = data[i+2], bi = data[i+3];
+        data[i] = ar + br; data[i+1] = ai + bi;
+        data[i+2] = ar - br; data[i+3] = ai - bi;
+    }
+
+    for (h = 2; h < pitch_fftsize; h <<= 1) {
+        const float *twr = t->twiddle.re + ((h - 1) * 2);
+        const float *twi = t->twiddle.im + ((h - 1) * 2);
+        for (i = 0; i < pitch_fftsize; i += h * 2) {
+            float *a = data + (i * 2);
+            float *b = a + (h * 2);
+            #if defined(__SSE__)
+            for (j = 0; j < h * 2; j += 4) {
+                const __m128 va = _mm_loadu_ps(a + j);
+                const __m128 vb = _mm_loadu_ps(b + j);
+                const __m128 vswap = _mm_shuffle_ps(vb, vb, _MM_SHUFFLE(2, 3, 0, 1));
+                const __m128 vt = _mm_add_ps(_mm_mul_ps(vb, _mm_loadu_ps(twr + j)), _mm_mul_ps(vswap, _mm_loadu_ps(twi + j)));
+                _mm_storeu_ps(a + j, _mm_add_ps(va, vt));
+                _mm_storeu_ps(b + j, _mm_sub_ps(va, vt));
             }
-        } else {
-            SDL_assert(buffer->channels == 2);
-            #ifdef __SSE__
-            if (has_sse) { mix_float32_c2_sse(panning, data, stream, mixframes); } else
             #elif defined(__ARM_NEON__)
-            if (has_neon) { mix_float32_c2_neon(panning, data, stream, mixframes); } else
+            if (has_neon) {
+                for (j = 0; j < h * 2; j += 4) {
+                    const float32x4_t va = vld1q_f32(a + j);
+                    const float32x4_t vb = vld1q_f32(b + j);
+                    const float32x4_t vt = vmlaq_f32(vmulq_f32(vb, vld1q_f32(twr + j)), vrev64q_f32(vb), vld1q_f32(twi + j));
+                    vst1q_f32(a + j, vaddq_f32(va, vt));
+                    vst1q_f32(b + j, vsubq_f32(va, vt));
+                }
+                continue;
+            }
             #endif
-            {
             #if NEED_SCALAR_FALLBACK
-            mix_float32_c2_scalar(panning, data, stream, mixframes);
-            #else
-            SDL_assert(!"uhoh, we didn't compile in enough mixers!");
+            for (j = 0; j < h * 2; j += 2) {
+                const float tr = (b[j] * twr[j]) + (b[j+1] * twi[j]);
+                const float ti = (b[j+1] * twr[j+1]) + (b[j] * twi[j+1]);
+                const float ar = a[j], ai = a[j+1];
+                a[j] = ar + tr; a[j+1] = ai + ti;
+                b[j] = ar - tr; b[j+1] = ai - ti;
+            }
             #endif
+        }
+    }
+}
+
+/* Transform (pitch_framesize) real samples in (data) to bins 0 through
+   pitch_framesize2, interleaved complex, in place. (data) needs room for
+   pitch_framesize+2 floats. */
+static void pitch_fft_real(float * restrict data)
+{
+    const float *w = pitch_tables.split;
+    int k;
+
+    pitch_fft_complex(data);
+
+    /* Z[M] is Z[0]; the Nyquist bin only needs that. */
+    data[pitch_fftsize*2] = data[0];
+    data[pitch_fftsize*2+1] = data[1];
+
+    for (k = 0; k <= pitch_fftsize / 2; k++) {
+        float *zk = data + (k * 2);
+        float *zm = data + ((pitch_fftsize - k) * 2);
+        /* even part E = (Z[k] + conj(Z[M-k])) / 2, odd part O = (Z[k] - conj(Z[M-k])) / 2i */
+        const float er = 0.5f * (zk[0] + zm[0]), ei = 0.5f * (zk[1] - zm[1]);
+        const float or_ = 0.5f * (zk[1] + zm[1]), oi = -0.5f * (zk[0] - zm[0]);
+        /* and the mirror image, for bin M-k. */
+        const float er2 = er, ei2 = -ei;
+        const float or2 = or_, oi2 = -oi;
+        const float *wk = w + (k * 2);
+        const float *wm = w + ((pitch_fftsize - k) * 2);
+        /* X[k] = E + W^k O */
+        const float xr = er + (or_ * wk[0] - oi * wk[1]);
+        const float xi = ei + (or_ * wk[1] + oi * wk[0]);
+        const float xr2 = er2 + (or2 * wm[0] - oi2 * wm[1]);
+        const float xi2 = ei2 + (or2 * wm[1] + oi2 * wm[0]);
+        zk[0] = xr; zk[1] = xi;
+        zm[0] = xr2; zm[1] = xi2;
+    }
+}
+
+/* The inverse of pitch_fft_real, unnormalized: bins 0 through pitch_framesize2
+   in (data) become pitch_framesize real samples, in place. The imaginary parts
+   of the DC and Nyquist bins are ignored. */
+static void pitch_ifft_real(float * restrict data)
+{
+    const float *w = pitch_tables.split;
+    int k;
+
+    data[1] = data[pitch_framesize+1] = 0.0f;  /* a real signal can't have these. */
+
+    for (k = 0; k <= pitch_fftsize / 2; k++) {
+        float *xk = data + (k * 2);
+        float *xm = data + ((pitch_fftsize - k) * 2);
+        const float *wk = w + (k * 2);
+        const float *wm = w + ((pitch_fftsize - k) * 2);
+        /* E = X[k] + conj(X[M-k]), O = (X[k] - conj(X[M-k])) * conj(W^k); Z[k] = E + iO.
+           We build conjugated Z so the forward FFT does the inverse for us. */
+        const float er = xk[0] + xm[0], ei = xk[1] - xm[1];
+        const float dr = xk[0] - xm[0], di = xk[1] + xm[1];
+        const float or_ = dr * wk[0] + di * wk[1], oi = di * wk[0] - dr * wk[1];
+        const float er2 = er, ei2 = -ei;
+        const float dr2 = -dr, di2 = di;
+        const float or2 = dr2 * wm[0] + di2 * wm[1], oi2 = di2 * wm[0] - dr2 * wm[1];
+        const float zr = er - oi, zi = ei + or_;
+        const float zr2 = er2 - oi2, zi2 = ei2 + or2;
+        if (k == 0) {
+            xk[0] = zr; xk[1] = -zi;  /* bin M folds into bin 0. */
+        } else {
+            xk[0] = zr; xk[1] = -zi;
+            xm[0] = zr2; xm[1] = -zi2;
+        }
+    }
+
+    pitch_fft_complex(data);
+
+    /* conjugate back: the odd samples are the imaginary parts. */
+    for (k = 1; k < pitch_framesize; k += 2) {
+        data[k] = -data[k];
+    }
+}
+
+/****************************************************************************
+*
+* pitch_shift is a modified version of code from:
+*
+*    http://blogs.zynaptiq.com/bernsee/pitch-shifting-using-the-ft/
+*
+*   The original code has this copyright/license:
+*
+*****************************************************************************
+*
+* COPYRIGHT 1999-2015 Stephan M. Bernsee <s.bernsee [AT] zynaptiq [DOT] com>
+*
+* 						The Wide Open License (WOL)
+*
+* Permission to use, copy, modify, distribute and sell this software and its
+* documentation for any purpose is hereby granted without fee, provided that
+* the above copyright notice and this license appear in all source copies. 
+* THIS SOFTWARE IS PROVIDED "AS IS" WITHOUT EXPRESS OR IMPLIED WARRANTY OF
+* ANY KIND. See http://www.dspguru.com/wol.htm for more information.
+*
+*****************************************************************************/ 
+
+static void pitch_shift(SourceVoice *voice, const ALbuffer *buffer, int numSampsToProcess, const float *indata, float *outdata)
+{
+    const float pitchShift = voice->pitch;
+    const int osamp = 4;
+    const int stepSize = pitch_framesize / osamp;
+    const int inFifoLatency = pitch_framesize - stepSize;
+    const float expct = (float) (2.0 * M_PI * ((double)stepSize / (double)pitch_framesize));
+    const float twopi = (float) (2.0 * M_PI);
+    const float *window = pitch_tables.window;
+    const float *synthesis_window = pitch_tables.synthesis_window;
+
+    float magn, phase, tmp, real, imag;
+    int i,k, qpd, index;
+    PitchState *state = voice->pitchstate;
+
+    SDL_assert(state != NULL);
+    SDL_assert(pitch_tables.initialized);
+
+    if (state->rover == 0) state->rover = inFifoLatency;
+
+    /* main processing loop */
+    for (i = 0; i < numSampsToProcess; i++){
+
+        /* As long as we have not yet collected enough data just read in */
+        state->infifo[state->rover] = indata[i];
+        outdata[i] = state->outfifo[state->rover-inFifoLatency];
+        state->rover++;
+
+        /* now we have enough data for processing */
+        if (state->rover >= pitch_framesize) {
+            state->rover = inFifoLatency;
+
+            /* do windowing */
+            for (k = 0; k < pitch_framesize;k++) {
+                state->workspace[k] = state->infifo[k] * window[k];
+            }
+
+
+            /* ***************** ANALYSIS ******************* */
+            /* do transform */
+            pitch_fft_real(state->workspace);
+
+            /* this is the analysis step. Frequencies are kept in units of bins, so the sample rate drops out. */
+            for (k = 0; k <= pitch_framesize2; k++) {
+
+                /* de-interlace FFT buffer */
+                real = state->workspace[2*k];
+                imag = state->workspace[2*k+1];
+
+                /* compute magnitude and phase */
+                magn = 2.0f*SDL_sqrtf(real*real + imag*imag);
+                phase = SDL_atan2f(imag,real);
+
+                /* compute phase difference */
+                tmp = phase - state->lastphase[k];
+                state->lastphase[k] = phase;
+
+                /* subtract expected phase difference */
+                tmp -= (float)k*expct;
+
+                /* map delta phase into +/- Pi interval */
+                qpd = (int) (tmp/(float)M_PI);
+                if (qpd >= 0) qpd += qpd&1;
+                else qpd -= qpd&1;
+                tmp -= (float)M_PI*(float)qpd;
+
+                /* get deviation from bin frequency from the +/- Pi interval */
+                tmp = osamp*tmp/twopi;
+
+                /* compute the k-th partials' true frequency */
+                tmp = (float)k + tmp;
+
+                /* store magnitude and true frequency in analysis arrays */
+                state->workspace[2*k] = magn;
+                state->workspace[2*k+1] = tmp;
+
+            }
+
+            /* ***************** PROCESSING ******************* */
+            /* this does the actual pitch shifting */
+            SDL_memset(state->synmagn, '\0', sizeof (state->synmagn));
+            for (k = 0; k <= pitch_framesize2; k++) {
+                index = k*pitchShift;
+                if (index <= pitch_framesize2) { 
+                    state->synmagn[index] += state->workspace[2*k];
+                    state->synfreq[index] = state->workspace[2*k+1] * pitchShift;
+                } 
+            }
+            
+            /* ***************** SYNTHESIS ******************* */
+            /* this is the synthesis step */
+            for (k = 0; k <= pitch_framesize2; k++) {
+
+                /* get magnitude and true frequency from synthesis arrays */
+                magn = state->synmagn[k];
+
+                /* the phase advance of a partial at this frequency, over one step. */
+                tmp = state->synfreq[k] * expct;
+
+                /* accumulate delta phase to get bin phase; keep it small so floats don't lose precision. */
+                phase = state->sumphase[k] + tmp;
+                phase -= twopi * SDL_floorf((phase + (float)M_PI) / twopi);
+                state->sumphase[k] = phase;
+
+                /* get real and imag part and re-interleave */
+                state->workspace[2*k] = magn*SDL_cosf(phase);
+                state->workspace[2*k+1] = magn*SDL_sinf(phase);
+            } 
+
+            /* only the real part of the DC and Nyquist bins survive the inverse; double them to match the rest. */
+            state->workspace[0] *= 2.0f;
+            state->workspace[pitch_framesize] *= 2.0f;
+
+            /* do inverse transform */
+            pitch_ifft_real(state->workspace);
+
+            /* do windowing and add to output accumulator */ 
+            for(k=0; k < pitch_framesize; k++) {
+                state->outputaccum[k] += synthesis_window[k]*state->workspace[k];
+            }
+            for (k = 0; k < stepSize; k++) state->outfifo[k] = state->outputaccum[k];
+
+            /* shift accumulator */
+            SDL_memmove(state->outputaccum, state->outputaccum+stepSize, pitch_framesize*sizeof(float));
+
+            /* move input FIFO */
+            for (k = 0; k < inFifoLatency; k++) state->infifo[k] = state->infifo[k+stepSize];
+        }
+    }
+}
+
+/* Normally AL_PITCH just changes the playback rate in the resampler; the phase vocoder is opt-in. */
+#define source_uses_vocoder(voice) ((voice)->preserve_duration && ((voice)->pitch != 1.0f) && ((voice)->pitchstate != NULL))
+
+/* How much the mixer is giving up to stay inside its budget, lowest cost
+   last. Each level keeps giving up what the ones before it did. See
+   govern_mix_quality(). */
+#define MIX_QUALITY_FULL 0
+#define MIX_QUALITY_NEAREST 1  /* resample without interpolating. */
+#define MIX_QUALITY_NO_VOCODER 2  /* AL_PITCH_PRESERVE_DURATION sources play without their pitch shift. */
+#define MIX_QUALITY_CULL 3  /* virtualize the lowest priority, quietest quarter of the audible voices... */
+#define MIX_QUALITY_LOWEST 5  /* ...and another quarter for each level past MIX_QUALITY_CULL. */
+
+/* ...but the mixer skips it when the governor needs the time back. */
+#define voice_uses_vocoder(ctx, voice) (source_uses_vocoder(voice) && ((ctx)->device->playback.quality < MIX_QUALITY_NO_VOCODER))
+
+/* ADPCM decoding. We keep compressed buffers compressed and decode a block at
+   a time in the mixer, so every block has to be decodable on its own; both
+   formats start each block with a header that resets the decoder state. */
+static const int ima4_step_table[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41,
+    45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209,
+    230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876,
+    963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749,
+    3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630,
+    9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623,
+    27086, 29794, 32767
+};
+
+static const int ima4_index_table[16] = { -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8 };
+
+static const int msadpcm_adaption_table[16] = { 230, 230, 230, 230, 307, 409, 512, 614, 768, 614, 512, 409, 307, 230, 230, 230 };
+static const int msadpcm_coefficients[7][2] = { { 256, 0 }, { 512, -256 }, { 0, 0 }, { 192, 64 }, { 240, 0 }, { 460, -208 }, { 392, -232 } };
+
+#define clamp_s16(x) (((x) < -32768) ? -32768 : (((x) > 32767) ? 32767 : (x)))
+#define read_s16le(ptr) ((Sint16) (((Uint16) (ptr)[0]) | (((Uint16) (ptr)[1]) << 8)))
+
+/* Each channel gets a 4 byte header (first sample, step index, padding), then
+   the nibbles come in 4 byte chunks of 8 samples per channel, low nibble first. */
+static void ima4_decode_block(const Uint8 *src, const int channels, const int frames, Sint16 * restrict output)
+{
+    int sample[2];
+    int index[2];
+    int ch, i, j;
+
+    for (ch = 0; ch < channels; ch++, src += 4) {
+        sample[ch] = read_s16le(src);
+        index[ch] = SDL_min(src[2], 88);
+        output[ch] = (Sint16) sample[ch];
+    }
+
+    for (i = 1; i < frames; i += 8) {
+        for (ch = 0; ch < channels; ch++, src += 4) {
+            for (j = 0; j < 8; j++) {
+                const int nibble = (src[j / 2] >> ((j & 1) * 4)) & 0xF;
+                const int step = ima4_step_table[index[ch]];
+                int diff = step >> 3;
+                if (nibble & 1) { diff += step >> 2; }
+                if (nibble & 2) { diff += step >> 1; }
+                if (nibble & 4) { diff += step; }
+                sample[ch] += (nibble & 8) ? -diff : diff;
+                sample[ch] = clamp_s16(sample[ch]);
+                index[ch] += ima4_index_table[nibble];
+                index[ch] = (index[ch] < 0) ? 0 : ((index[ch] > 88) ? 88 : index[ch]);
+                output[((i + j) * channels) + ch] = (Sint16) sample[ch];
+            }
+        }
+    }
+}
+
+/* The header has each channel's predictor, then initial delta, then the two
+   most recent samples (which are the block's first two frames, oldest
+   last). Then interleaved nibbles, high nibble first. */
+static void msadpcm_decode_block(const Uint8 *src, const int channels, const int frames, Sint16 * restrict output)
+{
+    const int *coef[2];
+    int delta[2];
+    int sample1[2];
+    int sample2[2];
+    int ch, i;
+
+    for (ch = 0; ch < channels; ch++) {
+        coef[ch] = msadpcm_coefficients[SDL_min(src[ch], 6)];
+    }
+    src += channels;
+    for (ch = 0; ch < channels; ch++, src += 2) { delta[ch] = read_s16le(src); }
+    for (ch = 0; ch < channels; ch++, src += 2) { sample1[ch] = read_s16le(src); }
+    for (ch = 0; ch < channels; ch++, src += 2) { sample2[ch] = read_s16le(src); }
+
+    for (ch = 0; ch < channels; ch++) {
+        output[ch] = (Sint16) sample2[ch];
+        output[channels + ch] = (Sint16) sample1[ch];
+    }
+
+    output += channels * 2;
+    for (i = 0; i < (frames - 2) * channels; i++) {
+        const int nibble = (src[i / 2] >> ((i & 1) ? 0 : 4)) & 0xF;
+        const int c = i % channels;
+        int predicted = ((sample1[c] * coef[c][0]) + (sample2[c] * coef[c][1])) / 256;
+        predicted += ((nibble ^ 8) - 8) * delta[c];
+        predicted = clamp_s16(predicted);
+        sample2[c] = sample1[c];
+        sample1[c] = predicted;
+        delta[c] = (msadpcm_adaption_table[nibble] * delta[c]) / 256;
+        delta[c] = SDL_max(delta[c], 16);
+        output[i] = (Sint16) predicted;
+    }
+}
+
+#undef clamp_s16
+#undef read_s16le
+
+/* decode block number (block) of a compressed buffer to (output), which has room for (buffer->block_frames) Sint16 frames. */
+static void adpcm_decode_block(const ALbuffer *buffer, const int block, Sint16 * restrict output)
+{
+    const Uint8 *src = ((const Uint8 *) buffer->data) + (block * buffer->block_size);
+    if (buffer->format == BUFFER_FORMAT_IMA4) {
+        ima4_decode_block(src, buffer->channels, buffer->block_frames, output);
+    } else {
+        SDL_assert(buffer->format == BUFFER_FORMAT_MSADPCM);
+        msadpcm_decode_block(src, buffer->channels, buffer->block_frames, output);
+    }
+}
+
+/* convert (frames) sample frames of (data), stored as (format), starting at (frame), to float32. */
+static void samples_to_float32(const SDL_AudioFormat format, const int channels, const void *_data, const int frame, const int frames, float * restrict output)
+{
+    const int samples = frames * channels;
+    const int first = frame * channels;
+    int i;
+
+    switch (format) {
+        case AUDIO_F32SYS:
+            SDL_memcpy(output, ((const float *) _data) + first, samples * sizeof (float));
+            break;
+        case AUDIO_S16SYS: {
+            const Sint16 *data = ((const Sint16 *) _data) + first;
+            for (i = 0; i < samples; i++) {
+                output[i] = ((float) data[i]) * S16_TO_FLOAT_SCALE;
+            }
+            break;
+        }
+        case AUDIO_U8: {
+            const Uint8 *data = ((const Uint8 *) _data) + first;
+            for (i = 0; i < samples; i++) {
+                output[i] = ((float) (((int) data[i]) - 128)) * U8_TO_FLOAT_SCALE;
             }
+            break;
+        }
+        default:
+            SDL_assert(!"unexpected sample format");
+            SDL_memset(output, '\0', samples * sizeof (float));
+            break;
+    }
+}
+
+static void mix_float32(const int channels, const ALfloat * restrict panning, const float * restrict data, float * restrict stream, const ALsizei mixframes)
+{
+    FIXME("currently expects output to be stereo");
+    if ((panning[0] != 0.0f) || (panning[1] != 0.0f)) {  /* don't bother mixing in silence. */
+        if (channels == 1) {
+            mix_float32_c1(panning, data, stream, mixframes);
+        } else {
+            SDL_assert(channels == 2);
+            mix_float32_c2(panning, data, stream, mixframes);
+        }
+    }
+}
+
+/* mix (mixframes) frames of (data), stored as (format), starting at sample frame (frame), without resampling. */
+static void mix_buffer(ALCcontext *ctx, SourceVoice *voice, const ALbuffer *buffer, const SDL_AudioFormat format, const void *data, const ALfloat * restrict panning, const int frame, float * restrict stream, const ALsizei mixframes)
+{
+    const ALfloat left = panning[0];
+    const ALfloat right = panning[1];
+    const int channels = buffer->channels;
+    const int first = frame * channels;
+
+    if (voice_uses_vocoder(ctx, voice)) {
+        /* the vocoder works in float32; pitch_shift() is fine working in place. */
+        float *pitched = (float *) alloca(mixframes * channels * sizeof (float));
+        samples_to_float32(format, channels, data, frame, mixframes, pitched);
+        pitch_shift(voice, buffer, mixframes * channels, pitched, pitched);
+        mix_float32(channels, panning, pitched, stream, mixframes);
+        return;
+    }
+
+    FIXME("currently expects output to be stereo");
+    if ((left == 0.0f) && (right == 0.0f)) {
+        return;  /* don't bother mixing in silence. */
+    }
+
+    SDL_assert((channels == 1) || (channels == 2));
+    switch (format) {
+        case AUDIO_F32SYS:
+            mix_float32(channels, panning, ((const float *) data) + first, stream, mixframes);
+            break;
+        case AUDIO_S16SYS:
+            (channels == 1 ? mix_s16_c1 : mix_s16_c2)(panning, ((const Sint16 *) data) + first, stream, mixframes);
+            break;
+        case AUDIO_U8:
+            (channels == 1 ? mix_u8_c1 : mix_u8_c2)(panning, ((const Uint8 *) data) + first, stream, mixframes);
+            break;
+        default:
+            SDL_assert(!"unexpected sample format");
+            break;
+    }
+}
+
+/* Linear-interpolating resampler. Positions are in fixed point: (*frame) is
+   the whole frame we're reading in (data) and (*frac) the fraction of the way
+   there from the frame before it (which is (history) when (*frame) is zero,
+   so we interpolate smoothly across buffer boundaries). We step (step) input
+   frames per output frame and stop at the end of the output or the input,
+   whichever comes first. Returns output frames generated; (*frame) may end
+   up past (frames) if (step) is more than one frame, and the caller carries
+   that into the next buffer.
+
+   There's a version of each of these for each format we store buffers in;
+   SAMPLE converts one stored sample to float. */
+#define RESAMPLER_FRAC_BITS 16
+#define RESAMPLER_FRAC_ONE (1 << RESAMPLER_FRAC_BITS)
+#define RESAMPLER_FRAC_MASK (RESAMPLER_FRAC_ONE - 1)
+
+/* Most input frames we'll step over per output frame, between sample rate conversion and AL_PITCH. */
+#define OPENAL_MAX_PITCH_STEP 255
+
+typedef int (*MixResampleFn)(const ALfloat * restrict panning, const void *data, const int frames, int *frame, Uint32 *frac, const Uint32 step, const float * restrict history, float * restrict stream, const int mixframes);
+typedef int (*ResampleFn)(const int channels, const void *data, const int frames, int *frame, Uint32 *frac, const Uint32 step, const float * restrict history, float * restrict output, const int outframes);
+
+#define RESAMPLER_FUNCTIONS(name, type, SAMPLE) \
+static int mix_resample_##name##_c1(const ALfloat * restrict panning, const void *_data, const int frames, int *frame, Uint32 *frac, const Uint32 step, const float * restrict history, float * restrict stream, const int mixframes) \
+{ \
+    const type *data = (const type *) _data; \
+    const ALfloat left = panning[0]; \
+    const ALfloat right = panning[1]; \
+    int i = *frame; \
+    Uint32 f = *frac; \
+    int o; \
+    for (o = 0; (o < mixframes) && (i < frames); o++, stream += 2) { \
+        const float prev = i ? SAMPLE(data[i-1]) : history[0]; \
+        const float samp = prev + ((SAMPLE(data[i]) - prev) * (((float) f) * (1.0f / RESAMPLER_FRAC_ONE))); \
+        stream[0] += samp * left; \
+        stream[1] += samp * right; \
+        f += step; \
+        i += (int) (f >> RESAMPLER_FRAC_BITS); \
+        f &= RESAMPLER_FRAC_MASK; \
+    } \
+    *frame = i; \
+    *frac = f; \
+    return o; \
+} \
+\
+static int mix_resample_##name##_c2(const ALfloat * restrict panning, const void *_data, const int frames, int *frame, Uint32 *frac, const Uint32 step, const float * restrict history, float * restrict stream, const int mixframes) \
+{ \
+    const type *data = (const type *) _data; \
+    const ALfloat left = panning[0]; \
+    const ALfloat right = panning[1]; \
+    int i = *frame; \
+    Uint32 f = *frac; \
+    int o; \
+    for (o = 0; (o < mixframes) && (i < frames); o++, stream += 2) { \
+        const type *cur = data + (i * 2); \
+        const float prevl = i ? SAMPLE(cur[-2]) : history[0]; \
+        const float prevr = i ? SAMPLE(cur[-1]) : history[1]; \
+        const float t = ((float) f) * (1.0f / RESAMPLER_FRAC_ONE); \
+        stream[0] += (prevl + ((SAMPLE(cur[0]) - prevl) * t)) * left; \
+        stream[1] += (prevr + ((SAMPLE(cur[1]) - prevr) * t)) * right; \
+        f += step; \
+        i += (int) (f >> RESAMPLER_FRAC_BITS); \
+        f &= RESAMPLER_FRAC_MASK; \
+    } \
+    *frame = i; \
+    *frac = f; \
+    return o; \
+} \
+\
+/* same as mix_resample_*, but takes the frame at or after each position instead of interpolating. Cheaper, but aliases; the governor uses these when the mixer is short on time. */ \
+static int mix_resample_nearest_##name##_c1(const ALfloat * restrict panning, const void *_data, const int frames, int *frame, Uint32 *frac, const Uint32 step, const float * restrict history, float * restrict stream, const int mixframes) \
+{ \
+    const type *data = (const type *) _data; \
+    const ALfloat left = panning[0]; \
+    const ALfloat right = panning[1]; \
+    int i = *frame; \
+    Uint32 f = *frac; \
+    int o; \
+    for (o = 0; (o < mixframes) && (i < frames); o++, stream += 2) { \
+        const float samp = SAMPLE(data[i]); \
+        stream[0] += samp * left; \
+        stream[1] += samp * right; \
+        f += step; \
+        i += (int) (f >> RESAMPLER_FRAC_BITS); \
+        f &= RESAMPLER_FRAC_MASK; \
+    } \
+    *frame = i; \
+    *frac = f; \
+    return o; \
+} \
+\
+static int mix_resample_nearest_##name##_c2(const ALfloat * restrict panning, const void *_data, const int frames, int *frame, Uint32 *frac, const Uint32 step, const float * restrict history, float * restrict stream, const int mixframes) \
+{ \
+    const type *data = (const type *) _data; \
+    const ALfloat left = panning[0]; \
+    const ALfloat right = panning[1]; \
+    int i = *frame; \
+    Uint32 f = *frac; \
+    int o; \
+    for (o = 0; (o < mixframes) && (i < frames); o++, stream += 2) { \
+        const type *cur = data + (i * 2); \
+        stream[0] += SAMPLE(cur[0]) * left; \
+        stream[1] += SAMPLE(cur[1]) * right; \
+        f += step; \
+        i += (int) (f >> RESAMPLER_FRAC_BITS); \
+        f &= RESAMPLER_FRAC_MASK; \
+    } \
+    *frame = i; \
+    *frac = f; \
+    return o; \
+} \
+\
+/* same as mix_resample_*, but just writes the resampled float32 frames to (output). */ \
+static int resample_##name(const int channels, const void *_data, const int frames, int *frame, Uint32 *frac, const Uint32 step, const float * restrict history, float * restrict output, const int outframes) \
+{ \
+    const type *data = (const type *) _data; \
+    int i = *frame; \
+    Uint32 f = *frac; \
+    int o, ch; \
+    for (o = 0; (o < outframes) && (i < frames); o++, output += channels) { \
+        const type *cur = data + (i * channels); \
+        const float t = ((float) f) * (1.0f / RESAMPLER_FRAC_ONE); \
+        for (ch = 0; ch < channels; ch++) { \
+            const float prev = i ? SAMPLE(cur[ch - channels]) : history[ch]; \
+            output[ch] = prev + ((SAMPLE(cur[ch]) - prev) * t); \
+        } \
+        f += step; \
+        i += (int) (f >> RESAMPLER_FRAC_BITS); \
+        f &= RESAMPLER_FRAC_MASK; \
+    } \
+    *frame = i; \
+    *frac = f; \
+    return o; \
+}
+
+#define SAMPLE_FLOAT32(x) (x)
+#define SAMPLE_S16(x) (((float) (x)) * S16_TO_FLOAT_SCALE)
+#define SAMPLE_U8(x) (((float) (((int) (x)) - 128)) * U8_TO_FLOAT_SCALE)
+RESAMPLER_FUNCTIONS(float32, float, SAMPLE_FLOAT32)
+RESAMPLER_FUNCTIONS(s16, Sint16, SAMPLE_S16)
+RESAMPLER_FUNCTIONS(u8, Uint8, SAMPLE_U8)
+#undef SAMPLE_FLOAT32
+#undef SAMPLE_S16
+#undef SAMPLE_U8
+#undef RESAMPLER_FUNCTIONS
+
+/* input frames to step per output frame, in RESAMPLER_FRAC_BITS fixed point. AL_PITCH is just a change in playback rate. */
+static Uint32 source_resample_step(ALCcontext *ctx, const SourceVoice *voice, const ALbuffer *buffer)
+{
+    const float maxstep = (float) (OPENAL_MAX_PITCH_STEP << RESAMPLER_FRAC_BITS);
+    float step = (((float) buffer->frequency) / ((float) ctx->device->frequency)) * ((float) RESAMPLER_FRAC_ONE);
+    if (!voice->preserve_duration) {
+        step *= voice->pitch;
+    }
+    if (step >= maxstep) {
+        return (Uint32) maxstep;
+    } else if (step < 1.0f) {
+        return 1;
+    }
+    return (Uint32) (step + 0.5f);
+}
+
+/* mix from (frames) sample frames of (data), stored as (format): all of a PCM
+   buffer, or one decoded block of a compressed one. (*frame) is our position
+   in (data), and might end up past (frames) when resampling. Returns the
+   number of output frames mixed. */
+static int mix_source_frames(ALCcontext *ctx, SourceVoice *voice, const ALbuffer *buffer, const SDL_AudioFormat format, const void *data, const int frames, int *frame, float *stream, const int framesneeded)
+{
+    const int channels = buffer->channels;
+    const Uint32 step = source_resample_step(ctx, voice, buffer);
+    int mixframes;
+
+    if ((step != RESAMPLER_FRAC_ONE) || (voice->offset_frac != 0)) {  /* resampling? */
+        if (voice_uses_vocoder(ctx, voice)) {
+            /* the pitch shifter needs the resampled data on its own before mixing. */
+            const ResampleFn resample = (format == AUDIO_S16SYS) ? resample_s16 : (format == AUDIO_U8) ? resample_u8 : resample_float32;
+            float *resampled = (float *) alloca(framesneeded * channels * sizeof (float));
+            TRACE_BEGIN("resample", "voice", NULL, 0);
+            mixframes = resample(channels, data, frames, frame, &voice->offset_frac, step, voice->resample_history, resampled, framesneeded);
+            TRACE_END("resample", "voice");
+            TRACE_BEGIN("pitch_shift", "voice", NULL, 0);
+            pitch_shift(voice, buffer, mixframes * channels, resampled, resampled);
+            TRACE_END("pitch_shift", "voice");
+            TRACE_BEGIN("mix", "voice", NULL, 0);
+            mix_float32(channels, voice->panning, resampled, stream, mixframes);
+            TRACE_END("mix", "voice");
+        } else {
+            MixResampleFn mix_resample;
+            FIXME("currently expects output to be stereo");
+            SDL_assert((channels == 1) || (channels == 2));
+            if (ctx->device->playback.quality >= MIX_QUALITY_NEAREST) {
+                switch (format) {
+                    case AUDIO_S16SYS: mix_resample = (channels == 1) ? mix_resample_nearest_s16_c1 : mix_resample_nearest_s16_c2; break;
+                    case AUDIO_U8: mix_resample = (channels == 1) ? mix_resample_nearest_u8_c1 : mix_resample_nearest_u8_c2; break;
+                    default: mix_resample = (channels == 1) ? mix_resample_nearest_float32_c1 : mix_resample_nearest_float32_c2; break;
+                }
+            } else {
+                switch (format) {
+                    case AUDIO_S16SYS: mix_resample = (channels == 1) ? mix_resample_s16_c1 : mix_resample_s16_c2; break;
+                    case AUDIO_U8: mix_resample = (channels == 1) ? mix_resample_u8_c1 : mix_resample_u8_c2; break;
+                    default: mix_resample = (channels == 1) ? mix_resample_float32_c1 : mix_resample_float32_c2; break;
+                }
+            }
+            TRACE_BEGIN("resample+mix", "voice", NULL, 0);
+            mixframes = mix_resample(voice->panning, data, frames, frame, &voice->offset_frac, step, voice->resample_history, stream, framesneeded);
+            TRACE_END("resample+mix", "voice");
+        }
+
+        /* Remember the frame before where we stopped, so we can interpolate from it later (maybe in the next buffer or block). */
+        if (*frame > 0) {
+            samples_to_float32(format, channels, data, SDL_min(*frame, frames) - 1, 1, voice->resample_history);
+        }
+    } else {
+        mixframes = SDL_min(framesneeded, frames - *frame);
+        TRACE_BEGIN("mix", "voice", NULL, 0);
+        mix_buffer(ctx, voice, buffer, format, data, voice->panning, *frame, stream, mixframes);
+        TRACE_END("mix", "voice");
+        if (mixframes > 0) {  /* in case the pitch changes and we start resampling from here. */
+            samples_to_float32(format, channels, data, *frame + mixframes - 1, 1, voice->resample_history);
+        }
+        *frame += mixframes;
+    }
+
+    return mixframes;
+}
+
+/* For virtual voices: move (*frame) through (buffer) as far as mixing
+   (framesneeded) output frames would have, without touching the samples in
+   between. The resampler makes an output frame for every step that starts
+   before the end of the data. Returns the output frames that covers. */
+static int skip_source_frames(ALCcontext *ctx, SourceVoice *voice, const ALbuffer *buffer, int *frame, const int framesneeded)
+{
+    const Sint64 step = (Sint64) source_resample_step(ctx, voice, buffer);
+    const Sint64 end = ((Sint64) buffer->frames) << RESAMPLER_FRAC_BITS;
+    Sint64 pos = (((Sint64) *frame) << RESAMPLER_FRAC_BITS) + voice->offset_frac;
+    int skipframes = 0;
+
+    if (pos < end) {
+        skipframes = (int) SDL_min((Sint64) framesneeded, ((end - pos) + step - 1) / step);
+        pos += skipframes * step;
+    }
+
+    *frame = (int) (pos >> RESAMPLER_FRAC_BITS);
+    voice->offset_frac = (Uint32) (pos & RESAMPLER_FRAC_MASK);
+
+    /* keep the frame before the offset, so the resampler picks up smoothly if this voice gets mixed again. */
+    if ((skipframes > 0) && (*frame > 0)) {
+        if (!buffer_is_adpcm(buffer)) {
+            samples_to_float32(buffer->format, buffer->channels, buffer->data, SDL_min(*frame, buffer->frames) - 1, 1, voice->resample_history);
+        } else if (*frame >= buffer->frames) {
+            /* leaving this buffer, and the next one won't have this frame to decode later, so decode the last block now. Once per buffer. */
+            Sint16 *decoded = (Sint16 *) alloca(buffer->block_frames * buffer->channels * sizeof (Sint16));
+            const int last = buffer->frames - 1;
+            adpcm_decode_block(buffer, last / buffer->block_frames, decoded);
+            samples_to_float32(AUDIO_S16SYS, buffer->channels, decoded, last % buffer->block_frames, 1, voice->resample_history);
+            voice->history_stale = AL_FALSE;
+        } else {
+            voice->history_stale = AL_TRUE;  /* decoding a block every callback would cost what being virtual saves; mix_source_buffer() decodes it if the voice gets mixed again. */
+        }
+    }
+
+    return skipframes;
+}
+
+static ALboolean mix_source_buffer(ALCcontext *ctx, SourceVoice *voice, BufferQueueItem *queue, float **stream, int *len)
+{
+    const ALbuffer *buffer = queue ? queue->buffer : NULL;
+    ALboolean processed = AL_TRUE;
+
+    /* you can legally queue or set a NULL buffer. */
+    if (buffer && buffer->data && (buffer->frames > 0) && (voice->offset < buffer->frames)) {
+        const int deviceframesize = ctx->device->framesize;
+        const ALboolean compressed = buffer_is_adpcm(buffer);
+        Sint16 *decoded = compressed ? (Sint16 *) alloca(buffer->block_frames * buffer->channels * sizeof (Sint16)) : NULL;
+
+        /* compressed buffers get decoded and mixed a block at a time; everything else is mixed in one go. */
+        while ((*len >= deviceframesize) && (voice->offset < buffer->frames)) {
+            SDL_AudioFormat format = buffer->format;
+            const void *data = buffer->data;
+            int frames = buffer->frames;
+            int first = 0;
+            int frame, mixframes;
+
+            if (voice->virtualized) {  /* nobody can hear it, so don't decode, resample or mix; just move along like we did. */
+                frame = voice->offset;
+                mixframes = skip_source_frames(ctx, voice, buffer, &frame, *len / deviceframesize);
+            } else {
+                if (compressed) {
+                    const int block = voice->offset / buffer->block_frames;
+                    if (voice->history_stale) {  /* was virtual; get the frame before the offset that skip_source_frames() didn't decode. */
+                        const int prev = voice->offset - 1;
+                        voice->history_stale = AL_FALSE;
+                        if (prev >= 0) {
+                            adpcm_decode_block(buffer, prev / buffer->block_frames, decoded);
+                            samples_to_float32(AUDIO_S16SYS, buffer->channels, decoded, prev % buffer->block_frames, 1, voice->resample_history);
+                        }
+                    }
+                    adpcm_decode_block(buffer, block, decoded);
+                    format = AUDIO_S16SYS;
+                    data = decoded;
+                    frames = buffer->block_frames;
+                    first = block * buffer->block_frames;
+                }
+
+                frame = voice->offset - first;
+                mixframes = mix_source_frames(ctx, voice, buffer, format, data, frames, &frame, *stream, *len / deviceframesize);
+            }
+            voice->offset = first + frame;  /* might be past the end of the buffer, see below. */
+
+            *len -= mixframes * deviceframesize;
+            *stream += mixframes * ctx->device->channels;
+        }
+
+        processed = voice->offset >= buffer->frames;
+    }
+
+    if (processed) {
+        FIXME("does the offset have to represent the whole queue or just the current buffer?");
+        /* the resampler can step past the end of a buffer; carry that into the next one. */
+        voice->offset = (buffer && (voice->offset > buffer->frames)) ? (voice->offset - buffer->frames) : 0;
+    }
+
+    return processed;
+}
+
+static ALCboolean mix_source_buffer_queue(ALCcontext *ctx, SourceVoice *voice, BufferQueueItem *queue, float *stream, int len)
+{
+    ALsource *src = voice->source;  /* the queues are cold data; only streaming sources touch them. */
+    ALCboolean keep = ALC_TRUE;
+
+    while ((len > 0) && (mix_source_buffer(ctx, voice, queue, &stream, &len))) {
+        /* Finished this buffer! */
+        BufferQueueItem *item = queue;
+        BufferQueueItem *next = queue ? (BufferQueueItem*)queue->next : NULL;
+        void *ptr;
+
+        if (queue) {
+            queue->next = NULL;
+            queue = next;
+        }
+
+        SDL_assert((voice->type == AL_STATIC) || (voice->type == AL_STREAMING));
+        if (voice->type == AL_STREAMING) {  /* mark buffer processed. */
+            SDL_assert(item == src->buffer_queue.head);
+            FIXME("bubble out all these NULL checks");  /* these are only here because we check for looping/stopping in this loop, but we really shouldn't enter this loop at all if queue==NULL. */
+            if (item != NULL) {
+                src->buffer_queue.head = next;
+                if (!next) {
+                    src->buffer_queue.tail = NULL;
+                }
+                SDL_AtomicAdd(&src->buffer_queue.num_items, -1);
+
+                /* Move it to the processed queue for alSourceUnqueueBuffers() to pick up. */
+                do {
+                    ptr = SDL_AtomicGetPtr(&src->buffer_queue_processed.just_queued);
+                    SDL_AtomicSetPtr(&item->next, ptr);
+                } while (!SDL_AtomicCASPtr(&src->buffer_queue_processed.just_queued, ptr, item));
+
+                SDL_AtomicAdd(&src->buffer_queue_processed.num_items, 1);
+            }
+        }
+
+        if (queue == NULL) {  /* nothing else to play? */
+            if (voice->looping) {
+                FIXME("looping is supposed to move to AL_INITIAL then immediately to AL_PLAYING, but I'm not sure what side effect this is meant to trigger");
+                if (voice->type == AL_STREAMING) {
+                    FIXME("what does looping do with the AL_STREAMING state?");
+                }
+            } else {
+                voice->playing = AL_FALSE;
+                SDL_AtomicSet(&voice->finished_serial, voice->mixer_play_serial);  /* source_state() says AL_STOPPED now. */
+                keep = ALC_FALSE;
+            }
+            break;  /* nothing else to mix here, so stop. */
+        }
+    }
+
+    return keep;
+}
+
+/* All the 3D math here is way overcommented because I HAVE NO IDEA WHAT I'M
+   DOING and had to research the hell out of what are probably pretty simple
+   concepts. Pay attention in math class, kids. */
+
+/* The scalar versions have explanitory comments and links. The SIMD versions don't. */
+
+/* calculates cross product. https://en.wikipedia.org/wiki/Cross_product
+    Basically takes two vectors and gives you a vector that's perpendicular
+    to both.
+*/
+#if NEED_SCALAR_FALLBACK || HAVE_SPATIALIZE_BATCH  /* the batched path uses these once per pass for the listener. */
+static void xyzzy(ALfloat *v, const ALfloat *a, const ALfloat *b)
+{
+    v[0] = (a[1] * b[2]) - (a[2] * b[1]);
+    v[1] = (a[2] * b[0]) - (a[0] * b[2]);
+    v[2] = (a[0] * b[1]) - (a[1] * b[0]);
+}
+
+#if NEED_SCALAR_FALLBACK
+/* calculate dot product (multiply each element of two vectors, sum them) */
+static ALfloat dotproduct(const ALfloat *a, const ALfloat *b)
+{
+    return (a[0] * b[0]) + (a[1] * b[1]) + (a[2] * b[2]);
+}
+#endif
+
+/* calculate distance ("magnitude") in 3D space:
+    https://math.stackexchange.com/questions/42640/calculate-distance-in-3d-space
+    assumes vector starts at (0,0,0). */
+static ALfloat magnitude(const ALfloat *v)
+{
+    /* technically, the inital part on this is just a dot product of itself. */
+    return SDL_sqrtf((v[0] * v[0]) + (v[1] * v[1]) + (v[2] * v[2]));
+}
+
+/* https://www.khanacademy.org/computing/computer-programming/programming-natural-simulations/programming-vectors/a/vector-magnitude-normalization */
+static void normalize(ALfloat *v)
+{
+    const ALfloat mag = magnitude(v);
+    if (mag == 0.0f) {
+        SDL_memset(v, '\0', sizeof (*v) * 3);
+    } else {
+        v[0] /= mag;
+        v[1] /= mag;
+        v[2] /= mag;
+    }
+}
+#endif
+
+#ifdef __SSE__
+static __m128 xyzzy_sse(const __m128 a, const __m128 b)
+{
+    /* http://fastcpp.blogspot.com/2011/04/vector-cross-product-using-sse-code.html
+        this is the "three shuffle" version in the comments, plus the variables swapped around for handedness in the later comment. */
+    const __m128 v = _mm_sub_ps(
+        _mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1))),
+        _mm_mul_ps(b, _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1)))
+    );
+    return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+static ALfloat dotproduct_sse(const __m128 a, const __m128 b)
+{
+    const __m128 prod = _mm_mul_ps(a, b);
+    const __m128 sum1 = _mm_add_ps(prod, _mm_shuffle_ps(prod, prod, _MM_SHUFFLE(1, 0, 3, 2)));
+    const __m128 sum2 = _mm_add_ps(sum1, _mm_shuffle_ps(sum1, sum1, _MM_SHUFFLE(2, 2, 0, 0)));
+    FIXME("this can use _mm_hadd_ps in SSE3, or _mm_dp_ps in SSE4.1");
+    return _mm_cvtss_f32(_mm_shuffle_ps(sum2, sum2, _MM_SHUFFLE(3, 3, 3, 3)));
+}
+
+static ALfloat magnitude_sse(const __m128 v)
+{
+    return SDL_sqrtf(dotproduct_sse(v, v));
+}
+
+static __m128 normalize_sse(const __m128 v)
+{
+    const ALfloat mag = magnitude_sse(v);
+    if (mag == 0.0f) {
+        return _mm_setzero_ps();
+    }
+    return _mm_div_ps(v, _mm_set_ps1(mag));
+}
+#endif
+
+#ifdef __ARM_NEON__
+static float32x4_t xyzzy_neon(const float32x4_t a, const float32x4_t b)
+{
+    const float32x4_t shuf_a = { a[1], a[2], a[0], a[3] };
+    const float32x4_t shuf_b = { b[1], b[2], b[0], b[3] };
+    const float32x4_t v = vsubq_f32(vmulq_f32(a, shuf_b), vmulq_f32(b, shuf_a));
+    const float32x4_t retval = { v[1], v[2], v[0], v[3] };
+    FIXME("need a better permute");
+    return retval;
+}
+
+static ALfloat dotproduct_neon(const float32x4_t a, const float32x4_t b)
+{
+    const float32x4_t prod = vmulq_f32(a, b);
+    const float32x4_t sum1 = vaddq_f32(prod, vrev64q_f32(prod));
+    const float32x4_t sum2 = vaddq_f32(sum1, vcombine_f32(vget_high_f32(sum1), vget_low_f32(sum1)));
+    return sum2[3];
+}
+
+static ALfloat magnitude_neon(const float32x4_t v)
+{
+    return SDL_sqrtf(dotproduct_neon(v, v));
+}
+
+static float32x4_t normalize_neon(const float32x4_t v)
+{
+    const ALfloat mag = magnitude_neon(v);
+    if (mag == 0.0f) {
+        return vdupq_n_f32(0.0f);
+    }
+    return vmulq_f32(v, vdupq_n_f32(1.0f / mag));
+}
+#endif
+
+
+
+/* Get the sin(angle) and cos(angle) at the same time. Ideally, with one
+   instruction, like what is offered on the x86.
+   angle is in radians, not degrees. */
+static void calculate_sincos(const ALfloat angle, ALfloat *_sin, ALfloat *_cos)
+{
+    *_sin = SDL_sinf(angle);
+    *_cos = SDL_cosf(angle);
+}
+
+static ALfloat calculate_distance_attenuation(const ALenum distance_model, const ALsource *src, ALfloat distance)
+{
+    /* AL SPEC: "With all the distance models, if the formula can not be
+       evaluated then the source will not be attenuated. For example, if a
+       linear model is being used with AL_REFERENCE_DISTANCE equal to
+       AL_MAX_DISTANCE, then the gain equation will have a divide-by-zero
+       error in it. In this case, there is no attenuation for that source." */
+    FIXME("check divisions by zero");
+
+    switch (distance_model) {
+        case AL_INVERSE_DISTANCE_CLAMPED:
+            distance = SDL_min(SDL_max(distance, src->reference_distance), src->max_distance);
+            /* fallthrough */
+        case AL_INVERSE_DISTANCE:
+            /* AL SPEC: "gain = AL_REFERENCE_DISTANCE / (AL_REFERENCE_DISTANCE + AL_ROLLOFF_FACTOR * (distance - AL_REFERENCE_DISTANCE))" */
+            return src->reference_distance / (src->reference_distance + src->rolloff_factor * (distance - src->reference_distance));
+
+        case AL_LINEAR_DISTANCE_CLAMPED:
+            distance = SDL_max(distance, src->reference_distance);
+            /* fallthrough */
+        case AL_LINEAR_DISTANCE:
+            /* AL SPEC: "distance = min(distance, AL_MAX_DISTANCE) // avoid negative gain
+                         gain = (1 - AL_ROLLOFF_FACTOR * (distance - AL_REFERENCE_DISTANCE) / (AL_MAX_DISTANCE - AL_REFERENCE_DISTANCE))" */
+            return 1.0f - src->rolloff_factor * (SDL_min(distance, src->max_distance) - src->reference_distance) / (src->max_distance - src->reference_distance);
+
+        case AL_EXPONENT_DISTANCE_CLAMPED:
+            distance = SDL_min(SDL_max(distance, src->reference_distance), src->max_distance);
+            /* fallthrough */
+        case AL_EXPONENT_DISTANCE:
+            /* AL SPEC: "gain = (distance / AL_REFERENCE_DISTANCE) ^ (- AL_ROLLOFF_FACTOR)" */
+            return SDL_powf(distance / src->reference_distance, -src->rolloff_factor);
+
+        default: break;
+    }
+
+    SDL_assert(!"Unexpected distance model");
+    return 1.0f;
+}
+
+/* rolloff==0.0f makes all distance models result in 1.0f,
+   and we never spatialize non-mono sources, per the AL spec. */
+#define source_is_spatialized(distance_model, src) (((distance_model) != AL_NONE) && ((src)->queue_channels == 1) && ((src)->rolloff_factor != 0.0f))
+
+static void calculate_channel_gains(const ListenerState *listener, const ALenum distance_model, const ALsource *src, float *gains)
+{
+    const ALboolean spatialize = source_is_spatialized(distance_model, src);
+
+    const ALfloat *at = &listener->orientation[0];
+    const ALfloat *up = &listener->orientation[4];
+
+    ALfloat distance;
+    ALfloat gain;
+    ALfloat radians;
+
+    #ifdef __SSE__
+    __m128 position_sse;
+    #elif defined(__ARM_NEON__)
+    float32x4_t position_neon = vdupq_n_f32(0.0f);
+    #endif
+
+    #if NEED_SCALAR_FALLBACK
+    ALfloat position[3];
+    #endif
+
+    /* this goes through the steps the AL spec dictates for gain and distance attenuation... */
+
+    if (!spatialize) {
+        /* simpler path through the same AL spec details if not spatializing. */
+        gain = SDL_min(SDL_max(src->gain, src->min_gain), src->max_gain) * listener->gain;
+        gains[0] = gains[1] = gain;  /* no spatialization, but AL_GAIN (etc) is still applied. */
+        return;
+    }
+
+    #ifdef __SSE__
+    if (has_sse) {
+        position_sse = _mm_load_ps(src->position);
+        if (!src->source_relative) {
+            position_sse = _mm_sub_ps(position_sse, _mm_load_ps(listener->position));
+        }
+        distance = magnitude_sse(position_sse);
+    } else
+    #elif defined(__ARM_NEON__)
+    if (has_neon) {
+        position_neon = vld1q_f32(src->position);
+        if (!src->source_relative) {
+            position_neon = vsubq_f32(position_neon, vld1q_f32(listener->position));
+        }
+        distance = magnitude_neon(position_neon);
+    } else
+    #endif
+
+    {
+    #if NEED_SCALAR_FALLBACK
+    SDL_memcpy(position, src->position, sizeof (position));
+    /* if values aren't source-relative, then convert it to be so. */
+    if (!src->source_relative) {
+        position[0] -= listener->position[0];
+        position[1] -= listener->position[1];
+        position[2] -= listener->position[2];
+    }
+    distance = magnitude(position);
+    #endif
+    }
+
+    /* AL SPEC: ""1. Distance attenuation is calculated first, including
+       minimum (AL_REFERENCE_DISTANCE) and maximum (AL_MAX_DISTANCE)
+       thresholds." */
+    gain = calculate_distance_attenuation(distance_model, src, distance);
+
+    /* AL SPEC: "2. The result is then multiplied by source gain (AL_GAIN)." */
+    gain *= src->gain;
+
+    /* AL SPEC: "3. If the source is directional (AL_CONE_INNER_ANGLE less
+       than AL_CONE_OUTER_ANGLE), an angle-dependent attenuation is calculated
+       depending on AL_CONE_OUTER_GAIN, and multiplied with the distance
+       dependent attenuation. The resulting attenuation factor for the given
+       angle and distance between listener and source is multiplied with
+       source AL_GAIN." */
+    if (src->cone_inner_angle < src->cone_outer_angle) {
+        FIXME("directional sources");
+    }
+
+    /* AL SPEC: "4. The effective gain computed this way is compared against
+       AL_MIN_GAIN and AL_MAX_GAIN thresholds." */
+    gain = SDL_min(SDL_max(gain, src->min_gain), src->max_gain);
+
+    /* AL SPEC: "5. The result is guaranteed to be clamped to [AL_MIN_GAIN,
+       AL_MAX_GAIN], and subsequently multiplied by listener gain which serves
+       as an overall volume control. The implementation is free to clamp
+       listener gain if necessary due to hardware or implementation
+       constraints." */
+    gain *= listener->gain;
+
+    /* now figure out positioning. Since we're aiming for stereo, we just
+       need a simple panning effect. We're going to do what's called
+       "constant power panning," as explained...
+
+       https://dsp.stackexchange.com/questions/21691/algorithm-to-pan-audio
+
+       Naturally, we'll need to know the angle between where our listener
+       is facing and where the source is to make that work...
+
+       https://www.youtube.com/watch?v=S_568VZWFJo
+
+       ...but to do that, we need to rotate so we have the correct side of
+       the listener, which isn't just a point in space, but has a definite
+       direction it is facing. More or less, this is what gluLookAt deals
+       with...
+
+       http://www.songho.ca/opengl/gl_camera.html
+
+       ...although I messed with the algorithm until it did what I wanted.
+
+       XYZZY!! https://en.wikipedia.org/wiki/Cross_product#Mnemonic
+    */
+
+    #ifdef __SSE__ /* (the math is explained in the scalar version.) */
+    if (has_sse) {
+        const __m128 at_sse = _mm_load_ps(at);
+        const __m128 U_sse = normalize_sse(xyzzy_sse(at_sse, _mm_load_ps(up)));
+        const __m128 V_sse = xyzzy_sse(at_sse, U_sse);
+        const __m128 N_sse = normalize_sse(at_sse);
+        const __m128 rotated_sse = {
+            dotproduct_sse(position_sse, U_sse),
+            -dotproduct_sse(position_sse, V_sse),
+            -dotproduct_sse(position_sse, N_sse),
+            0.0f
+        };
+
+        const ALfloat mags = magnitude_sse(at_sse) * magnitude_sse(rotated_sse);
+        radians = (mags == 0.0f) ? 0.0f : SDL_acosf(dotproduct_sse(at_sse, rotated_sse) / mags);
+        if (_mm_comilt_ss(rotated_sse, _mm_setzero_ps())) {
+            radians = -radians;
+        }
+    } else
+    #endif
+
+    #ifdef __ARM_NEON__  /* (the math is explained in the scalar version.) */
+    if (has_neon) {
+        const float32x4_t at_neon = vld1q_f32(at);
+        const float32x4_t U_neon = normalize_neon(xyzzy_neon(at_neon, vld1q_f32(up)));
+        const float32x4_t V_neon = xyzzy_neon(at_neon, U_neon);
+        const float32x4_t N_neon = normalize_neon(at_neon);
+        const float32x4_t rotated_neon = {
+            dotproduct_neon(position_neon, U_neon),
+            -dotproduct_neon(position_neon, V_neon),
+            -dotproduct_neon(position_neon, N_neon),
+            0.0f
+        };
+
+        const ALfloat mags = magnitude_neon(at_neon) * magnitude_neon(rotated_neon);
+        radians = (mags == 0.0f) ? 0.0f : SDL_acosf(dotproduct_neon(at_neon, rotated_neon) / mags);
+        if (rotated_neon[0] < 0.0f) {
+            radians = -radians;
+        }
+    } else
+    #endif
+
+    {
+    #if NEED_SCALAR_FALLBACK
+        ALfloat U[3];
+        ALfloat V[3];
+        ALfloat N[3];
+        ALfloat rotated[3];
+        ALfloat mags;
+
+        xyzzy(U, at, up);
+        normalize(U);
+        xyzzy(V, at, U);
+        SDL_memcpy(N, at, sizeof (N));
+        normalize(N);
+
+        /* we don't need the bottom row of the gluLookAt matrix, since we don't
+           translate. (Matrix * Vector) is just filling in each element of the
+           output vector with the dot product of a row of the matrix and the
+           vector. I made some of these negative to make it work for my purposes,
+           but that's not what GLU does here.
+
+           (This says gluLookAt is left-handed, so maybe that's part of it?)
+            https://stackoverflow.com/questions/25933581/how-u-v-n-camera-coordinate-system-explained-with-opengl
+         */
+        rotated[0] = dotproduct(position, U);
+        rotated[1] = -dotproduct(position, V);
+        rotated[2] = -dotproduct(position, N);
+
+        /* At this point, we have rotated vector and we can calculate the angle
+           from 0 (directly in front of where the listener is facing) to 180
+           degrees (directly behind) ... */
+
+        mags = magnitude(at) * magnitude(rotated);
+        radians = (mags == 0.0f) ? 0.0f : SDL_acosf(dotproduct(at, rotated) / mags);
+        /* and we already have what we need to decide if those degrees are on the
+           listener's left or right...
+           https://gamedev.stackexchange.com/questions/43897/determining-if-something-is-on-the-right-or-left-side-of-an-object
+           ...we already did this dot product: it's in rotated[0]. */
+
+        /* make it negative to the left, positive to the right. */
+        if (rotated[0] < 0.0f) {
+            radians = -radians;
+        }
+    #endif
+    }
+
+    /* here comes the Constant Power Panning magic... */
+    #define SQRT2_DIV2 0.7071067812f  /* sqrt(2.0) / 2.0 ... */
+
+    /* this might be a terrible idea, which is totally my own doing here,
+      but here you go: Constant Power Panning only works from -45 to 45
+      degrees in front of the listener. So we split this into 4 quadrants.
+      - from -45 to 45: standard panning.
+      - from 45 to 135: pan full right.
+      - from 135 to 225: flip angle so it works like standard panning.
+      - from 225 to -45: pan full left. */
+
+    #define RADIANS_45_DEGREES 0.7853981634f
+    #define RADIANS_135_DEGREES 2.3561944902f
+    if ((radians >= -RADIANS_45_DEGREES) && (radians <= RADIANS_45_DEGREES)) {
+        ALfloat sine, cosine;
+        calculate_sincos(radians, &sine, &cosine);
+        gains[0] = (SQRT2_DIV2 * (cosine - sine));
+        gains[1] = (SQRT2_DIV2 * (cosine + sine));
+    } else if ((radians >= RADIANS_45_DEGREES) && (radians <= RADIANS_135_DEGREES)) {
+        gains[0] = 0.0f;
+        gains[1] = 1.0f;
+    } else if ((radians >= -RADIANS_135_DEGREES) && (radians <= -RADIANS_45_DEGREES)) {
+        gains[0] = 1.0f;
+        gains[1] = 0.0f;
+    } else if (radians < 0.0f) {  /* back left */
+        ALfloat sine, cosine;
+        calculate_sincos((ALfloat) -(radians + M_PI), &sine, &cosine);
+        gains[0] = (SQRT2_DIV2 * (cosine - sine));
+        gains[1] = (SQRT2_DIV2 * (cosine + sine));
+    } else { /* back right */
+        ALfloat sine, cosine;
+        calculate_sincos((ALfloat) -(radians - M_PI), &sine, &cosine);
+        gains[0] = (SQRT2_DIV2 * (cosine - sine));
+        gains[1] = (SQRT2_DIV2 * (cosine + sine));
+    }
+
+    /* apply distance attenuation and gain to positioning. */
+    gains[0] *= gain;
+    gains[1] *= gain;
+}
+
+
+#if HAVE_SPATIALIZE_BATCH
+/* When the listener moves, every playing source needs its gains recalculated
+   at once, so instead of calculate_channel_gains() on one source at a time,
+   we gather the spatialized ones into arrays and run the same math on 4 or 8
+   of them per instruction. The panning here skips the acos/sin/cos round
+   trip: we only ever need the cosine of the angle (which we get from the dot
+   product directly) and the sine (which is sqrt(1 - cos^2), with the sign
+   telling us left from right), and the back quadrants are just the front
+   ones with the cosine's sign flipped. */
+#define OPENAL_SPATIAL_BATCH_SIZE 64  /* must be a multiple of 8. */
+
+SIMDALIGNEDSTRUCT SpatialBatch
+{
+    ALfloat x[OPENAL_SPATIAL_BATCH_SIZE];  /* listener-relative positions. */
+    ALfloat y[OPENAL_SPATIAL_BATCH_SIZE];
+    ALfloat z[OPENAL_SPATIAL_BATCH_SIZE];
+    ALfloat reference_distance[OPENAL_SPATIAL_BATCH_SIZE];
+    ALfloat max_distance[OPENAL_SPATIAL_BATCH_SIZE];
+    ALfloat rolloff_factor[OPENAL_SPATIAL_BATCH_SIZE];
+    ALfloat gain[OPENAL_SPATIAL_BATCH_SIZE];
+    ALfloat min_gain[OPENAL_SPATIAL_BATCH_SIZE];
+    ALfloat max_gain[OPENAL_SPATIAL_BATCH_SIZE];
+    ALfloat attenuation[OPENAL_SPATIAL_BATCH_SIZE];  /* scratch space for the exponent distance models. */
+    ALfloat left[OPENAL_SPATIAL_BATCH_SIZE];  /* results. */
+    ALfloat right[OPENAL_SPATIAL_BATCH_SIZE];
+    SourceVoice *voices[OPENAL_SPATIAL_BATCH_SIZE];
+    int count;
+
+    /* the listener's half of the math, which is the same for every source. */
+    ALenum distance_model;
+    ALfloat listener_gain;
+    ALfloat U[3];
+    ALfloat V[3];
+    ALfloat N[3];
+    ALfloat at[3];
+    ALfloat at_magnitude;
+};
+
+static void spatial_batch_init(const ListenerState *listener, const ALenum distance_model, SpatialBatch *batch)
+{
+    const ALfloat *at = &listener->orientation[0];
+    const ALfloat *up = &listener->orientation[4];
+
+    /* (the math is explained in calculate_channel_gains.) */
+    xyzzy(batch->U, at, up);
+    normalize(batch->U);
+    xyzzy(batch->V, at, batch->U);
+    SDL_memcpy(batch->N, at, sizeof (batch->N));
+    normalize(batch->N);
+    SDL_memcpy(batch->at, at, sizeof (batch->at));
+    batch->at_magnitude = magnitude(at);
+    batch->distance_model = distance_model;
+    batch->listener_gain = listener->gain;
+    batch->count = 0;
+}
+
+static void spatial_batch_add(const ListenerState *listener, SpatialBatch *batch, SourceVoice *voice)
+{
+    const ALsource *src = voice->source;
+    const int i = batch->count++;
+
+    SDL_assert(i < OPENAL_SPATIAL_BATCH_SIZE);
+
+    batch->x[i] = src->position[0];
+    batch->y[i] = src->position[1];
+    batch->z[i] = src->position[2];
+    if (!src->source_relative) {
+        batch->x[i] -= listener->position[0];
+        batch->y[i] -= listener->position[1];
+        batch->z[i] -= listener->position[2];
+    }
+    batch->reference_distance[i] = src->reference_distance;
+    batch->max_distance[i] = src->max_distance;
+    batch->rolloff_factor[i] = src->rolloff_factor;
+    batch->gain[i] = src->gain;
+    batch->min_gain[i] = src->min_gain;
+    batch->max_gain[i] = src->max_gain;
+    batch->voices[i] = voice;
+}
+
+/* there's no vector pow(), so the exponent distance models do that part one source at a time. */
+static void spatial_batch_exponent(SpatialBatch *batch, const int first, const int count)
+{
+    int i;
+    for (i = first; i < first + count; i++) {
+        batch->attenuation[i] = SDL_powf(batch->attenuation[i], -batch->rolloff_factor[i]);
+    }
+}
+
+/* run the batch and hand the results to the voices. */
+static void spatial_batch_flush(SpatialBatch *batch)
+{
+    int i;
+
+    /* fill the last vector out with something harmless; the kernels always do 8 at a time. */
+    for (i = batch->count; i & 7; i++) {
+        batch->x[i] = batch->y[i] = batch->z[i] = 0.0f;
+        batch->reference_distance[i] = batch->max_distance[i] = 1.0f;
+        batch->rolloff_factor[i] = 0.0f;
+        batch->gain[i] = batch->min_gain[i] = batch->max_gain[i] = 0.0f;
+    }
+
+    spatialize_batch(batch);
+
+    for (i = 0; i < batch->count; i++) {
+        SourceVoice *voice = batch->voices[i];
+        voice->panning[0] = batch->left[i];
+        voice->panning[1] = batch->right[i];
+    }
+
+    batch->count = 0;
+}
+
+#ifdef __SSE__
+static void spatialize_batch_sse(SpatialBatch *batch)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 negone = _mm_set1_ps(-1.0f);
+    const __m128 signbit = _mm_set1_ps(-0.0f);
+    const __m128 sqrt2_div2 = _mm_set1_ps(SQRT2_DIV2);
+    const __m128 listener_gain = _mm_set1_ps(batch->listener_gain);
+    const __m128 at_magnitude = _mm_set1_ps(batch->at_magnitude);
+    int i;
+
+    for (i = 0; i < batch->count; i += 4) {
+        const __m128 x = _mm_load_ps(&batch->x[i]);
+        const __m128 y = _mm_load_ps(&batch->y[i]);
+        const __m128 z = _mm_load_ps(&batch->z[i]);
+        const __m128 refdist = _mm_load_ps(&batch->reference_distance[i]);
+        const __m128 maxdist = _mm_load_ps(&batch->max_distance[i]);
+        const __m128 rolloff = _mm_load_ps(&batch->rolloff_factor[i]);
+        __m128 distance = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+        __m128 gain, rx, ry, rz, mags, cosine, abscosine, sine, leftside, nomags, sidepan, left, right;
+
+        /* distance attenuation, gain, and clamping, per the AL spec. */
+        switch (batch->distance_model) {
+            case AL_INVERSE_DISTANCE_CLAMPED:
+                distance = _mm_min_ps(_mm_max_ps(distance, refdist), maxdist);
+                /* fallthrough */
+            case AL_INVERSE_DISTANCE:
+                gain = _mm_div_ps(refdist, _mm_add_ps(refdist, _mm_mul_ps(rolloff, _mm_sub_ps(distance, refdist))));
+                break;
+
+            case AL_LINEAR_DISTANCE_CLAMPED:
+                distance = _mm_max_ps(distance, refdist);
+                /* fallthrough */
+            case AL_LINEAR_DISTANCE:
+                gain = _mm_sub_ps(one, _mm_div_ps(_mm_mul_ps(rolloff, _mm_sub_ps(_mm_min_ps(distance, maxdist), refdist)), _mm_sub_ps(maxdist, refdist)));
+                break;
+
+            case AL_EXPONENT_DISTANCE_CLAMPED:
+                distance = _mm_min_ps(_mm_max_ps(distance, refdist), maxdist);
+                /* fallthrough */
+            default:
+                SDL_assert((batch->distance_model == AL_EXPONENT_DISTANCE) || (batch->distance_model == AL_EXPONENT_DISTANCE_CLAMPED));
+                _mm_store_ps(&batch->attenuation[i], _mm_div_ps(distance, refdist));
+                spatial_batch_exponent(batch, i, 4);
+                gain = _mm_load_ps(&batch->attenuation[i]);
+                break;
+        }
+
+        gain = _mm_mul_ps(gain, _mm_load_ps(&batch->gain[i]));
+        gain = _mm_min_ps(_mm_max_ps(gain, _mm_load_ps(&batch->min_gain[i])), _mm_load_ps(&batch->max_gain[i]));
+        gain = _mm_mul_ps(gain, listener_gain);
+
+        /* rotate into the listener's view, and get the cosine and sine of the angle from straight ahead. */
+        rx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(batch->U[0])), _mm_mul_ps(y, _mm_set1_ps(batch->U[1]))), _mm_mul_ps(z, _mm_set1_ps(batch->U[2])));
+        ry = _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(batch->V[0])), _mm_mul_ps(y, _mm_set1_ps(batch->V[1]))), _mm_mul_ps(z, _mm_set1_ps(batch->V[2]))));
+        rz = _mm_sub_ps(zero, _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(batch->N[0])), _mm_mul_ps(y, _mm_set1_ps(batch->N[1]))), _mm_mul_ps(z, _mm_set1_ps(batch->N[2]))));
+        mags = _mm_mul_ps(at_magnitude, _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, rx), _mm_mul_ps(ry, ry)), _mm_mul_ps(rz, rz))));
+        nomags = _mm_cmpeq_ps(mags, zero);
+        cosine = _mm_add_ps(_mm_add_ps(_mm_mul_ps(rx, _mm_set1_ps(batch->at[0])), _mm_mul_ps(ry, _mm_set1_ps(batch->at[1]))), _mm_mul_ps(rz, _mm_set1_ps(batch->at[2])));
+        cosine = _mm_div_ps(cosine, _mm_or_ps(_mm_and_ps(nomags, one), _mm_andnot_ps(nomags, mags)));
+        cosine = _mm_or_ps(_mm_and_ps(nomags, one), _mm_andnot_ps(nomags, cosine));  /* straight ahead if we can't tell. */
+        cosine = _mm_min_ps(_mm_max_ps(cosine, negone), one);
+        abscosine = _mm_andnot_ps(signbit, cosine);
+        leftside = _mm_cmplt_ps(rx, zero);
+        sine = _mm_sqrt_ps(_mm_max_ps(zero, _mm_sub_ps(one, _mm_mul_ps(cosine, cosine))));
+        sine = _mm_xor_ps(sine, _mm_and_ps(leftside, signbit));  /* negative to the left, positive to the right. */
+
+        /* Constant Power Panning within 45 degrees of straight ahead or behind, all the way to one side otherwise. */
+        sidepan = _mm_cmplt_ps(abscosine, sqrt2_div2);
+        left = _mm_mul_ps(sqrt2_div2, _mm_sub_ps(abscosine, sine));
+        right = _mm_mul_ps(sqrt2_div2, _mm_add_ps(abscosine, sine));
+        left = _mm_or_ps(_mm_and_ps(sidepan, _mm_and_ps(leftside, one)), _mm_andnot_ps(sidepan, left));
+        right = _mm_or_ps(_mm_and_ps(sidepan, _mm_andnot_ps(leftside, one)), _mm_andnot_ps(sidepan, right));
+
+        _mm_store_ps(&batch->left[i], _mm_mul_ps(left, gain));
+        _mm_store_ps(&batch->right[i], _mm_mul_ps(right, gain));
+    }
+}
+#endif
+
+#if HAVE_AVX_MIXERS
+/* (this is the SSE version, twice as wide; the math is explained there.) */
+TARGET_AVX static void spatialize_batch_avx(SpatialBatch *batch)
+{
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 one = _mm256_set1_ps(1.0f);
+    const __m256 negone = _mm256_set1_ps(-1.0f);
+    const __m256 signbit = _mm256_set1_ps(-0.0f);
+    const __m256 sqrt2_div2 = _mm256_set1_ps(SQRT2_DIV2);
+    const __m256 listener_gain = _mm256_set1_ps(batch->listener_gain);
+    const __m256 at_magnitude = _mm256_set1_ps(batch->at_magnitude);
+    int i;
+
+    for (i = 0; i < batch->count; i += 8) {
+        const __m256 x = _mm256_loadu_ps(&batch->x[i]);
+        const __m256 y = _mm256_loadu_ps(&batch->y[i]);
+        const __m256 z = _mm256_loadu_ps(&batch->z[i]);
+        const __m256 refdist = _mm256_loadu_ps(&batch->reference_distance[i]);
+        const __m256 maxdist = _mm256_loadu_ps(&batch->max_distance[i]);
+        const __m256 rolloff = _mm256_loadu_ps(&batch->rolloff_factor[i]);
+        __m256 distance = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)));
+        __m256 gain, rx, ry, rz, mags, cosine, abscosine, sine, leftside, nomags, sidepan, left, right;
+
+        switch (batch->distance_model) {
+            case AL_INVERSE_DISTANCE_CLAMPED:
+                distance = _mm256_min_ps(_mm256_max_ps(distance, refdist), maxdist);
+                /* fallthrough */
+            case AL_INVERSE_DISTANCE:
+                gain = _mm256_div_ps(refdist, _mm256_add_ps(refdist, _mm256_mul_ps(rolloff, _mm256_sub_ps(distance, refdist))));
+                break;
+
+            case AL_LINEAR_DISTANCE_CLAMPED:
+                distance = _mm256_max_ps(distance, refdist);
+                /* fallthrough */
+            case AL_LINEAR_DISTANCE:
+                gain = _mm256_sub_ps(one, _mm256_div_ps(_mm256_mul_ps(rolloff, _mm256_sub_ps(_mm256_min_ps(distance, maxdist), refdist)), _mm256_sub_ps(maxdist, refdist)));
+                break;
+
+            case AL_EXPONENT_DISTANCE_CLAMPED:
+                distance = _mm256_min_ps(_mm256_max_ps(distance, refdist), maxdist);
+                /* fallthrough */
+            default:
+                SDL_assert((batch->distance_model == AL_EXPONENT_DISTANCE) || (batch->distance_model == AL_EXPONENT_DISTANCE_CLAMPED));
+                _mm256_storeu_ps(&batch->attenuation[i], _mm256_div_ps(distance, refdist));
+                spatial_batch_exponent(batch, i, 8);
+                gain = _mm256_loadu_ps(&batch->attenuation[i]);
+                break;
         }
+
+        gain = _mm256_mul_ps(gain, _mm256_loadu_ps(&batch->gain[i]));
+        gain = _mm256_min_ps(_mm256_max_ps(gain, _mm256_loadu_ps(&batch->min_gain[i])), _mm256_loadu_ps(&batch->max_gain[i]));
+        gain = _mm256_mul_ps(gain, listener_gain);
+
+        rx = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(batch->U[0])), _mm256_mul_ps(y, _mm256_set1_ps(batch->U[1]))), _mm256_mul_ps(z, _mm256_set1_ps(batch->U[2])));
+        ry = _mm256_sub_ps(zero, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(batch->V[0])), _mm256_mul_ps(y, _mm256_set1_ps(batch->V[1]))), _mm256_mul_ps(z, _mm256_set1_ps(batch->V[2]))));
+        rz = _mm256_sub_ps(zero, _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(batch->N[0])), _mm256_mul_ps(y, _mm256_set1_ps(batch->N[1]))), _mm256_mul_ps(z, _mm256_set1_ps(batch->N[2]))));
+        mags = _mm256_mul_ps(at_magnitude, _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rx, rx), _mm256_mul_ps(ry, ry)), _mm256_mul_ps(rz, rz))));
+        nomags = _mm256_cmp_ps(mags, zero, _CMP_EQ_OQ);
+        cosine = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(rx, _mm256_set1_ps(batch->at[0])), _mm256_mul_ps(ry, _mm256_set1_ps(batch->at[1]))), _mm256_mul_ps(rz, _mm256_set1_ps(batch->at[2])));
+        cosine = _mm256_div_ps(cosine, _mm256_blendv_ps(mags, one, nomags));
+        cosine = _mm256_blendv_ps(cosine, one, nomags);
+        cosine = _mm256_min_ps(_mm256_max_ps(cosine, negone), one);
+        abscosine = _mm256_andnot_ps(signbit, cosine);
+        leftside = _mm256_cmp_ps(rx, zero, _CMP_LT_OQ);
+        sine = _mm256_sqrt_ps(_mm256_max_ps(zero, _mm256_sub_ps(one, _mm256_mul_ps(cosine, cosine))));
+        sine = _mm256_xor_ps(sine, _mm256_and_ps(leftside, signbit));
+
+        sidepan = _mm256_cmp_ps(abscosine, sqrt2_div2, _CMP_LT_OQ);
+        left = _mm256_mul_ps(sqrt2_div2, _mm256_sub_ps(abscosine, sine));
+        right = _mm256_mul_ps(sqrt2_div2, _mm256_add_ps(abscosine, sine));
+        left = _mm256_blendv_ps(left, _mm256_and_ps(leftside, one), sidepan);
+        right = _mm256_blendv_ps(right, _mm256_andnot_ps(leftside, one), sidepan);
+
+        _mm256_storeu_ps(&batch->left[i], _mm256_mul_ps(left, gain));
+        _mm256_storeu_ps(&batch->right[i], _mm256_mul_ps(right, gain));
     }
 }
+#endif
 
-static ALboolean mix_source_buffer(ALCcontext *ctx, ALsource *src, BufferQueueItem *queue, float **stream, int *len)
+#if defined(__ARM_NEON__) && !defined(__SSE__)
+/* (this is the SSE version with AArch64 NEON; the math is explained there.) */
+static void spatialize_batch_neon(SpatialBatch *batch)
 {
-    const ALbuffer *buffer = queue ? queue->buffer : NULL;
-    ALboolean processed = AL_TRUE;
+    const float32x4_t zero = vdupq_n_f32(0.0f);
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t negone = vdupq_n_f32(-1.0f);
+    const float32x4_t sqrt2_div2 = vdupq_n_f32(SQRT2_DIV2);
+    const float32x4_t listener_gain = vdupq_n_f32(batch->listener_gain);
+    const float32x4_t at_magnitude = vdupq_n_f32(batch->at_magnitude);
+    int i;
 
-    /* you can legally queue or set a NULL buffer. */
-    if (buffer && buffer->data && (buffer->len > 0)) {
-        const float *data = buffer->data + (src->offset / sizeof (float));
-        const int bufferframesize = (int) (buffer->channels * sizeof (float));
-        const int deviceframesize = ctx->device->framesize;
-        const int framesneeded = *len / deviceframesize;
-
-        SDL_assert(src->offset < buffer->len);
-
-        if (src->stream) {  /* resampling? */
-            int mixframes, mixlen, remainingmixframes;
-            while ( (((mixlen = SDL_AudioStreamAvailable(src->stream)) / bufferframesize) < framesneeded) && (src->offset < buffer->len) ) {
-                const int framesput = (buffer->len - src->offset) / bufferframesize;
-                const int bytesput = SDL_min(framesput, 1024) * bufferframesize;
-                FIXME("dynamically adjust frames here?");  /* we hardcode 1024 samples when opening the audio device, too. */
-                SDL_AudioStreamPut(src->stream, data, bytesput);
-                src->offset += bytesput;
-                data += bytesput / sizeof (float);
-            }
+    for (i = 0; i < batch->count; i += 4) {
+        const float32x4_t x = vld1q_f32(&batch->x[i]);
+        const float32x4_t y = vld1q_f32(&batch->y[i]);
+        const float32x4_t z = vld1q_f32(&batch->z[i]);
+        const float32x4_t refdist = vld1q_f32(&batch->reference_distance[i]);
+        const float32x4_t maxdist = vld1q_f32(&batch->max_distance[i]);
+        const float32x4_t rolloff = vld1q_f32(&batch->rolloff_factor[i]);
+        float32x4_t distance = vsqrtq_f32(vmlaq_f32(vmlaq_f32(vmulq_f32(x, x), y, y), z, z));
+        float32x4_t gain, rx, ry, rz, mags, cosine, abscosine, sine, left, right;
+        uint32x4_t leftside, nomags, sidepan;
+
+        switch (batch->distance_model) {
+            case AL_INVERSE_DISTANCE_CLAMPED:
+                distance = vminq_f32(vmaxq_f32(distance, refdist), maxdist);
+                /* fallthrough */
+            case AL_INVERSE_DISTANCE:
+                gain = vdivq_f32(refdist, vmlaq_f32(refdist, rolloff, vsubq_f32(distance, refdist)));
+                break;
 
-            mixframes = SDL_min(mixlen / bufferframesize, framesneeded);
-            remainingmixframes = mixframes;
-            while (remainingmixframes > 0) {
-                float mixbuf[256];
-                const int mixbuflen = sizeof (mixbuf);
-                const int mixbufframes = mixbuflen / bufferframesize;
-                const int getframes = SDL_min(remainingmixframes, mixbufframes);
-                SDL_AudioStreamGet(src->stream, mixbuf, getframes * bufferframesize);
-                mix_buffer(src, buffer, src->panning, mixbuf, *stream, getframes);
-                *len -= getframes * deviceframesize;
-                *stream += getframes * ctx->device->channels;
-                remainingmixframes -= getframes;
-            }
-        } else {
-            const int framesavail = (buffer->len - src->offset) / bufferframesize;
-            const int mixframes = SDL_min(framesneeded, framesavail);
-            mix_buffer(src, buffer, src->panning, data, *stream, mixframes);
-            src->offset += mixframes * bufferframesize;
-            *len -= mixframes * deviceframesize;
-            *stream += mixframes * ctx->device->channels;
+            case AL_LINEAR_DISTANCE_CLAMPED:
+                distance = vmaxq_f32(distance, refdist);
+                /* fallthrough */
+            case AL_LINEAR_DISTANCE:
+                gain = vsubq_f32(one, vdivq_f32(vmulq_f32(rolloff, vsubq_f32(vminq_f32(distance, maxdist), refdist)), vsubq_f32(maxdist, refdist)));
+                break;
+
+            case AL_EXPONENT_DISTANCE_CLAMPED:
+                distance = vminq_f32(vmaxq_f32(distance, refdist), maxdist);
+                /* fallthrough */
+            default:
+                SDL_assert((batch->distance_model == AL_EXPONENT_DISTANCE) || (batch->distance_model == AL_EXPONENT_DISTANCE_CLAMPED));
+                vst1q_f32(&batch->attenuation[i], vdivq_f32(distance, refdist));
+                spatial_batch_exponent(batch, i, 4);
+                gain = vld1q_f32(&batch->attenuation[i]);
+                break;
         }
 
-        SDL_assert(src->offset <= buffer->len);
+        gain = vmulq_f32(gain, vld1q_f32(&batch->gain[i]));
+        gain = vminq_f32(vmaxq_f32(gain, vld1q_f32(&batch->min_gain[i])), vld1q_f32(&batch->max_gain[i]));
+        gain = vmulq_f32(gain, listener_gain);
+
+        rx = vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(x, batch->U[0]), y, batch->U[1]), z, batch->U[2]);
+        ry = vnegq_f32(vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(x, batch->V[0]), y, batch->V[1]), z, batch->V[2]));
+        rz = vnegq_f32(vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(x, batch->N[0]), y, batch->N[1]), z, batch->N[2]));
+        mags = vmulq_f32(at_magnitude, vsqrtq_f32(vmlaq_f32(vmlaq_f32(vmulq_f32(rx, rx), ry, ry), rz, rz)));
+        nomags = vceqq_f32(mags, zero);
+        cosine = vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(rx, batch->at[0]), ry, batch->at[1]), rz, batch->at[2]);
+        cosine = vdivq_f32(cosine, vbslq_f32(nomags, one, mags));
+        cosine = vbslq_f32(nomags, one, cosine);
+        cosine = vminq_f32(vmaxq_f32(cosine, negone), one);
+        abscosine = vabsq_f32(cosine);
+        leftside = vcltq_f32(rx, zero);
+        sine = vsqrtq_f32(vmaxq_f32(zero, vmlsq_f32(one, cosine, cosine)));
+        sine = vbslq_f32(leftside, vnegq_f32(sine), sine);
+
+        sidepan = vcltq_f32(abscosine, sqrt2_div2);
+        left = vmulq_f32(sqrt2_div2, vsubq_f32(abscosine, sine));
+        right = vmulq_f32(sqrt2_div2, vaddq_f32(abscosine, sine));
+        left = vbslq_f32(sidepan, vbslq_f32(leftside, one, zero), left);
+        right = vbslq_f32(sidepan, vbslq_f32(leftside, zero, one), right);
+
+        vst1q_f32(&batch->left[i], vmulq_f32(left, gain));
+        vst1q_f32(&batch->right[i], vmulq_f32(right, gain));
+    }
+}
+#endif
 
-        processed = src->offset >= buffer->len;
-        if (processed) {
-            FIXME("does the offset have to represent the whole queue or just the current buffer?");
-            src->offset = 0;
-        }
+/* Pick the widest spatializer this CPU can run. Like select_mixers(), this is safe to redo at each device open. */
+static void select_spatializer(void)
+{
+    #ifdef __SSE__
+    spatialize_batch = spatialize_batch_sse;
+    #elif defined(__ARM_NEON__)
+    spatialize_batch = spatialize_batch_neon;
+    #endif
+
+    #if HAVE_AVX_MIXERS
+    if (SDL_HasAVX()) {
+        spatialize_batch = spatialize_batch_avx;
     }
+    #endif
 
-    return processed;
+    SDL_assert(spatialize_batch != NULL);
 }
+#endif
 
-static ALCboolean mix_source_buffer_queue(ALCcontext *ctx, ALsource *src, BufferQueueItem *queue, float *stream, int len)
+/* Recalculate gains for every playing voice that needs it, before anything
+   gets mixed. If the listener moved, that's all of them, so spatialized
+   voices go through spatialize_batch() together when we can. */
+/* (first_voice) skips voices that were already listed, for deferred updates. */
+static void recalculate_playlist_gains(ALCcontext *ctx, const ListenerState *listener, const ALenum distance_model, const ALboolean force_recalc, const int first_voice)
 {
-    ALCboolean keep = ALC_TRUE;
+    #if HAVE_SPATIALIZE_BATCH
+    SpatialBatch batch;
+    #endif
+    int i;
 
-    while ((len > 0) && (mix_source_buffer(ctx, src, queue, &stream, &len))) {
-        /* Finished this buffer! */
-        BufferQueueItem *item = queue;
-        BufferQueueItem *next = queue ? (BufferQueueItem*)queue->next : NULL;
-        void *ptr;
+    #if HAVE_SPATIALIZE_BATCH
+    spatial_batch_init(listener, distance_model, &batch);
+    #endif
 
-        if (queue) {
-            queue->next = NULL;
-            queue = next;
+    for (i = first_voice; i < ctx->playlist_count; i++) {
+        SourceVoice *voice = ctx->playlist[i];
+        if ((!voice->recalc && !force_recalc) || !voice->playing) {
+            continue;  /* (if it isn't playing, mix_source() drops it anyhow.) */
         }
 
-        SDL_assert((src->type == AL_STATIC) || (src->type == AL_STREAMING));
-        if (src->type == AL_STREAMING) {  /* mark buffer processed. */
-            SDL_assert(item == src->buffer_queue.head);
-            FIXME("bubble out all these NULL checks");  /* these are only here because we check for looping/stopping in this loop, but we really shouldn't enter this loop at all if queue==NULL. */
-            if (item != NULL) {
-                src->buffer_queue.head = next;
-                if (!next) {
-                    src->buffer_queue.tail = NULL;
-                }
-                SDL_AtomicAdd(&src->buffer_queue.num_items, -1);
-
-                /* Move it to the processed queue for alSourceUnqueueBuffers() to pick up. */
-                do {
-                    ptr = SDL_AtomicGetPtr(&src->buffer_queue_processed.just_queued);
-                    SDL_AtomicSetPtr(&item->next, ptr);
-                } while (!SDL_AtomicCASPtr(&src->buffer_queue_processed.just_queued, ptr, item));
+        SDL_MemoryBarrierAcquire();
+        voice->recalc = AL_FALSE;
 
-                SDL_AtomicAdd(&src->buffer_queue_processed.num_items, 1);
+        #if HAVE_SPATIALIZE_BATCH
+        if (source_is_spatialized(distance_model, voice->source)) {
+            spatial_batch_add(listener, &batch, voice);
+            if (batch.count == OPENAL_SPATIAL_BATCH_SIZE) {
+                spatial_batch_flush(&batch);
             }
+            continue;
         }
+        #endif
 
-        if (queue == NULL) {  /* nothing else to play? */
-            if (src->looping) {
-                FIXME("looping is supposed to move to AL_INITIAL then immediately to AL_PLAYING, but I'm not sure what side effect this is meant to trigger");
-                if (src->type == AL_STREAMING) {
-                    FIXME("what does looping do with the AL_STREAMING state?");
-                }
-            } else {
-                SDL_AtomicSet(&src->state, AL_STOPPED);
-                keep = ALC_FALSE;
-            }
-            break;  /* nothing else to mix here, so stop. */
-        }
+        calculate_channel_gains(listener, distance_model, voice->source, voice->panning);
     }
 
-    return keep;
+    #if HAVE_SPATIALIZE_BATCH
+    if (batch.count > 0) {
+        spatial_batch_flush(&batch);
+    }
+    #endif
 }
 
-/* All the 3D math here is way overcommented because I HAVE NO IDEA WHAT I'M
-   DOING and had to research the hell out of what are probably pretty simple
-   concepts. Pay attention in math class, kids. */
-
-/* The scalar versions have explanitory comments and links. The SIMD versions don't. */
+#define voice_is_inaudible(voice) (((voice)->panning[0] < OPENAL_VIRTUAL_VOICE_GAIN) && ((voice)->panning[1] < OPENAL_VIRTUAL_VOICE_GAIN))
 
-/* calculates cross product. https://en.wikipedia.org/wiki/Cross_product
-    Basically takes two vectors and gives you a vector that's perpendicular
-    to both.
-*/
-#if NEED_SCALAR_FALLBACK
-static void xyzzy(ALfloat *v, const ALfloat *a, const ALfloat *b)
+static int SDLCALL compare_voice_ranks(const void *_a, const void *_b)
 {
-    v[0] = (a[1] * b[2]) - (a[2] * b[1]);
-    v[1] = (a[2] * b[0]) - (a[0] * b[2]);
-    v[2] = (a[0] * b[1]) - (a[1] * b[0]);
+    const VoiceRank *a = (const VoiceRank *) _a;
+    const VoiceRank *b = (const VoiceRank *) _b;
+    if (a->priority != b->priority) {
+        return (a->priority > b->priority) ? -1 : 1;
+    } else if (a->gain != b->gain) {
+        return (a->gain > b->gain) ? -1 : 1;
+    }
+    return (a->order < b->order) ? -1 : 1;  /* never equal; SDL_qsort isn't stable. */
 }
 
-/* calculate dot product (multiply each element of two vectors, sum them) */
-static ALfloat dotproduct(const ALfloat *a, const ALfloat *b)
+/* If more voices are audible than ctx->max_real_voices (or than the
+   governor will let us mix right now), mix the ones with the highest
+   AL_SOURCE_PRIORITY, and the loudest of those, and make the rest virtual
+   for this callback. Voices we were already mixing win ties and keep their
+   place until something is OPENAL_CULL_HYSTERESIS louder; mix_source()
+   fades the ones that change sides. Runs after the gains are up to date. */
+static void cull_playlist_voices(ALCcontext *ctx)
 {
-    return (a[0] * b[0]) + (a[1] * b[1]) + (a[2] * b[2]);
-}
+    const int quality = ctx->device->playback.quality;
+    const int governor_quarters = (quality >= MIX_QUALITY_CULL) ? ((quality - MIX_QUALITY_CULL) + 1) : 0;  /* of the audible voices, to virtualize. */
+    int max_real_voices = ctx->max_real_voices;
+    int audible = 0;
+    int i;
 
-/* calculate distance ("magnitude") in 3D space:
-    https://math.stackexchange.com/questions/42640/calculate-distance-in-3d-space
-    assumes vector starts at (0,0,0). */
-static ALfloat magnitude(const ALfloat *v)
-{
-    /* technically, the inital part on this is just a dot product of itself. */
-    return SDL_sqrtf((v[0] * v[0]) + (v[1] * v[1]) + (v[2] * v[2]));
-}
+    ctx->culling = AL_FALSE;
+    if (!governor_quarters) {
+        ctx->governed_quarters = 0;
+        if ((max_real_voices <= 0) || (ctx->playlist_count <= max_real_voices)) {
+            return;
+        }
+    }
 
-/* https://www.khanacademy.org/computing/computer-programming/programming-natural-simulations/programming-vectors/a/vector-magnitude-normalization */
-static void normalize(ALfloat *v)
-{
-    const ALfloat mag = magnitude(v);
-    if (mag == 0.0f) {
-        SDL_memset(v, '\0', sizeof (*v) * 3);
-    } else {
-        v[0] /= mag;
-        v[1] /= mag;
-        v[2] /= mag;
+    if (ctx->voice_ranks_capacity < ctx->playlist_capacity) {
+        /* this only allocates when more sources are playing at once than ever before. */
+        void *ptr = SDL_realloc(ctx->voice_ranks, ctx->playlist_capacity * sizeof (VoiceRank));
+        if (!ptr) {
+            return;  /* just mix everything this time. */
+        }
+        ctx->voice_ranks = (VoiceRank *) ptr;
+        ctx->voice_ranks_capacity = ctx->playlist_capacity;
+    }
+
+    for (i = 0; i < ctx->playlist_count; i++) {
+        SourceVoice *voice = ctx->playlist[i];
+        if (voice->playing && !voice_is_inaudible(voice)) {  /* the rest are virtual anyhow. */
+            VoiceRank *rank = &ctx->voice_ranks[audible++];
+            rank->voice = voice;
+            rank->priority = voice->source->priority;
+            rank->gain = SDL_max(voice->panning[0], voice->panning[1]);
+            if (voice->cull_gain > 0.0f) {
+                rank->gain *= OPENAL_CULL_HYSTERESIS;
+            }
+            rank->order = i;
+        }
     }
-}
-#endif
 
-#ifdef __SSE__
-static __m128 xyzzy_sse(const __m128 a, const __m128 b)
-{
-    /* http://fastcpp.blogspot.com/2011/04/vector-cross-product-using-sse-code.html
-        this is the "three shuffle" version in the comments, plus the variables swapped around for handedness in the later comment. */
-    const __m128 v = _mm_sub_ps(
-        _mm_mul_ps(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1))),
-        _mm_mul_ps(b, _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1)))
-    );
-    return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 2, 1));
-}
+    if (governor_quarters) {
+        int governed = SDL_max(((4 - governor_quarters) * audible) / 4, 1);
+        /* the audible count wobbles by a voice as sounds start, stop and cross
+           OPENAL_VIRTUAL_VOICE_GAIN; don't let that nudge the limit back and
+           forth every callback. A new governor level takes effect right away. */
+        if ((governor_quarters == ctx->governed_quarters) && (governed >= ctx->governed_voices - 1) && (governed <= ctx->governed_voices + 1)) {
+            governed = ctx->governed_voices;
+        }
+        ctx->governed_quarters = governor_quarters;
+        ctx->governed_voices = governed;
+        max_real_voices = (max_real_voices > 0) ? SDL_min(max_real_voices, governed) : governed;
+    }
 
-static ALfloat dotproduct_sse(const __m128 a, const __m128 b)
-{
-    const __m128 prod = _mm_mul_ps(a, b);
-    const __m128 sum1 = _mm_add_ps(prod, _mm_shuffle_ps(prod, prod, _MM_SHUFFLE(1, 0, 3, 2)));
-    const __m128 sum2 = _mm_add_ps(sum1, _mm_shuffle_ps(sum1, sum1, _MM_SHUFFLE(2, 2, 0, 0)));
-    FIXME("this can use _mm_hadd_ps in SSE3, or _mm_dp_ps in SSE4.1");
-    return _mm_cvtss_f32(_mm_shuffle_ps(sum2, sum2, _MM_SHUFFLE(3, 3, 3, 3)));
-}
+    if (audible <= max_real_voices) {
+        return;
+    }
 
-static ALfloat magnitude_sse(const __m128 v)
-{
-    return SDL_sqrtf(dotproduct_sse(v, v));
+    SDL_qsort(ctx->voice_ranks, audible, sizeof (VoiceRank), compare_voice_ranks);
+    for (i = 0; i < audible; i++) {
+        ctx->voice_ranks[i].voice->culled = (i >= max_real_voices) ? AL_TRUE : AL_FALSE;
+    }
+    ctx->culling = AL_TRUE;
 }
 
-static __m128 normalize_sse(const __m128 v)
+/* add stereo (mixed) into (stream), taking its gain from (from) to (to) across (frames). */
+static void mix_faded(const float * restrict mixed, float * restrict stream, const int frames, const ALfloat from, const ALfloat to)
 {
-    const ALfloat mag = magnitude_sse(v);
-    if (mag == 0.0f) {
-        return _mm_setzero_ps();
+    const ALfloat step = (to - from) / (ALfloat) frames;
+    ALfloat gain = from;
+    int i;
+
+    FIXME("currently expects output to be stereo");
+    for (i = 0; i < frames; i++) {
+        stream[0] += mixed[0] * gain;
+        stream[1] += mixed[1] * gain;
+        stream += 2;
+        mixed += 2;
+        gain += step;
     }
-    return _mm_div_ps(v, _mm_set_ps1(mag));
 }
-#endif
 
-#ifdef __ARM_NEON__
-static float32x4_t xyzzy_neon(const float32x4_t a, const float32x4_t b)
+/* (voice->panning was already brought up to date by recalculate_playlist_gains().) */
+/* count what (voice) is about to do for ALC_EXT_MIXER_STATS, going by the buffer it's starting this callback in. */
+static void count_voice(ALCcontext *ctx, const SourceVoice *voice, const ALbuffer *buffer, MixCounts *counts)
 {
-    const float32x4_t shuf_a = { a[1], a[2], a[0], a[3] };
-    const float32x4_t shuf_b = { b[1], b[2], b[0], b[3] };
-    const float32x4_t v = vsubq_f32(vmulq_f32(a, shuf_b), vmulq_f32(b, shuf_a));
-    const float32x4_t retval = { v[1], v[2], v[0], v[3] };
-    FIXME("need a better permute");
-    return retval;
-}
+    if (voice->virtualized) {
+        counts->voices_virtual++;
+        return;
+    }
 
-static ALfloat dotproduct_neon(const float32x4_t a, const float32x4_t b)
-{
-    const float32x4_t prod = vmulq_f32(a, b);
-    const float32x4_t sum1 = vaddq_f32(prod, vrev64q_f32(prod));
-    const float32x4_t sum2 = vaddq_f32(sum1, vcombine_f32(vget_high_f32(sum1), vget_low_f32(sum1)));
-    return sum2[3];
+    counts->voices++;
+    if (buffer && ((source_resample_step(ctx, voice, buffer) != RESAMPLER_FRAC_ONE) || (voice->offset_frac != 0))) {
+        counts->voices_resampled++;
+    }
+    if (voice_uses_vocoder(ctx, voice)) {
+        counts->voices_pitch_shifted++;
+    }
 }
 
-static ALfloat magnitude_neon(const float32x4_t v)
+static ALCboolean mix_source(ALCcontext *ctx, SourceVoice *voice, float *stream, int len, MixCounts *counts)
 {
-    return SDL_sqrtf(dotproduct_neon(v, v));
-}
+    ALCboolean keep;
 
-static float32x4_t normalize_neon(const float32x4_t v)
-{
-    const ALfloat mag = magnitude_neon(v);
-    if (mag == 0.0f) {
-        return vdupq_n_f32(0.0f);
+    keep = voice->playing;
+    if (keep) {
+        ALsource *src = voice->source;
+        const char *label = trace_enabled ? (const char *) SDL_AtomicGetPtr(&src->label) : NULL;
+        const ALfloat cull_gain = (ctx->culling && voice->culled) ? 0.0f : 1.0f;
+        const ALboolean virtualize = voice_is_inaudible(voice) || ((cull_gain == 0.0f) && (voice->cull_gain == 0.0f));  /* a voice culled just now is mixed once more, fading out. */
+        const ALboolean fading = !virtualize && (cull_gain != voice->cull_gain);
+        float *mixed = stream;
+        SDL_assert(src->allocated);
+
+        if (fading) {  /* crossing the cull limit; mix it on the side so we can ramp it in or out. */
+            mixed = (float *) alloca(len);
+            SDL_memset(mixed, '\0', len);
+        }
+
+        if (virtualize != voice->virtualized) {
+            voice->virtualized = virtualize;
+            if (!virtualize && voice->pitchstate) {
+                SDL_memset(voice->pitchstate, '\0', sizeof (PitchState));  /* what the vocoder had queued up is stale now; start it fresh. */
+            }
+        }
+
+        if (voice->type == AL_STATIC) {
+            BufferQueueItem fakequeue = { voice->buffer, NULL };
+            count_voice(ctx, voice, voice->buffer, counts);
+            TRACE_BEGIN(label ? label : "mix_source", "mixer", voice->buffer ? (const char *) SDL_AtomicGetPtr(&voice->buffer->label) : NULL, src->name);
+            keep = mix_source_buffer_queue(ctx, voice, &fakequeue, mixed, len);
+            TRACE_END(label ? label : "mix_source", "mixer");
+        } else if (voice->type == AL_STREAMING) {
+            BufferQueueItem *queue;
+            obtain_newly_queued_buffers(&src->buffer_queue);
+            queue = src->buffer_queue.head;
+            count_voice(ctx, voice, queue ? queue->buffer : NULL, counts);
+            TRACE_BEGIN(label ? label : "mix_source", "mixer", (queue && queue->buffer) ? (const char *) SDL_AtomicGetPtr(&queue->buffer->label) : NULL, src->name);
+            keep = mix_source_buffer_queue(ctx, voice, queue, mixed, len);
+            TRACE_END(label ? label : "mix_source", "mixer");
+        } else if (voice->type == AL_UNDETERMINED) {
+            keep = ALC_FALSE;  /* this has AL_BUFFER set to 0; just dump it. */
+        } else {
+            SDL_assert(!"unknown source type");
+        }
+
+        if (fading) {
+            mix_faded(mixed, stream, len / (2 * sizeof (float)), voice->cull_gain, cull_gain);
+        }
+        voice->cull_gain = cull_gain;
     }
-    return vmulq_f32(v, vdupq_n_f32(1.0f / mag));
+
+    return keep;
 }
-#endif
 
+/* put (voice) at the end of the playlist. Returns AL_FALSE if we're out of memory. */
+static ALboolean add_to_playlist(ALCcontext *ctx, SourceVoice *voice)
+{
+    SDL_assert(!voice->listed);
+    if (ctx->playlist_count == ctx->playlist_capacity) {
+        /* this only allocates when more sources are playing at once than ever before. */
+        const int newcap = ctx->playlist_capacity ? (ctx->playlist_capacity * 2) : OPENAL_SOURCE_BLOCK_SIZE;
+        void *ptr = SDL_realloc(ctx->playlist, newcap * sizeof (SourceVoice *));
+        if (!ptr) {
+            return AL_FALSE;
+        }
+        ctx->playlist = (SourceVoice **) ptr;
+        ctx->playlist_capacity = newcap;
+    }
+    voice->listed = AL_TRUE;
+    SDL_AtomicSet(&voice->mixer_accessible, 1);
+    ctx->playlist[ctx->playlist_count++] = voice;
+    return AL_TRUE;
+}
+
+/* Run the source commands the API published since last time, in order.
+   Mixer thread only, unless the API locked the mixer out to do it itself.
+   ctx->playlist and SourceVoice->listed are only ever touched here and by
+   the rest of the mixer, and source pointers live until context destruction. */
+static void run_source_commands(ALCcontext *ctx)
+{
+    const Uint32 tail = (Uint32) SDL_AtomicGet(&ctx->commands_tail);
+    Uint32 head = (Uint32) SDL_AtomicGet(&ctx->commands_head);
+
+    SDL_MemoryBarrierAcquire();  /* see the commands the API wrote before it moved commands_tail. */
+
+    for (; head != tail; head++) {
+        const SourceCommand *cmd = &ctx->commands[head & (OPENAL_SOURCE_COMMAND_RING_SIZE - 1)];
+        SourceVoice *voice = cmd->voice;
+        switch (cmd->type) {
+            case AL_PLAYING:
+                voice->mixer_play_serial = cmd->arg;
+                if (!voice->playing) {  /* if we're culling, it has to earn a place before it's heard, and it fades in when it does. */
+                    voice->cull_gain = ctx->culling ? 0.0f : 1.0f;
+                }
+                if (voice->listed || add_to_playlist(ctx, voice)) {
+                    voice->playing = AL_TRUE;
+                } else {  /* out of memory, so it stops right away. */
+                    voice->playing = AL_FALSE;
+                    SDL_AtomicSet(&voice->finished_serial, cmd->arg);
+                }
+                break;
 
+            case AL_PAUSED:
+                voice->playing = AL_FALSE;
+                break;
 
-/* Get the sin(angle) and cos(angle) at the same time. Ideally, with one
-   instruction, like what is offered on the x86.
-   angle is in radians, not degrees. */
-static void calculate_sincos(const ALfloat angle, ALfloat *_sin, ALfloat *_cos)
-{
-    *_sin = SDL_sinf(angle);
-    *_cos = SDL_cosf(angle);
+            case AL_STOPPED:
+                voice->playing = AL_FALSE;
+                source_reset_resampler(voice->source);
+                break;
+
+            case AL_INITIAL:
+                voice->playing = AL_FALSE;
+                voice->offset = 0;
+                source_reset_resampler(voice->source);
+                break;
+
+            case AL_SAMPLE_OFFSET:
+                voice->offset = cmd->arg;
+                source_reset_resampler(voice->source);
+                break;
+
+            default:
+                SDL_assert(!"unknown source command");
+                break;
+        }
+        (void) SDL_AtomicDecRef(&voice->commands_pending);
+    }
+
+    SDL_MemoryBarrierRelease();  /* done with these slots before the API can reuse them. */
+    SDL_AtomicSet(&ctx->commands_head, (int) head);
 }
 
-static ALfloat calculate_distance_attenuation(const ALCcontext *ctx, const ALsource *src, ALfloat distance)
+/* Wait for a mix that's running on (device) right now to finish. A mix that
+   starts later runs any source commands we already published before it
+   touches a source, so after this, the mixer is done with anything we told
+   it to stop. Only the API waits here; the mixer never waits for the API.
+   This gets called every frame by apps that use alDeferUpdatesSOFT, so it
+   sleeps on a semaphore the mixer posts when it's done, instead of spinning. */
+static void wait_for_mixer(ALCdevice *device)
 {
-    /* AL SPEC: "With all the distance models, if the formula can not be
-       evaluated then the source will not be attenuated. For example, if a
-       linear model is being used with AL_REFERENCE_DISTANCE equal to
-       AL_MAX_DISTANCE, then the gain equation will have a divide-by-zero
-       error in it. In this case, there is no attenuation for that source." */
-    FIXME("check divisions by zero");
-
-    switch (ctx->distance_model) {
-        case AL_INVERSE_DISTANCE_CLAMPED:
-            distance = SDL_min(SDL_max(distance, src->reference_distance), src->max_distance);
-            /* fallthrough */
-        case AL_INVERSE_DISTANCE:
-            /* AL SPEC: "gain = AL_REFERENCE_DISTANCE / (AL_REFERENCE_DISTANCE + AL_ROLLOFF_FACTOR * (distance - AL_REFERENCE_DISTANCE))" */
-            return src->reference_distance / (src->reference_distance + src->rolloff_factor * (distance - src->reference_distance));
+    const int serial = SDL_AtomicGet(&device->playback.mix_serial);
+    if (serial & 1) {  /* odd: mixing right now. */
+        if (!device->playback.mix_done) {
+            device->playback.mix_done = SDL_CreateSemaphore(0);  /* we hold the device's api lock, so nothing else makes one at the same time. */
+        }
 
-        case AL_LINEAR_DISTANCE_CLAMPED:
-            distance = SDL_max(distance, src->reference_distance);
-            /* fallthrough */
-        case AL_LINEAR_DISTANCE:
-            /* AL SPEC: "distance = min(distance, AL_MAX_DISTANCE) // avoid negative gain
-                         gain = (1 - AL_ROLLOFF_FACTOR * (distance - AL_REFERENCE_DISTANCE) / (AL_MAX_DISTANCE - AL_REFERENCE_DISTANCE))" */
-            return 1.0f - src->rolloff_factor * (SDL_min(distance, src->max_distance) - src->reference_distance) / (src->max_distance - src->reference_distance);
+        /* both are full barriers: the mixer bumps the serial before it checks
+           for waiters, and we check the serial after we're counted, so either
+           it sees us and posts, or we see the new serial and don't block. */
+        SDL_AtomicIncRef(&device->playback.mix_waiters);
+        while (SDL_AtomicGet(&device->playback.mix_serial) == serial) {
+            if (device->playback.mix_done) {
+                SDL_SemWait(device->playback.mix_done);  /* (might be a leftover post from an earlier wait; the loop checks again.) */
+            } else {
+                SDL_Delay(1);  /* out of memory for the semaphore; slow, but it works. */
+            }
+        }
+        (void) SDL_AtomicDecRef(&device->playback.mix_waiters);
+    }
+}
 
-        case AL_EXPONENT_DISTANCE_CLAMPED:
-            distance = SDL_min(SDL_max(distance, src->reference_distance), src->max_distance);
-            /* fallthrough */
-        case AL_EXPONENT_DISTANCE:
-            /* AL SPEC: "gain = (distance / AL_REFERENCE_DISTANCE) ^ (- AL_ROLLOFF_FACTOR)" */
-            return SDL_powf(distance / src->reference_distance, -src->rolloff_factor);
+/* Queue a command for the mixer to run on (voice). The mixer can't see it
+   until publish_source_commands(), so a batch of them takes effect in the
+   same callback. API only; the api lock keeps the ring single-producer. */
+static void post_source_command(ALCcontext *ctx, SourceVoice *voice, const ALenum type, const int arg)
+{
+    SourceCommand *cmd;
 
-        default: break;
+    if ((ctx->commands_written - (Uint32) SDL_AtomicGet(&ctx->commands_head)) >= OPENAL_SOURCE_COMMAND_RING_SIZE) {
+        /* Full, so the mixer isn't keeping up (or isn't running, like a
+           loopback device nobody is rendering). Lock it out until this batch
+           is published and run the commands ourselves, so the batch still
+           lands all at once. */
+        if (!ctx->commands_locked_mixer) {
+            lock_mixer(ctx->device);
+            ctx->commands_locked_mixer = AL_TRUE;
+            SDL_AtomicIncRef(&ctx->device->playback.source_locks);
+        }
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&ctx->commands_tail, (int) ctx->commands_written);
+        run_source_commands(ctx);
     }
 
-    SDL_assert(!"Unexpected distance model");
-    return 1.0f;
+    cmd = &ctx->commands[ctx->commands_written & (OPENAL_SOURCE_COMMAND_RING_SIZE - 1)];
+    cmd->voice = voice;
+    cmd->type = type;
+    cmd->arg = arg;
+    SDL_AtomicIncRef(&voice->commands_pending);
+    ctx->commands_written++;
 }
 
-static void calculate_channel_gains(const ALCcontext *ctx, const ALsource *src, float *gains)
+/* Let the mixer see everything post_source_command() queued since last time. */
+static void publish_source_commands(ALCcontext *ctx)
 {
-    /* rolloff==0.0f makes all distance models result in 1.0f,
-       and we never spatialize non-mono sources, per the AL spec. */
-    const ALboolean spatialize = (ctx->distance_model != AL_NONE) &&
-                                 (src->queue_channels == 1) &&
-                                 (src->rolloff_factor != 0.0f);
+    SDL_MemoryBarrierRelease();  /* the commands land before the mixer can see commands_tail move. */
+    SDL_AtomicSet(&ctx->commands_tail, (int) ctx->commands_written);
+    if (ctx->commands_locked_mixer) {
+        run_source_commands(ctx);
+        ctx->commands_locked_mixer = AL_FALSE;
+        unlock_mixer(ctx->device);
+    }
+}
 
-    const ALfloat *at = &ctx->listener.orientation[0];
-    const ALfloat *up = &ctx->listener.orientation[4];
+/* take ctx->playlist[idx] out of the playlist. It wasn't actually playing or it just finished.
+   The last voice moves into its slot, so the playlist stays dense. */
+static void remove_from_playlist(ALCcontext *ctx, const int idx)
+{
+    SourceVoice *voice = ctx->playlist[idx];
+    SDL_assert(idx < ctx->playlist_count);
+    ctx->playlist[idx] = ctx->playlist[--ctx->playlist_count];
+    voice->listed = AL_FALSE;
+    SDL_AtomicSet(&voice->mixer_accessible, 0);
+}
 
-    ALfloat distance;
-    ALfloat gain;
-    ALfloat radians;
+/* add (frames) of interleaved stereo float32 from (data) into (stream). */
+static void mix_add_float32(const float * restrict data, float * restrict stream, const ALsizei frames)
+{
+    static const ALfloat unity[2] = { 1.0f, 1.0f };
+    mix_float32_c2(unity, data, stream, frames);
+}
 
-    #ifdef __SSE__
-    __m128 position_sse;
-    #elif defined(__ARM_NEON__)
-    float32x4_t position_neon = vdupq_n_f32(0.0f);
-    #endif
+/* claim voices from the playlist until they run out.
+   Returns AL_TRUE if anything was mixed into (stream). */
+static ALboolean mixer_pool_run(MixerPool *pool, float *stream, const ALboolean clear, MixCounts *counts)
+{
+    ALCcontext *ctx = pool->ctx;
+    ALboolean mixed = AL_FALSE;
+    int i;
 
-    #if NEED_SCALAR_FALLBACK
-    ALfloat position[3];
-    #endif
+    TRACE_BEGIN("mixer_pool_run", "mixer", NULL, 0);
+    while ((i = SDL_AtomicAdd(&pool->next_voice, 1)) < pool->num_voices) {
+        if (clear && !mixed) {
+            SDL_memset(stream, '\0', pool->len);
+        }
+        pool->keep[i] = mix_source(ctx, ctx->playlist[i], stream, pool->len, counts);
+        mixed = AL_TRUE;
+    }
+    TRACE_END("mixer_pool_run", "mixer");
 
-    /* this goes through the steps the AL spec dictates for gain and distance attenuation... */
+    return mixed;
+}
 
-    if (!spatialize) {
-        /* simpler path through the same AL spec details if not spatializing. */
-        gain = SDL_min(SDL_max(src->gain, src->min_gain), src->max_gain) * ctx->listener.gain;
-        gains[0] = gains[1] = gain;  /* no spatialization, but AL_GAIN (etc) is still applied. */
-        return;
-    }
+static int SDLCALL mixer_worker_thread(void *data)
+{
+    MixerWorker *worker = (MixerWorker *) data;
+    MixerPool *pool = worker->pool;
 
-    #ifdef __SSE__
-    if (has_sse) {
-        position_sse = _mm_load_ps(src->position);
-        if (!src->source_relative) {
-            position_sse = _mm_sub_ps(position_sse, _mm_load_ps(ctx->listener.position));
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH);
+    trace_thread_name("mixer worker");
+
+    while (ALC_TRUE) {
+        SDL_SemWait(worker->wake);
+        if (SDL_AtomicGet(&pool->quit)) {
+            break;
         }
-        distance = magnitude_sse(position_sse);
-    } else
-    #elif defined(__ARM_NEON__)
-    if (has_neon) {
-        position_neon = vld1q_f32(src->position);
-        if (!src->source_relative) {
-            position_neon = vsubq_f32(position_neon, vld1q_f32(ctx->listener.position));
+        worker->mixed = mixer_pool_run(pool, worker->buffer, AL_TRUE, &worker->counts);
+        SDL_SemPost(pool->done);
+    }
+
+    return 0;
+}
+
+static void mix_playlist_serial(ALCcontext *ctx, float *stream, int len)
+{
+    MixCounts *counts = &ctx->device->playback.mix_counts;
+    int i = 0;
+
+    while (i < ctx->playlist_count) {
+        if (!mix_source(ctx, ctx->playlist[i], stream, len, counts)) {
+            remove_from_playlist(ctx, i);  /* something we haven't mixed yet moves into slot (i). */
+        } else {
+            i++;
         }
-        distance = magnitude_neon(position_neon);
-    } else
-    #endif
+    }
+}
 
-    {
-    #if NEED_SCALAR_FALLBACK
-    SDL_memcpy(position, src->position, sizeof (position));
-    /* if values aren't source-relative, then convert it to be so. */
-    if (!src->source_relative) {
-        position[0] -= ctx->listener.position[0];
-        position[1] -= ctx->listener.position[1];
-        position[2] -= ctx->listener.position[2];
+/* Mix one chunk (no bigger than pool->buflen) of the playlist across the worker pool.
+   Returns AL_FALSE if we couldn't set this up. */
+static ALboolean mix_playlist_parallel(ALCcontext *ctx, float *stream, int len)
+{
+    MixCounts *counts = &ctx->device->playback.mix_counts;
+    MixerPool *pool = ctx->mixer_pool;
+    const int total = ctx->playlist_count;
+    int woken;
+    int j;
+
+    if (total > pool->keep_capacity) {
+        /* this only allocates when the playlist grows past anything we've mixed before. */
+        void *ptr = SDL_realloc(pool->keep, ctx->playlist_capacity * sizeof (ALCboolean));
+        if (!ptr) {
+            return AL_FALSE;
+        }
+        pool->keep = (ALCboolean *) ptr;
+        pool->keep_capacity = ctx->playlist_capacity;
     }
-    distance = magnitude(position);
-    #endif
+
+    /* the workers read ctx->playlist directly; nothing changes it until they're done. */
+    pool->num_voices = total;
+    pool->len = len;
+    SDL_AtomicSet(&pool->next_voice, 0);  /* this is a full barrier, so workers see everything above. */
+
+    /* the audio thread mixes too, so don't wake more workers than there are other sources. */
+    woken = SDL_min(pool->num_workers, total - 1);
+    for (j = 0; j < woken; j++) {
+        SDL_SemPost(pool->workers[j].wake);
     }
 
-    /* AL SPEC: ""1. Distance attenuation is calculated first, including
-       minimum (AL_REFERENCE_DISTANCE) and maximum (AL_MAX_DISTANCE)
-       thresholds." */
-    gain = calculate_distance_attenuation(ctx, src, distance);
+    mixer_pool_run(pool, stream, AL_FALSE, counts);
 
-    /* AL SPEC: "2. The result is then multiplied by source gain (AL_GAIN)." */
-    gain *= src->gain;
+    for (j = 0; j < woken; j++) {
+        SDL_SemWait(pool->done);
+    }
 
-    /* AL SPEC: "3. If the source is directional (AL_CONE_INNER_ANGLE less
-       than AL_CONE_OUTER_ANGLE), an angle-dependent attenuation is calculated
-       depending on AL_CONE_OUTER_GAIN, and multiplied with the distance
-       dependent attenuation. The resulting attenuation factor for the given
-       angle and distance between listener and source is multiplied with
-       source AL_GAIN." */
-    if (src->cone_inner_angle < src->cone_outer_angle) {
-        FIXME("directional sources");
+    for (j = 0; j < woken; j++) {
+        MixerWorker *worker = &pool->workers[j];
+        if (worker->mixed) {
+            mix_add_float32(worker->buffer, stream, len / ctx->device->framesize);
+        }
+        counts->voices += worker->counts.voices;
+        counts->voices_resampled += worker->counts.voices_resampled;
+        counts->voices_pitch_shifted += worker->counts.voices_pitch_shifted;
+        counts->voices_virtual += worker->counts.voices_virtual;
+        SDL_zero(worker->counts);
     }
 
-    /* AL SPEC: "4. The effective gain computed this way is compared against
-       AL_MIN_GAIN and AL_MAX_GAIN thresholds." */
-    gain = SDL_min(SDL_max(gain, src->min_gain), src->max_gain);
+    /* walk backwards, so whatever remove_from_playlist moves into slot (j) has already been checked. */
+    for (j = total - 1; j >= 0; j--) {
+        if (!pool->keep[j]) {
+            remove_from_playlist(ctx, j);
+        }
+    }
 
-    /* AL SPEC: "5. The result is guaranteed to be clamped to [AL_MIN_GAIN,
-       AL_MAX_GAIN], and subsequently multiplied by listener gain which serves
-       as an overall volume control. The implementation is free to clamp
-       listener gain if necessary due to hardware or implementation
-       constraints." */
-    gain *= ctx->listener.gain;
+    return AL_TRUE;
+}
 
-    /* now figure out positioning. Since we're aiming for stereo, we just
-       need a simple panning effect. We're going to do what's called
-       "constant power panning," as explained...
+static void mix_context(ALCcontext *ctx, float *stream, int len)
+{
+    MixCounts *counts = &ctx->device->playback.mix_counts;
+    const int previously_listed = ctx->playlist_count;
+    ALboolean force_recalc;
+    Uint64 gains_start;
+
+    TRACE_BEGIN("run_source_commands", "mixer", NULL, 0);
+    run_source_commands(ctx);
+    TRACE_END("run_source_commands", "mixer");
+
+    TRACE_BEGIN("recalculate_playlist_gains", "mixer", NULL, 0);
+    gains_start = SDL_GetPerformanceCounter();
+    if (SDL_AtomicGet(&ctx->deferring)) {
+        /* leave the recalc flags for alProcessUpdatesSOFT; only newly-playing
+           voices need gains now, and they get them from the listener as it
+           was before the batch, not the one the app is halfway through changing. */
+        recalculate_playlist_gains(ctx, &ctx->deferred_listener, ctx->deferred_distance_model, AL_FALSE, previously_listed);
+    } else {
+        force_recalc = ctx->recalc;
+        if (force_recalc) {
+            SDL_MemoryBarrierAcquire();
+            ctx->recalc = AL_FALSE;
+        }
+        recalculate_playlist_gains(ctx, &ctx->listener, ctx->distance_model, force_recalc, 0);
+    }
+    counts->gains_ticks += SDL_GetPerformanceCounter() - gains_start;
+    TRACE_END("recalculate_playlist_gains", "mixer");
+
+    TRACE_BEGIN("cull_playlist_voices", "mixer", NULL, 0);
+    cull_playlist_voices(ctx);
+    TRACE_END("cull_playlist_voices", "mixer");
+
+    /* not worth waking up other threads unless there's more than one source playing. */
+    if (ctx->mixer_pool && (ctx->playlist_count > 1)) {
+        MixerPool *pool = ctx->mixer_pool;
+        while ((len > 0) && ctx->playlist_count) {
+            const int chunklen = SDL_min(len, pool->buflen);
+            if (!mix_playlist_parallel(ctx, stream, chunklen)) {
+                mix_playlist_serial(ctx, stream, chunklen);
+            }
+            stream += chunklen / sizeof (float);
+            len -= chunklen;
+        }
+        return;
+    }
 
-       https://dsp.stackexchange.com/questions/21691/algorithm-to-pan-audio
+    mix_playlist_serial(ctx, stream, len);
+}
 
-       Naturally, we'll need to know the angle between where our listener
-       is facing and where the source is to make that work...
+/* Disconnected devices move all PLAYING sources to STOPPED, making their buffer queues processed. */
+static void mix_disconnected_context(ALCcontext *ctx)
+{
+    int i;
 
-       https://www.youtube.com/watch?v=S_568VZWFJo
+    run_source_commands(ctx);
 
-       ...but to do that, we need to rotate so we have the correct side of
-       the listener, which isn't just a point in space, but has a definite
-       direction it is facing. More or less, this is what gluLookAt deals
-       with...
+    for (i = 0; i < ctx->playlist_count; i++) {
+        SourceVoice *voice = ctx->playlist[i];
 
-       http://www.songho.ca/opengl/gl_camera.html
+        /* remove from playlist; all playing things got stopped, paused/initial/stopped shouldn't be listed. */
+        if (voice->playing) {
+            SDL_assert(voice->source->allocated);
+            voice->playing = AL_FALSE;
+            SDL_AtomicSet(&voice->finished_serial, voice->mixer_play_serial);
+            source_mark_all_buffers_processed(voice->source);
+        }
 
-       ...although I messed with the algorithm until it did what I wanted.
+        voice->listed = AL_FALSE;
+        SDL_AtomicSet(&voice->mixer_accessible, 0);
+    }
+    ctx->playlist_count = 0;
+}
 
-       XYZZY!! https://en.wikipedia.org/wiki/Cross_product#Mnemonic
-    */
+/* The mix quality governor, for devices with a context that set
+   ALC_MIX_GOVERNOR: when OPENAL_GOVERNOR_BUSY_CALLBACKS in a row use more
+   than OPENAL_GOVERNOR_HIGH_PERCENT of their budget, it mixes a MIX_QUALITY_*
+   step cheaper (nearest-frame resampling, then no phase vocoder, then
+   virtualizing more and more of the least important voices), so we lose
+   fidelity instead of glitching the whole output. One slow callback (a page
+   fault, a cold cache) isn't enough; the load has to stay up. After
+   OPENAL_GOVERNOR_CALM_CALLBACKS in a row under OPENAL_GOVERNOR_LOW_PERCENT,
+   it comes back up a step. Loopback devices have no deadline, so they always
+   mix at full quality. Only the mixer thread calls this, after mixing. */
+static void govern_mix_quality(ALCdevice *device, const Uint64 ns, const Uint64 budget_ns)
+{
+    const int prev_quality = device->playback.quality;
+    int quality = prev_quality;
+    ALCboolean governed = ALC_FALSE;
+    ALCcontext *ctx;
 
-    #ifdef __SSE__ /* (the math is explained in the scalar version.) */
-    if (has_sse) {
-        const __m128 at_sse = _mm_load_ps(at);
-        const __m128 U_sse = normalize_sse(xyzzy_sse(at_sse, _mm_load_ps(up)));
-        const __m128 V_sse = xyzzy_sse(at_sse, U_sse);
-        const __m128 N_sse = normalize_sse(at_sse);
-        const __m128 rotated_sse = {
-            dotproduct_sse(position_sse, U_sse),
-            -dotproduct_sse(position_sse, V_sse),
-            -dotproduct_sse(position_sse, N_sse),
-            0.0f
-        };
+    if (budget_ns == 0) {
+        return;
+    }
 
-        const ALfloat mags = magnitude_sse(at_sse) * magnitude_sse(rotated_sse);
-        radians = (mags == 0.0f) ? 0.0f : SDL_acosf(dotproduct_sse(at_sse, rotated_sse) / mags);
-        if (_mm_comilt_ss(rotated_sse, _mm_setzero_ps())) {
-            radians = -radians;
+    for (ctx = device->playback.contexts; ctx != NULL; ctx = ctx->next) {
+        if (ctx->mix_governor) {
+            governed = ALC_TRUE;
+            break;
         }
-    } else
-    #endif
-
-    #ifdef __ARM_NEON__  /* (the math is explained in the scalar version.) */
-    if (has_neon) {
-        const float32x4_t at_neon = vld1q_f32(at);
-        const float32x4_t U_neon = normalize_neon(xyzzy_neon(at_neon, vld1q_f32(up)));
-        const float32x4_t V_neon = xyzzy_neon(at_neon, U_neon);
-        const float32x4_t N_neon = normalize_neon(at_neon);
-        const float32x4_t rotated_neon = {
-            dotproduct_neon(position_neon, U_neon),
-            -dotproduct_neon(position_neon, V_neon),
-            -dotproduct_neon(position_neon, N_neon),
-            0.0f
-        };
+    }
 
-        const ALfloat mags = magnitude_neon(at_neon) * magnitude_neon(rotated_neon);
-        radians = (mags == 0.0f) ? 0.0f : SDL_acosf(dotproduct_neon(at_neon, rotated_neon) / mags);
-        if (rotated_neon[0] < 0.0f) {
-            radians = -radians;
+    if (!governed || device->isloopback) {
+        device->playback.busy_callbacks = device->playback.calm_callbacks = 0;
+        quality = MIX_QUALITY_FULL;  /* (in case the contexts that wanted the governor went away while it had quality down.) */
+    } else if ((ns * 100) > (budget_ns * OPENAL_GOVERNOR_HIGH_PERCENT)) {
+        device->playback.calm_callbacks = 0;
+        if (++device->playback.busy_callbacks >= OPENAL_GOVERNOR_BUSY_CALLBACKS) {
+            device->playback.busy_callbacks = 0;  /* give the cheaper level a fresh run of callbacks to show whether it's enough. */
+            quality = SDL_min(quality + 1, MIX_QUALITY_LOWEST);
         }
-    } else
-    #endif
+    } else if ((ns * 100) < (budget_ns * OPENAL_GOVERNOR_LOW_PERCENT)) {
+        device->playback.busy_callbacks = 0;
+        if (++device->playback.calm_callbacks >= OPENAL_GOVERNOR_CALM_CALLBACKS) {
+            device->playback.calm_callbacks = 0;
+            quality = SDL_max(quality - 1, MIX_QUALITY_FULL);
+        }
+    } else {
+        device->playback.busy_callbacks = device->playback.calm_callbacks = 0;
+    }
 
-    {
-    #if NEED_SCALAR_FALLBACK
-        ALfloat U[3];
-        ALfloat V[3];
-        ALfloat N[3];
-        ALfloat rotated[3];
-        ALfloat mags;
+    if (quality == prev_quality) {
+        return;
+    }
 
-        xyzzy(U, at, up);
-        normalize(U);
-        xyzzy(V, at, U);
-        SDL_memcpy(N, at, sizeof (N));
-        normalize(N);
+    if ((prev_quality >= MIX_QUALITY_NO_VOCODER) && (quality < MIX_QUALITY_NO_VOCODER)) {
+        /* what the vocoders had queued up is stale now; start them fresh. */
+        for (ctx = device->playback.contexts; ctx != NULL; ctx = ctx->next) {
+            int i;
+            for (i = 0; i < ctx->playlist_count; i++) {
+                SourceVoice *voice = ctx->playlist[i];
+                if (voice->pitchstate) {
+                    SDL_memset(voice->pitchstate, '\0', sizeof (PitchState));
+                }
+            }
+        }
+    }
 
-        /* we don't need the bottom row of the gluLookAt matrix, since we don't
-           translate. (Matrix * Vector) is just filling in each element of the
-           output vector with the dot product of a row of the matrix and the
-           vector. I made some of these negative to make it work for my purposes,
-           but that's not what GLU does here.
+    if (trace_enabled) {
+        trace_event('i', (quality > prev_quality) ? "mix quality down" : "mix quality up", "mixer", NULL, (Uint32) quality);
+    }
+
+    device->playback.quality = quality;
+}
+
+/* Publish this callback's numbers for ALC_EXT_MIXER_STATS, and check it against
+   its deadline: (frames) at the device's frequency is how long we had before the
+   device needed more audio. Only the mixer thread calls this. */
+static void publish_mixer_stats(ALCdevice *device, const Uint64 start, const Uint64 ticks, const int frames)
+{
+    MixerStats *stats = &device->playback.stats;
+    MixCounts *counts = &device->playback.mix_counts;
+    const double ns_per_tick = 1000000000.0 / ((double) SDL_GetPerformanceFrequency());
+    const Uint64 ns = (Uint64) (((double) ticks) * ns_per_tick);
+    const Uint64 budget_ns = device->frequency ? ((((Uint64) frames) * 1000000000) / ((Uint64) device->frequency)) : 0;
+    const Uint64 last_start = device->playback.last_callback_ticks;
+    const Uint64 interval_ns = last_start ? ((Uint64) (((double) (start - last_start)) * ns_per_tick)) : 0;
+    /* loopback devices render when the app asks, so there's no deadline to miss there. */
+    const ALCboolean realtime = !device->isloopback && (budget_ns > 0);
+    const ALCboolean overrun = realtime && (ns > budget_ns);
+    const ALCboolean late = realtime && (interval_ns > ((budget_ns * OPENAL_LATE_CALLBACK_PERCENT) / 100));
+    const int bucket = budget_ns ? ((int) SDL_min((ns * 10) / budget_ns, (Uint64) (ALC_MIX_BUDGET_HISTOGRAM_BUCKETS - 1))) : 0;
+    ALCMIXDEADLINEPROC callback;
+
+    device->playback.last_callback_ticks = start;
+
+    SDL_AtomicIncRef(&stats->sequence);  /* odd now, readers will wait. This is a full barrier. */
+    stats->callbacks++;
+    stats->last_ns = ns;
+    stats->total_ns += ns;
+    if (ns > stats->max_ns) {
+        stats->max_ns = ns;
+    }
+    stats->gains_ns += (Uint64) (((double) counts->gains_ticks) * ns_per_tick);
+    stats->voices = counts->voices;
+    stats->voices_resampled = counts->voices_resampled;
+    stats->voices_pitch_shifted = counts->voices_pitch_shifted;
+    stats->voices_virtual = counts->voices_virtual;
+    stats->quality = device->playback.quality;
+    stats->budget_ns = budget_ns;
+    stats->overruns += overrun ? 1 : 0;
+    stats->late_callbacks += late ? 1 : 0;
+    stats->histogram[bucket]++;
+    SDL_AtomicIncRef(&stats->sequence);  /* even again, it's consistent. */
+
+    SDL_zerop(counts);
+
+    govern_mix_quality(device, ns, budget_ns);
+
+    if (overrun || late) {
+        if (trace_enabled) {
+            trace_event('i', overrun ? "mix overrun" : "late callback", "xrun", NULL, 0);
+        }
 
-           (This says gluLookAt is left-handed, so maybe that's part of it?)
-            https://stackoverflow.com/questions/25933581/how-u-v-n-camera-coordinate-system-explained-with-opengl
-         */
-        rotated[0] = dotproduct(position, U);
-        rotated[1] = -dotproduct(position, V);
-        rotated[2] = -dotproduct(position, N);
+        /* we hold the mixer lock here, so this can't change under us. */
+        callback = device->playback.deadline_callback;
+        if (callback) {
+            if (overrun) {
+                callback(device, ALC_MIX_OVERRUNS, (ALCint64SOFT) ns, (ALCint64SOFT) budget_ns, device->playback.deadline_userdata);
+            }
+            if (late) {
+                callback(device, ALC_MIX_LATE_CALLBACKS, (ALCint64SOFT) interval_ns, (ALCint64SOFT) budget_ns, device->playback.deadline_userdata);
+            }
+        }
+    }
+}
 
-        /* At this point, we have rotated vector and we can calculate the angle
-           from 0 (directly in front of where the listener is facing) to 180
-           degrees (directly behind) ... */
+/* We process all of the device's ALC contexts during this call, mixing their
+   output to (stream). SDL then plays this mixed audio to the hardware. */
+static void SDLCALL playback_device_callback(void *userdata, Uint8 *stream, int len)
+{
+    ALCdevice *device = (ALCdevice *) userdata;
+    const Uint64 start = SDL_GetPerformanceCounter();
+    const char *device_label = NULL;
+    ALCcontext *ctx;
+    ALCboolean connected = ALC_FALSE;
 
-        mags = magnitude(at) * magnitude(rotated);
-        radians = (mags == 0.0f) ? 0.0f : SDL_acosf(dotproduct(at, rotated) / mags);
-        /* and we already have what we need to decide if those degrees are on the
-           listener's left or right...
-           https://gamedev.stackexchange.com/questions/43897/determining-if-something-is-on-the-right-or-left-side-of-an-object
-           ...we already did this dot product: it's in rotated[0]. */
+    SDL_memset(stream, '\0', len);
 
-        /* make it negative to the left, positive to the right. */
-        if (rotated[0] < 0.0f) {
-            radians = -radians;
+    SDL_AtomicIncRef(&device->playback.mix_serial);  /* odd now; see wait_for_mixer(). */
+
+    if (SDL_AtomicGet(&device->connected)) {
+        if (!device->isloopback && (SDL_GetAudioDeviceStatus(device->sdldevice) == SDL_AUDIO_STOPPED)) {
+            SDL_AtomicSet(&device->connected, ALC_FALSE);
+        } else {
+            connected = ALC_TRUE;
         }
-    #endif
     }
 
-    /* here comes the Constant Power Panning magic... */
-    #define SQRT2_DIV2 0.7071067812f  /* sqrt(2.0) / 2.0 ... */
+    if (trace_enabled) {
+        trace_thread_name(device->isloopback ? "loopback render" : "audio callback");
+        device_label = (const char *) SDL_AtomicGetPtr(&device->label);
+        TRACE_BEGIN(device_label ? device_label : "playback_device_callback", "mixer", NULL, 0);
+    }
 
-    /* this might be a terrible idea, which is totally my own doing here,
-      but here you go: Constant Power Panning only works from -45 to 45
-      degrees in front of the listener. So we split this into 4 quadrants.
-      - from -45 to 45: standard panning.
-      - from 45 to 135: pan full right.
-      - from 135 to 225: flip angle so it works like standard panning.
-      - from 225 to -45: pan full left. */
+    for (ctx = device->playback.contexts; ctx != NULL; ctx = ctx->next) {
+        if (SDL_AtomicGet(&ctx->processing)) {
+            const char *ctx_label = trace_enabled ? (const char *) SDL_AtomicGetPtr(&ctx->label) : NULL;
+            TRACE_BEGIN(ctx_label ? ctx_label : "mix_context", "mixer", NULL, 0);
+            if (connected) {
+                mix_context(ctx, (float *) stream, len);
+            } else {
+                mix_disconnected_context(ctx);
+            }
+            TRACE_END(ctx_label ? ctx_label : "mix_context", "mixer");
+        }
+    }
 
-    #define RADIANS_45_DEGREES 0.7853981634f
-    #define RADIANS_135_DEGREES 2.3561944902f
-    if ((radians >= -RADIANS_45_DEGREES) && (radians <= RADIANS_45_DEGREES)) {
-        ALfloat sine, cosine;
-        calculate_sincos(radians, &sine, &cosine);
-        gains[0] = (SQRT2_DIV2 * (cosine - sine));
-        gains[1] = (SQRT2_DIV2 * (cosine + sine));
-    } else if ((radians >= RADIANS_45_DEGREES) && (radians <= RADIANS_135_DEGREES)) {
-        gains[0] = 0.0f;
-        gains[1] = 1.0f;
-    } else if ((radians >= -RADIANS_135_DEGREES) && (radians <= -RADIANS_45_DEGREES)) {
-        gains[0] = 1.0f;
-        gains[1] = 0.0f;
-    } else if (radians < 0.0f) {  /* back left */
-        ALfloat sine, cosine;
-        calculate_sincos((ALfloat) -(radians + M_PI), &sine, &cosine);
-        gains[0] = (SQRT2_DIV2 * (cosine - sine));
-        gains[1] = (SQRT2_DIV2 * (cosine + sine));
-    } else { /* back right */
-        ALfloat sine, cosine;
-        calculate_sincos((ALfloat) -(radians - M_PI), &sine, &cosine);
-        gains[0] = (SQRT2_DIV2 * (cosine - sine));
-        gains[1] = (SQRT2_DIV2 * (cosine + sine));
+    SDL_AtomicIncRef(&device->playback.mix_serial);  /* even again; we're done with every source. */
+    if (SDL_AtomicGet(&device->playback.mix_waiters) && device->playback.mix_done) {
+        SDL_SemPost(device->playback.mix_done);
     }
 
-    /* apply distance attenuation and gain to positioning. */
-    gains[0] *= gain;
-    gains[1] *= gain;
+    TRACE_END(device_label ? device_label : "playback_device_callback", "mixer");
+    publish_mixer_stats(device, start, SDL_GetPerformanceCounter() - start, device->framesize ? (len / device->framesize) : 0);
 }
 
-
-static ALCboolean mix_source(ALCcontext *ctx, ALsource *src, float *stream, int len, const ALboolean force_recalc)
+static void destroy_mixer_pool(MixerPool *pool)
 {
-    ALCboolean keep;
+    int i;
 
-    keep = (SDL_AtomicGet(&src->state) == AL_PLAYING);
-    if (keep) {
-        SDL_assert(src->allocated);
-        if (src->recalc || force_recalc) {
-            SDL_MemoryBarrierAcquire();
-            src->recalc = AL_FALSE;
-            calculate_channel_gains(ctx, src, src->panning);
+    if (!pool) {
+        return;
+    }
+
+    SDL_AtomicSet(&pool->quit, 1);
+    for (i = 0; i < pool->num_workers; i++) {
+        MixerWorker *worker = &pool->workers[i];
+        if (worker->thread) {
+            SDL_SemPost(worker->wake);
+            SDL_WaitThread(worker->thread, NULL);
         }
-        if (src->type == AL_STATIC) {
-            BufferQueueItem fakequeue = { src->buffer, NULL };
-            keep = mix_source_buffer_queue(ctx, src, &fakequeue, stream, len);
-        } else if (src->type == AL_STREAMING) {
-            obtain_newly_queued_buffers(&src->buffer_queue);
-            keep = mix_source_buffer_queue(ctx, src, src->buffer_queue.head, stream, len);
-        } else if (src->type == AL_UNDETERMINED) {
-            keep = ALC_FALSE;  /* this has AL_BUFFER set to 0; just dump it. */
-        } else {
-            SDL_assert(!"unknown source type");
+        if (worker->wake) {
+            SDL_DestroySemaphore(worker->wake);
         }
+        free_simd_aligned(worker->buffer);
     }
 
-    return keep;
+    if (pool->done) {
+        SDL_DestroySemaphore(pool->done);
+    }
+    SDL_free(pool->workers);
+    SDL_free(pool->keep);
+    SDL_free(pool);
 }
 
-/* move new play requests over to the mixer thread. */
-static void migrate_playlist_requests(ALCcontext *ctx)
+/* (numthreads) includes the SDL audio thread, so this spins up (numthreads-1) workers. */
+static MixerPool *create_mixer_pool(ALCcontext *ctx, const int numthreads)
 {
-    SourcePlayTodo *todo;
-    SourcePlayTodo *todoend;
-    SourcePlayTodo *i;
+    MixerPool *pool;
+    int i;
 
-    do {  /* take the todo list atomically, now we own it. */
-        todo = (SourcePlayTodo *) ctx->playlist_todo;
-    } while (!SDL_AtomicCASPtr(&ctx->playlist_todo, todo, NULL));
+    #if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+    return NULL;  /* no threads in Emscripten (at the moment...!) */
+    #endif
 
-    if (!todo) {
-        return;  /* nothing new. */
+    if (numthreads <= 1) {
+        return NULL;  /* just mix on the audio thread. */
     }
 
-    todoend = todo;
+    pool = (MixerPool *) SDL_calloc(1, sizeof (MixerPool));
+    if (!pool) {
+        return NULL;
+    }
 
-    /* ctx->playlist and ALsource->playlist_next are only every touched
-       by the mixer thread, and source pointers live until context destruction. */
-    for (i = todo; i != NULL; i = i->next) {
-        todoend = i;
-        if ((i->source != ctx->playlist_tail) && (!i->source->playlist_next)) {
-            i->source->playlist_next = ctx->playlist;
-            if (!ctx->playlist) {
-                ctx->playlist_tail = i->source;
-            }
-            ctx->playlist = i->source;
+    pool->ctx = ctx;
+    pool->buflen = 1024 * ctx->device->framesize;  /* bigger callbacks get mixed in chunks. */
+    pool->done = SDL_CreateSemaphore(0);
+    pool->workers = (MixerWorker *) SDL_calloc(numthreads - 1, sizeof (MixerWorker));
+    if (!pool->done || !pool->workers) {
+        destroy_mixer_pool(pool);
+        return NULL;
+    }
+
+    for (i = 0; i < numthreads - 1; i++) {
+        MixerWorker *worker = &pool->workers[i];
+        worker->pool = pool;
+        pool->num_workers++;
+        worker->buffer = (float *) calloc_simd_aligned(pool->buflen);
+        worker->wake = SDL_CreateSemaphore(0);
+        if (!worker->buffer || !worker->wake) {
+            destroy_mixer_pool(pool);
+            return NULL;
+        }
+        worker->thread = SDL_CreateThread(mixer_worker_thread, "mojoal mixer", worker);
+        if (!worker->thread) {
+            destroy_mixer_pool(pool);
+            return NULL;
         }
     }
 
-    /* put these objects back in the pool for reuse */
-    do {
-        todoend->next = i = (SourcePlayTodo *) ctx->device->playback.source_todo_pool;
-    } while (!SDL_AtomicCASPtr(&ctx->device->playback.source_todo_pool, i, todo));
+    return pool;
 }
 
-static void mix_context(ALCcontext *ctx, float *stream, int len)
+/* We only mix in stereo for now, but alcRenderSamplesSOFT() can convert that to any sample type. */
+static ALCboolean loopback_format_supported(const ALCsizei freq, const ALCenum channels, const ALCenum type)
 {
-    const ALboolean force_recalc = ctx->recalc;
-    ALsource *next = NULL;
-    ALsource *prev = NULL;
-    ALsource *i;
-
-    if (force_recalc) {
-        SDL_MemoryBarrierAcquire();
-        ctx->recalc = AL_FALSE;
+    if ((freq <= 0) || (channels != ALC_STEREO_SOFT)) {
+        return ALC_FALSE;
     }
 
-    migrate_playlist_requests(ctx);
+    switch (type) {
+        case ALC_BYTE_SOFT:
+        case ALC_UNSIGNED_BYTE_SOFT:
+        case ALC_SHORT_SOFT:
+        case ALC_UNSIGNED_SHORT_SOFT:
+        case ALC_INT_SOFT:
+        case ALC_UNSIGNED_INT_SOFT:
+        case ALC_FLOAT_SOFT:
+            return ALC_TRUE;
+        default: break;
+    }
 
-    for (i = ctx->playlist; i != NULL; i = next) {
-        next = i->playlist_next;  /* save this to a local in case we leave the list. */
+    return ALC_FALSE;
+}
 
-        SDL_LockMutex(ctx->source_lock);
-        if (!mix_source(ctx, i, stream, len, force_recalc)) {
-            /* take it out of the playlist. It wasn't actually playing or it just finished. */
-            i->playlist_next = NULL;
-            if (next == NULL) {
-                SDL_assert(i == ctx->playlist_tail);
-                ctx->playlist_tail = prev;
-            }
-            if (prev) {
-                prev->playlist_next = next;
-            } else {
-                SDL_assert(i == ctx->playlist);
-                ctx->playlist = next;
-            }
-            SDL_AtomicSet(&i->mixer_accessible, 0);
-        } else {
-            prev = i;
-        }
-        SDL_UnlockMutex(ctx->source_lock);
+static ALCboolean _alcIsRenderFormatSupportedSOFT(ALCdevice *device, ALCsizei freq, ALCenum channels, ALCenum type)
+{
+    if (!device || !device->isloopback) {
+        set_alc_error(device, ALC_INVALID_DEVICE);
+        return ALC_FALSE;
+    } else if (freq <= 0) {
+        set_alc_error(device, ALC_INVALID_VALUE);
+        return ALC_FALSE;
     }
+    return loopback_format_supported(freq, channels, type);
 }
+DEVICE_ENTRYPOINT(ALCboolean,alcIsRenderFormatSupportedSOFT,(ALCdevice *device, ALCsizei freq, ALCenum channels, ALCenum type),(device,freq,channels,type),device)
 
-/* Disconnected devices move all PLAYING sources to STOPPED, making their buffer queues processed. */
-static void mix_disconnected_context(ALCcontext *ctx)
+/* convert (total) float32 samples from the mixer to a loopback device's
+   format, clamping as we go. Returns where the next sample goes in (dst). */
+static Uint8 *convert_loopback_samples(const ALCenum type, const float *src, Uint8 *dst, const int total)
 {
-    ALsource *next = NULL;
-    ALsource *i;
+    #define LOOPBACK_CONVERT(typ, expr) { \
+        typ *out = (typ *) dst; \
+        for (i = 0; i < total; i++) { \
+            const float sample = SDL_min(SDL_max(src[i], -1.0f), 1.0f); \
+            out[i] = (typ) (expr); \
+        } \
+        return (Uint8 *) (out + total); \
+    }
 
-    migrate_playlist_requests(ctx);
+    int i;
 
-    for (i = ctx->playlist; i != NULL; i = next) {
-        next = i->playlist_next;
+    switch (type) {
+        case ALC_FLOAT_SOFT:
+            SDL_memcpy(dst, src, total * sizeof (float));
+            return dst + (total * sizeof (float));
+        case ALC_BYTE_SOFT: LOOPBACK_CONVERT(Sint8, sample * 127.0f);
+        case ALC_UNSIGNED_BYTE_SOFT: LOOPBACK_CONVERT(Uint8, (sample * 127.0f) + 128.0f);
+        case ALC_SHORT_SOFT: LOOPBACK_CONVERT(Sint16, sample * 32767.0f);
+        case ALC_UNSIGNED_SHORT_SOFT: LOOPBACK_CONVERT(Uint16, (sample * 32767.0f) + 32768.0f);
+        case ALC_INT_SOFT: LOOPBACK_CONVERT(Sint32, sample * 2147483647.0);
+        case ALC_UNSIGNED_INT_SOFT: LOOPBACK_CONVERT(Uint32, (sample * 2147483647.0) + 2147483648.0);
+        default: break;
+    }
 
-        SDL_LockMutex(ctx->source_lock);
-        /* remove from playlist; all playing things got stopped, paused/initial/stopped shouldn't be listed. */
-        if (SDL_AtomicGet(&i->state) == AL_PLAYING) {
-            SDL_assert(i->allocated);
-            SDL_AtomicSet(&i->state, AL_STOPPED);
-            source_mark_all_buffers_processed(i);
-        }
+    #undef LOOPBACK_CONVERT
 
-        i->playlist_next = NULL;
-        SDL_AtomicSet(&i->mixer_accessible, 0);
-        SDL_UnlockMutex(ctx->source_lock);
-    }
-    ctx->playlist = NULL;
-    ctx->playlist_tail = NULL;
+    SDL_assert(!"unexpected loopback format");
+    return dst;
 }
 
-/* We process all unsuspended ALC contexts during this call, mixing their
-   output to (stream). SDL then plays this mixed audio to the hardware. */
-static void SDLCALL playback_device_callback(void *userdata, Uint8 *stream, int len)
+/* no api lock; this stands in for SDL's audio thread on loopback devices, so it only holds the mixer lock. */
+void alcRenderSamplesSOFT(ALCdevice *device, ALCvoid *buffer, ALCsizei samples)
 {
-    ALCdevice *device = (ALCdevice *) userdata;
-    ALCcontext *ctx;
-    ALCboolean connected = ALC_FALSE;
-
-    SDL_memset(stream, '\0', len);
+    Uint8 *dst = (Uint8 *) buffer;
 
-    if (SDL_AtomicGet(&device->connected)) {
-        if (SDL_GetAudioDeviceStatus(device->sdldevice) == SDL_AUDIO_STOPPED) {
-            SDL_AtomicSet(&device->connected, ALC_FALSE);
-        } else {
-            connected = ALC_TRUE;
-        }
+    if (!device || !device->isloopback) {
+        set_alc_error(device, ALC_INVALID_DEVICE);
+        return;
+    } else if ((samples < 0) || ((samples > 0) && !buffer)) {
+        set_alc_error(device, ALC_INVALID_VALUE);
+        return;
     }
 
-    for (ctx = device->playback.contexts; ctx != NULL; ctx = ctx->next) {
-        if (SDL_AtomicGet(&ctx->processing)) {
-            if (connected) {
-                mix_context(ctx, (float *) stream, len);
-            } else {
-                mix_disconnected_context(ctx);
-            }
+    lock_mixer(device);
+    if (!device->frequency) {
+        set_alc_error(device, ALC_INVALID_DEVICE);  /* no context has told us a format yet. */
+    } else {
+        /* mix a chunk at a time into our own (aligned) buffer through the usual path, then convert it out. */
+        while (samples > 0) {
+            const int frames = SDL_min(samples, OPENAL_LOOPBACK_CHUNK_FRAMES);
+            playback_device_callback(device, (Uint8 *) device->playback.loopback_mix, frames * device->framesize);
+            dst = convert_loopback_samples(device->playback.loopback_type, device->playback.loopback_mix, dst, frames * device->channels);
+            samples -= frames;
         }
     }
+    unlock_mixer(device);
 }
 
 static ALCcontext *_alcCreateContext(ALCdevice *device, const ALCint* attrlist)
@@ -2092,6 +5212,12 @@ static ALCcontext *_alcCreateContext(ALCdevice *device, const ALCint* attrlist)
     ALCint freq = 48000;
     ALCboolean sync = ALC_FALSE;
     ALCint refresh = 100;
+    ALCint mixer_threads = -1;
+    ALCint max_real_voices = -1;
+    ALCint mix_governor = -1;
+    ALCboolean freq_set = ALC_FALSE;
+    ALCenum loopback_channels = 0;
+    ALCenum loopback_type = 0;
     /* we don't care about ALC_MONO_SOURCES or ALC_STEREO_SOURCES as we have no hardware limitation. */
 
     if (!device) {
@@ -2108,14 +5234,25 @@ static ALCcontext *_alcCreateContext(ALCdevice *device, const ALCint* attrlist)
         ALCint attr;
         while ((attr = attrlist[attrcount++]) != 0) {
             switch (attr) {
-                case ALC_FREQUENCY: freq = attrlist[attrcount++]; break;
+                case ALC_FREQUENCY: freq = attrlist[attrcount++]; freq_set = ALC_TRUE; break;
                 case ALC_REFRESH: refresh = attrlist[attrcount++]; break;
                 case ALC_SYNC: sync = (attrlist[attrcount++] ? ALC_TRUE : ALC_FALSE); break;
+                case ALC_MIXER_THREADS: mixer_threads = attrlist[attrcount++]; break;
+                case ALC_MAX_REAL_VOICES: max_real_voices = attrlist[attrcount++]; break;
+                case ALC_MIX_GOVERNOR: mix_governor = (attrlist[attrcount++] ? 1 : 0); break;
+                case ALC_FORMAT_CHANNELS_SOFT: loopback_channels = attrlist[attrcount++]; break;
+                case ALC_FORMAT_TYPE_SOFT: loopback_type = attrlist[attrcount++]; break;
                 default: FIXME("fail for unknown attributes?"); break;
             }
         }
     }
 
+    /* ALC_SOFT_loopback: "...the context attributes must specify ALC_FREQUENCY, ALC_FORMAT_CHANNELS_SOFT, and ALC_FORMAT_TYPE_SOFT." */
+    if (device->isloopback && (!freq_set || !loopback_format_supported(freq, loopback_channels, loopback_type))) {
+        set_alc_error(device, ALC_INVALID_VALUE);
+        return NULL;
+    }
+
     FIXME("use these variables at some point"); (void) refresh; (void) sync;
 
     retval = (ALCcontext *) calloc_simd_aligned(sizeof (ALCcontext));
@@ -2129,8 +5266,8 @@ static ALCcontext *_alcCreateContext(ALCdevice *device, const ALCint* attrlist)
     SDL_assert( (((size_t) &retval->listener.orientation[0]) % 16) == 0 );
     SDL_assert( (((size_t) &retval->listener.velocity[0]) % 16) == 0 );
 
-    retval->source_lock = SDL_CreateMutex();
-    if (!retval->source_lock) {
+    retval->commands = (SourceCommand *) SDL_calloc(OPENAL_SOURCE_COMMAND_RING_SIZE, sizeof (SourceCommand));
+    if (!retval->commands) {
         set_alc_error(device, ALC_OUT_OF_MEMORY);
         free_simd_aligned(retval);
         return NULL;
@@ -2139,14 +5276,22 @@ static ALCcontext *_alcCreateContext(ALCdevice *device, const ALCint* attrlist)
     retval->attributes = (ALCint *) SDL_malloc(attrcount * sizeof (ALCint));
     if (!retval->attributes) {
         set_alc_error(device, ALC_OUT_OF_MEMORY);
-        SDL_DestroyMutex(retval->source_lock);
+        SDL_free(retval->commands);
         free_simd_aligned(retval);
         return NULL;
     }
     SDL_memcpy(retval->attributes, attrlist, attrcount * sizeof (ALCint));
     retval->attributes_count = attrcount;
 
-    if (!device->sdldevice) {
+    if (device->isloopback) {
+        /* every new context sets the format; contexts that already exist just start mixing at the new rate. */
+        lock_mixer(device);
+        device->channels = 2;
+        device->frequency = freq;
+        device->framesize = sizeof (float) * device->channels;
+        device->playback.loopback_type = loopback_type;
+        unlock_mixer(device);
+    } else if (!device->sdldevice) {
         SDL_AudioSpec desired;
         const char *devicename = device->name;
 
@@ -2165,7 +5310,7 @@ static ALCcontext *_alcCreateContext(ALCdevice *device, const ALCint* attrlist)
         desired.userdata = device;
         device->sdldevice = SDL_OpenAudioDevice(devicename, 0, &desired, NULL, 0);
         if (!device->sdldevice) {
-            SDL_DestroyMutex(retval->source_lock);
+            SDL_free(retval->commands);
             SDL_free(retval->attributes);
             free_simd_aligned(retval);
             FIXME("What error do you set for this?");
@@ -2177,6 +5322,7 @@ static ALCcontext *_alcCreateContext(ALCdevice *device, const ALCint* attrlist)
         SDL_PauseAudioDevice(device->sdldevice, 0);
     }
 
+    retval->free_sources_tail = &retval->free_sources;
     retval->distance_model = AL_INVERSE_DISTANCE_CLAMPED;
     retval->doppler_factor = 1.0f;
     retval->doppler_velocity = 1.0f;
@@ -2188,33 +5334,115 @@ static ALCcontext *_alcCreateContext(ALCdevice *device, const ALCint* attrlist)
     context_needs_recalc(retval);
     SDL_AtomicSet(&retval->processing, 1);  /* contexts default to processing */
 
-    SDL_LockAudioDevice(device->sdldevice);
+    /* Mixer threads: 1 (the default) mixes on the SDL audio thread only, 0 means one per CPU core. */
+    if (mixer_threads < 0) {
+        const char *env = SDL_getenv("MOJOAL_MIXER_THREADS");
+        mixer_threads = env ? SDL_atoi(env) : 1;
+    }
+    if (mixer_threads == 0) {
+        mixer_threads = SDL_GetCPUCount();
+    }
+    mixer_threads = SDL_min(mixer_threads, OPENAL_MAX_MIXER_THREADS);
+    retval->mixer_pool = create_mixer_pool(retval, mixer_threads);  /* if this fails, we just mix serially. */
+
+    /* Real voices: 0 (the default) mixes everything that's audible. */
+    if (max_real_voices < 0) {
+        const char *env = SDL_getenv("MOJOAL_MAX_REAL_VOICES");
+        max_real_voices = env ? SDL_atoi(env) : 0;
+    }
+    retval->max_real_voices = SDL_max(max_real_voices, 0);
+
+    /* Mix quality governor: off by default, so nobody's output changes unless they ask. */
+    if (mix_governor < 0) {
+        const char *env = SDL_getenv("MOJOAL_MIX_GOVERNOR");
+        mix_governor = (env && (SDL_atoi(env) != 0)) ? 1 : 0;
+    }
+    retval->mix_governor = mix_governor ? ALC_TRUE : ALC_FALSE;
+
+    lock_mixer(device);
     if (device->playback.contexts != NULL) {
         SDL_assert(device->playback.contexts->prev == NULL);
         device->playback.contexts->prev = retval;
     }
     retval->next = device->playback.contexts;
     device->playback.contexts = retval;
-    SDL_UnlockAudioDevice(device->sdldevice);
+    unlock_mixer(device);
 
     return retval;
 }
-ENTRYPOINT(ALCcontext *,alcCreateContext,(ALCdevice *device, const ALCint* attrlist),(device,attrlist))
-
-
-static SDL_INLINE ALCcontext *get_current_context(void)
-{
-    return (ALCcontext *) SDL_AtomicGetPtr(&current_context);
-}
+DEVICE_ENTRYPOINT(ALCcontext *,alcCreateContext,(ALCdevice *device, const ALCint* attrlist),(device,attrlist),device)
 
 /* no api lock; it just sets an atomic pointer at the moment */
 ALCboolean alcMakeContextCurrent(ALCcontext *ctx)
 {
+    const SDL_TLSID tls = (SDL_TLSID) SDL_AtomicGet(&thread_context_tls);
+    if (tls && SDL_TLSGet(tls)) {
+        SDL_TLSSet(tls, NULL, NULL);  /* ALC_EXT_thread_local_context: this also unsets the calling thread's context. */
+    }
+
     SDL_AtomicSetPtr(&current_context, ctx);
     FIXME("any reason this might return ALC_FALSE?");
     return ALC_TRUE;
 }
 
+/* no api lock; the context is only visible to the calling thread. */
+ALCboolean alcSetThreadContext(ALCcontext *ctx)
+{
+    SDL_TLSID tls = (SDL_TLSID) SDL_AtomicGet(&thread_context_tls);
+
+    if (!tls) {
+        if (!ctx) {
+            return ALC_TRUE;  /* nothing to unset. */
+        }
+
+        SDL_AtomicLock(&thread_context_tls_lock);
+        tls = (SDL_TLSID) SDL_AtomicGet(&thread_context_tls);
+        if (!tls) {
+            tls = SDL_TLSCreate();
+            SDL_AtomicSet(&thread_context_tls, (int) tls);
+        }
+        SDL_AtomicUnlock(&thread_context_tls_lock);
+
+        if (!tls) {
+            set_alc_error(ctx->device, ALC_OUT_OF_MEMORY);
+            return ALC_FALSE;
+        }
+    }
+
+    if (SDL_TLSSet(tls, ctx, NULL) == -1) {
+        set_alc_error(ctx ? ctx->device : NULL, ALC_OUT_OF_MEMORY);
+        return ALC_FALSE;
+    }
+
+    return ALC_TRUE;
+}
+
+/* no api lock; thread-local. */
+ALCcontext *alcGetThreadContext(void)
+{
+    const SDL_TLSID tls = (SDL_TLSID) SDL_AtomicGet(&thread_context_tls);
+    return tls ? (ALCcontext *) SDL_TLSGet(tls) : NULL;
+}
+
+/* AL_SOFT_deferred_updates. When deferring starts, snapshot the listener for
+   voices that start during the batch, and wait out a mix that might be
+   recalculating gains right now, so no mix sees half of the batch. */
+static void set_context_deferring(ALCcontext *ctx, const int deferring)
+{
+    if (deferring && !SDL_AtomicGet(&ctx->deferring)) {
+        wait_for_mixer(ctx->device);  /* a mix from the last batch might still be reading the old snapshot. */
+        SDL_memcpy(&ctx->deferred_listener, &ctx->listener, sizeof (ctx->deferred_listener));
+        ctx->deferred_distance_model = ctx->distance_model;
+    }
+
+    SDL_AtomicSet(&ctx->deferring, deferring);  /* a full barrier, so the snapshot is in place before a mix can see this. */
+    if (deferring) {
+        wait_for_mixer(ctx->device);
+    }
+}
+
+/* Suspending a context just batches up state changes until it's processed
+   again (it keeps mixing), like alDeferUpdatesSOFT. */
 static void _alcProcessContext(ALCcontext *ctx)
 {
     if (!ctx) {
@@ -2223,9 +5451,9 @@ static void _alcProcessContext(ALCcontext *ctx)
     }
 
     SDL_assert(!ctx->device->iscapture);
-    SDL_AtomicSet(&ctx->processing, 1);
+    set_context_deferring(ctx, 0);
 }
-ENTRYPOINTVOID(alcProcessContext,(ALCcontext *ctx),(ctx))
+DEVICE_ENTRYPOINTVOID(alcProcessContext,(ALCcontext *ctx),(ctx),ctx ? ctx->device : NULL)
 
 static void _alcSuspendContext(ALCcontext *ctx)
 {
@@ -2233,10 +5461,10 @@ static void _alcSuspendContext(ALCcontext *ctx)
         set_alc_error(NULL, ALC_INVALID_CONTEXT);
     } else {
         SDL_assert(!ctx->device->iscapture);
-        SDL_AtomicSet(&ctx->processing, 0);
+        set_context_deferring(ctx, 1);
     }
 }
-ENTRYPOINTVOID(alcSuspendContext,(ALCcontext *ctx),(ctx))
+DEVICE_ENTRYPOINTVOID(alcSuspendContext,(ALCcontext *ctx),(ctx),ctx ? ctx->device : NULL)
 
 static void _alcDestroyContext(ALCcontext *ctx)
 {
@@ -2245,8 +5473,8 @@ static void _alcDestroyContext(ALCcontext *ctx)
     FIXME("Should NULL context be an error?");
     if (!ctx) return;
 
-    /* The spec says it's illegal to delete the current context. */
-    if (get_current_context() == ctx) {
+    /* The spec says it's illegal to delete the current context. We can only see this thread's thread context, though. */
+    if ((get_current_context() == ctx) || (SDL_AtomicGetPtr(&current_context) == ctx)) {
         set_alc_error(ctx->device, ALC_INVALID_CONTEXT);
         return;
     }
@@ -2254,7 +5482,7 @@ static void _alcDestroyContext(ALCcontext *ctx)
     /* do this first in case the mixer is running _right now_. */
     SDL_AtomicSet(&ctx->processing, 0);
 
-    SDL_LockAudioDevice(ctx->device->sdldevice);
+    lock_mixer(ctx->device);
     if (ctx->prev) {
         ctx->prev->next = ctx->next;
     } else {
@@ -2264,7 +5492,9 @@ static void _alcDestroyContext(ALCcontext *ctx)
     if (ctx->next) {
         ctx->next->prev = ctx->prev;
     }
-    SDL_UnlockAudioDevice(ctx->device->sdldevice);
+    unlock_mixer(ctx->device);
+
+    destroy_mixer_pool(ctx->mixer_pool);
 
     for (blocki = 0; blocki < ctx->num_source_blocks; blocki++) {
         SourceBlock *sb = ctx->source_blocks[blocki];
@@ -2276,7 +5506,6 @@ static void _alcDestroyContext(ALCcontext *ctx)
                     continue;
                 }
 
-                SDL_FreeAudioStream(src->stream);
                 source_release_buffer_queue(ctx, src);
                 if (--sb->used == 0) {
                     break;
@@ -2286,12 +5515,21 @@ static void _alcDestroyContext(ALCcontext *ctx)
         free_simd_aligned(sb);
     }
 
-    SDL_DestroyMutex(ctx->source_lock);
+    while (ctx->retired_source_blocks) {
+        RetiredSourceBlocks *next = ctx->retired_source_blocks->next;
+        SDL_free(ctx->retired_source_blocks->source_blocks);
+        SDL_free(ctx->retired_source_blocks);
+        ctx->retired_source_blocks = next;
+    }
+
+    SDL_free(ctx->commands);
     SDL_free(ctx->source_blocks);
+    SDL_free(ctx->playlist);
+    SDL_free(ctx->voice_ranks);
     SDL_free(ctx->attributes);
     free_simd_aligned(ctx);
 }
-ENTRYPOINTVOID(alcDestroyContext,(ALCcontext *ctx),(ctx))
+DEVICE_ENTRYPOINTVOID(alcDestroyContext,(ALCcontext *ctx),(ctx),ctx ? ctx->device : NULL)
 
 /* no api lock; atomic. */
 ALCcontext *alcGetCurrentContext(void)
@@ -2312,7 +5550,7 @@ static ALCenum _alcGetError(ALCdevice *device)
     *perr = ALC_NO_ERROR;
     return retval;
 }
-ENTRYPOINT(ALCenum,alcGetError,(ALCdevice *device),(device))
+DEVICE_ENTRYPOINT(ALCenum,alcGetError,(ALCdevice *device),(device),device)
 
 /* no api lock; immutable */
 ALCboolean alcIsExtensionPresent(ALCdevice *device, const ALCchar *extname)
@@ -2338,6 +5576,8 @@ void *alcGetProcAddress(ALCdevice *device, const ALCchar *funcname)
     FN_TEST(alcSuspendContext);
     FN_TEST(alcDestroyContext);
     FN_TEST(alcGetCurrentContext);
+    FN_TEST(alcSetThreadContext);
+    FN_TEST(alcGetThreadContext);
     FN_TEST(alcGetContextsDevice);
     FN_TEST(alcOpenDevice);
     FN_TEST(alcCloseDevice);
@@ -2352,6 +5592,14 @@ void *alcGetProcAddress(ALCdevice *device, const ALCchar *funcname)
     FN_TEST(alcCaptureStart);
     FN_TEST(alcCaptureStop);
     FN_TEST(alcCaptureSamples);
+    FN_TEST(alcLoopbackOpenDeviceSOFT);
+    FN_TEST(alcIsRenderFormatSupportedSOFT);
+    FN_TEST(alcRenderSamplesSOFT);
+    FN_TEST(alcGetInteger64v);
+    FN_TEST(alcMixDeadlineCallback);
+    FN_TEST(alcTraceDeviceLabel);
+    FN_TEST(alcTraceContextLabel);
+    FN_TEST(alcTraceDump);
     #undef FN_TEST
 
     set_alc_error(device, ALC_INVALID_VALUE);
@@ -2393,6 +5641,40 @@ ALCenum alcGetEnumValue(ALCdevice *device, const ALCchar *enumname)
     ENUM_TEST(ALC_DEFAULT_ALL_DEVICES_SPECIFIER);
     ENUM_TEST(ALC_ALL_DEVICES_SPECIFIER);
     ENUM_TEST(ALC_CONNECTED);
+    ENUM_TEST(ALC_MIXER_THREADS);
+    ENUM_TEST(ALC_MAX_REAL_VOICES);
+    ENUM_TEST(ALC_MIX_GOVERNOR);
+    ENUM_TEST(ALC_FORMAT_CHANNELS_SOFT);
+    ENUM_TEST(ALC_FORMAT_TYPE_SOFT);
+    ENUM_TEST(ALC_BYTE_SOFT);
+    ENUM_TEST(ALC_UNSIGNED_BYTE_SOFT);
+    ENUM_TEST(ALC_SHORT_SOFT);
+    ENUM_TEST(ALC_UNSIGNED_SHORT_SOFT);
+    ENUM_TEST(ALC_INT_SOFT);
+    ENUM_TEST(ALC_UNSIGNED_INT_SOFT);
+    ENUM_TEST(ALC_FLOAT_SOFT);
+    ENUM_TEST(ALC_MONO_SOFT);
+    ENUM_TEST(ALC_STEREO_SOFT);
+    ENUM_TEST(ALC_QUAD_SOFT);
+    ENUM_TEST(ALC_5POINT1_SOFT);
+    ENUM_TEST(ALC_6POINT1_SOFT);
+    ENUM_TEST(ALC_7POINT1_SOFT);
+    ENUM_TEST(ALC_MIX_CALLBACKS);
+    ENUM_TEST(ALC_MIX_TIME_NS);
+    ENUM_TEST(ALC_MIX_TIME_AVG_NS);
+    ENUM_TEST(ALC_MIX_TIME_MAX_NS);
+    ENUM_TEST(ALC_MIX_TIME_TOTAL_NS);
+    ENUM_TEST(ALC_MIX_VOICES);
+    ENUM_TEST(ALC_MIX_VOICES_RESAMPLED);
+    ENUM_TEST(ALC_MIX_VOICES_PITCH_SHIFTED);
+    ENUM_TEST(ALC_MIX_SOURCE_LOCKS);
+    ENUM_TEST(ALC_MIX_GAINS_TIME_NS);
+    ENUM_TEST(ALC_MIX_BUDGET_NS);
+    ENUM_TEST(ALC_MIX_OVERRUNS);
+    ENUM_TEST(ALC_MIX_LATE_CALLBACKS);
+    ENUM_TEST(ALC_MIX_BUDGET_HISTOGRAM);
+    ENUM_TEST(ALC_MIX_VOICES_VIRTUAL);
+    ENUM_TEST(ALC_MIX_QUALITY);
     #undef ENUM_TEST
 
     set_alc_error(device, ALC_INVALID_VALUE);
@@ -2576,7 +5858,151 @@ static void _alcGetIntegerv(ALCdevice *device, const ALCenum param, const ALCsiz
     set_alc_error(device, ALC_INVALID_ENUM);
     *values = 0;
 }
-ENTRYPOINTVOID(alcGetIntegerv,(ALCdevice *device, ALCenum param, ALCsizei size, ALCint *values),(device,param,size,values))
+
+/* ALC_EXT_MIXER_STATS queries. Returns ALC_FALSE if (param) isn't one of ours.
+   (size) must be > 0. ALC_MIX_BUDGET_HISTOGRAM fills in all the buckets, the rest are one value.
+   no api lock; this takes a consistent snapshot without ever blocking the mixer. */
+static ALCboolean get_mixer_stat(ALCdevice *device, const ALCenum param, const ALCsizei size, ALCint64SOFT *values)
+{
+    ALCint64SOFT *value = values;
+    MixerStats stats;
+    int sequence;
+    int i;
+
+    switch (param) {
+        case ALC_MIX_CALLBACKS:
+        case ALC_MIX_TIME_NS:
+        case ALC_MIX_TIME_AVG_NS:
+        case ALC_MIX_TIME_MAX_NS:
+        case ALC_MIX_TIME_TOTAL_NS:
+        case ALC_MIX_VOICES:
+        case ALC_MIX_VOICES_RESAMPLED:
+        case ALC_MIX_VOICES_PITCH_SHIFTED:
+        case ALC_MIX_SOURCE_LOCKS:
+        case ALC_MIX_GAINS_TIME_NS:
+        case ALC_MIX_BUDGET_NS:
+        case ALC_MIX_OVERRUNS:
+        case ALC_MIX_LATE_CALLBACKS:
+        case ALC_MIX_BUDGET_HISTOGRAM:
+        case ALC_MIX_VOICES_VIRTUAL:
+        case ALC_MIX_QUALITY:
+            break;
+        default:
+            return ALC_FALSE;
+    }
+
+    if (!device || device->iscapture) {
+        set_alc_error(device, ALC_INVALID_DEVICE);
+        *value = 0;
+        return ALC_TRUE;
+    } else if ((param == ALC_MIX_BUDGET_HISTOGRAM) && (size < ALC_MIX_BUDGET_HISTOGRAM_BUCKETS)) {
+        set_alc_error(device, ALC_INVALID_VALUE);
+        *value = 0;
+        return ALC_TRUE;
+    }
+
+    do {  /* the mixer only holds the sequence odd for a few stores, so this won't spin long. */
+        sequence = SDL_AtomicGet(&device->playback.stats.sequence);
+        SDL_memcpy(&stats, &device->playback.stats, sizeof (stats));
+    } while ((sequence & 1) || (SDL_AtomicGet(&device->playback.stats.sequence) != sequence));
+
+    switch (param) {
+        case ALC_MIX_CALLBACKS: *value = (ALCint64SOFT) stats.callbacks; break;
+        case ALC_MIX_TIME_NS: *value = (ALCint64SOFT) stats.last_ns; break;
+        case ALC_MIX_TIME_AVG_NS: *value = stats.callbacks ? (ALCint64SOFT) (stats.total_ns / stats.callbacks) : 0; break;
+        case ALC_MIX_TIME_MAX_NS: *value = (ALCint64SOFT) stats.max_ns; break;
+        case ALC_MIX_TIME_TOTAL_NS: *value = (ALCint64SOFT) stats.total_ns; break;
+        case ALC_MIX_VOICES: *value = stats.voices; break;
+        case ALC_MIX_VOICES_RESAMPLED: *value = stats.voices_resampled; break;
+        case ALC_MIX_VOICES_PITCH_SHIFTED: *value = stats.voices_pitch_shifted; break;
+        case ALC_MIX_SOURCE_LOCKS: *value = (ALCint64SOFT) SDL_AtomicGet(&device->playback.source_locks); break;  /* only when the command ring fills up now; see the locking notes. */
+        case ALC_MIX_GAINS_TIME_NS: *value = (ALCint64SOFT) stats.gains_ns; break;
+        case ALC_MIX_BUDGET_NS: *value = (ALCint64SOFT) stats.budget_ns; break;
+        case ALC_MIX_OVERRUNS: *value = (ALCint64SOFT) stats.overruns; break;
+        case ALC_MIX_LATE_CALLBACKS: *value = (ALCint64SOFT) stats.late_callbacks; break;
+        case ALC_MIX_VOICES_VIRTUAL: *value = stats.voices_virtual; break;
+        case ALC_MIX_QUALITY: *value = stats.quality; break;
+        case ALC_MIX_BUDGET_HISTOGRAM:
+            for (i = 0; i < ALC_MIX_BUDGET_HISTOGRAM_BUCKETS; i++) {
+                values[i] = (ALCint64SOFT) stats.histogram[i];
+            }
+            break;
+        default: SDL_assert(!"missing mixer stat"); *value = 0; break;
+    }
+
+    return ALC_TRUE;
+}
+
+/* no api lock for mixer stats, so telemetry can poll them from any thread cheaply. */
+void alcGetIntegerv(ALCdevice *device, ALCenum param, ALCsizei size, ALCint *values)
+{
+    ALCint64SOFT stat[ALC_MIX_BUDGET_HISTOGRAM_BUCKETS];
+    SDL_mutex *lock;
+    ALCsizei i;
+
+    if (size && values && get_mixer_stat(device, param, SDL_min(size, (ALCsizei) SDL_arraysize(stat)), stat)) {
+        const ALCsizei count = (param == ALC_MIX_BUDGET_HISTOGRAM) ? ALC_MIX_BUDGET_HISTOGRAM_BUCKETS : 1;
+        for (i = 0; (i < count) && (i < size); i++) {
+            values[i] = (ALCint) SDL_min(stat[i], (ALCint64SOFT) SDL_MAX_SINT32);  /* the totals can outgrow this; use alcGetInteger64v for those. */
+        }
+        return;
+    }
+
+    lock = grab_device_api_lock_traced(device, "alcGetIntegerv");
+    _alcGetIntegerv(device, param, size, values);
+    ungrab_device_api_lock_traced(lock, "alcGetIntegerv");
+}
+
+/* no api lock for mixer stats. Everything else is an alcGetIntegerv() query, widened. */
+void alcGetInteger64v(ALCdevice *device, ALCenum param, ALCsizei size, ALCint64SOFT *values)
+{
+    ALCint stackvalues[16];
+    ALCint *ivalues = stackvalues;
+    SDL_mutex *lock;
+    ALCsizei i;
+
+    if (!size || !values) {
+        return;  /* "A NULL destination or a zero size parameter will cause ALC to ignore the query." */
+    } else if (get_mixer_stat(device, param, size, values)) {
+        return;
+    }
+
+    SDL_zero(stackvalues);
+    if (size > (ALCsizei) SDL_arraysize(stackvalues)) {
+        ivalues = (ALCint *) SDL_calloc(size, sizeof (ALCint));
+        if (!ivalues) {
+            set_alc_error(device, ALC_OUT_OF_MEMORY);
+            return;
+        }
+    }
+
+    lock = grab_device_api_lock_traced(device, "alcGetInteger64v");
+    _alcGetIntegerv(device, param, size, ivalues);
+    ungrab_device_api_lock_traced(lock, "alcGetInteger64v");
+
+    for (i = 0; i < size; i++) {
+        values[i] = (ALCint64SOFT) ivalues[i];
+    }
+
+    if (ivalues != stackvalues) {
+        SDL_free(ivalues);
+    }
+}
+
+/* The callback runs on the mixer thread, right after a callback misses its deadline, with the mixer locked; it must be quick! */
+static void _alcMixDeadlineCallback(ALCdevice *device, ALCMIXDEADLINEPROC callback, void *userdata)
+{
+    if (!device || device->iscapture) {
+        set_alc_error(device, ALC_INVALID_DEVICE);
+        return;
+    }
+
+    lock_mixer(device);
+    device->playback.deadline_callback = callback;
+    device->playback.deadline_userdata = userdata;
+    unlock_mixer(device);
+}
+DEVICE_ENTRYPOINTVOID(alcMixDeadlineCallback,(ALCdevice *device, ALCMIXDEADLINEPROC callback, void *userdata),(device,callback,userdata),device)
 
 
 /* audio callback for capture devices just needs to move data into our
@@ -2642,6 +6068,7 @@ ALCdevice *alcCaptureOpenDevice(const ALCchar *devicename, ALCuint frequency, AL
     }
 
     if (!ringbuf) {
+        destroy_device_api_lock(device);
         SDL_free(device->name);
         SDL_free(device);
         SDL_QuitSubSystem(SDL_INIT_AUDIO);
@@ -2655,6 +6082,7 @@ ALCdevice *alcCaptureOpenDevice(const ALCchar *devicename, ALCuint frequency, AL
     device->sdldevice = SDL_OpenAudioDevice(sdldevname, 1, &desired, NULL, 0);
     if (!device->sdldevice) {
         SDL_free(ringbuf);
+        destroy_device_api_lock(device);
         SDL_free(device->name);
         SDL_free(device);
         SDL_QuitSubSystem(SDL_INIT_AUDIO);
@@ -2676,6 +6104,7 @@ ALCboolean alcCaptureCloseDevice(ALCdevice *device)
     }
 
     SDL_free(device->capture.ring.buffer);
+    destroy_device_api_lock(device);
     SDL_free(device->name);
     SDL_free(device);
     SDL_QuitSubSystem(SDL_INIT_AUDIO);
@@ -2696,7 +6125,7 @@ static void _alcCaptureStart(ALCdevice *device)
         SDL_PauseAudioDevice(device->sdldevice, 0);
     }
 }
-ENTRYPOINTVOID(alcCaptureStart,(ALCdevice *device),(device))
+DEVICE_ENTRYPOINTVOID(alcCaptureStart,(ALCdevice *device),(device),device)
 
 static void _alcCaptureStop(ALCdevice *device)
 {
@@ -2704,7 +6133,7 @@ static void _alcCaptureStop(ALCdevice *device)
         SDL_PauseAudioDevice(device->sdldevice, 1);
     }
 }
-ENTRYPOINTVOID(alcCaptureStop,(ALCdevice *device),(device))
+DEVICE_ENTRYPOINTVOID(alcCaptureStop,(ALCdevice *device),(device),device)
 
 static void _alcCaptureSamples(ALCdevice *device, ALCvoid *buffer, const ALCsizei samples)
 {
@@ -2725,12 +6154,12 @@ static void _alcCaptureSamples(ALCdevice *device, ALCvoid *buffer, const ALCsize
     ring_buffer_get(&device->capture.ring, buffer, requested_bytes);
     SDL_UnlockAudioDevice(device->sdldevice);
 }
-ENTRYPOINTVOID(alcCaptureSamples,(ALCdevice *device, ALCvoid *buffer, ALCsizei samples),(device,buffer,samples))
+DEVICE_ENTRYPOINTVOID(alcCaptureSamples,(ALCdevice *device, ALCvoid *buffer, ALCsizei samples),(device,buffer,samples),device)
 
 
 /* AL implementation... */
 
-static ALenum null_context_error = AL_NO_ERROR;
+static ALenum null_context_error = AL_NO_ERROR;  /* calls with no current context hold the global api lock. */
 
 static void set_al_error(ALCcontext *ctx, const ALenum error)
 {
@@ -2742,10 +6171,16 @@ static void set_al_error(ALCcontext *ctx, const ALenum error)
 }
 
 /* !!! FIXME: buffers and sources use almost identical code for blocks */
+static SDL_INLINE ALboolean source_name_matches(const ALuint name, const int generation)
+{
+    return ((generation & 1) && (source_name_tag(generation) == (name & ~SOURCE_NAME_INDEX_MASK))) ? AL_TRUE : AL_FALSE;
+}
+
 static ALsource *get_source(ALCcontext *ctx, const ALuint name, SourceBlock **_block)
 {
-    const ALsizei blockidx = (((ALsizei) name) - 1) / OPENAL_SOURCE_BLOCK_SIZE;
-    const ALsizei block_offset = (((ALsizei) name) - 1) % OPENAL_SOURCE_BLOCK_SIZE;
+    const ALsizei index = (ALsizei) (name & SOURCE_NAME_INDEX_MASK);
+    const ALsizei blockidx = (index - 1) / OPENAL_SOURCE_BLOCK_SIZE;
+    const ALsizei block_offset = (index - 1) % OPENAL_SOURCE_BLOCK_SIZE;
     ALsource *source;
     SourceBlock *block;
 
@@ -2755,7 +6190,7 @@ static ALsource *get_source(ALCcontext *ctx, const ALuint name, SourceBlock **_b
         set_al_error(ctx, AL_INVALID_OPERATION);
         if (_block) *_block = NULL;
         return NULL;
-    } else if ((name == 0) || (blockidx >= ctx->num_source_blocks)) {
+    } else if ((index == 0) || (blockidx >= ctx->num_source_blocks)) {
         set_al_error(ctx, AL_INVALID_NAME);
         if (_block) *_block = NULL;
         return NULL;
@@ -2763,7 +6198,7 @@ static ALsource *get_source(ALCcontext *ctx, const ALuint name, SourceBlock **_b
 
     block = ctx->source_blocks[blockidx];
     source = &block->sources[block_offset];
-    if (source->allocated) {
+    if (source->allocated && source_name_matches(name, SDL_AtomicGet(&source->generation))) {
         if (_block) *_block = block;
         return source;
     }
@@ -2805,9 +6240,8 @@ static ALbuffer *get_buffer(ALCcontext *ctx, const ALuint name, BufferBlock **_b
     return NULL;
 }
 
-static void _alDopplerFactor(const ALfloat value)
+static void _alDopplerFactor(ALCcontext *ctx, const ALfloat value)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
     } else if (value < 0.0f) {
@@ -2817,11 +6251,10 @@ static void _alDopplerFactor(const ALfloat value)
         context_needs_recalc(ctx);
     }
 }
-ENTRYPOINTVOID(alDopplerFactor,(ALfloat value),(value))
+ENTRYPOINTVOID(alDopplerFactor,(ALfloat value),(ctx,value))
 
-static void _alDopplerVelocity(const ALfloat value)
+static void _alDopplerVelocity(ALCcontext *ctx, const ALfloat value)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
     } else if (value < 0.0f) {
@@ -2831,11 +6264,10 @@ static void _alDopplerVelocity(const ALfloat value)
         context_needs_recalc(ctx);
     }
 }
-ENTRYPOINTVOID(alDopplerVelocity,(ALfloat value),(value))
+ENTRYPOINTVOID(alDopplerVelocity,(ALfloat value),(ctx,value))
 
-static void _alSpeedOfSound(const ALfloat value)
+static void _alSpeedOfSound(ALCcontext *ctx, const ALfloat value)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
     } else if (value < 0.0f) {
@@ -2845,11 +6277,10 @@ static void _alSpeedOfSound(const ALfloat value)
         context_needs_recalc(ctx);
     }
 }
-ENTRYPOINTVOID(alSpeedOfSound,(ALfloat value),(value))
+ENTRYPOINTVOID(alSpeedOfSound,(ALfloat value),(ctx,value))
 
-static void _alDistanceModel(const ALenum model)
+static void _alDistanceModel(ALCcontext *ctx, const ALenum model)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
         return;
@@ -2870,31 +6301,51 @@ static void _alDistanceModel(const ALenum model)
     }
     set_al_error(ctx, AL_INVALID_ENUM);
 }
-ENTRYPOINTVOID(alDistanceModel,(ALenum model),(model))
+ENTRYPOINTVOID(alDistanceModel,(ALenum model),(ctx,model))
+
+static void _alDeferUpdatesSOFT(ALCcontext *ctx)
+{
+    if (!ctx) {
+        set_al_error(ctx, AL_INVALID_OPERATION);
+        return;
+    }
+    set_context_deferring(ctx, 1);
+}
+ENTRYPOINTVOID(alDeferUpdatesSOFT,(void),(ctx))
 
+static void _alProcessUpdatesSOFT(ALCcontext *ctx)
+{
+    if (!ctx) {
+        set_al_error(ctx, AL_INVALID_OPERATION);
+        return;
+    }
+    set_context_deferring(ctx, 0);  /* everything flagged during the batch gets recalculated on the next mix. */
+}
+ENTRYPOINTVOID(alProcessUpdatesSOFT,(void),(ctx))
 
-static void _alEnable(const ALenum capability)
+
+static void _alEnable(ALCcontext *ctx, const ALenum capability)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
 }
-ENTRYPOINTVOID(alEnable,(ALenum capability),(capability))
+ENTRYPOINTVOID(alEnable,(ALenum capability),(ctx,capability))
 
 
-static void _alDisable(const ALenum capability)
+static void _alDisable(ALCcontext *ctx, const ALenum capability)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
 }
-ENTRYPOINTVOID(alDisable,(ALenum capability),(capability))
+ENTRYPOINTVOID(alDisable,(ALenum capability),(ctx,capability))
 
 
-static ALboolean _alIsEnabled(const ALenum capability)
+static ALboolean _alIsEnabled(ALCcontext *ctx, const ALenum capability)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
     return AL_FALSE;
 }
-ENTRYPOINT(ALboolean,alIsEnabled,(ALenum capability),(capability))
+ENTRYPOINT(ALboolean,alIsEnabled,(ALenum capability),(ctx,capability))
 
-static const ALchar *_alGetString(const ALenum param)
+static const ALchar *_alGetString(ALCcontext *ctx, const ALenum param)
 {
     switch (param) {
         case AL_EXTENSIONS: {
@@ -2918,15 +6369,14 @@ static const ALchar *_alGetString(const ALenum param)
     }
 
     FIXME("other enums that should report as strings?");
-    set_al_error(get_current_context(), AL_INVALID_ENUM);
+    set_al_error(ctx, AL_INVALID_ENUM);
 
     return NULL;
 }
-ENTRYPOINT(const ALchar *,alGetString,(const ALenum param),(param))
+ENTRYPOINT(const ALchar *,alGetString,(const ALenum param),(ctx,param))
 
-static void _alGetBooleanv(const ALenum param, ALboolean *values)
+static void _alGetBooleanv(ALCcontext *ctx, const ALenum param, ALboolean *values)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
         return;
@@ -2934,14 +6384,15 @@ static void _alGetBooleanv(const ALenum param, ALboolean *values)
 
     if (!values) return;  /* legal no-op */
 
-    /* nothing in core OpenAL 1.1 uses this */
-    set_al_error(ctx, AL_INVALID_ENUM);
+    switch (param) {
+        case AL_DEFERRED_UPDATES_SOFT: *values = SDL_AtomicGet(&ctx->deferring) ? AL_TRUE : AL_FALSE; break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;  /* nothing in core OpenAL 1.1 uses this */
+    }
 }
-ENTRYPOINTVOID(alGetBooleanv,(ALenum param, ALboolean *values),(param,values))
+ENTRYPOINTVOID(alGetBooleanv,(ALenum param, ALboolean *values),(ctx,param,values))
 
-static void _alGetIntegerv(const ALenum param, ALint *values)
+static void _alGetIntegerv(ALCcontext *ctx, const ALenum param, ALint *values)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
         return;
@@ -2951,14 +6402,14 @@ static void _alGetIntegerv(const ALenum param, ALint *values)
 
     switch (param) {
         case AL_DISTANCE_MODEL: *values = (ALint) ctx->distance_model; break;
+        case AL_DEFERRED_UPDATES_SOFT: *values = (ALint) SDL_AtomicGet(&ctx->deferring); break;
         default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetIntegerv,(ALenum param, ALint *values),(param,values))
+ENTRYPOINTVOID(alGetIntegerv,(ALenum param, ALint *values),(ctx,param,values))
 
-static void _alGetFloatv(const ALenum param, ALfloat *values)
+static void _alGetFloatv(ALCcontext *ctx, const ALenum param, ALfloat *values)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
         return;
@@ -2973,11 +6424,10 @@ static void _alGetFloatv(const ALenum param, ALfloat *values)
         default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetFloatv,(ALenum param, ALfloat *values),(param,values))
+ENTRYPOINTVOID(alGetFloatv,(ALenum param, ALfloat *values),(ctx,param,values))
 
-static void _alGetDoublev(const ALenum param, ALdouble *values)
+static void _alGetDoublev(ALCcontext *ctx, const ALenum param, ALdouble *values)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
         return;
@@ -2988,7 +6438,7 @@ static void _alGetDoublev(const ALenum param, ALdouble *values)
     /* nothing in core OpenAL 1.1 uses this */
     set_al_error(ctx, AL_INVALID_ENUM);
 }
-ENTRYPOINTVOID(alGetDoublev,(ALenum param, ALdouble *values),(param,values))
+ENTRYPOINTVOID(alGetDoublev,(ALenum param, ALdouble *values),(ctx,param,values))
 
 /* no api lock; just passes through to the real api */
 ALboolean alGetBoolean(ALenum param)
@@ -3022,15 +6472,14 @@ ALdouble alGetDouble(ALenum param)
     return retval;
 }
 
-static ALenum _alGetError(void)
+static ALenum _alGetError(ALCcontext *ctx)
 {
-    ALCcontext *ctx = get_current_context();
     ALenum *perr = ctx ? &ctx->error : &null_context_error;
     const ALenum retval = *perr;
     *perr = AL_NO_ERROR;
     return retval;
 }
-ENTRYPOINT(ALenum,alGetError,(void),())
+ENTRYPOINT(ALenum,alGetError,(void),(ctx))
 
 /* no api lock; immutable (unless we start having contexts with different extensions) */
 ALboolean alIsExtensionPresent(const ALchar *extname)
@@ -3041,9 +6490,8 @@ ALboolean alIsExtensionPresent(const ALchar *extname)
     return AL_FALSE;
 }
 
-static void *_alGetProcAddress(const ALchar *funcname)
+static void *_alGetProcAddress(ALCcontext *ctx, const ALchar *funcname)
 {
-    ALCcontext *ctx = get_current_context();
     FIXME("fail if ctx == NULL?");
     if (!funcname) {
         set_al_error(ctx, AL_INVALID_VALUE);
@@ -3112,6 +6560,15 @@ static void *_alGetProcAddress(const ALchar *funcname)
     FN_TEST(alDeleteBuffers);
     FN_TEST(alIsBuffer);
     FN_TEST(alBufferData);
+    FN_TEST(alBufferDataStatic);
+    FN_TEST(alLoadSoundBank);
+    FN_TEST(alTracePushScope);
+    FN_TEST(alTracePopScope);
+    FN_TEST(alTraceMessage);
+    FN_TEST(alTraceBufferLabel);
+    FN_TEST(alTraceSourceLabel);
+    FN_TEST(alDeferUpdatesSOFT);
+    FN_TEST(alProcessUpdatesSOFT);
     FN_TEST(alBufferf);
     FN_TEST(alBuffer3f);
     FN_TEST(alBufferfv);
@@ -3129,11 +6586,10 @@ static void *_alGetProcAddress(const ALchar *funcname)
     set_al_error(ctx, ALC_INVALID_VALUE);
     return NULL;
 }
-ENTRYPOINT(void *,alGetProcAddress,(const ALchar *funcname),(funcname))
+ENTRYPOINT(void *,alGetProcAddress,(const ALchar *funcname),(ctx,funcname))
 
-static ALenum _alGetEnumValue(const ALchar *enumname)
+static ALenum _alGetEnumValue(ALCcontext *ctx, const ALchar *enumname)
 {
-    ALCcontext *ctx = get_current_context();
     FIXME("fail if ctx == NULL?");
     if (!enumname) {
         set_al_error(ctx, AL_INVALID_VALUE);
@@ -3208,16 +6664,23 @@ static ALenum _alGetEnumValue(const ALchar *enumname)
     ENUM_TEST(AL_EXPONENT_DISTANCE_CLAMPED);
     ENUM_TEST(AL_FORMAT_MONO_FLOAT32);
     ENUM_TEST(AL_FORMAT_STEREO_FLOAT32);
+    ENUM_TEST(AL_FORMAT_MONO_IMA4);
+    ENUM_TEST(AL_FORMAT_STEREO_IMA4);
+    ENUM_TEST(AL_FORMAT_MONO_MSADPCM_SOFT);
+    ENUM_TEST(AL_FORMAT_STEREO_MSADPCM_SOFT);
+    ENUM_TEST(AL_UNPACK_BLOCK_ALIGNMENT_SOFT);
+    ENUM_TEST(AL_PITCH_PRESERVE_DURATION);
+    ENUM_TEST(AL_SOURCE_PRIORITY);
+    ENUM_TEST(AL_DEFERRED_UPDATES_SOFT);
     #undef ENUM_TEST
 
     set_al_error(ctx, AL_INVALID_VALUE);
     return AL_NONE;
 }
-ENTRYPOINT(ALenum,alGetEnumValue,(const ALchar *enumname),(enumname))
+ENTRYPOINT(ALenum,alGetEnumValue,(const ALchar *enumname),(ctx,enumname))
 
-static void _alListenerfv(const ALenum param, const ALfloat *values)
+static void _alListenerfv(ALCcontext *ctx, const ALenum param, const ALfloat *values)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
     } else if (!values) {
@@ -3253,34 +6716,33 @@ static void _alListenerfv(const ALenum param, const ALfloat *values)
         }
     }
 }
-ENTRYPOINTVOID(alListenerfv,(ALenum param, const ALfloat *values),(param,values))
+ENTRYPOINTVOID(alListenerfv,(ALenum param, const ALfloat *values),(ctx,param,values))
 
-static void _alListenerf(const ALenum param, const ALfloat value)
+static void _alListenerf(ALCcontext *ctx, const ALenum param, const ALfloat value)
 {
     switch (param) {
-        case AL_GAIN: _alListenerfv(param, &value); break;
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        case AL_GAIN: _alListenerfv(ctx, param, &value); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alListenerf,(ALenum param, ALfloat value),(param,value))
+ENTRYPOINTVOID(alListenerf,(ALenum param, ALfloat value),(ctx,param,value))
 
-static void _alListener3f(const ALenum param, const ALfloat value1, const ALfloat value2, const ALfloat value3)
+static void _alListener3f(ALCcontext *ctx, const ALenum param, const ALfloat value1, const ALfloat value2, const ALfloat value3)
 {
     switch (param) {
         case AL_POSITION:
         case AL_VELOCITY: {
             const ALfloat values[3] = { value1, value2, value3 };
-            _alListenerfv(param, values);
+            _alListenerfv(ctx, param, values);
             break;
         }
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alListener3f,(ALenum param, ALfloat value1, ALfloat value2, ALfloat value3),(param,value1,value2,value3))
+ENTRYPOINTVOID(alListener3f,(ALenum param, ALfloat value1, ALfloat value2, ALfloat value3),(ctx,param,value1,value2,value3))
 
-static void _alListeneriv(const ALenum param, const ALint *values)
+static void _alListeneriv(ALCcontext *ctx, const ALenum param, const ALint *values)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
     } else if (!values) {
@@ -3321,33 +6783,32 @@ static void _alListeneriv(const ALenum param, const ALint *values)
         }
     }
 }
-ENTRYPOINTVOID(alListeneriv,(ALenum param, const ALint *values),(param,values))
+ENTRYPOINTVOID(alListeneriv,(ALenum param, const ALint *values),(ctx,param,values))
 
-static void _alListeneri(const ALenum param, const ALint value)
+static void _alListeneri(ALCcontext *ctx, const ALenum param, const ALint value)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in AL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in AL 1.1 uses this */
 }
-ENTRYPOINTVOID(alListeneri,(ALenum param, ALint value),(param,value))
+ENTRYPOINTVOID(alListeneri,(ALenum param, ALint value),(ctx,param,value))
 
-static void _alListener3i(const ALenum param, const ALint value1, const ALint value2, const ALint value3)
+static void _alListener3i(ALCcontext *ctx, const ALenum param, const ALint value1, const ALint value2, const ALint value3)
 {
     switch (param) {
         case AL_POSITION:
         case AL_VELOCITY: {
             const ALint values[3] = { value1, value2, value3 };
-            _alListeneriv(param, values);
+            _alListeneriv(ctx, param, values);
             break;
         }
         default:
-            set_al_error(get_current_context(), AL_INVALID_ENUM);
+            set_al_error(ctx, AL_INVALID_ENUM);
             break;
     }
 }
-ENTRYPOINTVOID(alListener3i,(ALenum param, ALint value1, ALint value2, ALint value3),(param,value1,value2,value3))
+ENTRYPOINTVOID(alListener3i,(ALenum param, ALint value1, ALint value2, ALint value3),(ctx,param,value1,value2,value3))
 
-static void _alGetListenerfv(const ALenum param, ALfloat *values)
+static void _alGetListenerfv(ALCcontext *ctx, const ALenum param, ALfloat *values)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
         return;
@@ -3376,45 +6837,44 @@ static void _alGetListenerfv(const ALenum param, ALfloat *values)
         default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetListenerfv,(ALenum param, ALfloat *values),(param,values))
+ENTRYPOINTVOID(alGetListenerfv,(ALenum param, ALfloat *values),(ctx,param,values))
 
-static void _alGetListenerf(const ALenum param, ALfloat *value)
+static void _alGetListenerf(ALCcontext *ctx, const ALenum param, ALfloat *value)
 {
     switch (param) {
-        case AL_GAIN: _alGetListenerfv(param, value); break;
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        case AL_GAIN: _alGetListenerfv(ctx, param, value); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetListenerf,(ALenum param, ALfloat *value),(param,value))
+ENTRYPOINTVOID(alGetListenerf,(ALenum param, ALfloat *value),(ctx,param,value))
 
 
-static void _alGetListener3f(const ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
+static void _alGetListener3f(ALCcontext *ctx, const ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
 {
     ALfloat values[3];
     switch (param) {
         case AL_POSITION:
         case AL_VELOCITY:
-            _alGetListenerfv(param, values);
+            _alGetListenerfv(ctx, param, values);
             if (value1) *value1 = values[0];
             if (value2) *value2 = values[1];
             if (value3) *value3 = values[2];
             break;
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetListener3f,(ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3),(param,value1,value2,value3))
+ENTRYPOINTVOID(alGetListener3f,(ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3),(ctx,param,value1,value2,value3))
 
 
-static void _alGetListeneri(const ALenum param, ALint *value)
+static void _alGetListeneri(ALCcontext *ctx, const ALenum param, ALint *value)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in AL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in AL 1.1 uses this */
 }
-ENTRYPOINTVOID(alGetListeneri,(ALenum param, ALint *value),(param,value))
+ENTRYPOINTVOID(alGetListeneri,(ALenum param, ALint *value),(ctx,param,value))
 
 
-static void _alGetListeneriv(const ALenum param, ALint *values)
+static void _alGetListeneriv(ALCcontext *ctx, const ALenum param, ALint *values)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
         return;
@@ -3447,141 +6907,166 @@ static void _alGetListeneriv(const ALenum param, ALint *values)
         default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetListeneriv,(ALenum param, ALint *values),(param,values))
+ENTRYPOINTVOID(alGetListeneriv,(ALenum param, ALint *values),(ctx,param,values))
 
-static void _alGetListener3i(const ALenum param, ALint *value1, ALint *value2, ALint *value3)
+static void _alGetListener3i(ALCcontext *ctx, const ALenum param, ALint *value1, ALint *value2, ALint *value3)
 {
     ALint values[3];
     switch (param) {
         case AL_POSITION:
         case AL_VELOCITY:
-            _alGetListeneriv(param, values);
+            _alGetListeneriv(ctx, param, values);
             if (value1) *value1 = values[0];
             if (value2) *value2 = values[1];
             if (value3) *value3 = values[2];
             break;
 
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetListener3i,(ALenum param, ALint *value1, ALint *value2, ALint *value3),(param,value1,value2,value3))
+ENTRYPOINTVOID(alGetListener3i,(ALenum param, ALint *value1, ALint *value2, ALint *value3),(ctx,param,value1,value2,value3))
 
 /* !!! FIXME: buffers and sources use almost identical code for blocks */
-static void _alGenSources(const ALsizei n, ALuint *names)
-{
-    ALCcontext *ctx = get_current_context();
-    ALboolean out_of_memory = AL_FALSE;
-    ALsizei totalblocks;
-    ALsource *stackobjs[16];
-    ALsource **objects = stackobjs;
-    ALsizei found = 0;
-    ALsizei block_offset = 0;
-    ALsizei blocki;
+/* (tail) is the end of ctx->free_sources; the new sources go there, so names come off the list in order. Returns the new end, NULL on failure. */
+static ALsource **add_source_block(ALCcontext *ctx, ALsource **tail)
+{
+    /* lockless getters might be reading ctx->source_blocks right now, so
+       when it's full, build a bigger table and retire the old one instead of
+       reallocating it. Capacity doubles, so the retired tables add up to less
+       than the live one. */
+    const ALsizei totalblocks = ctx->num_source_blocks;
+    const ALboolean grow = (totalblocks == ctx->source_blocks_capacity);
+    const ALsizei capacity = grow ? SDL_max(ctx->source_blocks_capacity * 2, 16) : ctx->source_blocks_capacity;
+    RetiredSourceBlocks *retired = NULL;
+    SourceBlock **table = ctx->source_blocks;
+    SourceBlock *block;
     ALsizei i;
 
-    if (!ctx) {
-        set_al_error(ctx, AL_INVALID_OPERATION);
-        return;
+    if (((totalblocks + 1) * OPENAL_SOURCE_BLOCK_SIZE) > SOURCE_NAME_INDEX_MASK) {
+        return NULL;  /* out of names. */
     }
 
-    if (n <= SDL_arraysize(stackobjs)) {
-        SDL_memset(stackobjs, '\0', sizeof (ALsource *) * n);
-    } else {
-        objects = (ALsource **) SDL_calloc(n, sizeof (ALsource *));
-        if (!objects) {
-            set_al_error(ctx, AL_OUT_OF_MEMORY);
-            return;
+    if (grow) {
+        table = (SourceBlock **) SDL_malloc(sizeof (SourceBlock *) * capacity);
+        retired = ctx->source_blocks ? (RetiredSourceBlocks *) SDL_malloc(sizeof (RetiredSourceBlocks)) : NULL;
+        if (!table || (ctx->source_blocks && !retired)) {
+            SDL_free(table);
+            SDL_free(retired);
+            return NULL;
         }
     }
 
-    totalblocks = ctx->num_source_blocks;
-    for (blocki = 0; blocki < totalblocks; blocki++) {
-        SourceBlock *block = ctx->source_blocks[blocki];
-        block->tmp = 0;
-        if (block->used < SDL_arraysize(block->sources)) {  /* skip if full */
-            for (i = 0; i < SDL_arraysize(block->sources); i++) {
-                /* if a playing source was deleted, it will still be marked mixer_accessible
-                    until the mixer thread shuffles it out. Until then, the source isn't
-                    available for reuse. */
-                if (!block->sources[i].allocated && !SDL_AtomicGet(&block->sources[i].mixer_accessible)) {
-                    block->tmp++;
-                    objects[found] = &block->sources[i];
-                    names[found++] = (i + block_offset) + 1;  /* +1 so it isn't zero. */
-                    if (found == n) {
-                        break;
-                    }
-                }
-            }
-
-            if (found == n) {
-                break;
-            }
+    block = (SourceBlock *) calloc_simd_aligned(sizeof (SourceBlock));
+    if (!block) {
+        if (grow) {
+            SDL_free(table);
+            SDL_free(retired);
         }
+        return NULL;
+    }
+
+    for (i = 0; i < SDL_arraysize(block->sources); i++) {
+        ALsource *src = &block->sources[i];
+        src->voice = &block->voices[i];
+        src->name = (ALuint) ((totalblocks * OPENAL_SOURCE_BLOCK_SIZE) + i + 1);  /* +1 so it isn't zero. */
+        *tail = src;
+        tail = &src->next_free;
+    }
+    ctx->num_free_sources += SDL_arraysize(block->sources);
 
-        block_offset += SDL_arraysize(block->sources);
+    if (grow && totalblocks) {
+        SDL_memcpy(table, ctx->source_blocks, sizeof (SourceBlock *) * totalblocks);
     }
+    table[totalblocks] = block;  /* lockless readers don't look past lockless_num_source_blocks, so this is safe in a live table. */
 
-    while (found < n) {  /* out of blocks? Add new ones. */
-        /* ctx->source_blocks is only accessed on the API thread under a mutex, so it's safe to realloc. */
-        void *ptr = SDL_realloc(ctx->source_blocks, sizeof (SourceBlock *) * (totalblocks + 1));
-        SourceBlock *block;
+    if (retired) {
+        retired->source_blocks = ctx->source_blocks;
+        retired->next = ctx->retired_source_blocks;
+        ctx->retired_source_blocks = retired;
+    }
 
-        if (!ptr) {
-            out_of_memory = AL_TRUE;
-            break;
-        }
-        ctx->source_blocks = (SourceBlock **) ptr;
+    if (grow) {
+        SDL_AtomicSetPtr((void **) &ctx->source_blocks, table);
+        ctx->source_blocks_capacity = capacity;
+    }
+    ctx->num_source_blocks++;
+    SDL_AtomicSet(&ctx->lockless_num_source_blocks, (int) ctx->num_source_blocks);  /* only after the table and its new slot are in place. */
+    return tail;
+}
 
-        block = (SourceBlock *) calloc_simd_aligned(sizeof (SourceBlock));
-        if (!block) {
-            out_of_memory = AL_TRUE;
-            break;
-        }
-        ctx->source_blocks[totalblocks] = block;
-        totalblocks++;
-        ctx->num_source_blocks++;
+/* Sources go on the end of the free list and come off the front, so a
+   slot waits as long as possible before it's reused. A name only carries a
+   few bits of its slot's generation, so handing the same slot right back
+   out would make a stale name valid again after a couple thousand
+   alGenSources/alDeleteSources cycles; this way, it takes that many times
+   the number of free sources. */
+static void free_source(ALCcontext *ctx, ALsource *src)
+{
+    src->next_free = NULL;
+    *ctx->free_sources_tail = src;
+    ctx->free_sources_tail = &src->next_free;
+    ctx->num_free_sources++;
+}
 
-        for (i = 0; i < SDL_arraysize(block->sources); i++) {
-            block->tmp++;
-            objects[found] = &block->sources[i];
-            names[found++] = (i + block_offset) + 1;  /* +1 so it isn't zero. */
-            if (found == n) {
-                break;
-            }
+/* move deleted sources the mixer has let go of to the free list. */
+static void reclaim_sources(ALCcontext *ctx)
+{
+    ALsource **prev = &ctx->reclaim_sources;
+    ALsource *src = *prev;
+    while (src) {
+        ALsource *next = src->next_free;
+        if (source_mixer_owned(src->voice)) {
+            prev = &src->next_free;
+        } else {
+            *prev = next;
+            free_source(ctx, src);
         }
-        block_offset += SDL_arraysize(block->sources);
+        src = next;
     }
+}
 
-    if (out_of_memory) {
-        if (objects != stackobjs) SDL_free(objects);
-        SDL_memset(names, '\0', sizeof (*names) * n);
-        set_al_error(ctx, AL_OUT_OF_MEMORY);
+static void _alGenSources(ALCcontext *ctx, const ALsizei n, ALuint *names)
+{
+    ALsizei i;
+
+    if (!ctx) {
+        set_al_error(ctx, AL_INVALID_OPERATION);
         return;
     }
 
-    SDL_assert(found == n);  /* we should have either gotten space or bailed on alloc failure */
+    /* usually the mixer let go of deleted sources long ago, but only walk them when we'd need a new block otherwise. */
+    if (ctx->num_free_sources < n) {
+        reclaim_sources(ctx);
+    }
 
-    /* update the "used" field in blocks with items we are taking now. */
-    found = 0;
-    for (blocki = 0; found < n; blocki++) {
-        SourceBlock *block = ctx->source_blocks[blocki];
-        SDL_assert(blocki < totalblocks);
-        const int foundhere = block->tmp;
-        if (foundhere) {
-            block->used += foundhere;
-            found += foundhere;
-            block->tmp = 0;
+    while (ctx->num_free_sources < n) {  /* out of sources? Add new blocks. */
+        ALsource **tail = add_source_block(ctx, ctx->free_sources_tail);
+        if (!tail) {
+            SDL_memset(names, '\0', sizeof (*names) * n);
+            set_al_error(ctx, AL_OUT_OF_MEMORY);
+            return;
         }
+        ctx->free_sources_tail = tail;
     }
 
-    SDL_assert(found == n);
-
     for (i = 0; i < n; i++) {
-        ALsource *src = objects[i];
+        ALsource *src = ctx->free_sources;
+        SourceVoice *voice = src->voice;
+        const ALuint index = src->name & SOURCE_NAME_INDEX_MASK;
+        const int generation = SDL_AtomicGet(&src->generation);
+
+        ctx->free_sources = src->next_free;
+        if (!ctx->free_sources) {
+            ctx->free_sources_tail = &ctx->free_sources;
+        }
+        ctx->num_free_sources--;
+        ctx->source_blocks[(index - 1) / OPENAL_SOURCE_BLOCK_SIZE]->used++;
 
-        /*printf("Generated source %u\n", (unsigned int) names[i]);*/
+        /*printf("Generated source %u\n", (unsigned int) index);*/
 
         SDL_assert(!src->allocated);
+        SDL_assert((generation & 1) == 0);
+        SDL_assert(!source_mixer_owned(voice));
 
         /* Make sure everything that wants to use SIMD is aligned for it. */
         SDL_assert( (((size_t) &src->position[0]) % 16) == 0 );
@@ -3589,31 +7074,35 @@ static void _alGenSources(const ALsizei n, ALuint *names)
         SDL_assert( (((size_t) &src->direction[0]) % 16) == 0 );
 
         SDL_zerop(src);
-        SDL_AtomicSet(&src->state, AL_INITIAL);
+        SDL_AtomicSet(&src->generation, generation);
+        src->voice = voice;
+        SDL_zerop(voice);
+        voice->source = src;
+        SDL_AtomicSet(&voice->state, AL_INITIAL);
         SDL_AtomicSet(&src->total_queued_buffers, 0);
+        names[i] = index | source_name_tag(generation + 1);
         src->name = names[i];
-        src->type = AL_UNDETERMINED;
-        src->recalc = AL_TRUE;
+        voice->type = AL_UNDETERMINED;
+        voice->recalc = AL_TRUE;
         src->gain = 1.0f;
         src->max_gain = 1.0f;
         src->reference_distance = 1.0f;
         src->max_distance = FLT_MAX;
         src->rolloff_factor = 1.0f;
-        src->pitch = 1.0f;
+        voice->pitch = 1.0f;
         src->cone_inner_angle = 360.0f;
         src->cone_outer_angle = 360.0f;
         source_needs_recalc(src);
         src->allocated = AL_TRUE;   /* we officially own it. */
+        SDL_AtomicIncRef(&src->generation);  /* odd now, so lockless getters accept the new name. */
     }
-
-    if (objects != stackobjs) SDL_free(objects);
 }
-ENTRYPOINTVOID(alGenSources,(ALsizei n, ALuint *names),(n,names))
+ENTRYPOINTVOID(alGenSources,(ALsizei n, ALuint *names),(ctx,n,names))
 
 
-static void _alDeleteSources(const ALsizei n, const ALuint *names)
+static void _alDeleteSources(ALCcontext *ctx, const ALsizei n, const ALuint *names)
 {
-    ALCcontext *ctx = get_current_context();
+    ALboolean mixer_owned = AL_FALSE;
     ALsizei i;
 
     if (!ctx) {
@@ -3635,6 +7124,25 @@ static void _alDeleteSources(const ALsizei n, const ALuint *names)
         }
     }
 
+    /* "A playing source can be deleted--the source will be stopped automatically and then deleted." */
+    for (i = 0; i < n; i++) {
+        const ALuint name = names[i];
+        if (name != 0) {
+            ALsource *source = get_source(ctx, name, NULL);
+            SDL_assert(source != NULL);
+            SDL_AtomicSet(&source->voice->state, AL_STOPPED);
+            if (source_mixer_owned(source->voice)) {
+                post_source_command(ctx, source->voice, AL_STOPPED, 0);  /* mixer will drop from playlist next time it sees this. */
+                mixer_owned = AL_TRUE;
+            }
+        }
+    }
+
+    if (mixer_owned) {
+        publish_source_commands(ctx);
+        wait_for_mixer(ctx->device);  /* after this, the mixer won't touch their buffers again. */
+    }
+
     for (i = 0; i < n; i++) {
         const ALuint name = names[i];
         if (name != 0) {
@@ -3642,54 +7150,67 @@ static void _alDeleteSources(const ALsizei n, const ALuint *names)
             ALsource *source = get_source(ctx, name, &block);
             SDL_assert(source != NULL);
 
-            /* "A playing source can be deleted--the source will be stopped automatically and then deleted." */
-            if (!SDL_AtomicGet(&source->mixer_accessible)) {
-                SDL_AtomicSet(&source->state, AL_STOPPED);
-            } else {
-                SDL_LockMutex(ctx->source_lock);
-                SDL_AtomicSet(&source->state, AL_STOPPED);  /* mixer will drop from playlist next time it sees this. */
-                SDL_UnlockMutex(ctx->source_lock);
-            }
+            SDL_AtomicIncRef(&source->generation);  /* even now, so lockless getters reject this name from here on. */
             source->allocated = AL_FALSE;
             source_release_buffer_queue(ctx, source);
-            if (source->buffer) {
-                SDL_assert(source->type == AL_STATIC);
-                (void) SDL_AtomicDecRef(&source->buffer->refcount);
-                source->buffer = NULL;
-            }
-            if (source->stream) {
-                SDL_FreeAudioStream(source->stream);
-                source->stream = NULL;
+            if (source->voice->buffer) {
+                SDL_assert(source->voice->type == AL_STATIC);
+                (void) SDL_AtomicDecRef(&source->voice->buffer->refcount);
+                source->voice->buffer = NULL;
             }
             block->used--;
+
+            /* the mixer might not have run the stop command yet, and can't reuse the voice until it has. */
+            if (source_mixer_owned(source->voice)) {
+                source->next_free = ctx->reclaim_sources;
+                ctx->reclaim_sources = source;
+            } else {
+                free_source(ctx, source);
+            }
         }
     }
 }
-ENTRYPOINTVOID(alDeleteSources,(ALsizei n, const ALuint *names),(n,names))
+ENTRYPOINTVOID(alDeleteSources,(ALsizei n, const ALuint *names),(ctx,n,names))
 
-static ALboolean _alIsSource(const ALuint name)
+static ALboolean _alIsSource(ALCcontext *ctx, const ALuint name)
 {
-    ALCcontext *ctx = get_current_context();
     return (ctx && (get_source(ctx, name, NULL) != NULL)) ? AL_TRUE : AL_FALSE;
 }
-ENTRYPOINT(ALboolean,alIsSource,(ALuint name),(name))
+ENTRYPOINT(ALboolean,alIsSource,(ALuint name),(ctx,name))
 
-static void source_set_pitch(ALCcontext *ctx, ALsource *src, const ALfloat pitch)
+/* only allocate pitchstate if we need the phase vocoder, because it's a lot of
+   RAM and we leave it allocated to the source until forever once needed */
+static void source_prepare_vocoder(ALCcontext *ctx, ALsource *src)
 {
-    /* only allocate pitchstate if the pitch every changes, because it's a lot of
-       RAM and we leave it allocated to the source until forever once needed */
-    if ((pitch != 1.0f) && (src->pitchstate == NULL)) {
-        src->pitchstate = (PitchState *) SDL_calloc(1, sizeof (PitchState));
-        if (src->pitchstate == NULL) {
+    if (src->voice->preserve_duration && (src->voice->pitch != 1.0f) && (src->voice->pitchstate == NULL)) {
+        grab_api_lock();  /* the tables are shared by every device, so the device lock isn't enough. */
+        init_pitch_tables();
+        ungrab_api_lock();
+        src->voice->pitchstate = (PitchState *) SDL_calloc(1, sizeof (PitchState));
+        if (src->voice->pitchstate == NULL) {
             set_al_error(ctx, AL_OUT_OF_MEMORY);
         }
     }
-    src->pitch = pitch;
 }
 
-static void _alSourcefv(const ALuint name, const ALenum param, const ALfloat *values)
+static void source_set_pitch(ALCcontext *ctx, ALsource *src, const ALfloat pitch)
+{
+    if (pitch <= 0.0f) {
+        set_al_error(ctx, AL_INVALID_VALUE);
+        return;
+    }
+    src->voice->pitch = pitch;
+    source_prepare_vocoder(ctx, src);
+}
+
+static void source_set_preserve_duration(ALCcontext *ctx, ALsource *src, const ALboolean preserve)
+{
+    src->voice->preserve_duration = preserve;
+    source_prepare_vocoder(ctx, src);
+}
+
+static void _alSourcefv(ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat *values)
 {
-    ALCcontext *ctx = get_current_context();
     ALsource *src = get_source(ctx, name, NULL);
     if (!src) return;
 
@@ -3711,7 +7232,7 @@ static void _alSourcefv(const ALuint name, const ALenum param, const ALfloat *va
         case AL_SEC_OFFSET:
         case AL_SAMPLE_OFFSET:
         case AL_BYTE_OFFSET:
-            source_set_offset(src, param, *values);
+            source_set_offset(ctx, src, param, *values);
             break;
 
         default: set_al_error(ctx, AL_INVALID_ENUM); return;
@@ -3720,9 +7241,9 @@ static void _alSourcefv(const ALuint name, const ALenum param, const ALfloat *va
 
     source_needs_recalc(src);
 }
-ENTRYPOINTVOID(alSourcefv,(ALuint name, ALenum param, const ALfloat *values),(name,param,values))
+ENTRYPOINTVOID(alSourcefv,(ALuint name, ALenum param, const ALfloat *values),(ctx,name,param,values))
 
-static void _alSourcef(const ALuint name, const ALenum param, const ALfloat value)
+static void _alSourcef(ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat value)
 {
     switch (param) {
         case AL_GAIN:
@@ -3738,32 +7259,32 @@ static void _alSourcef(const ALuint name, const ALenum param, const ALfloat valu
         case AL_SEC_OFFSET:
         case AL_SAMPLE_OFFSET:
         case AL_BYTE_OFFSET:
-            _alSourcefv(name, param, &value);
+            _alSourcefv(ctx, name, param, &value);
             break;
 
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alSourcef,(ALuint name, ALenum param, ALfloat value),(name,param,value))
+ENTRYPOINTVOID(alSourcef,(ALuint name, ALenum param, ALfloat value),(ctx,name,param,value))
 
-static void _alSource3f(const ALuint name, const ALenum param, const ALfloat value1, const ALfloat value2, const ALfloat value3)
+static void _alSource3f(ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat value1, const ALfloat value2, const ALfloat value3)
 {
     switch (param) {
         case AL_POSITION:
         case AL_VELOCITY:
         case AL_DIRECTION: {
             const ALfloat values[3] = { value1, value2, value3 };
-            _alSourcefv(name, param, values);
+            _alSourcefv(ctx, name, param, values);
             break;
         }
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alSource3f,(ALuint name, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3),(name,param,value1,value2,value3))
+ENTRYPOINTVOID(alSource3f,(ALuint name, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3),(ctx,name,param,value1,value2,value3))
 
 static void set_source_static_buffer(ALCcontext *ctx, ALsource *src, const ALuint bufname)
 {
-    const ALenum state = (const ALenum) SDL_AtomicGet(&src->state);
+    const ALenum state = source_state(src->voice);
     if ((state == AL_PLAYING) || (state == AL_PAUSED)) {
         set_al_error(ctx, AL_INVALID_OPERATION);  /* can't change buffer on playing/paused sources */
     } else {
@@ -3771,68 +7292,49 @@ static void set_source_static_buffer(ALCcontext *ctx, ALsource *src, const ALuin
         if (bufname && ((buffer = get_buffer(ctx, bufname, NULL)) == NULL)) {
             set_al_error(ctx, AL_INVALID_VALUE);
         } else {
-            const ALboolean must_lock = SDL_AtomicGet(&src->mixer_accessible) ? AL_TRUE : AL_FALSE;
-            SDL_AudioStream *stream = NULL;
-            SDL_AudioStream *freestream = NULL;
-            /* We only use the stream for resampling, not for channel conversion. */
-            FIXME("keep the existing stream if formats match?");
-            if (buffer && (ctx->device->frequency != buffer->frequency)) {
-                stream = SDL_NewAudioStream(AUDIO_F32SYS, buffer->channels, buffer->frequency, AUDIO_F32SYS, buffer->channels, ctx->device->frequency);
-                if (!stream) {
-                    set_al_error(ctx, AL_OUT_OF_MEMORY);
-                    return;
-                }
-                FIXME("need a way to prealloc space in the stream, so the mixer doesn't have to malloc");
-            }
-
-            /* this can happen if you alSource(AL_BUFFER) while the exact source is in the middle of mixing */
-            FIXME("Double-check this lock; we shouldn't be able to reach this if the source is playing.");
-            if (must_lock) {
-                SDL_LockMutex(ctx->source_lock);
+            const ALboolean mixer_owned = source_mixer_owned(src->voice);
+
+            /* It isn't playing, but the mixer might not know that yet. Make sure
+               it's done with this source before the old buffer can go away. */
+            if (mixer_owned) {
+                post_source_command(ctx, src->voice, AL_STOPPED, 0);
+                publish_source_commands(ctx);
+                wait_for_mixer(ctx->device);
             }
 
-            if (src->buffer != buffer) {
-                if (src->buffer) {
-                    (void) SDL_AtomicDecRef(&src->buffer->refcount);
+            if (src->voice->buffer != buffer) {
+                if (src->voice->buffer) {
+                    (void) SDL_AtomicDecRef(&src->voice->buffer->refcount);
                 }
                 if (buffer) {
                     SDL_AtomicIncRef(&buffer->refcount);
                 }
-                src->buffer = buffer;
+                src->voice->buffer = buffer;
             }
 
-            src->type = buffer ? AL_STATIC : AL_UNDETERMINED;
+            src->voice->type = buffer ? AL_STATIC : AL_UNDETERMINED;
             src->queue_channels = buffer ? buffer->channels : 0;
             src->queue_frequency = 0;
 
             source_release_buffer_queue(ctx, src);
-
-            if (src->stream != stream) {
-                freestream = src->stream;  /* free this after unlocking. */
-                src->stream = stream;
-            }
-
-            if (must_lock) {
-                SDL_UnlockMutex(ctx->source_lock);
-            }
-
-            if (freestream) {
-                SDL_FreeAudioStream(freestream);
+            if (!mixer_owned) {
+                source_reset_resampler(src);  /* (the stop command does this when the mixer has it.) */
             }
         }
     }
 }
 
-static void _alSourceiv(const ALuint name, const ALenum param, const ALint *values)
+static void _alSourceiv(ALCcontext *ctx, const ALuint name, const ALenum param, const ALint *values)
 {
-    ALCcontext *ctx = get_current_context();
     ALsource *src = get_source(ctx, name, NULL);
     if (!src) return;
 
     switch (param) {
         case AL_BUFFER: set_source_static_buffer(ctx, src, (ALuint) *values); break;
         case AL_SOURCE_RELATIVE: src->source_relative = *values ? AL_TRUE : AL_FALSE; break;
-        case AL_LOOPING: src->looping = *values ? AL_TRUE : AL_FALSE; break;
+        case AL_LOOPING: src->voice->looping = *values ? AL_TRUE : AL_FALSE; break;
+        case AL_PITCH_PRESERVE_DURATION: source_set_preserve_duration(ctx, src, *values ? AL_TRUE : AL_FALSE); break;
+        case AL_SOURCE_PRIORITY: src->priority = *values; break;
         case AL_REFERENCE_DISTANCE: src->reference_distance = (ALfloat) *values; break;
         case AL_ROLLOFF_FACTOR: src->rolloff_factor = (ALfloat) *values; break;
         case AL_MAX_DISTANCE: src->max_distance = (ALfloat) *values; break;
@@ -3848,7 +7350,7 @@ static void _alSourceiv(const ALuint name, const ALenum param, const ALint *valu
         case AL_SEC_OFFSET:
         case AL_SAMPLE_OFFSET:
         case AL_BYTE_OFFSET:
-            source_set_offset(src, param, (ALfloat)*values);
+            source_set_offset(ctx, src, param, (ALfloat)*values);
             break;
 
         default: set_al_error(ctx, AL_INVALID_ENUM); return;
@@ -3856,13 +7358,15 @@ static void _alSourceiv(const ALuint name, const ALenum param, const ALint *valu
 
     source_needs_recalc(src);
 }
-ENTRYPOINTVOID(alSourceiv,(ALuint name, ALenum param, const ALint *values),(name,param,values))
+ENTRYPOINTVOID(alSourceiv,(ALuint name, ALenum param, const ALint *values),(ctx,name,param,values))
 
-static void _alSourcei(const ALuint name, const ALenum param, const ALint value)
+static void _alSourcei(ALCcontext *ctx, const ALuint name, const ALenum param, const ALint value)
 {
     switch (param) {
         case AL_SOURCE_RELATIVE:
         case AL_LOOPING:
+        case AL_PITCH_PRESERVE_DURATION:
+        case AL_SOURCE_PRIORITY:
         case AL_BUFFER:
         case AL_REFERENCE_DISTANCE:
         case AL_ROLLOFF_FACTOR:
@@ -3872,29 +7376,28 @@ static void _alSourcei(const ALuint name, const ALenum param, const ALint value)
         case AL_SEC_OFFSET:
         case AL_SAMPLE_OFFSET:
         case AL_BYTE_OFFSET:
-            _alSourceiv(name, param, &value);
+            _alSourceiv(ctx, name, param, &value);
             break;
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alSourcei,(ALuint name, ALenum param, ALint value),(name,param,value))
+ENTRYPOINTVOID(alSourcei,(ALuint name, ALenum param, ALint value),(ctx,name,param,value))
 
-static void _alSource3i(const ALuint name, const ALenum param, const ALint value1, const ALint value2, const ALint value3)
+static void _alSource3i(ALCcontext *ctx, const ALuint name, const ALenum param, const ALint value1, const ALint value2, const ALint value3)
 {
     switch (param) {
         case AL_DIRECTION: {
             const ALint values[3] = { (ALint) value1, (ALint) value2, (ALint) value3 };
-            _alSourceiv(name, param, values);
+            _alSourceiv(ctx, name, param, values);
             break;
         }
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alSource3i,(ALuint name, ALenum param, ALint value1, ALint value2, ALint value3),(name,param,value1,value2,value3))
+ENTRYPOINTVOID(alSource3i,(ALuint name, ALenum param, ALint value1, ALint value2, ALint value3),(ctx,name,param,value1,value2,value3))
 
-static void _alGetSourcefv(const ALuint name, const ALenum param, ALfloat *values)
+static void _alGetSourcefv(ALCcontext *ctx, const ALuint name, const ALenum param, ALfloat *values)
 {
-    ALCcontext *ctx = get_current_context();
     ALsource *src = get_source(ctx, name, NULL);
     if (!src) return;
 
@@ -3908,7 +7411,7 @@ static void _alGetSourcefv(const ALuint name, const ALenum param, ALfloat *value
         case AL_REFERENCE_DISTANCE: *values = src->reference_distance; break;
         case AL_ROLLOFF_FACTOR: *values = src->rolloff_factor; break;
         case AL_MAX_DISTANCE: *values = src->max_distance; break;
-        case AL_PITCH: *values = src->pitch; break;
+        case AL_PITCH: *values = src->voice->pitch; break;
         case AL_CONE_INNER_ANGLE: *values = src->cone_inner_angle; break;
         case AL_CONE_OUTER_ANGLE: *values = src->cone_outer_angle; break;
         case AL_CONE_OUTER_GAIN:  *values = src->cone_outer_gain; break;
@@ -3922,9 +7425,9 @@ static void _alGetSourcefv(const ALuint name, const ALenum param, ALfloat *value
         default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetSourcefv,(ALuint name, ALenum param, ALfloat *values),(name,param,values))
+ENTRYPOINTVOID(alGetSourcefv,(ALuint name, ALenum param, ALfloat *values),(ctx,name,param,values))
 
-static void _alGetSourcef(const ALuint name, const ALenum param, ALfloat *value)
+static void _alGetSourcef(ALCcontext *ctx, const ALuint name, const ALenum param, ALfloat *value)
 {
     switch (param) {
         case AL_GAIN:
@@ -3940,45 +7443,46 @@ static void _alGetSourcef(const ALuint name, const ALenum param, ALfloat *value)
         case AL_SEC_OFFSET:
         case AL_SAMPLE_OFFSET:
         case AL_BYTE_OFFSET:
-            _alGetSourcefv(name, param, value);
+            _alGetSourcefv(ctx, name, param, value);
             break;
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetSourcef,(ALuint name, ALenum param, ALfloat *value),(name,param,value))
+ENTRYPOINTVOID(alGetSourcef,(ALuint name, ALenum param, ALfloat *value),(ctx,name,param,value))
 
-static void _alGetSource3f(const ALuint name, const ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
+static void _alGetSource3f(ALCcontext *ctx, const ALuint name, const ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
 {
     switch (param) {
         case AL_POSITION:
         case AL_VELOCITY:
         case AL_DIRECTION: {
             ALfloat values[3];
-            _alGetSourcefv(name, param, values);
+            _alGetSourcefv(ctx, name, param, values);
             if (value1) *value1 = values[0];
             if (value2) *value2 = values[1];
             if (value3) *value3 = values[2];
             break;
         }
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetSource3f,(ALuint name, ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3),(name,param,value1,value2,value3))
+ENTRYPOINTVOID(alGetSource3f,(ALuint name, ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3),(ctx,name,param,value1,value2,value3))
 
-static void _alGetSourceiv(const ALuint name, const ALenum param, ALint *values)
+static void _alGetSourceiv(ALCcontext *ctx, const ALuint name, const ALenum param, ALint *values)
 {
-    ALCcontext *ctx = get_current_context();
     ALsource *src = get_source(ctx, name, NULL);
     if (!src) return;
 
     switch (param) {
-        case AL_SOURCE_STATE: *values = (ALint) SDL_AtomicGet(&src->state); break;
-        case AL_SOURCE_TYPE: *values = (ALint) src->type; break;
-        case AL_BUFFER: *values = (ALint) (src->buffer ? src->buffer->name : 0); break;
+        case AL_SOURCE_STATE: *values = (ALint) source_state(src->voice); break;
+        case AL_SOURCE_TYPE: *values = (ALint) src->voice->type; break;
+        case AL_BUFFER: *values = (ALint) (src->voice->buffer ? src->voice->buffer->name : 0); break;
         case AL_BUFFERS_QUEUED: *values = (ALint) SDL_AtomicGet(&src->total_queued_buffers); break;
         case AL_BUFFERS_PROCESSED: *values = (ALint) SDL_AtomicGet(&src->buffer_queue_processed.num_items); break;
         case AL_SOURCE_RELATIVE: *values = (ALint) src->source_relative; break;
-        case AL_LOOPING: *values = (ALint) src->looping; break;
+        case AL_LOOPING: *values = (ALint) src->voice->looping; break;
+        case AL_PITCH_PRESERVE_DURATION: *values = (ALint) src->voice->preserve_duration; break;
+        case AL_SOURCE_PRIORITY: *values = src->priority; break;
         case AL_REFERENCE_DISTANCE: *values = (ALint) src->reference_distance; break;
         case AL_ROLLOFF_FACTOR: *values = (ALint) src->rolloff_factor; break;
         case AL_MAX_DISTANCE: *values = (ALint) src->max_distance; break;
@@ -3999,14 +7503,95 @@ static void _alGetSourceiv(const ALuint name, const ALenum param, ALint *values)
         default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetSourceiv,(ALuint name, ALenum param, ALint *values),(name,param,values))
 
-static void _alGetSourcei(const ALuint name, const ALenum param, ALint *value)
+/* The queries streaming code polls all the time, answered without any lock. Returns
+   AL_FALSE if it can't answer (not one of those queries, bogus or stale name, etc);
+   the caller takes the usual locked path then, which will report any error. */
+static ALboolean get_source_lockless(ALCcontext *ctx, const ALuint name, const ALenum param, ALint *value)
+{
+    const ALsizei index = (ALsizei) (name & SOURCE_NAME_INDEX_MASK);
+    const ALsizei blockidx = (index - 1) / OPENAL_SOURCE_BLOCK_SIZE;
+    const ALsizei block_offset = (index - 1) % OPENAL_SOURCE_BLOCK_SIZE;
+    SourceBlock **blocks;
+    SourceBlock *block;
+    SourceVoice *voice;
+    ALsource *src;
+    int generation;
+    ALint retval;
+
+    switch (param) {
+        case AL_SOURCE_STATE:
+        case AL_BUFFERS_PROCESSED:
+        case AL_SAMPLE_OFFSET:
+            break;
+        default:
+            return AL_FALSE;
+    }
+
+    if (!ctx || (index == 0) || (blockidx >= SDL_AtomicGet(&ctx->lockless_num_source_blocks))) {
+        return AL_FALSE;
+    }
+
+    /* the count is set after the table grows and the new slot is filled, so this table has at least that many blocks. Old tables are never freed while the context lives. */
+    blocks = (SourceBlock **) SDL_AtomicGetPtr((void **) &ctx->source_blocks);
+    block = blocks[blockidx];
+    src = &block->sources[block_offset];
+    voice = &block->voices[block_offset];  /* not src->voice, it's briefly NULL while a source is being generated. */
+
+    generation = SDL_AtomicGet(&src->generation);
+    if (!source_name_matches(name, generation)) {
+        return AL_FALSE;
+    }
+
+    switch (param) {
+        case AL_SOURCE_STATE:
+            retval = (ALint) source_state(voice);
+            break;
+        case AL_BUFFERS_PROCESSED:
+            retval = (ALint) SDL_AtomicGet(&src->buffer_queue_processed.num_items);
+            break;
+        case AL_SAMPLE_OFFSET:
+            if (voice->type != AL_STATIC) {
+                return AL_FALSE;  /* streaming offsets walk the buffer queue; let source_get_offset() handle it. */
+            }
+            retval = voice->buffer ? (ALint) voice->offset : 0;
+            break;
+        default:
+            SDL_assert(!"missing lockless source query");
+            return AL_FALSE;
+    }
+
+    if (SDL_AtomicGet(&src->generation) != generation) {
+        return AL_FALSE;  /* deleted (and maybe reused) while we were looking. */
+    }
+
+    *value = retval;
+    return AL_TRUE;
+}
+
+/* no api lock for the queries in get_source_lockless(). */
+void alGetSourceiv(ALuint name, ALenum param, ALint *values)
+{
+    ALCcontext *ctx = get_current_context();
+    SDL_mutex *lock;
+
+    if (values && get_source_lockless(ctx, name, param, values)) {
+        return;
+    }
+
+    lock = grab_device_api_lock_traced(ctx ? ctx->device : NULL, "alGetSourceiv");
+    _alGetSourceiv(ctx, name, param, values);
+    ungrab_device_api_lock_traced(lock, "alGetSourceiv");
+}
+
+static void _alGetSourcei(ALCcontext *ctx, const ALuint name, const ALenum param, ALint *value)
 {
     switch (param) {
         case AL_SOURCE_STATE:
         case AL_SOURCE_RELATIVE:
         case AL_LOOPING:
+        case AL_PITCH_PRESERVE_DURATION:
+        case AL_SOURCE_PRIORITY:
         case AL_BUFFER:
         case AL_BUFFERS_QUEUED:
         case AL_BUFFERS_PROCESSED:
@@ -4019,36 +7604,45 @@ static void _alGetSourcei(const ALuint name, const ALenum param, ALint *value)
         case AL_SEC_OFFSET:
         case AL_SAMPLE_OFFSET:
         case AL_BYTE_OFFSET:
-            _alGetSourceiv(name, param, value);
+            _alGetSourceiv(ctx, name, param, value);
             break;
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
+    }
+}
+
+/* no api lock for the queries in get_source_lockless(). */
+void alGetSourcei(ALuint name, ALenum param, ALint *value)
+{
+    ALCcontext *ctx = get_current_context();
+    SDL_mutex *lock;
+
+    if (value && get_source_lockless(ctx, name, param, value)) {
+        return;
     }
+
+    lock = grab_device_api_lock_traced(ctx ? ctx->device : NULL, "alGetSourcei");
+    _alGetSourcei(ctx, name, param, value);
+    ungrab_device_api_lock_traced(lock, "alGetSourcei");
 }
-ENTRYPOINTVOID(alGetSourcei,(ALuint name, ALenum param, ALint *value),(name,param,value))
 
-static void _alGetSource3i(const ALuint name, const ALenum param, ALint *value1, ALint *value2, ALint *value3)
+static void _alGetSource3i(ALCcontext *ctx, const ALuint name, const ALenum param, ALint *value1, ALint *value2, ALint *value3)
 {
     switch (param) {
         case AL_DIRECTION: {
             ALint values[3];
-            _alGetSourceiv(name, param, values);
+            _alGetSourceiv(ctx, name, param, values);
             if (value1) *value1 = values[0];
             if (value2) *value2 = values[1];
             if (value3) *value3 = values[2];
             break;
         }
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetSource3i,(ALuint name, ALenum param, ALint *value1, ALint *value2, ALint *value3),(name,param,value1,value2,value3))
+ENTRYPOINTVOID(alGetSource3i,(ALuint name, ALenum param, ALint *value1, ALint *value2, ALint *value3),(ctx,name,param,value1,value2,value3))
 
 static void source_play(ALCcontext *ctx, const ALsizei n, const ALuint *names)
 {
-    ALboolean failed = AL_FALSE;
-    SourcePlayTodo todo;
-    SourcePlayTodo *todoend = &todo;
-    SourcePlayTodo *todoptr;
-    void *ptr;
     ALsizei i;
 
     if (n == 0) {
@@ -4058,55 +7652,27 @@ static void source_play(ALCcontext *ctx, const ALsizei n, const ALuint *names)
         return;
     }
 
-    SDL_zero(todo);
-
-    /* Obtain our SourcePlayTodo items upfront; if this runs out of
-       memory, we won't have changed any state. The mixer thread will
-       put items back in the pool when done with them, so this handoff needs
-       to be atomic. */
-    for (i = 0; i < n; i++) {
-        SourcePlayTodo *item;
-        do {
-            ptr = SDL_AtomicGetPtr(&ctx->device->playback.source_todo_pool);
-            item = (SourcePlayTodo *) ptr;
-            if (!item) break;
-            ptr = item->next;
-        } while (!SDL_AtomicCASPtr(&ctx->device->playback.source_todo_pool, item, ptr));
-
-        if (!item) {  /* allocate a new item */
-            item = (SourcePlayTodo *) SDL_calloc(1, sizeof (SourcePlayTodo));
-            if (!item) {
-                set_al_error(ctx, AL_OUT_OF_MEMORY);
-                failed = AL_TRUE;
-                break;
-            }
-        }
-
-        item->next = NULL;
-        todoend->next = item;
-        todoend = item;
-    }
-
-    if (failed) {
-        /* put the whole new queue back in the pool for reuse later. */
-        if (todo.next) {
-            do {
-                ptr = SDL_AtomicGetPtr(&ctx->device->playback.source_todo_pool);
-                todoend->next = (SourcePlayTodo *) ptr;
-            } while (!SDL_AtomicCASPtr(&ctx->device->playback.source_todo_pool, ptr, todo.next));
-        }
-        return;
-    }
-
     FIXME("What do we do if there's an invalid source in the middle of the names vector?");
-    for (i = 0, todoptr = todo.next; i < n; i++) {
+    for (i = 0; i < n; i++) {
         const ALuint name = names[i];
         ALsource *src = get_source(ctx, name, NULL);
         if (src) {
+            SourceVoice *voice = src->voice;
+            const ALboolean mixer_owned = source_mixer_owned(voice);
+            int serial;
+
             if (src->offset_latched) {
                 src->offset_latched = AL_FALSE;
-            } else if (SDL_AtomicGet(&src->state) != AL_PAUSED) {
-                src->offset = 0;
+                if (!mixer_owned) {
+                    source_reset_resampler(src);  /* (the seek command did this if the mixer has it.) */
+                }
+            } else if (source_state(voice) != AL_PAUSED) {
+                if (mixer_owned) {
+                    post_source_command(ctx, voice, AL_SAMPLE_OFFSET, 0);
+                } else {
+                    voice->offset = 0;
+                    source_reset_resampler(src);
+                }
             }
 
             /* this used to move right to AL_STOPPED if the device is
@@ -4118,73 +7684,57 @@ static void source_play(ALCcontext *ctx, const ALsizei n, const ALuint *names)
                say that the mixer will "immediately" move it as opposed to
                it stopping when the source would be done mixing (or worse:
                hang there forever). */
-            SDL_AtomicSet(&src->state, AL_PLAYING);
-
-            /* Mark this as visible to the mixer. This will be set back to zero by the mixer thread when it is done with the source. */
-            SDL_AtomicSet(&src->mixer_accessible, 1);
-
-            todoptr->source = src;
-            todoptr = todoptr->next;
+            serial = SDL_AtomicAdd(&voice->play_serial, 1) + 1;  /* before the state, so source_state() never sees the last play's finish. */
+            SDL_AtomicSet(&voice->state, AL_PLAYING);
+            post_source_command(ctx, voice, AL_PLAYING, serial);
         }
     }
 
-    /* Send the list to the mixer atomically, so all sources start playing in sync!
-       We're going to put these on a linked list called playlist_todo
-       The mixer does an atomiccasptr to grab the current list, swapping
-       in a NULL. Once it has the list, it's safe to do what it likes
-       with it, as nothing else owns the pointers in that list. */
-    do {
-        ptr = SDL_AtomicGetPtr(&ctx->playlist_todo);
-        todoend->next = (SourcePlayTodo*)ptr;
-    } while (!SDL_AtomicCASPtr(&ctx->playlist_todo, ptr, todo.next));
+    /* Send them to the mixer all at once, so all sources start playing in sync! */
+    publish_source_commands(ctx);
 }
 
-static void _alSourcePlay(const ALuint name)
+static void _alSourcePlay(ALCcontext *ctx, const ALuint name)
 {
-    source_play(get_current_context(), 1, &name);
+    source_play(ctx, 1, &name);
 }
-ENTRYPOINTVOID(alSourcePlay,(ALuint name),(name))
+ENTRYPOINTVOID(alSourcePlay,(ALuint name),(ctx,name))
 
-static void _alSourcePlayv(ALsizei n, const ALuint *names)
+static void _alSourcePlayv(ALCcontext *ctx, ALsizei n, const ALuint *names)
 {
-    source_play(get_current_context(), n, names);
+    source_play(ctx, n, names);
 }
-ENTRYPOINTVOID(alSourcePlayv,(ALsizei n, const ALuint *names),(n, names))
+ENTRYPOINTVOID(alSourcePlayv,(ALsizei n, const ALuint *names),(ctx,n, names))
 
 
-static void source_stop(ALCcontext *ctx, const ALuint name)
+/* Returns AL_TRUE if (name)'s buffer queue still has to be marked processed once the mixer lets go of it. */
+static ALboolean source_stop(ALCcontext *ctx, const ALuint name)
 {
     ALsource *src = get_source(ctx, name, NULL);
     if (src) {
-        if (SDL_AtomicGet(&src->state) != AL_INITIAL) {
-            const ALboolean must_lock = SDL_AtomicGet(&src->mixer_accessible) ? AL_TRUE : AL_FALSE;
-            if (must_lock) {
-                SDL_LockMutex(ctx->source_lock);
+        if (source_state(src->voice) != AL_INITIAL) {
+            SDL_AtomicSet(&src->voice->state, AL_STOPPED);
+            if (source_mixer_owned(src->voice)) {
+                post_source_command(ctx, src->voice, AL_STOPPED, 0);
+                return (src->voice->type == AL_STREAMING) ? AL_TRUE : AL_FALSE;
             }
-            SDL_AtomicSet(&src->state, AL_STOPPED);
             source_mark_all_buffers_processed(src);
-            if (src->stream) {
-                SDL_AudioStreamClear(src->stream);
-            }
-            if (must_lock) {
-                SDL_UnlockMutex(ctx->source_lock);
-            }
+            source_reset_resampler(src);
         }
     }
+    return AL_FALSE;
 }
 
 static void source_rewind(ALCcontext *ctx, const ALuint name)
 {
     ALsource *src = get_source(ctx, name, NULL);
     if (src) {
-        const ALboolean must_lock = SDL_AtomicGet(&src->mixer_accessible) ? AL_TRUE : AL_FALSE;
-        if (must_lock) {
-            SDL_LockMutex(ctx->source_lock);
-        }
-        SDL_AtomicSet(&src->state, AL_INITIAL);
-        src->offset = 0;
-        if (must_lock) {
-            SDL_UnlockMutex(ctx->source_lock);
+        SDL_AtomicSet(&src->voice->state, AL_INITIAL);
+        if (source_mixer_owned(src->voice)) {
+            post_source_command(ctx, src->voice, AL_INITIAL, 0);
+        } else {
+            src->voice->offset = 0;
+            source_reset_resampler(src);
         }
     }
 }
@@ -4192,133 +7742,172 @@ static void source_rewind(ALCcontext *ctx, const ALuint name)
 static void source_pause(ALCcontext *ctx, const ALuint name)
 {
     ALsource *src = get_source(ctx, name, NULL);
-    if (src) {
-        SDL_AtomicCAS(&src->state, AL_PLAYING, AL_PAUSED);
+    if (src && (source_state(src->voice) == AL_PLAYING)) {
+        SDL_AtomicSet(&src->voice->state, AL_PAUSED);
+        post_source_command(ctx, src->voice, AL_PAUSED, 0);  /* the mixer has everything that's playing. */
     }
 }
 
 static float source_get_offset(ALsource *src, ALenum param)
 {
-    int offset = 0;
-    int framesize = sizeof (float);
-    int freq = 1;
-    if (src->type == AL_STREAMING) {
+    const ALbuffer *buffer = NULL;
+    int offset = 0;  /* in sample frames */
+    if (src->voice->type == AL_STREAMING) {
         /* streaming: the offset counts from the first processed buffer in the queue. */
         BufferQueueItem *item = src->buffer_queue.head;
         if (item) {
-            framesize = (int) (item->buffer->channels * sizeof (float));
-            freq = (int) (item->buffer->frequency);
+            buffer = item->buffer;
             int proc_buf = SDL_AtomicGet(&src->buffer_queue_processed.num_items);
-            offset = (proc_buf * item->buffer->len + src->offset);
+            offset = (proc_buf * buffer->frames + src->voice->offset);
         }
-    } else if (src->buffer) {
-        framesize = (int) (src->buffer->channels * sizeof (float));
-        freq = (int) src->buffer->frequency;
-        offset = src->offset;
+    } else if (src->voice->buffer) {
+        buffer = src->voice->buffer;
+        offset = src->voice->offset;
+    }
+
+    if (!buffer) {
+        return 0.0f;
     }
+
     switch(param) {
-        case AL_SAMPLE_OFFSET: return (float) (offset / framesize); break;
-        case AL_SEC_OFFSET: return ((float) (offset / framesize)) / ((float) freq); break;
-        case AL_BYTE_OFFSET: return (float) offset; break;
+        case AL_SAMPLE_OFFSET: return (float) offset; break;
+        case AL_SEC_OFFSET: return ((float) offset) / ((float) buffer->frequency); break;
+        case AL_BYTE_OFFSET:
+            /* in bytes as the app handed it to alBufferData; compressed data can only report the start of the current block. */
+            if (buffer_is_adpcm(buffer)) {
+                return (float) ((offset / buffer->block_frames) * buffer->block_size);
+            }
+            return (float) (offset * buffer->channels * (buffer->bits / 8));
+            break;
         default: break;
     }
 
     return 0.0f;
 }
 
-static void source_set_offset(ALsource *src, ALenum param, ALfloat value)
+static void source_set_offset(ALCcontext *ctx, ALsource *src, ALenum param, ALfloat value)
 {
-    ALCcontext *ctx = get_current_context();
     if (!ctx) {
         set_al_error(ctx, AL_INVALID_OPERATION);
         return;
-    } else if (src->type == AL_UNDETERMINED) {  /* no buffer to seek in */
+    } else if (src->voice->type == AL_UNDETERMINED) {  /* no buffer to seek in */
         set_al_error(ctx, AL_INVALID_OPERATION);
         return;
-    } else if (src->type == AL_STREAMING) {
+    } else if (src->voice->type == AL_STREAMING) {
         FIXME("set_offset for streaming sources not implemented");
         return;
     }
 
-    const int bufflen = (int) src->buffer->len;
-    const int framesize = (int) (src->buffer->channels * sizeof (float));
-    const int freq = (int) src->buffer->frequency;
-    int offset = -1;
+    const ALbuffer *buffer = src->voice->buffer;
+    const int bufferframes = (int) buffer->frames;
+    const int freq = (int) buffer->frequency;
+    int offset = -1;  /* in sample frames */
 
     switch (param) {
         case AL_SAMPLE_OFFSET:
-            offset = value * framesize;
+            offset = (int) value;
             break;
         case AL_SEC_OFFSET:
-            offset = value * freq * framesize;
+            offset = (int) (value * freq);
             break;
         case AL_BYTE_OFFSET:
-            offset = ((int)value / framesize) * framesize;
+            if (buffer_is_adpcm(buffer)) {  /* compressed data can only seek by block. */
+                offset = (((int) value) / buffer->block_size) * buffer->block_frames;
+            } else {  /* rounds down to a sample frame boundary. */
+                offset = ((int) value) / (buffer->channels * (buffer->bits / 8));
+            }
             break;
     }
 
-    if ((offset < 0) || (offset > bufflen)) {
+    if ((offset < 0) || (offset > bufferframes)) {
         set_al_error(ctx, AL_INVALID_VALUE);
         return;
     }
 
-    /* make sure the offset lands on a sample frame boundary. */
-    offset -= offset % framesize;
-
-    if (!SDL_AtomicGet(&src->mixer_accessible)) {
-        src->offset = offset;
+    if (!source_mixer_owned(src->voice)) {
+        src->voice->offset = offset;
+        source_reset_resampler(src);
     } else {
-        SDL_LockMutex(ctx->source_lock);
-        src->offset = offset;
-        SDL_UnlockMutex(ctx->source_lock);
+        post_source_command(ctx, src->voice, AL_SAMPLE_OFFSET, offset);
+        publish_source_commands(ctx);
+    }
+}
+
+static void _alSourceStopv(ALCcontext *ctx, ALsizei n, const ALuint *names)
+{
+    ALboolean mixer_has_queues = AL_FALSE;
+    ALsizei i;
+
+    if (!ctx) {
+        set_al_error(ctx, AL_INVALID_OPERATION);
+        return;
+    }
+
+    for (i = 0; i < n; i++) {
+        if (source_stop(ctx, names[i])) {
+            mixer_has_queues = AL_TRUE;
+        }
+    }
+
+    publish_source_commands(ctx);  /* they all stop in the same callback. */
+
+    if (mixer_has_queues) {
+        /* the mixer won't touch these queues once it runs the stop commands, so wait out a mix that started before that, then take them back. */
+        wait_for_mixer(ctx->device);
+        for (i = 0; i < n; i++) {
+            ALsource *src = get_source(ctx, names[i], NULL);
+            if (src && (src->voice->type == AL_STREAMING) && (source_state(src->voice) == AL_STOPPED)) {
+                source_mark_all_buffers_processed(src);
+            }
+        }
     }
 }
+ENTRYPOINTVOID(alSourceStopv,(ALsizei n, const ALuint *names),(ctx,n,names))
 
-/* deal with alSourcePlay and alSourcePlayv (etc) boiler plate... */
+static void _alSourceStop(ALCcontext *ctx, const ALuint name)
+{
+    _alSourceStopv(ctx, 1, &name);
+}
+ENTRYPOINTVOID(alSourceStop,(ALuint name),(ctx,name))
+
+/* deal with alSourceRewind and alSourceRewindv (etc) boiler plate...
+   Source commands reach the mixer all at once, so every source changes in the same callback. */
 #define SOURCE_STATE_TRANSITION_OP(alfn, fn) \
-    void alSource##alfn(ALuint name) { source_##fn(get_current_context(), name); } \
-    void alSource##alfn##v(ALsizei n, const ALuint *sources) { \
-        ALCcontext *ctx = get_current_context(); \
+    static void _alSource##alfn##v(ALCcontext *ctx, ALsizei n, const ALuint *names) { \
         if (!ctx) { \
             set_al_error(ctx, AL_INVALID_OPERATION); \
         } else { \
             ALsizei i; \
-            if (n > 1) { \
-                FIXME("Can we do this without a full device lock?"); \
-                SDL_LockAudioDevice(ctx->device->sdldevice);  /* lock the SDL device so these all start mixing in the same callback. */ \
-                for (i = 0; i < n; i++) { \
-                    source_##fn(ctx, sources[i]); \
-                } \
-                SDL_UnlockAudioDevice(ctx->device->sdldevice); \
-            } else if (n == 1) { \
-                source_##fn(ctx, *sources); \
+            for (i = 0; i < n; i++) { \
+                source_##fn(ctx, names[i]); \
             } \
+            publish_source_commands(ctx); \
         } \
-    }
+    } \
+    ENTRYPOINTVOID(alSource##alfn##v,(ALsizei n, const ALuint *names),(ctx,n,names)) \
+    static void _alSource##alfn(ALCcontext *ctx, const ALuint name) { _alSource##alfn##v(ctx, 1, &name); } \
+    ENTRYPOINTVOID(alSource##alfn,(ALuint name),(ctx,name))
 
-SOURCE_STATE_TRANSITION_OP(Stop, stop)
 SOURCE_STATE_TRANSITION_OP(Rewind, rewind)
 SOURCE_STATE_TRANSITION_OP(Pause, pause)
 
 
-static void _alSourceQueueBuffers(const ALuint name, const ALsizei nb, const ALuint *bufnames)
+static void _alSourceQueueBuffers(ALCcontext *ctx, const ALuint name, const ALsizei nb, const ALuint *bufnames)
 {
     BufferQueueItem *queue = NULL;
     BufferQueueItem *queueend = NULL;
     void *ptr;
     ALsizei i;
-    ALCcontext *ctx = get_current_context();
     ALsource *src = get_source(ctx, name, NULL);
     ALint queue_channels = 0;
     ALsizei queue_frequency = 0;
     ALboolean failed = AL_FALSE;
-    SDL_AudioStream *stream = NULL;
 
     if (!src) {
         return;
     }
 
-    if (src->type == AL_STATIC) {
+    if (src->voice->type == AL_STATIC) {
         set_al_error(ctx, AL_INVALID_OPERATION);
         return;
     }
@@ -4387,20 +7976,6 @@ static void _alSourceQueueBuffers(const ALuint name, const ALsizei nb, const ALu
         }
     }
 
-    if (!src->queue_frequency) {
-        SDL_assert(!src->queue_channels);
-        SDL_assert(!src->stream);
-        /* We only use the stream for resampling, not for channel conversion. */
-        if (ctx->device->frequency != queue_frequency) {
-            stream = SDL_NewAudioStream(AUDIO_F32SYS, queue_channels, queue_frequency, AUDIO_F32SYS, queue_channels, ctx->device->frequency);
-            if (!stream) {
-                set_al_error(ctx, AL_OUT_OF_MEMORY);
-                failed = AL_TRUE;
-            }
-            FIXME("need a way to prealloc space in the stream, so the mixer doesn't have to malloc");
-        }
-    }
-
     if (failed) {
         if (queue) {
             /* Drop our claim on any buffers we planned to queue. */
@@ -4415,21 +7990,17 @@ static void _alSourceQueueBuffers(const ALuint name, const ALsizei nb, const ALu
             queueend->next = ctx->device->playback.buffer_queue_pool;
             ctx->device->playback.buffer_queue_pool = queue;
         }
-        if (stream) {
-            SDL_FreeAudioStream(stream);
-        }
         return;
     }
 
     FIXME("this needs to be set way sooner");
 
     FIXME("this used to have a source lock, think this one through");
-    src->type = AL_STREAMING;
+    src->voice->type = AL_STREAMING;
 
     if (!src->queue_channels) {
         src->queue_channels = queue_channels;
         src->queue_frequency = queue_frequency;
-        src->stream = stream;
     }
 
     /* so we're going to put these on a linked list called just_queued,
@@ -4454,21 +8025,20 @@ static void _alSourceQueueBuffers(const ALuint name, const ALsizei nb, const ALu
     SDL_AtomicAdd(&src->total_queued_buffers, (int) nb);
     SDL_AtomicAdd(&src->buffer_queue.num_items, (int) nb);
 }
-ENTRYPOINTVOID(alSourceQueueBuffers,(ALuint name, ALsizei nb, const ALuint *bufnames),(name,nb,bufnames))
+ENTRYPOINTVOID(alSourceQueueBuffers,(ALuint name, ALsizei nb, const ALuint *bufnames),(ctx,name,nb,bufnames))
 
-static void _alSourceUnqueueBuffers(const ALuint name, const ALsizei nb, ALuint *bufnames)
+static void _alSourceUnqueueBuffers(ALCcontext *ctx, const ALuint name, const ALsizei nb, ALuint *bufnames)
 {
     BufferQueueItem *queueend = NULL;
     BufferQueueItem *queue;
     BufferQueueItem *item;
     ALsizei i;
-    ALCcontext *ctx = get_current_context();
     ALsource *src = get_source(ctx, name, NULL);
     if (!src) {
         return;
     }
 
-    if (src->type == AL_STATIC) {
+    if (src->voice->type == AL_STATIC) {
         set_al_error(ctx, AL_INVALID_OPERATION);
         return;
     }
@@ -4512,134 +8082,90 @@ static void _alSourceUnqueueBuffers(const ALuint name, const ALsizei nb, ALuint
     SDL_assert(queueend != NULL);
     queueend->next = ctx->device->playback.buffer_queue_pool;
     ctx->device->playback.buffer_queue_pool = queue;
-}
-ENTRYPOINTVOID(alSourceUnqueueBuffers,(ALuint name, ALsizei nb, ALuint *bufnames),(name,nb,bufnames))
-
-/* !!! FIXME: buffers and sources use almost identical code for blocks */
-static void _alGenBuffers(const ALsizei n, ALuint *names)
-{
-    ALCcontext *ctx = get_current_context();
-    ALboolean out_of_memory = AL_FALSE;
-    ALsizei totalblocks;
-    ALbuffer *stackobjs[16];
-    ALbuffer **objects = stackobjs;
-    ALsizei found = 0;
-    ALsizei block_offset = 0;
-    ALsizei blocki;
-    ALsizei i;
-
-    if (!ctx) {
-        set_al_error(ctx, AL_INVALID_OPERATION);
-        return;
-    }
-
-    if (n <= SDL_arraysize(stackobjs)) {
-        SDL_memset(stackobjs, '\0', sizeof (ALbuffer *) * n);
-    } else {
-        objects = (ALbuffer **) SDL_calloc(n, sizeof (ALbuffer *));
-        if (!objects) {
-            set_al_error(ctx, AL_OUT_OF_MEMORY);
-            return;
-        }
-    }
-
-    totalblocks = ctx->device->playback.num_buffer_blocks;
-    for (blocki = 0; blocki < totalblocks; blocki++) {
-        BufferBlock *block = ctx->device->playback.buffer_blocks[blocki];
-        block->tmp = 0;
-        if (block->used < SDL_arraysize(block->buffers)) {  /* skip if full */
-            for (i = 0; i < SDL_arraysize(block->buffers); i++) {
-                if (!block->buffers[i].allocated) {
-                    block->tmp++;
-                    objects[found] = &block->buffers[i];
-                    names[found++] = (i + block_offset) + 1;  /* +1 so it isn't zero. */
-                    if (found == n) {
-                        break;
-                    }
-                }
-            }
-
-            if (found == n) {
-                break;
-            }
-        }
+}
+ENTRYPOINTVOID(alSourceUnqueueBuffers,(ALuint name, ALsizei nb, ALuint *bufnames),(ctx,name,nb,bufnames))
+
+/* !!! FIXME: buffers and sources use almost identical code for blocks */
+/* (tail) is the end of the device's free_buffers; the new buffers go there, so names come off the list in order. Returns the new end, NULL on failure. */
+static ALbuffer **add_buffer_block(ALCdevice *device, ALbuffer **tail)
+{
+    /* device->playback.buffer_blocks is only accessed on the API thread under a mutex, so it's safe to realloc. */
+    const ALCsizei totalblocks = device->playback.num_buffer_blocks;
+    void *ptr = SDL_realloc(device->playback.buffer_blocks, sizeof (BufferBlock *) * (totalblocks + 1));
+    BufferBlock *block;
+    ALsizei i;
 
-        block_offset += SDL_arraysize(block->buffers);
+    if (!ptr) {
+        return NULL;
     }
+    device->playback.buffer_blocks = (BufferBlock **) ptr;
 
-    while (found < n) {  /* out of blocks? Add new ones. */
-        /* ctx->buffer_blocks is only accessed on the API thread under a mutex, so it's safe to realloc. */
-        void *ptr = SDL_realloc(ctx->device->playback.buffer_blocks, sizeof (BufferBlock *) * (totalblocks + 1));
-        BufferBlock *block;
+    block = (BufferBlock *) SDL_calloc(1, sizeof (BufferBlock));
+    if (!block) {
+        return NULL;
+    }
 
-        if (!ptr) {
-            out_of_memory = AL_TRUE;
-            break;
-        }
-        ctx->device->playback.buffer_blocks = (BufferBlock **) ptr;
+    for (i = 0; i < SDL_arraysize(block->buffers); i++) {
+        ALbuffer *buffer = &block->buffers[i];
+        buffer->name = (ALuint) ((totalblocks * OPENAL_BUFFER_BLOCK_SIZE) + i + 1);  /* +1 so it isn't zero. */
+        *tail = buffer;
+        tail = &buffer->next_free;
+    }
+    device->playback.num_free_buffers += SDL_arraysize(block->buffers);
 
-        block = (BufferBlock *) SDL_calloc(1, sizeof (BufferBlock));
-        if (!block) {
-            out_of_memory = AL_TRUE;
-            break;
-        }
-        ctx->device->playback.buffer_blocks[totalblocks] = block;
-        totalblocks++;
-        ctx->device->playback.num_buffer_blocks++;
+    device->playback.buffer_blocks[totalblocks] = block;
+    device->playback.num_buffer_blocks++;
+    return tail;
+}
 
-        for (i = 0; i < SDL_arraysize(block->buffers); i++) {
-            block->tmp++;
-            objects[found] = &block->buffers[i];
-            names[found++] = (i + block_offset) + 1;  /* +1 so it isn't zero. */
-            if (found == n) {
-                break;
-            }
-        }
-        block_offset += SDL_arraysize(block->buffers);
-    }
+static void _alGenBuffers(ALCcontext *ctx, const ALsizei n, ALuint *names)
+{
+    ALCdevice *device;
+    ALsizei i;
 
-    if (out_of_memory) {
-        if (objects != stackobjs) SDL_free(objects);
-        SDL_memset(names, '\0', sizeof (*names) * n);
-        set_al_error(ctx, AL_OUT_OF_MEMORY);
+    if (!ctx) {
+        set_al_error(ctx, AL_INVALID_OPERATION);
         return;
     }
 
-    SDL_assert(found == n);  /* we should have either gotten space or bailed on alloc failure */
+    device = ctx->device;
+    if (device->playback.num_free_buffers < n) {  /* out of buffers? Add new blocks. */
+        ALbuffer **tail = &device->playback.free_buffers;
+        while (*tail) {  /* fewer than (n) of these, so this doesn't cost more than handing out the names. */
+            tail = &(*tail)->next_free;
+        }
 
-    /* update the "used" field in blocks with items we are taking now. */
-    found = 0;
-    for (blocki = 0; found < n; blocki++) {
-        BufferBlock *block = ctx->device->playback.buffer_blocks[blocki];
-        SDL_assert(blocki < totalblocks);
-        const int foundhere = block->tmp;
-        if (foundhere) {
-            block->used += foundhere;
-            found += foundhere;
-            block->tmp = 0;
+        while (device->playback.num_free_buffers < n) {
+            tail = add_buffer_block(device, tail);
+            if (!tail) {
+                SDL_memset(names, '\0', sizeof (*names) * n);
+                set_al_error(ctx, AL_OUT_OF_MEMORY);
+                return;
+            }
         }
     }
 
-    SDL_assert(found == n);
-
     for (i = 0; i < n; i++) {
-        ALbuffer *buffer = objects[i];
-        /*printf("Generated buffer %u\n", (unsigned int) names[i]);*/
+        ALbuffer *buffer = device->playback.free_buffers;
+        const ALuint name = buffer->name;
+
+        device->playback.free_buffers = buffer->next_free;
+        device->playback.num_free_buffers--;
+        device->playback.buffer_blocks[(name - 1) / OPENAL_BUFFER_BLOCK_SIZE]->used++;
+
+        /*printf("Generated buffer %u\n", (unsigned int) name);*/
         SDL_assert(!buffer->allocated);
         SDL_zerop(buffer);
-        buffer->name = names[i];
+        buffer->name = names[i] = name;
         buffer->channels = 1;
         buffer->bits = 16;
         buffer->allocated = AL_TRUE;  /* we officially own it. */
     }
-
-    if (objects != stackobjs) SDL_free(objects);
 }
-ENTRYPOINTVOID(alGenBuffers,(ALsizei n, ALuint *names),(n,names))
+ENTRYPOINTVOID(alGenBuffers,(ALsizei n, ALuint *names),(ctx,n,names))
 
-static void _alDeleteBuffers(const ALsizei n, const ALuint *names)
+static void _alDeleteBuffers(ALCcontext *ctx, const ALsizei n, const ALuint *names)
 {
-    ALCcontext *ctx = get_current_context();
     ALsizei i;
 
     if (!ctx) {
@@ -4671,37 +8197,97 @@ static void _alDeleteBuffers(const ALsizei n, const ALuint *names)
             ALbuffer *buffer = get_buffer(ctx, name, &block);
             void *data;
             SDL_assert(buffer != NULL);
-            data = (void *) buffer->data;
+            data = buffer->static_data ? NULL : (void *) buffer->data;  /* static data belongs to the app (or a sound bank). */
             buffer->allocated = AL_FALSE;
             buffer->data = NULL;
             free_simd_aligned(data);
+            if (buffer->bank) {
+                sound_bank_release(buffer->bank);
+                buffer->bank = NULL;
+            }
             block->used--;
+            buffer->next_free = ctx->device->playback.free_buffers;
+            ctx->device->playback.free_buffers = buffer;
+            ctx->device->playback.num_free_buffers++;
         }
     }
 }
-ENTRYPOINTVOID(alDeleteBuffers,(ALsizei n, const ALuint *names),(n,names))
+ENTRYPOINTVOID(alDeleteBuffers,(ALsizei n, const ALuint *names),(ctx,n,names))
 
-static ALboolean _alIsBuffer(ALuint name)
+static ALboolean _alIsBuffer(ALCcontext *ctx, ALuint name)
 {
-    ALCcontext *ctx = get_current_context();
     return (ctx && (get_buffer(ctx, name, NULL) != NULL)) ? AL_TRUE : AL_FALSE;
 }
-ENTRYPOINT(ALboolean,alIsBuffer,(ALuint name),(name))
+ENTRYPOINT(ALboolean,alIsBuffer,(ALuint name),(ctx,name))
 
-static void _alBufferData(const ALuint name, const ALenum alfmt, const ALvoid *data, const ALsizei size, const ALsizei freq)
+/* Compressed formats are only for buffers, not capture, so they don't go through alcfmt_to_sdlfmt. */
+static ALboolean alfmt_to_adpcm(const ALenum alfmt, SDL_AudioFormat *format, Uint8 *channels)
+{
+    switch (alfmt) {
+        case AL_FORMAT_MONO_IMA4: *format = BUFFER_FORMAT_IMA4; *channels = 1; break;
+        case AL_FORMAT_STEREO_IMA4: *format = BUFFER_FORMAT_IMA4; *channels = 2; break;
+        case AL_FORMAT_MONO_MSADPCM_SOFT: *format = BUFFER_FORMAT_MSADPCM; *channels = 1; break;
+        case AL_FORMAT_STEREO_MSADPCM_SOFT: *format = BUFFER_FORMAT_MSADPCM; *channels = 2; break;
+        default: return AL_FALSE;
+    }
+    return AL_TRUE;
+}
+
+/* Sample frames per block, bytes per block, for an ADPCM format. Defaults
+   match OpenAL Soft: 65 frames for IMA4, 64 for MSADPCM. Returns AL_FALSE
+   if (alignment) isn't valid for this format. */
+static ALboolean adpcm_block_layout(const SDL_AudioFormat format, const int channels, const ALsizei alignment, ALsizei *block_frames, ALsizei *block_size)
+{
+    if (format == BUFFER_FORMAT_IMA4) {
+        /* a 4 byte header holding the first sample, then 8 samples per 4 bytes, per channel. */
+        *block_frames = alignment ? alignment : 65;
+        if (((*block_frames - 1) % 8) != 0) {
+            return AL_FALSE;
+        }
+        *block_size = (((*block_frames - 1) / 2) + 4) * channels;
+    } else {
+        /* a 7 byte header holding the first two samples, then 2 samples per byte, per channel. */
+        SDL_assert(format == BUFFER_FORMAT_MSADPCM);
+        *block_frames = alignment ? alignment : 64;
+        if ((*block_frames < 2) || ((*block_frames % 2) != 0)) {
+            return AL_FALSE;
+        }
+        *block_size = (((*block_frames - 2) / 2) + 7) * channels;
+    }
+    return (*block_frames <= OPENAL_MAX_ADPCM_BLOCK_FRAMES) ? AL_TRUE : AL_FALSE;
+}
+
+/* alBufferData, alBufferDataStatic and alLoadSoundBank. If (is_static),
+   (data) belongs to the app (or to (bank), if not NULL) and we use it in
+   place instead of copying it. On success, the buffer takes a reference
+   to (bank). */
+static void set_buffer_data(ALCcontext *ctx, const ALuint name, const ALenum alfmt, const ALvoid *data, const ALsizei size, const ALsizei freq, const ALboolean is_static, SoundBank *bank)
 {
-    ALCcontext *ctx = get_current_context();
     ALbuffer *buffer = get_buffer(ctx, name, NULL);
-    SDL_AudioCVT sdlcvt;
     Uint8 channels;
     SDL_AudioFormat sdlfmt;
     ALCsizei framesize;
-    int rc;
+    ALsizei frames;
+    ALsizei block_frames = 0;
+    ALsizei block_size = 0;
+    ALsizei len;
+    const void *storage;
     int prevrefcount;
 
     if (!buffer) return;
 
-    if (!alcfmt_to_sdlfmt(alfmt, &sdlfmt, &channels, &framesize)) {
+    if (is_static && !data && size) {
+        set_al_error(ctx, AL_INVALID_VALUE);
+        return;
+    }
+
+    if (alfmt_to_adpcm(alfmt, &sdlfmt, &channels)) {
+        if (!adpcm_block_layout(sdlfmt, channels, buffer->unpack_block_alignment, &block_frames, &block_size)) {
+            set_al_error(ctx, AL_INVALID_VALUE);
+            return;
+        }
+        framesize = 0;
+    } else if (!alcfmt_to_sdlfmt(alfmt, &sdlfmt, &channels, &framesize)) {
         set_al_error(ctx, AL_INVALID_VALUE);
         return;
     }
@@ -4719,125 +8305,401 @@ static void _alBufferData(const ALuint name, const ALenum alfmt, const ALvoid *d
     /* This check was from the wild west of lock-free programming, now we shouldn't pass get_buffer() if not allocated. */
     SDL_assert(buffer->allocated);
 
-    /* right now we take a moment to convert the data to float32, since that's
-       the format we want to work in, but we don't resample or change the channels */
-    SDL_zero(sdlcvt);
-    rc = SDL_BuildAudioCVT(&sdlcvt, sdlfmt, channels, (int) freq, AUDIO_F32SYS, channels, (int) freq);
-    if (rc == -1) {
-        (void) SDL_AtomicDecRef(&buffer->refcount);
-        set_al_error(ctx, AL_OUT_OF_MEMORY);  /* not really, but oh well. */
-        return;
+    /* we keep the data in the format the app gave us (8- and 16-bit data is
+       half or a quarter the size of float32, ADPCM is 4 bits per sample); the
+       mixers convert or decode as they go. We don't resample or change the
+       channels here, either. */
+    if (block_size) {  /* compressed? Only keep whole blocks. */
+        frames = (size / block_size) * block_frames;
+        len = (size / block_size) * block_size;
+    } else {
+        frames = size / framesize;
+        len = frames * framesize;
     }
 
-    sdlcvt.len = sdlcvt.len_cvt = size;
-    sdlcvt.buf = (Uint8 *) calloc_simd_aligned(size * sdlcvt.len_mult);
-    if (!sdlcvt.buf) {
-        (void) SDL_AtomicDecRef(&buffer->refcount);
-        set_al_error(ctx, AL_OUT_OF_MEMORY);
-        return;
+    if (is_static) {
+        storage = data;
+    } else {
+        void *copy = calloc_simd_aligned(len);
+        if (!copy) {
+            (void) SDL_AtomicDecRef(&buffer->refcount);
+            set_al_error(ctx, AL_OUT_OF_MEMORY);
+            return;
+        }
+        SDL_memcpy(copy, data, len);
+        storage = copy;
     }
-    SDL_memcpy(sdlcvt.buf, data, size);
 
-    if (rc == 1) {  /* conversion necessary */
-        rc = SDL_ConvertAudio(&sdlcvt);
-        SDL_assert(rc == 0);  /* this shouldn't fail. */
-        #if 0   /* !!! FIXME: need realloc_simd_aligned. */
-        if (sdlcvt.len_cvt < (size * sdlcvt.len_mult)) {  /* maybe shrink buffer */
-            void *ptr = SDL_realloc(sdlcvt.buf, sdlcvt.len_cvt);
-            if (ptr) {
-                sdlcvt.buf = (Uint8 *) ptr;
-            }
-        }
-        #endif
+    /* nuke any previous data. */
+    if (buffer->bank) {
+        sound_bank_release(buffer->bank);
+    } else if (!buffer->static_data) {
+        free_simd_aligned((void *) buffer->data);
     }
 
-    free_simd_aligned((void *) buffer->data);  /* nuke any previous data. */
-    buffer->data = (const float *) sdlcvt.buf;
+    if (bank) {
+        SDL_AtomicIncRef(&bank->refcount);
+    }
+
+    buffer->data = storage;
+    buffer->static_data = is_static;
+    buffer->bank = bank;
+    buffer->format = sdlfmt;
     buffer->channels = (ALint) channels;
-    buffer->bits = (ALint) SDL_AUDIO_BITSIZE(sdlfmt);  /* we're in float32, though. */
+    buffer->bits = (ALint) SDL_AUDIO_BITSIZE(sdlfmt);
     buffer->frequency = freq;
-    buffer->len = (ALsizei) sdlcvt.len_cvt;
+    buffer->frames = frames;
+    buffer->block_frames = block_frames;
+    buffer->block_size = block_size;
+    buffer->len = len;
     (void) SDL_AtomicDecRef(&buffer->refcount);  /* ready to go! */
 }
-ENTRYPOINTVOID(alBufferData,(ALuint name, ALenum alfmt, const ALvoid *data, ALsizei size, ALsizei freq),(name,alfmt,data,size,freq))
 
-static void _alBufferfv(const ALuint name, const ALenum param, const ALfloat *values)
+static void _alBufferData(ALCcontext *ctx, const ALuint name, const ALenum alfmt, const ALvoid *data, const ALsizei size, const ALsizei freq)
+{
+    set_buffer_data(ctx, name, alfmt, data, size, freq, AL_FALSE, NULL);
+}
+ENTRYPOINTVOID(alBufferData,(ALuint name, ALenum alfmt, const ALvoid *data, ALsizei size, ALsizei freq),(ctx,name,alfmt,data,size,freq))
+
+/* AL_EXT_STATIC_BUFFER: the mixer reads (data) directly, so it has to stay
+   valid and unchanged until the buffer is deleted or gets new data. The same
+   rules as alBufferData apply: you can't do this to a buffer that a source
+   is using. SIMD-aligned memory mixes fastest, but isn't required. */
+static void _alBufferDataStatic(ALCcontext *ctx, const ALuint name, const ALenum alfmt, ALvoid *data, const ALsizei size, const ALsizei freq)
+{
+    set_buffer_data(ctx, name, alfmt, data, size, freq, AL_TRUE, NULL);
+}
+ENTRYPOINTVOID(alBufferDataStatic,(ALuint name, ALenum alfmt, ALvoid *data, ALsizei size, ALsizei freq),(ctx,name,alfmt,data,size,freq))
+
+/* Sound banks...
+
+   A sound bank is a file of sample data that's already in a format we can
+   mix, so loading hundreds of sounds is just pointing ALbuffers into a
+   memory-mapped file. The OS pages in samples as they get played, and every
+   process on the machine that maps the same bank shares the same memory.
+
+   Everything is little endian. The header is 16 bytes:
+     char magic[8];     "MOJOBANK"
+     Uint32 version;    1
+     Uint32 count;      number of entries.
+   Then (count) 32 byte entries:
+     Uint32 format;     AL_FORMAT_* enum; anything alBufferData accepts.
+     Uint32 frequency;  sample rate in Hz.
+     Uint64 offset;     where this entry's data starts, from the start of
+                        the file. Must be a multiple of 64, so it's aligned
+                        for SIMD and doesn't share cache lines.
+     Uint64 size;       length of this entry's data in bytes.
+     Uint32 alignment;  AL_UNPACK_BLOCK_ALIGNMENT_SOFT for compressed
+                        formats, 0 for the default.
+     Uint32 reserved;   zero.
+   The sample data follows, wherever the entries say. tests/makesoundbank.c
+   builds these from .wav files. */
+#define SOUND_BANK_MAGIC "MOJOBANK"
+#define SOUND_BANK_VERSION 1
+#define SOUND_BANK_HEADER_SIZE 16
+#define SOUND_BANK_ENTRY_SIZE 32
+#define SOUND_BANK_DATA_ALIGNMENT 64
+
+static SoundBank *sound_bank_open(const char *path)
+{
+    SoundBank *bank = (SoundBank *) SDL_calloc(1, sizeof (SoundBank));
+    if (!bank) {
+        return NULL;
+    }
+
+    #if defined(SOUND_BANK_MMAP_POSIX)
+    {
+        struct stat statbuf;
+        const int fd = open(path, O_RDONLY);
+        if (fd != -1) {
+            if ((fstat(fd, &statbuf) == 0) && (statbuf.st_size > 0)) {
+                void *ptr = mmap(NULL, (size_t) statbuf.st_size, PROT_READ, MAP_SHARED, fd, 0);
+                if (ptr != MAP_FAILED) {
+                    bank->data = (const Uint8 *) ptr;
+                    bank->len = (size_t) statbuf.st_size;
+                    bank->mapped = AL_TRUE;
+                }
+            }
+            close(fd);  /* the mapping stays valid without it. */
+        }
+    }
+    #elif defined(SOUND_BANK_MMAP_WINDOWS)
+    {
+        WCHAR *wpath = (WCHAR *) SDL_iconv_string("UTF-16LE", "UTF-8", path, SDL_strlen(path) + 1);
+        if (wpath) {
+            const HANDLE file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            SDL_free(wpath);
+            if (file != INVALID_HANDLE_VALUE) {
+                LARGE_INTEGER size;
+                if (GetFileSizeEx(file, &size) && (size.QuadPart > 0) && ((ULONGLONG) size.QuadPart <= (ULONGLONG) ((size_t) -1))) {
+                    const HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                    if (mapping) {
+                        void *ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                        if (ptr) {
+                            bank->data = (const Uint8 *) ptr;
+                            bank->len = (size_t) size.QuadPart;
+                            bank->mapped = AL_TRUE;
+                        }
+                        CloseHandle(mapping);  /* the view stays valid without these. */
+                    }
+                }
+                CloseHandle(file);
+            }
+        }
+    }
+    #endif
+
+    if (!bank->data) {  /* no mmap on this platform (or it failed), just read it in. */
+        SDL_RWops *rw = SDL_RWFromFile(path, "rb");
+        if (rw) {
+            const Sint64 len = SDL_RWsize(rw);
+            if ((len > 0) && ((Uint64) len <= (Uint64) ((size_t) -1))) {
+                Uint8 *ptr = (Uint8 *) calloc_simd_aligned((size_t) len);
+                if (ptr && (SDL_RWread(rw, ptr, (size_t) len, 1) == 1)) {
+                    bank->data = ptr;
+                    bank->len = (size_t) len;
+                } else {
+                    free_simd_aligned(ptr);
+                }
+            }
+            SDL_RWclose(rw);
+        }
+    }
+
+    if (!bank->data) {
+        SDL_free(bank);
+        return NULL;
+    }
+
+    return bank;
+}
+
+static void sound_bank_close(SoundBank *bank)
+{
+    if (!bank->mapped) {
+        free_simd_aligned((void *) bank->data);
+    } else {
+        #if defined(SOUND_BANK_MMAP_POSIX)
+        munmap((void *) bank->data, bank->len);
+        #elif defined(SOUND_BANK_MMAP_WINDOWS)
+        UnmapViewOfFile(bank->data);
+        #endif
+    }
+    SDL_free(bank);
+}
+
+static void sound_bank_release(SoundBank *bank)
+{
+    if (SDL_AtomicDecRef(&bank->refcount)) {  /* last buffer using it is done? */
+        sound_bank_close(bank);
+    }
+}
+
+#define read_le32(ptr) SDL_SwapLE32(*((const Uint32 *) (ptr)))
+#define read_le64(ptr) SDL_SwapLE64(*((const Uint64 *) (ptr)))
+
+/* make sure the bank's header and entries make sense before we touch any buffers. Returns the entry count, -1 if it's bogus. */
+static int sound_bank_validate(const SoundBank *bank)
+{
+    Uint32 count, i;
+
+    if ((bank->len < SOUND_BANK_HEADER_SIZE) || (SDL_memcmp(bank->data, SOUND_BANK_MAGIC, 8) != 0) || (read_le32(bank->data + 8) != SOUND_BANK_VERSION)) {
+        return -1;
+    }
+
+    count = read_le32(bank->data + 12);
+    if ((count > (Uint32) SDL_MAX_SINT32) || (((Uint64) count) > ((bank->len - SOUND_BANK_HEADER_SIZE) / SOUND_BANK_ENTRY_SIZE))) {
+        return -1;
+    }
+
+    for (i = 0; i < count; i++) {
+        const Uint8 *entry = bank->data + SOUND_BANK_HEADER_SIZE + (i * SOUND_BANK_ENTRY_SIZE);
+        const ALenum alfmt = (ALenum) read_le32(entry);
+        const Uint32 freq = read_le32(entry + 4);
+        const Uint64 offset = read_le64(entry + 8);
+        const Uint64 size = read_le64(entry + 16);
+        const Uint32 alignment = read_le32(entry + 24);
+        SDL_AudioFormat sdlfmt;
+        Uint8 channels;
+        ALCsizei framesize;
+        ALsizei block_frames, block_size;
+
+        if (alfmt_to_adpcm(alfmt, &sdlfmt, &channels)) {
+            if ((alignment > OPENAL_MAX_ADPCM_BLOCK_FRAMES) || !adpcm_block_layout(sdlfmt, channels, (ALsizei) alignment, &block_frames, &block_size)) {
+                return -1;
+            }
+        } else if (!alcfmt_to_sdlfmt(alfmt, &sdlfmt, &channels, &framesize)) {
+            return -1;
+        }
+
+        #if SDL_BYTEORDER == SDL_BIG_ENDIAN
+        if (SDL_AUDIO_BITSIZE(sdlfmt) > 8) {
+            return -1;  /* !!! FIXME: the samples are little endian; we'd have to byteswap, which defeats the point. */
+        }
+        #endif
+
+        if ((freq == 0) || (freq > (Uint32) SDL_MAX_SINT32) || (size > (Uint64) SDL_MAX_SINT32) || ((offset % SOUND_BANK_DATA_ALIGNMENT) != 0) || (offset > bank->len) || (size > (bank->len - offset))) {
+            return -1;
+        }
+    }
+
+    return (int) count;
+}
+
+/* Map the sound bank at (path) and point (buffers) at its first (n) entries
+   instead of copying anything. Returns the number of buffers filled in, or
+   the number of entries in the bank if (n) is zero, so you know how many
+   buffers to generate. The buffers hold the bank open until they're all
+   deleted or given other data; as with alBufferDataStatic, you can't do this
+   to buffers that a source is using. */
+static ALsizei _alLoadSoundBank(ALCcontext *ctx, const ALchar *path, const ALsizei n, const ALuint *buffers)
+{
+    SoundBank *bank;
+    ALsizei count;
+    ALsizei i;
+
+    if (!ctx) {
+        set_al_error(ctx, AL_INVALID_OPERATION);
+        return 0;
+    } else if (!path || (n < 0) || (n && !buffers)) {
+        set_al_error(ctx, AL_INVALID_VALUE);
+        return 0;
+    }
+
+    for (i = 0; i < n; i++) {  /* all or nothing, so check the buffers before we start. */
+        ALbuffer *buffer = get_buffer(ctx, buffers[i], NULL);
+        if (!buffer) {
+            return 0;  /* get_buffer set the error. */
+        } else if (SDL_AtomicGet(&buffer->refcount) != 0) {
+            set_al_error(ctx, AL_INVALID_OPERATION);  /* still in use */
+            return 0;
+        }
+    }
+
+    bank = sound_bank_open((const char *) path);
+    if (!bank) {
+        set_al_error(ctx, AL_INVALID_VALUE);
+        return 0;
+    }
+
+    SDL_AtomicSet(&bank->refcount, 1);  /* hold it open while we work. */
+
+    count = (ALsizei) sound_bank_validate(bank);
+    if (count < 0) {
+        set_al_error(ctx, AL_INVALID_VALUE);
+        sound_bank_release(bank);
+        return 0;
+    } else if (n == 0) {
+        sound_bank_release(bank);
+        return count;
+    }
+
+    count = SDL_min(count, n);
+    for (i = 0; i < count; i++) {
+        const Uint8 *entry = bank->data + SOUND_BANK_HEADER_SIZE + (i * SOUND_BANK_ENTRY_SIZE);
+        ALbuffer *buffer = get_buffer(ctx, buffers[i], NULL);
+        buffer->unpack_block_alignment = (ALsizei) read_le32(entry + 24);
+        set_buffer_data(ctx, buffers[i], (ALenum) read_le32(entry), bank->data + read_le64(entry + 8), (ALsizei) read_le64(entry + 16), (ALsizei) read_le32(entry + 4), AL_TRUE, bank);
+    }
+
+    sound_bank_release(bank);  /* the buffers have their own references now. */
+    return count;
+}
+ENTRYPOINT(ALsizei,alLoadSoundBank,(const ALchar *path, ALsizei n, const ALuint *buffers),(ctx,path,n,buffers))
+
+#undef read_le32
+#undef read_le64
+
+static void _alBufferfv(ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat *values)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
 }
-ENTRYPOINTVOID(alBufferfv,(ALuint name, ALenum param, const ALfloat *values),(name,param,values))
+ENTRYPOINTVOID(alBufferfv,(ALuint name, ALenum param, const ALfloat *values),(ctx,name,param,values))
 
-static void _alBufferf(const ALuint name, const ALenum param, const ALfloat value)
+static void _alBufferf(ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat value)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
 }
-ENTRYPOINTVOID(alBufferf,(ALuint name, ALenum param, ALfloat value),(name,param,value))
+ENTRYPOINTVOID(alBufferf,(ALuint name, ALenum param, ALfloat value),(ctx,name,param,value))
 
-static void _alBuffer3f(const ALuint name, const ALenum param, const ALfloat value1, const ALfloat value2, const ALfloat value3)
+static void _alBuffer3f(ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat value1, const ALfloat value2, const ALfloat value3)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
 }
-ENTRYPOINTVOID(alBuffer3f,(ALuint name, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3),(name,param,value1,value2,value3))
+ENTRYPOINTVOID(alBuffer3f,(ALuint name, ALenum param, ALfloat value1, ALfloat value2, ALfloat value3),(ctx,name,param,value1,value2,value3))
 
-static void _alBufferiv(const ALuint name, const ALenum param, const ALint *values)
+static void _alBufferiv(ALCcontext *ctx, const ALuint name, const ALenum param, const ALint *values)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
 }
-ENTRYPOINTVOID(alBufferiv,(ALuint name, ALenum param, const ALint *values),(name,param,values))
+ENTRYPOINTVOID(alBufferiv,(ALuint name, ALenum param, const ALint *values),(ctx,name,param,values))
 
-static void _alBufferi(const ALuint name, const ALenum param, const ALint value)
+static void _alBufferi(ALCcontext *ctx, const ALuint name, const ALenum param, const ALint value)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
+    ALbuffer *buffer = get_buffer(ctx, name, NULL);
+    if (!buffer) return;
+
+    switch (param) {
+        case AL_UNPACK_BLOCK_ALIGNMENT_SOFT:
+            /* only compressed formats care about this; it's checked against the format in alBufferData. */
+            if ((value < 0) || (value > OPENAL_MAX_ADPCM_BLOCK_FRAMES)) {
+                set_al_error(ctx, AL_INVALID_VALUE);
+            } else {
+                buffer->unpack_block_alignment = (ALsizei) value;
+            }
+            break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
+    }
 }
-ENTRYPOINTVOID(alBufferi,(ALuint name, ALenum param, ALint value),(name,param,value))
+ENTRYPOINTVOID(alBufferi,(ALuint name, ALenum param, ALint value),(ctx,name,param,value))
 
-static void _alBuffer3i(const ALuint name, const ALenum param, const ALint value1, const ALint value2, const ALint value3)
+static void _alBuffer3i(ALCcontext *ctx, const ALuint name, const ALenum param, const ALint value1, const ALint value2, const ALint value3)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
 }
-ENTRYPOINTVOID(alBuffer3i,(ALuint name, ALenum param, ALint value1, ALint value2, ALint value3),(name,param,value1,value2,value3))
+ENTRYPOINTVOID(alBuffer3i,(ALuint name, ALenum param, ALint value1, ALint value2, ALint value3),(ctx,name,param,value1,value2,value3))
 
-static void _alGetBufferfv(const ALuint name, const ALenum param, const ALfloat *values)
+static void _alGetBufferfv(ALCcontext *ctx, const ALuint name, const ALenum param, const ALfloat *values)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
 }
-ENTRYPOINTVOID(alGetBufferfv,(ALuint name, ALenum param, ALfloat *values),(name,param,values))
+ENTRYPOINTVOID(alGetBufferfv,(ALuint name, ALenum param, ALfloat *values),(ctx,name,param,values))
 
-static void _alGetBufferf(const ALuint name, const ALenum param, ALfloat *value)
+static void _alGetBufferf(ALCcontext *ctx, const ALuint name, const ALenum param, ALfloat *value)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
 }
-ENTRYPOINTVOID(alGetBufferf,(ALuint name, ALenum param, ALfloat *value),(name,param,value))
+ENTRYPOINTVOID(alGetBufferf,(ALuint name, ALenum param, ALfloat *value),(ctx,name,param,value))
 
-static void _alGetBuffer3f(const ALuint name, const ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
+static void _alGetBuffer3f(ALCcontext *ctx, const ALuint name, const ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM);  /* nothing in core OpenAL 1.1 uses this */
 }
-ENTRYPOINTVOID(alGetBuffer3f,(ALuint name, ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3),(name,param,value1,value2,value3))
+ENTRYPOINTVOID(alGetBuffer3f,(ALuint name, ALenum param, ALfloat *value1, ALfloat *value2, ALfloat *value3),(ctx,name,param,value1,value2,value3))
 
-static void _alGetBufferi(const ALuint name, const ALenum param, ALint *value)
+static void _alGetBufferi(ALCcontext *ctx, const ALuint name, const ALenum param, ALint *value)
 {
     switch (param) {
         case AL_FREQUENCY:
         case AL_SIZE:
         case AL_BITS:
         case AL_CHANNELS:
+        case AL_UNPACK_BLOCK_ALIGNMENT_SOFT:
             alGetBufferiv(name, param, value);
             break;
-        default: set_al_error(get_current_context(), AL_INVALID_ENUM); break;
+        default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetBufferi,(ALuint name, ALenum param, ALint *value),(name,param,value))
+ENTRYPOINTVOID(alGetBufferi,(ALuint name, ALenum param, ALint *value),(ctx,name,param,value))
 
-static void _alGetBuffer3i(const ALuint name, const ALenum param, ALint *value1, ALint *value2, ALint *value3)
+static void _alGetBuffer3i(ALCcontext *ctx, const ALuint name, const ALenum param, ALint *value1, ALint *value2, ALint *value3)
 {
-    set_al_error(get_current_context(), AL_INVALID_ENUM); /* nothing in core OpenAL 1.1 uses this */
+    set_al_error(ctx, AL_INVALID_ENUM); /* nothing in core OpenAL 1.1 uses this */
 }
-ENTRYPOINTVOID(alGetBuffer3i,(ALuint name, ALenum param, ALint *value1, ALint *value2, ALint *value3),(name,param,value1,value2,value3))
+ENTRYPOINTVOID(alGetBuffer3i,(ALuint name, ALenum param, ALint *value1, ALint *value2, ALint *value3),(ctx,name,param,value1,value2,value3))
 
-static void _alGetBufferiv(const ALuint name, const ALenum param, ALint *values)
+static void _alGetBufferiv(ALCcontext *ctx, const ALuint name, const ALenum param, ALint *values)
 {
-    ALCcontext *ctx = get_current_context();
     ALbuffer *buffer = get_buffer(ctx, name, NULL);
     if (!buffer) return;
 
@@ -4846,10 +8708,219 @@ static void _alGetBufferiv(const ALuint name, const ALenum param, ALint *values)
         case AL_SIZE: *values = (ALint) buffer->len; break;
         case AL_BITS: *values = (ALint) buffer->bits; break;
         case AL_CHANNELS: *values = (ALint) buffer->channels; break;
+        case AL_UNPACK_BLOCK_ALIGNMENT_SOFT: *values = (ALint) buffer->unpack_block_alignment; break;
         default: set_al_error(ctx, AL_INVALID_ENUM); break;
     }
 }
-ENTRYPOINTVOID(alGetBufferiv,(ALuint name, ALenum param, ALint *values),(name,param,values))
+ENTRYPOINTVOID(alGetBufferiv,(ALuint name, ALenum param, ALint *values),(ctx,name,param,values))
+
+/* AL_EXT_trace_info / ALC_EXT_trace_info entry points. See init_tracing() and friends for the details. */
+
+/* no ENTRYPOINT wrapper: the api call's own end event would close the app's scope in the trace. */
+void alTracePushScope(const ALchar *name)
+{
+    if (trace_enabled) {
+        trace_event('B', trace_intern(name ? (const char *) name : "(null)"), "app", NULL, 0);
+    }
+}
+
+void alTracePopScope(void)
+{
+    if (trace_enabled) {
+        trace_event('E', "(scope)", "app", NULL, 0);  /* Chrome matches 'E' events to the last 'B' on the thread, the name doesn't matter. */
+    }
+}
+
+static void _alTraceMessage(ALCcontext *ctx, const ALchar *message)
+{
+    if (trace_enabled && message) {
+        trace_event('i', trace_intern((const char *) message), "app", NULL, 0);
+    }
+}
+ENTRYPOINTVOID(alTraceMessage,(const ALchar *message),(ctx,message))
+
+static void _alTraceSourceLabel(ALCcontext *ctx, const ALuint name, const ALchar *label)
+{
+    ALsource *src = get_source(ctx, name, NULL);
+    if (src && trace_enabled) {
+        SDL_AtomicSetPtr(&src->label, (void *) trace_intern((const char *) label));
+    }
+}
+ENTRYPOINTVOID(alTraceSourceLabel,(ALuint name, const ALchar *label),(ctx,name,label))
+
+static void _alTraceBufferLabel(ALCcontext *ctx, const ALuint name, const ALchar *label)
+{
+    ALbuffer *buffer = get_buffer(ctx, name, NULL);
+    if (buffer && trace_enabled) {
+        SDL_AtomicSetPtr(&buffer->label, (void *) trace_intern((const char *) label));
+    }
+}
+ENTRYPOINTVOID(alTraceBufferLabel,(ALuint name, const ALchar *label),(ctx,name,label))
+
+static void _alcTraceDeviceLabel(ALCdevice *device, const ALCchar *label)
+{
+    if (!device) {
+        set_alc_error(NULL, ALC_INVALID_DEVICE);
+    } else if (trace_enabled) {
+        SDL_AtomicSetPtr(&device->label, (void *) trace_intern((const char *) label));
+    }
+}
+DEVICE_ENTRYPOINTVOID(alcTraceDeviceLabel,(ALCdevice *device, const ALCchar *label),(device,label),device)
+
+static void _alcTraceContextLabel(ALCcontext *ctx, const ALCchar *label)
+{
+    if (!ctx) {
+        set_alc_error(NULL, ALC_INVALID_CONTEXT);
+    } else if (trace_enabled) {
+        SDL_AtomicSetPtr(&ctx->label, (void *) trace_intern((const char *) label));
+    }
+}
+DEVICE_ENTRYPOINTVOID(alcTraceContextLabel,(ALCcontext *ctx, const ALCchar *label),(ctx,label),ctx ? ctx->device : NULL)
+
+/* a little buffered writer so we don't make a syscall per event. */
+typedef struct TraceWriter
+{
+    SDL_RWops *rw;
+    size_t len;
+    ALCboolean failed;
+    char buf[16 * 1024];
+} TraceWriter;
+
+static void trace_write(TraceWriter *writer, const char *str)
+{
+    const size_t len = SDL_strlen(str);
+    if (writer->failed) {
+        return;
+    } else if ((writer->len + len) > sizeof (writer->buf)) {
+        if (SDL_RWwrite(writer->rw, writer->buf, writer->len, 1) != 1) {
+            writer->failed = ALC_TRUE;
+            return;
+        }
+        writer->len = 0;
+        if (len > sizeof (writer->buf)) {  /* too big to buffer at all, just write it out. */
+            if (SDL_RWwrite(writer->rw, str, len, 1) != 1) {
+                writer->failed = ALC_TRUE;
+            }
+            return;
+        }
+    }
+    SDL_memcpy(writer->buf + writer->len, str, len);
+    writer->len += len;
+}
+
+static void trace_write_string(TraceWriter *writer, const char *str)
+{
+    char tmp[8];
+    trace_write(writer, "\"");
+    for (; *str; str++) {
+        const Uint8 ch = (Uint8) *str;
+        if ((ch == '"') || (ch == '\\')) {
+            tmp[0] = '\\'; tmp[1] = (char) ch; tmp[2] = '\0';
+        } else if (ch < 0x20) {
+            SDL_snprintf(tmp, sizeof (tmp), "\\u%04x", (unsigned int) ch);
+        } else {
+            tmp[0] = (char) ch; tmp[1] = '\0';
+        }
+        trace_write(writer, tmp);
+    }
+    trace_write(writer, "\"");
+}
+
+/* Write every thread's ring out as Chrome trace JSON. Other threads keep
+   recording while we do this; we copy each ring and only keep events that
+   were definitely finished before we started and not overwritten by the
+   time we were done copying. */
+static ALCboolean trace_dump(const char *path)
+{
+    const double ticks_to_usecs = 1000000.0 / (double) SDL_GetPerformanceFrequency();
+    TraceEvent *events;
+    TraceWriter *writer;
+    TraceRing *ring;
+    ALCboolean first = ALC_TRUE;
+    ALCboolean retval;
+    char tmp[128];
+
+    if (!trace_enabled || !path) {
+        return ALC_FALSE;
+    }
+
+    writer = (TraceWriter *) SDL_calloc(1, sizeof (TraceWriter));
+    events = (TraceEvent *) SDL_malloc(sizeof (TraceEvent) * OPENAL_TRACE_RING_EVENTS);
+    if (!writer || !events) {
+        SDL_free(writer);
+        SDL_free(events);
+        return ALC_FALSE;
+    }
+
+    writer->rw = SDL_RWFromFile(path, "w");
+    if (!writer->rw) {
+        SDL_free(writer);
+        SDL_free(events);
+        return ALC_FALSE;
+    }
+
+    trace_write(writer, "{\"traceEvents\":[");
+
+    for (ring = (TraceRing *) SDL_AtomicGetPtr(&trace_rings); ring != NULL; ring = ring->next) {
+        const Uint32 head = (Uint32) SDL_AtomicGet(&ring->head);
+        Uint32 head2, i;
+
+        SDL_memcpy(events, ring->events, sizeof (TraceEvent) * OPENAL_TRACE_RING_EVENTS);
+        head2 = (Uint32) SDL_AtomicGet(&ring->head);  /* anything this far behind head2 was overwritten while we copied. */
+
+        SDL_snprintf(tmp, sizeof (tmp), "%s\n{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":", first ? "" : ",", (unsigned long) ring->thread);
+        trace_write(writer, tmp);
+        trace_write_string(writer, ring->thread_name);
+        trace_write(writer, "}}");
+        first = ALC_FALSE;
+
+        for (i = head - (ring->full ? OPENAL_TRACE_RING_EVENTS : head); i != head; i++) {
+            const TraceEvent *event = &events[i & (OPENAL_TRACE_RING_EVENTS - 1)];
+            const Uint32 age = head2 - i;
+            if ((age == 0) || (age >= OPENAL_TRACE_RING_EVENTS)) {
+                continue;  /* overwritten while we copied. */
+            }
+
+            SDL_snprintf(tmp, sizeof (tmp), ",\n{\"ph\":\"%c\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"name\":", event->phase, (unsigned long) ring->thread, ((double) (event->ticks - trace_start_ticks)) * ticks_to_usecs);
+            trace_write(writer, tmp);
+            trace_write_string(writer, event->name ? event->name : "");
+            trace_write(writer, ",\"cat\":");
+            trace_write_string(writer, event->category ? event->category : "");
+            if (event->phase == 'i') {
+                trace_write(writer, ",\"s\":\"t\"");
+            }
+            if (event->id || event->detail) {
+                trace_write(writer, ",\"args\":{");
+                if (event->id) {
+                    SDL_snprintf(tmp, sizeof (tmp), "\"id\":%u%s", (unsigned int) event->id, event->detail ? "," : "");
+                    trace_write(writer, tmp);
+                }
+                if (event->detail) {
+                    trace_write(writer, "\"detail\":");
+                    trace_write_string(writer, event->detail);
+                }
+                trace_write(writer, "}");
+            }
+            trace_write(writer, "}");
+        }
+    }
+
+    trace_write(writer, "\n],\"displayTimeUnit\":\"ns\"}\n");
+    if (!writer->failed && writer->len && (SDL_RWwrite(writer->rw, writer->buf, writer->len, 1) != 1)) {
+        writer->failed = ALC_TRUE;
+    }
+
+    retval = (SDL_RWclose(writer->rw) == 0) && !writer->failed;
+    SDL_free(writer);
+    SDL_free(events);
+    return retval;
+}
+
+/* no api lock, so you can grab a trace even if something is wedged holding it. */
+ALCboolean alcTraceDump(const ALCchar *path)
+{
+    return trace_dump(path ? (const char *) path : trace_path);
+}
 
 /* end of mojoal.c ... */
 
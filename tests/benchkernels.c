@@ -0,0 +1,494 @@
+/**
+ * MojoAL; a simple drop-in OpenAL implementation.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+/* This is just test code, you don't need to compile this with MojoAL. */
+
+/* This measures the mixer's inner kernels one at a time: every float32 mixer
+   this build has (scalar, SSE, AVX, AVX2, AVX-512, NEON) across frame counts
+   and buffer alignments, calculate_channel_gains() against the batched
+   spatializers, pitch_shift(), and ring_buffer_put/get. It builds mojoal.c
+   right into itself so it can call those static functions directly. A
+   loopback device supplies the context and sources, so no sound card is
+   needed.
+
+   Before timing anything, each SIMD mixer is checked against the scalar one
+   on the same input and alignment, and each batched spatializer against
+   calculate_channel_gains() for every distance model. If any of them are
+   off by more than a small tolerance, this says so and exits with 1.
+
+   Cycles come from the CPU's timestamp counter on x86, which ticks at a
+   fixed rate and not the current clock speed, so treat them as relative
+   numbers. Other CPUs only get nanoseconds. GB/s counts every byte the
+   kernel has to read or write. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../mojoal.c"
+
+#if HAVE_AVX_MIXERS && !defined(_MSC_VER)
+#include <x86intrin.h>
+#endif
+
+#define MIX_TOLERANCE 0.00001f
+#define GAIN_TOLERANCE 0.0001f
+#define SAMPLES_PER_RUN (1 << 22)  /* how much work each timed run does, so small frame counts don't just measure the timer. */
+
+typedef struct Timing
+{
+    Uint64 ticks;
+    Uint64 cycles;
+} Timing;
+
+static void start_timing(Timing *t)
+{
+    #if HAVE_AVX_MIXERS
+    t->cycles = __rdtsc();
+    #else
+    t->cycles = 0;
+    #endif
+    t->ticks = SDL_GetPerformanceCounter();
+}
+
+static void stop_timing(Timing *t)
+{
+    t->ticks = SDL_GetPerformanceCounter() - t->ticks;
+    #if HAVE_AVX_MIXERS
+    t->cycles = __rdtsc() - t->cycles;
+    #endif
+}
+
+static double timing_nsecs(const Timing *t)
+{
+    return (((double) t->ticks) * 1000000000.0) / ((double) SDL_GetPerformanceFrequency());
+}
+
+/* prints cycles and nanoseconds per (units), and GB/s if (bytes) isn't zero. */
+static void print_timing(const Timing *t, const double units, const double bytes)
+{
+    const double nsecs = timing_nsecs(t);
+    #if HAVE_AVX_MIXERS
+    printf(" %8.3f cycles", ((double) t->cycles) / units);
+    #else
+    printf("        - cycles");
+    #endif
+    printf(" %8.3f ns", nsecs / units);
+    if (bytes > 0.0) {
+        printf(" %8.2f GB/s", (nsecs > 0.0) ? (bytes / nsecs) : 0.0);
+    }
+    printf("\n");
+}
+
+
+static int always_available(void) { return 1; }
+#ifdef __ARM_NEON__
+static int neon_available(void) { return has_neon; }
+#endif
+#if HAVE_AVX_MIXERS
+static int avx_available(void) { return SDL_HasAVX(); }
+static int avx2_available(void) { return SDL_HasAVX() && SDL_HasAVX2() && cpu_has_fma(); }
+#if SDL_VERSION_ATLEAST(2, 0, 9)
+static int avx512_available(void) { return avx2_available() && SDL_HasAVX512F(); }
+#endif
+#endif
+
+typedef struct MixKernel
+{
+    const char *name;
+    int channels;
+    MixFloat32Fn fn;
+    int (*available)(void);
+} MixKernel;
+
+static const MixKernel mix_kernels[] = {
+    { "mix_float32_c1_scalar", 1, mix_float32_c1_scalar, always_available },
+    { "mix_float32_c2_scalar", 2, mix_float32_c2_scalar, always_available },
+    #ifdef __SSE__
+    { "mix_float32_c1_sse", 1, mix_float32_c1_sse, always_available },
+    { "mix_float32_c2_sse", 2, mix_float32_c2_sse, always_available },
+    #endif
+    #if HAVE_AVX_MIXERS
+    { "mix_float32_c1_avx", 1, mix_float32_c1_avx, avx_available },
+    { "mix_float32_c2_avx", 2, mix_float32_c2_avx, avx_available },
+    { "mix_float32_c1_avx2", 1, mix_float32_c1_avx2, avx2_available },
+    { "mix_float32_c2_avx2", 2, mix_float32_c2_avx2, avx2_available },
+    #if SDL_VERSION_ATLEAST(2, 0, 9)
+    { "mix_float32_c1_avx512", 1, mix_float32_c1_avx512, avx512_available },
+    { "mix_float32_c2_avx512", 2, mix_float32_c2_avx512, avx512_available },
+    #endif
+    #endif
+    #ifdef __ARM_NEON__
+    { "mix_float32_c1_neon", 1, mix_float32_c1_neon, neon_available },
+    { "mix_float32_c2_neon", 2, mix_float32_c2_neon, neon_available },
+    #endif
+};
+
+typedef struct SpatialKernel
+{
+    const char *name;
+    SpatializeBatchFn fn;
+    int (*available)(void);
+} SpatialKernel;
+
+#if HAVE_SPATIALIZE_BATCH
+static const SpatialKernel spatial_kernels[] = {
+    #ifdef __SSE__
+    { "spatialize_batch_sse", spatialize_batch_sse, always_available },
+    #endif
+    #if HAVE_AVX_MIXERS
+    { "spatialize_batch_avx", spatialize_batch_avx, avx_available },
+    #endif
+    #ifdef __ARM_NEON__
+    { "spatialize_batch_neon", spatialize_batch_neon, neon_available },
+    #endif
+};
+#endif
+
+static const int frame_counts[] = { 16, 64, 256, 1024, 4096 };
+
+/* offsets, in floats, from a 64-byte boundary for the data and stream buffers. */
+static const struct { int data; int stream; const char *name; } alignments[] = {
+    { 0, 0, "aligned" },
+    { 2, 0, "data+8" },  /* the SSE mono mixer realigns this one itself. */
+    { 2, 2, "both+8" },
+    { 1, 3, "both+odd" }
+};
+
+static float max_difference(const float *a, const float *b, const int count)
+{
+    float retval = 0.0f;
+    int i;
+    for (i = 0; i < count; i++) {
+        const float diff = SDL_fabsf(a[i] - b[i]);
+        if (diff > retval) {
+            retval = diff;
+        }
+    }
+    return retval;
+}
+
+static int bench_mixers(void)
+{
+    const int maxframes = frame_counts[SDL_arraysize(frame_counts) - 1];
+    const ALfloat pannings[2][2] = { { 1.0f, 1.0f }, { 0.8f, 0.35f } };
+    float *data = (float *) calloc_simd_aligned((maxframes * 2 + 16) * sizeof (float));
+    float *reference = (float *) calloc_simd_aligned((maxframes * 2 + 16) * sizeof (float));
+    float *stream = (float *) calloc_simd_aligned((maxframes * 2 + 16) * sizeof (float));
+    int failures = 0;
+    size_t k, f, a, p;
+    int i;
+
+    if (!data || !reference || !stream) {
+        fprintf(stderr, "Out of memory!\n");
+        return 1;
+    }
+
+    for (i = 0; i < maxframes * 2 + 16; i++) {
+        data[i] = (float) (0.5 * SDL_sin(i * 0.05) + 0.25 * SDL_sin(i * 0.31));
+    }
+
+    printf("float32 mixers (per sample frame, panned):\n");
+    for (k = 0; k < SDL_arraysize(mix_kernels); k++) {
+        const MixKernel *kernel = &mix_kernels[k];
+        const MixFloat32Fn scalar = (kernel->channels == 1) ? mix_float32_c1_scalar : mix_float32_c2_scalar;
+
+        if (!kernel->available()) {
+            printf("  %-22s (this CPU can't run it)\n", kernel->name);
+            continue;
+        }
+
+        for (f = 0; f < SDL_arraysize(frame_counts); f++) {
+            const int frames = frame_counts[f];
+            const int iterations = SDL_max(1, SAMPLES_PER_RUN / frames);
+            for (a = 0; a < SDL_arraysize(alignments); a++) {
+                const float *in = data + alignments[a].data;
+                float *out = stream + alignments[a].stream;
+                float *ref = reference + alignments[a].stream;
+                Timing t;
+
+                for (p = 0; p < SDL_arraysize(pannings); p++) {
+                    for (i = 0; i < frames * 2; i++) {
+                        out[i] = ref[i] = (float) (i % 7) * 0.01f;
+                    }
+                    scalar(pannings[p], in, ref, frames);
+                    kernel->fn(pannings[p], in, out, frames);
+                    if (max_difference(out, ref, frames * 2) > MIX_TOLERANCE) {
+                        printf("  %-22s %5d frames %-9s MISMATCH against scalar (max difference %g)\n", kernel->name, frames, alignments[a].name, max_difference(out, ref, frames * 2));
+                        failures++;
+                    }
+                }
+
+                SDL_memset(out, '\0', frames * 2 * sizeof (float));
+                start_timing(&t);
+                for (i = 0; i < iterations; i++) {
+                    kernel->fn(pannings[1], in, out, frames);
+                }
+                stop_timing(&t);
+
+                printf("  %-22s %5d frames %-9s", kernel->name, frames, alignments[a].name);
+                /* reads data, reads and writes the stereo stream. */
+                print_timing(&t, ((double) frames) * iterations, ((double) frames) * iterations * sizeof (float) * (kernel->channels + 4));
+            }
+        }
+    }
+    printf("\n");
+
+    free_simd_aligned(data);
+    free_simd_aligned(reference);
+    free_simd_aligned(stream);
+    return failures;
+}
+
+static int bench_spatializers(ALCcontext *ctx, ALuint *sources, const int numsources)
+{
+    const ALenum models[] = {
+        AL_INVERSE_DISTANCE, AL_INVERSE_DISTANCE_CLAMPED, AL_LINEAR_DISTANCE,
+        AL_LINEAR_DISTANCE_CLAMPED, AL_EXPONENT_DISTANCE, AL_EXPONENT_DISTANCE_CLAMPED
+    };
+    const int iterations = 20000;
+    float reference[OPENAL_SPATIAL_BATCH_SIZE][2];
+    int failures = 0;
+    Timing t;
+    size_t m;
+    int i, j;
+
+    SDL_assert(numsources == OPENAL_SPATIAL_BATCH_SIZE);
+
+    printf("channel gains (per source):\n");
+    for (m = 0; m < SDL_arraysize(models); m++) {
+        alDistanceModel(models[m]);
+        for (i = 0; i < numsources; i++) {
+            calculate_channel_gains(&ctx->listener, ctx->distance_model, get_source(ctx, sources[i], NULL), reference[i]);
+        }
+
+        #if HAVE_SPATIALIZE_BATCH
+        for (j = 0; j < (int) SDL_arraysize(spatial_kernels); j++) {
+            SpatialBatch batch;
+            float maxdiff = 0.0f;
+            if (!spatial_kernels[j].available()) {
+                continue;
+            }
+            spatial_batch_init(&ctx->listener, ctx->distance_model, &batch);
+            for (i = 0; i < numsources; i++) {
+                spatial_batch_add(&ctx->listener, &batch, get_source(ctx, sources[i], NULL)->voice);
+            }
+            spatial_kernels[j].fn(&batch);
+            for (i = 0; i < numsources; i++) {
+                maxdiff = SDL_max(maxdiff, SDL_fabsf(batch.left[i] - reference[i][0]));
+                maxdiff = SDL_max(maxdiff, SDL_fabsf(batch.right[i] - reference[i][1]));
+            }
+            if (maxdiff > GAIN_TOLERANCE) {
+                printf("  %-22s distance model 0x%X MISMATCH against calculate_channel_gains (max difference %g)\n", spatial_kernels[j].name, (unsigned int) models[m], maxdiff);
+                failures++;
+            }
+        }
+        #endif
+    }
+
+    alDistanceModel(AL_INVERSE_DISTANCE_CLAMPED);
+
+    start_timing(&t);
+    for (j = 0; j < iterations; j++) {
+        for (i = 0; i < numsources; i++) {
+            const ALsource *src = get_source(ctx, sources[i], NULL);
+            calculate_channel_gains(&ctx->listener, ctx->distance_model, src, src->voice->panning);
+        }
+    }
+    stop_timing(&t);
+    printf("  %-22s %5d sources", "calculate_channel_gains", numsources);
+    print_timing(&t, ((double) numsources) * iterations, 0.0);
+
+    #if HAVE_SPATIALIZE_BATCH
+    for (i = 0; i < (int) SDL_arraysize(spatial_kernels); i++) {
+        SpatialBatch batch;
+        int s;
+        if (!spatial_kernels[i].available()) {
+            printf("  %-22s (this CPU can't run it)\n", spatial_kernels[i].name);
+            continue;
+        }
+        start_timing(&t);
+        for (j = 0; j < iterations; j++) {  /* this includes gathering the sources into the batch, like the mixer has to. */
+            spatial_batch_init(&ctx->listener, ctx->distance_model, &batch);
+            for (s = 0; s < numsources; s++) {
+                spatial_batch_add(&ctx->listener, &batch, get_source(ctx, sources[s], NULL)->voice);
+            }
+            spatial_kernels[i].fn(&batch);
+        }
+        stop_timing(&t);
+        printf("  %-22s %5d sources", spatial_kernels[i].name, numsources);
+        print_timing(&t, ((double) numsources) * iterations, 0.0);
+    }
+    #endif
+
+    printf("\n");
+    return failures;
+}
+
+static int bench_pitch_shift(const int freq)
+{
+    const int chunks[] = { 64, 256, 1024, 4096 };
+    const int maxchunk = chunks[SDL_arraysize(chunks) - 1];
+    float *input = (float *) SDL_malloc(maxchunk * sizeof (float));
+    float *output = (float *) SDL_malloc(maxchunk * sizeof (float));
+    ALbuffer buffer;
+    SourceVoice voice;
+    size_t c;
+    int i;
+
+    if (!input || !output) {
+        fprintf(stderr, "Out of memory!\n");
+        return 1;
+    }
+
+    for (i = 0; i < maxchunk; i++) {
+        input[i] = (float) (0.5 * SDL_sin(i * 0.05) + 0.25 * SDL_sin(i * 0.31));
+    }
+
+    SDL_zero(buffer);
+    buffer.channels = 1;
+    buffer.frequency = freq;
+
+    init_pitch_tables();
+
+    printf("pitch_shift (per sample, pitch 1.5):\n");
+    for (c = 0; c < SDL_arraysize(chunks); c++) {
+        const int chunk = chunks[c];
+        const int iterations = SDL_max(1, (SAMPLES_PER_RUN / 16) / chunk);  /* the vocoder is slow, don't take all day. */
+        Timing t;
+
+        SDL_zero(voice);
+        voice.pitch = 1.5f;
+        voice.preserve_duration = AL_TRUE;
+        voice.pitchstate = (PitchState *) SDL_calloc(1, sizeof (PitchState));
+        if (!voice.pitchstate) {
+            fprintf(stderr, "Out of memory!\n");
+            return 1;
+        }
+
+        start_timing(&t);
+        for (i = 0; i < iterations; i++) {
+            pitch_shift(&voice, &buffer, chunk, input, output);
+        }
+        stop_timing(&t);
+
+        printf("  %-22s %5d samples  ", "pitch_shift", chunk);
+        print_timing(&t, ((double) chunk) * iterations, ((double) chunk) * iterations * sizeof (float) * 2);
+        SDL_free(voice.pitchstate);
+    }
+    printf("\n");
+
+    SDL_free(input);
+    SDL_free(output);
+    return 0;
+}
+
+static int bench_ring_buffer(void)
+{
+    const int sizes[] = { 64, 1024, 16384 };
+    const int ringsize = 65536;
+    ALCubyte *data = (ALCubyte *) SDL_calloc(1, sizes[SDL_arraysize(sizes) - 1]);
+    RingBuffer ring;
+    size_t s;
+    int i;
+
+    SDL_zero(ring);
+    ring.size = ringsize;
+    ring.buffer = (ALCubyte *) SDL_calloc(1, ringsize);
+    if (!ring.buffer || !data) {
+        fprintf(stderr, "Out of memory!\n");
+        return 1;
+    }
+
+    printf("ring buffer (per byte):\n");
+    for (s = 0; s < SDL_arraysize(sizes); s++) {
+        const int size = sizes[s];
+        const int iterations = SDL_max(1, (SAMPLES_PER_RUN * 4) / size);
+        Timing t;
+
+        start_timing(&t);
+        for (i = 0; i < iterations; i++) {
+            ring_buffer_put(&ring, data, size);
+        }
+        stop_timing(&t);
+        printf("  %-22s %5d bytes    ", "ring_buffer_put", size);
+        print_timing(&t, ((double) size) * iterations, ((double) size) * iterations * 2);
+
+        start_timing(&t);
+        for (i = 0; i < iterations; i++) {
+            ring_buffer_put(&ring, data, size);  /* keep it full; we're timing the get. */
+            ring_buffer_get(&ring, data, size);
+        }
+        stop_timing(&t);
+        printf("  %-22s %5d bytes    ", "ring_buffer_put+get", size);
+        print_timing(&t, ((double) size) * iterations, ((double) size) * iterations * 4);
+    }
+    printf("\n");
+
+    SDL_free(ring.buffer);
+    SDL_free(data);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const int freq = 48000;
+    ALCint attrs[] = {
+        ALC_FREQUENCY, freq,
+        ALC_FORMAT_CHANNELS_SOFT, ALC_STEREO_SOFT,
+        ALC_FORMAT_TYPE_SOFT, ALC_FLOAT_SOFT,
+        0
+    };
+    ALCdevice *device;
+    ALCcontext *ctx;
+    ALuint buffer;
+    ALuint sources[OPENAL_SPATIAL_BATCH_SIZE];
+    Sint16 pcm[256];
+    int failures = 0;
+    int i;
+
+    device = alcLoopbackOpenDeviceSOFT(NULL);
+    ctx = device ? alcCreateContext(device, attrs) : NULL;  /* this also runs select_mixers() and friends. */
+    if (!ctx) {
+        fprintf(stderr, "Couldn't create an OpenAL context!\n");
+        return 1;
+    }
+    alcMakeContextCurrent(ctx);
+
+    SDL_zero(pcm);
+    alGenBuffers(1, &buffer);
+    alBufferData(buffer, AL_FORMAT_MONO16, pcm, sizeof (pcm), freq);
+    alGenSources(SDL_arraysize(sources), sources);
+    for (i = 0; i < (int) SDL_arraysize(sources); i++) {
+        alSourcei(sources[i], AL_BUFFER, buffer);
+        alSource3f(sources[i], AL_POSITION, (ALfloat) (i % 17) - 8.0f, (ALfloat) (i % 3) - 1.0f, (ALfloat) (i % 5) - 2.0f);
+        alSourcef(sources[i], AL_REFERENCE_DISTANCE, 1.0f + (i % 4));
+        alSourcef(sources[i], AL_MAX_DISTANCE, 4.0f + (i % 9));
+        alSourcef(sources[i], AL_ROLLOFF_FACTOR, 0.5f + (i % 3) * 0.5f);
+        alSourcef(sources[i], AL_GAIN, 0.25f + (i % 4) * 0.25f);
+    }
+    alListener3f(AL_POSITION, 0.5f, 0.0f, -0.25f);
+
+    failures += bench_mixers();
+    failures += bench_spatializers(ctx, sources, SDL_arraysize(sources));
+    failures += bench_pitch_shift(freq);
+    failures += bench_ring_buffer();
+
+    alDeleteSources(SDL_arraysize(sources), sources);
+    alDeleteBuffers(1, &buffer);
+    alcMakeContextCurrent(NULL);
+    alcDestroyContext(ctx);
+    alcCloseDevice(device);
+
+    if (failures) {
+        printf("%d SIMD kernel checks FAILED!\n", failures);
+        return 1;
+    }
+
+    printf("All SIMD kernels match their scalar references.\n");
+    return 0;
+}
+
+/* end of benchkernels.c ... */
@@ -0,0 +1,81 @@
+/**
+ * MojoAL; a simple drop-in OpenAL implementation.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+/* This is just test code, you don't need to compile this with MojoAL. */
+
+/* This measures what the AL_PITCH_PRESERVE_DURATION phase vocoder costs per
+   source. It builds mojoal.c right into itself so it can call the vocoder
+   directly, without an audio device or mixer thread getting in the way. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../mojoal.c"
+
+int main(int argc, char **argv)
+{
+    const int freq = 48000;
+    const int chunk = 1024;  /* the mixer works in callbacks this size. */
+    const int seconds = (argc > 1) ? SDL_atoi(argv[1]) : 10;
+    const int total = freq * seconds;
+    const float pitches[] = { 0.5f, 0.9f, 1.1f, 1.5f, 2.0f };
+    float *input = (float *) SDL_malloc(chunk * sizeof (float));
+    float *output = (float *) SDL_malloc(chunk * sizeof (float));
+    ALbuffer buffer;
+    size_t p;
+    int i;
+
+    if (!input || !output) {
+        fprintf(stderr, "Out of memory!\n");
+        return 1;
+    }
+
+    for (i = 0; i < chunk; i++) {
+        input[i] = (float) (0.5 * SDL_sin(i * 0.05) + 0.25 * SDL_sin(i * 0.31));
+    }
+
+    SDL_zero(buffer);
+    buffer.channels = 1;
+    buffer.frequency = freq;
+
+    init_pitch_tables();
+
+    printf("Vocoder cost per mono source, %d seconds of %dHz audio each:\n", seconds, freq);
+    for (p = 0; p < SDL_arraysize(pitches); p++) {
+        SourceVoice voice;
+        Uint64 start, elapsed;
+        double secs;
+        int done;
+
+        SDL_zero(voice);
+        voice.pitch = pitches[p];
+        voice.preserve_duration = AL_TRUE;
+        voice.pitchstate = (PitchState *) SDL_calloc(1, sizeof (PitchState));
+        if (!voice.pitchstate) {
+            fprintf(stderr, "Out of memory!\n");
+            return 1;
+        }
+
+        start = SDL_GetPerformanceCounter();
+        for (done = 0; done < total; done += chunk) {
+            pitch_shift(&voice, &buffer, chunk, input, output);
+        }
+        elapsed = SDL_GetPerformanceCounter() - start;
+        secs = ((double) elapsed) / ((double) SDL_GetPerformanceFrequency());
+
+        printf("  pitch %.2f: %8.1f usec per second of audio (%.3f%% of one core, ~%d sources per core)\n",
+               pitches[p], (secs * 1000000.0) / seconds, (secs / seconds) * 100.0,
+               (secs > 0.0) ? (int) (seconds / secs) : 0);
+
+        SDL_free(voice.pitchstate);
+    }
+
+    SDL_free(input);
+    SDL_free(output);
+    return 0;
+}
+
+/* end of benchvocoder.c ... */
@@ -0,0 +1,111 @@
+/**
+ * MojoAL; a simple drop-in OpenAL implementation.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+/* This is just test code, you don't need to compile this with MojoAL. */
+
+/* This measures the mixer's per-voice overhead with lots of sources playing.
+   It builds mojoal.c right into itself so it can run mix_context() directly
+   on this thread, with the real audio device paused. Every other source is
+   played, so playing voices are scattered through memory like they are in a
+   real game, and a few sources move every callback so the API side keeps
+   writing source state while we mix. Short callbacks and tiny looping
+   buffers keep the sample data small, so what's left is mostly the cost of
+   walking the sources. Pass a fourth argument of 1 to move the listener every
+   callback too, which makes every playing source recalculate its gains. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../mojoal.c"
+
+int main(int argc, char **argv)
+{
+    const int numvoices = (argc > 1) ? SDL_atoi(argv[1]) : 1024;
+    const int frames = (argc > 2) ? SDL_atoi(argv[2]) : 64;
+    const int iterations = (argc > 3) ? SDL_atoi(argv[3]) : 20000;
+    const int move_listener = (argc > 4) ? SDL_atoi(argv[4]) : 0;
+    const int numsources = numvoices * 2;
+    ALCdevice *device;
+    ALCcontext *ctx;
+    ALuint buffers[2];
+    ALuint *sources;
+    float *stream;
+    Sint16 pcm[256];
+    Uint64 start, elapsed;
+    double nsecs;
+    int i;
+
+    if (!SDL_getenv("SDL_AUDIODRIVER")) {
+        SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);  /* we never listen to this. */
+    }
+
+    device = alcOpenDevice(NULL);
+    ctx = device ? alcCreateContext(device, NULL) : NULL;
+    if (!ctx) {
+        fprintf(stderr, "Couldn't create an OpenAL context!\n");
+        return 1;
+    }
+    alcMakeContextCurrent(ctx);
+    SDL_PauseAudioDevice(device->sdldevice, 1);  /* we'll run the mixer ourselves. */
+
+    sources = (ALuint *) SDL_calloc(numsources, sizeof (ALuint));
+    stream = (float *) calloc_simd_aligned(frames * device->framesize);
+    if (!sources || !stream) {
+        fprintf(stderr, "Out of memory!\n");
+        return 1;
+    }
+
+    for (i = 0; i < (int) SDL_arraysize(pcm); i++) {
+        pcm[i] = (Sint16) (SDL_sin(i * 0.1) * 8000.0);
+    }
+
+    alGenBuffers(2, buffers);
+    alBufferData(buffers[0], AL_FORMAT_MONO16, pcm, sizeof (pcm), device->frequency);  /* plays without resampling. */
+    alBufferData(buffers[1], AL_FORMAT_MONO16, pcm, sizeof (pcm), 44100);  /* needs resampling, unless the device is 44.1kHz. */
+
+    alGenSources(numsources, sources);
+    for (i = 0; i < numsources; i++) {
+        alSourcei(sources[i], AL_BUFFER, buffers[(i / 2) % 2]);
+        alSourcei(sources[i], AL_LOOPING, AL_TRUE);
+        alSource3f(sources[i], AL_POSITION, (ALfloat) (i % 17) - 8.0f, 0.0f, (ALfloat) (i % 5) - 2.0f);
+        alSourcef(sources[i], AL_GAIN, 1.0f / numvoices);
+        if ((i % 2) == 0) {
+            alSourcePlay(sources[i]);
+        }
+    }
+
+    for (i = 0; i < 100; i++) {  /* warm up. */
+        mix_context(ctx, stream, frames * device->framesize);
+    }
+
+    start = SDL_GetPerformanceCounter();
+    for (i = 0; i < iterations; i++) {
+        const ALuint mover = sources[(i * 2 * 37) % numsources];
+        alSource3f(mover, AL_POSITION, (ALfloat) (i % 13) - 6.0f, 1.0f, 2.0f);
+        if (move_listener) {
+            alListener3f(AL_POSITION, (ALfloat) (i % 7) - 3.0f, 0.0f, 0.0f);
+        }
+        SDL_memset(stream, '\0', frames * device->framesize);
+        mix_context(ctx, stream, frames * device->framesize);
+    }
+    elapsed = SDL_GetPerformanceCounter() - start;
+    nsecs = (((double) elapsed) * 1000000000.0) / ((double) SDL_GetPerformanceFrequency());
+
+    printf("%d voices playing out of %d sources, %d frames per callback, %d callbacks%s:\n", numvoices, numsources, frames, iterations, move_listener ? ", listener moving" : "");
+    printf("  %.1f usec per callback, %.1f nsec per voice per callback\n", nsecs / iterations / 1000.0, nsecs / iterations / numvoices);
+    printf("  sizeof (SourceVoice) == %d, sizeof (ALsource) == %d\n", (int) sizeof (SourceVoice), (int) sizeof (ALsource));
+
+    alDeleteSources(numsources, sources);
+    alDeleteBuffers(2, buffers);
+    alcMakeContextCurrent(NULL);
+    alcDestroyContext(ctx);
+    alcCloseDevice(device);
+    free_simd_aligned(stream);
+    SDL_free(sources);
+    return 0;
+}
+
+/* end of benchvoices.c ... */
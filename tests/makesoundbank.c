@@ -0,0 +1,180 @@
+/**
+ * MojoAL; a simple drop-in OpenAL implementation.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ *
+ *  This file written by Ryan C. Gordon.
+ */
+
+/* This builds a sound bank for alLoadSoundBank() out of .wav files. Each
+   file becomes one entry, in the order given on the command line. See the
+   comments in mojoal.c for the file format. */
+
+#include <stdio.h>
+
+#include "AL/al.h"
+#include "SDL.h"
+
+#define SOUND_BANK_HEADER_SIZE 16
+#define SOUND_BANK_ENTRY_SIZE 32
+#define SOUND_BANK_DATA_ALIGNMENT 64
+
+#ifndef AL_FORMAT_MONO_FLOAT32
+#define AL_FORMAT_MONO_FLOAT32 0x10010
+#endif
+
+#ifndef AL_FORMAT_STEREO_FLOAT32
+#define AL_FORMAT_STEREO_FLOAT32 0x10011
+#endif
+
+static int pad_to_alignment(SDL_RWops *rw)
+{
+    static const Uint8 zeroes[SOUND_BANK_DATA_ALIGNMENT];
+    const Sint64 pos = SDL_RWtell(rw);
+    const size_t pad = (size_t) ((SOUND_BANK_DATA_ALIGNMENT - (pos % SOUND_BANK_DATA_ALIGNMENT)) % SOUND_BANK_DATA_ALIGNMENT);
+    return (pos >= 0) && ((pad == 0) || (SDL_RWwrite(rw, zeroes, pad, 1) == 1));
+}
+
+/* load a .wav, converted to stereo or mono 16-bit (or float32) at its original rate. */
+static Uint8 *load_wav(const char *fname, const SDL_bool use_float32, ALenum *alfmt, Uint32 *freq, Uint32 *len)
+{
+    const SDL_AudioFormat fmt = use_float32 ? AUDIO_F32LSB : AUDIO_S16LSB;
+    SDL_AudioSpec spec;
+    SDL_AudioCVT cvt;
+    Uint8 *buf = NULL;
+    Uint32 buflen = 0;
+    Uint8 channels;
+    int rc;
+
+    if (!SDL_LoadWAV(fname, &spec, &buf, &buflen)) {
+        fprintf(stderr, "Loading '%s' failed! %s\n", fname, SDL_GetError());
+        return NULL;
+    }
+
+    channels = (spec.channels == 1) ? 1 : 2;
+    rc = SDL_BuildAudioCVT(&cvt, spec.format, spec.channels, spec.freq, fmt, channels, spec.freq);
+    if (rc < 0) {
+        fprintf(stderr, "Can't convert '%s'! %s\n", fname, SDL_GetError());
+        SDL_FreeWAV(buf);
+        return NULL;
+    }
+
+    cvt.len = (int) buflen;
+    cvt.buf = (Uint8 *) SDL_malloc(buflen * cvt.len_mult);
+    if (!cvt.buf) {
+        fprintf(stderr, "Out of memory!\n");
+        SDL_FreeWAV(buf);
+        return NULL;
+    }
+    SDL_memcpy(cvt.buf, buf, buflen);
+    SDL_FreeWAV(buf);
+
+    if (rc == 0) {
+        cvt.len_cvt = cvt.len;
+    } else if (SDL_ConvertAudio(&cvt) < 0) {
+        fprintf(stderr, "Can't convert '%s'! %s\n", fname, SDL_GetError());
+        SDL_free(cvt.buf);
+        return NULL;
+    }
+
+    if (use_float32) {
+        *alfmt = (channels == 1) ? AL_FORMAT_MONO_FLOAT32 : AL_FORMAT_STEREO_FLOAT32;
+    } else {
+        *alfmt = (channels == 1) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16;
+    }
+    *freq = (Uint32) spec.freq;
+    *len = (Uint32) cvt.len_cvt;
+    return cvt.buf;
+}
+
+int main(int argc, char **argv)
+{
+    SDL_bool use_float32 = SDL_FALSE;
+    const char *outname = NULL;
+    const char **wavs;
+    SDL_RWops *rw;
+    Uint32 count = 0;
+    Uint32 entry;
+    int retval = 0;
+    int i;
+
+    wavs = (const char **) SDL_calloc(argc, sizeof (const char *));
+    if (!wavs) {
+        fprintf(stderr, "Out of memory!\n");
+        return 2;
+    }
+
+    for (i = 1; i < argc; i++) {
+        if (SDL_strcmp(argv[i], "--float32") == 0) {
+            use_float32 = SDL_TRUE;
+        } else if (!outname) {
+            outname = argv[i];
+        } else {
+            wavs[count++] = argv[i];
+        }
+    }
+
+    if (!outname || !count) {
+        fprintf(stderr, "USAGE: %s [--float32] <outfile.bank> <file1.wav> [file2.wav ...]\n", argv[0]);
+        SDL_free(wavs);
+        return 1;
+    }
+
+    if (SDL_Init(0) == -1) {
+        fprintf(stderr, "SDL_Init(0) failed: %s\n", SDL_GetError());
+        SDL_free(wavs);
+        return 2;
+    }
+
+    rw = SDL_RWFromFile(outname, "wb");
+    if (!rw) {
+        fprintf(stderr, "Couldn't open '%s' for writing: %s\n", outname, SDL_GetError());
+        SDL_free(wavs);
+        SDL_Quit();
+        return 3;
+    }
+
+    /* header, then skip the entries; we fill them in once we know where everything landed. */
+    SDL_RWwrite(rw, "MOJOBANK", 8, 1);
+    SDL_WriteLE32(rw, 1);
+    SDL_WriteLE32(rw, count);
+    SDL_RWseek(rw, SOUND_BANK_HEADER_SIZE + (count * SOUND_BANK_ENTRY_SIZE), RW_SEEK_SET);
+
+    for (entry = 0; (entry < count) && !retval; entry++) {
+        ALenum alfmt;
+        Uint32 freq, len;
+        Sint64 pos;
+        Uint8 *buf = load_wav(wavs[entry], use_float32, &alfmt, &freq, &len);
+
+        if (!buf) {
+            retval = 4;
+        } else if (!pad_to_alignment(rw) || ((pos = SDL_RWtell(rw)) < 0) || (len && (SDL_RWwrite(rw, buf, len, 1) != 1))) {
+            fprintf(stderr, "Couldn't write '%s': %s\n", outname, SDL_GetError());
+            retval = 5;
+        } else {
+            const Sint64 endpos = SDL_RWtell(rw);
+            SDL_RWseek(rw, SOUND_BANK_HEADER_SIZE + (entry * SOUND_BANK_ENTRY_SIZE), RW_SEEK_SET);
+            SDL_WriteLE32(rw, (Uint32) alfmt);
+            SDL_WriteLE32(rw, freq);
+            SDL_WriteLE64(rw, (Uint64) pos);
+            SDL_WriteLE64(rw, (Uint64) len);
+            SDL_WriteLE32(rw, 0);  /* block alignment, only for compressed formats. */
+            SDL_WriteLE32(rw, 0);  /* reserved */
+            SDL_RWseek(rw, endpos, RW_SEEK_SET);
+            printf("%u: '%s', %u bytes at %u Hz\n", (unsigned int) entry, wavs[entry], (unsigned int) len, (unsigned int) freq);
+        }
+
+        SDL_free(buf);
+    }
+
+    if (SDL_RWclose(rw) < 0) {
+        fprintf(stderr, "Couldn't write '%s': %s\n", outname, SDL_GetError());
+        retval = 5;
+    }
+
+    SDL_free(wavs);
+    SDL_Quit();
+    return retval;
+}
+
+/* end of makesoundbank.c ... */
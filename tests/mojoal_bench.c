@@ -0,0 +1,223 @@
+/**
+ * MojoAL; a simple drop-in OpenAL implementation.
+ *
+ * Please see the file LICENSE.txt in the source's root directory.
+ */
+
+/* This is just test code, you don't need to compile this with MojoAL. */
+
+/* This is a headless benchmark of the whole mixer. It opens an
+   ALC_SOFT_loopback device, so no sound card is needed, and renders a few
+   seconds of audio with alcRenderSamplesSOFT() for every combination of
+   source count, mono vs stereo buffers, native vs resampled rate, pitch on or
+   off, and spatialized or not (stereo buffers are never spatialized, so those
+   cases are skipped). In the spatialized cases the listener turns a little
+   every render call, like a game camera does, so those cases also pay for
+   recalculating gains.
+
+   Results go to stdout as JSON, so scripts can compare them between releases.
+   "ns_per_frame" is the wall clock time it took to render one output frame, and
+   "voices_per_core" is how many voices of that kind one core could mix in
+   realtime at this rate, if it did nothing else.
+
+   Usage: mojoal_bench [seconds] [frequency] [frames_per_render] [max_voices] */
+
+#include <stdio.h>
+
+#include "AL/al.h"
+#include "AL/alc.h"
+#include "SDL.h"
+
+static const int voice_counts[] = { 1, 16, 64, 256, 1024 };
+
+static int check_openal_error(const char *where)
+{
+    const ALenum err = alGetError();
+    if (err != AL_NONE) {
+        fprintf(stderr, "OpenAL Error at %s! %s (%u)\n", where, alGetString(err), (unsigned int) err);
+        return 1;
+    }
+    return 0;
+}
+
+static void render(ALCdevice *device, float *stream, const int frames, const int total_frames, const int turn_listener)
+{
+    int rendered = 0;
+    int i = 0;
+    while (rendered < total_frames) {
+        const int todo = SDL_min(frames, total_frames - rendered);
+        if (turn_listener) {
+            const float angle = ((float) (i++ % 360)) * (M_PI / 180.0f);
+            const ALfloat orientation[6] = { SDL_sinf(angle), 0.0f, -SDL_cosf(angle), 0.0f, 1.0f, 0.0f };
+            alListenerfv(AL_ORIENTATION, orientation);
+        }
+        alcRenderSamplesSOFT(device, stream, todo);
+        rendered += todo;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const double seconds = (argc > 1) ? SDL_atof(argv[1]) : 2.0;
+    const int freq = (argc > 2) ? SDL_atoi(argv[2]) : 48000;
+    const int frames = (argc > 3) ? SDL_atoi(argv[3]) : 512;
+    const int max_voices = (argc > 4) ? SDL_atoi(argv[4]) : 1024;
+    const int resampled_freq = (freq == 44100) ? 48000 : 44100;
+    const int total_frames = (int) (seconds * freq);
+    ALCint attrs[] = {
+        ALC_FREQUENCY, freq,
+        ALC_FORMAT_CHANNELS_SOFT, ALC_STEREO_SOFT,
+        ALC_FORMAT_TYPE_SOFT, ALC_FLOAT_SOFT,
+        0
+    };
+    ALCdevice *device;
+    ALCcontext *ctx;
+    ALuint buffers[2][2];  /* [mono/stereo][native/resampled] */
+    ALuint *sources;
+    float *stream;
+    Sint16 *pcm;
+    int first = 1;
+    int channels, resampled, pitched, spatialized, v;
+    int i;
+
+    if ((seconds <= 0.0) || (freq <= 0) || (frames <= 0) || (max_voices <= 0)) {
+        fprintf(stderr, "USAGE: %s [seconds] [frequency] [frames_per_render] [max_voices]\n", argv[0]);
+        return 1;
+    }
+
+    if (!alcIsExtensionPresent(NULL, "ALC_SOFT_loopback")) {
+        fprintf(stderr, "This OpenAL doesn't support ALC_SOFT_loopback!\n");
+        return 1;
+    }
+
+    device = alcLoopbackOpenDeviceSOFT(NULL);
+    if (!device) {
+        fprintf(stderr, "Couldn't open a loopback device!\n");
+        return 1;
+    } else if (!alcIsRenderFormatSupportedSOFT(device, freq, ALC_STEREO_SOFT, ALC_FLOAT_SOFT)) {
+        fprintf(stderr, "Loopback device can't render float32 stereo at %dHz!\n", freq);
+        alcCloseDevice(device);
+        return 1;
+    }
+
+    ctx = alcCreateContext(device, attrs);
+    if (!ctx) {
+        fprintf(stderr, "Couldn't create an OpenAL context!\n");
+        alcCloseDevice(device);
+        return 1;
+    }
+    alcMakeContextCurrent(ctx);
+
+    sources = (ALuint *) SDL_calloc(max_voices, sizeof (ALuint));
+    stream = (float *) SDL_malloc(frames * sizeof (float) * 2);
+    pcm = (Sint16 *) SDL_malloc(SDL_max(freq, resampled_freq) * sizeof (Sint16) * 2);  /* one second of the larger rate, in stereo. */
+    if (!sources || !stream || !pcm) {
+        fprintf(stderr, "Out of memory!\n");
+        return 1;
+    }
+
+    /* a second of (not quite) looping tone, for each format. Content doesn't matter to the mixer, but keep it from clipping. */
+    for (channels = 1; channels <= 2; channels++) {
+        for (resampled = 0; resampled <= 1; resampled++) {
+            const int rate = resampled ? resampled_freq : freq;
+            for (i = 0; i < rate * channels; i++) {
+                pcm[i] = (Sint16) (SDL_sinf((float) (i / channels) * 0.0627f) * 8000.0f);
+            }
+            alGenBuffers(1, &buffers[channels - 1][resampled]);
+            alBufferData(buffers[channels - 1][resampled], (channels == 1) ? AL_FORMAT_MONO16 : AL_FORMAT_STEREO16, pcm, rate * channels * sizeof (Sint16), rate);
+        }
+    }
+    SDL_free(pcm);
+
+    if (check_openal_error("buffer setup")) {
+        return 1;
+    }
+
+    printf("{\n");
+    printf("  \"benchmark\": \"mojoal_bench\",\n");
+    printf("  \"renderer\": \"%s\",\n", alGetString(AL_RENDERER));
+    printf("  \"version\": \"%s\",\n", alGetString(AL_VERSION));
+    printf("  \"frequency\": %d,\n", freq);
+    printf("  \"resampled_frequency\": %d,\n", resampled_freq);
+    printf("  \"frames_per_render\": %d,\n", frames);
+    printf("  \"seconds\": %g,\n", seconds);
+    printf("  \"results\": [");
+
+    for (v = 0; v < (int) SDL_arraysize(voice_counts); v++) {
+        const int numvoices = voice_counts[v];
+        if (numvoices > max_voices) {
+            break;
+        }
+
+        alGenSources(numvoices, sources);
+        if (check_openal_error("alGenSources")) {
+            return 1;
+        }
+
+        for (channels = 1; channels <= 2; channels++) {
+            for (resampled = 0; resampled <= 1; resampled++) {
+                for (pitched = 0; pitched <= 1; pitched++) {
+                    for (spatialized = 0; spatialized <= 1; spatialized++) {
+                        Uint64 start, elapsed;
+                        double nsecs;
+
+                        if (spatialized && (channels == 2)) {
+                            continue;  /* stereo buffers never spatialize. */
+                        }
+
+                        alListener3f(AL_POSITION, 0.0f, 0.0f, 0.0f);
+                        for (i = 0; i < numvoices; i++) {
+                            const ALuint sid = sources[i];
+                            alSourceStop(sid);
+                            alSourcei(sid, AL_BUFFER, buffers[channels - 1][resampled]);
+                            alSourcei(sid, AL_LOOPING, AL_TRUE);
+                            alSourcef(sid, AL_GAIN, 1.0f / numvoices);
+                            alSourcef(sid, AL_PITCH, pitched ? 1.1f : 1.0f);
+                            alSourcef(sid, AL_ROLLOFF_FACTOR, spatialized ? 1.0f : 0.0f);
+                            alSource3f(sid, AL_POSITION, (ALfloat) (i % 17) - 8.0f, 0.0f, (ALfloat) (i % 5) - 2.0f);
+                            alSourcei(sid, AL_SAMPLE_OFFSET, (i * 331) % SDL_min(freq, resampled_freq));  /* don't have every voice at the same place. */
+                        }
+                        alSourcePlayv(numvoices, sources);
+                        if (check_openal_error("source setup")) {
+                            return 1;
+                        }
+
+                        render(device, stream, frames, SDL_min(total_frames, freq / 10), spatialized);  /* warm up. */
+
+                        start = SDL_GetPerformanceCounter();
+                        render(device, stream, frames, total_frames, spatialized);
+                        elapsed = SDL_GetPerformanceCounter() - start;
+                        nsecs = (((double) elapsed) * 1000000000.0) / ((double) SDL_GetPerformanceFrequency());
+                        if (nsecs <= 0.0) {
+                            nsecs = 1.0;
+                        }
+
+                        printf("%s\n    { \"voices\": %d, \"channels\": %d, \"resampled\": %s, \"pitched\": %s, \"spatialized\": %s, "
+                               "\"frames\": %d, \"ns_per_frame\": %.3f, \"ns_per_voice_frame\": %.4f, \"realtime_ratio\": %.3f, \"voices_per_core\": %.1f }",
+                               first ? "" : ",", numvoices, channels,
+                               resampled ? "true" : "false", pitched ? "true" : "false", spatialized ? "true" : "false",
+                               total_frames, nsecs / total_frames, nsecs / total_frames / numvoices,
+                               (seconds * 1000000000.0) / nsecs, numvoices * ((seconds * 1000000000.0) / nsecs));
+                        fflush(stdout);
+                        first = 0;
+                    }
+                }
+            }
+        }
+
+        alSourceStopv(numvoices, sources);
+        alDeleteSources(numvoices, sources);
+    }
+
+    printf("\n  ]\n}\n");
+
+    alDeleteBuffers(4, &buffers[0][0]);
+    alcMakeContextCurrent(NULL);
+    alcDestroyContext(ctx);
+    alcCloseDevice(device);
+    SDL_free(stream);
+    SDL_free(sources);
+    return 0;
+}
+
+/* end of mojoal_bench.c ... */